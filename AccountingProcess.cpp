@@ -35,9 +35,16 @@ void AccountingProcess::Accounting(PluginContext * context) {
 	int command, //The command from foreground process.
 			result; //The result from the socket.
 	string key; //The unique key.
-	AcctScheduler scheduler; //The scheduler for the accounting.
+	int slot; //The slot of the user in the session table.
+	User session; //The user as read from the session table.
+	AcctScheduler scheduler(&context->acctjournal); //The scheduler for the accounting.
 	fd_set set; //A set for the select function.
+	fd_set writeset; //A set of the sockets to write for the select function.
+	StatsServer stats; //The stats socket.
+	long long nextstats = 0; //The time when the snapshots of the stats socket are renewed.
 	struct timeval tv; //A timeinterval for the select funtion.
+	long long start; //The start time of a measured stage.
+	long long nextmetrics = 0; //The time when the metrics are logged.
 
 
 	//Tell the parent everythink is ok.
@@ -51,21 +58,67 @@ void AccountingProcess::Accounting(PluginContext * context) {
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Started, RESPONSE_INIT_SUCCEEDED was sent to Foreground Process.\n";
 
+	//open the spool, the packets of the last run which weren't answered are sent again,
+	//in the thread model it was opened before OpenVPN dropped the root rights
+	if (context->conf.getAcctSpool() != "") {
+		if (!context->acctspool.isOpen())
+			context->acctspool.open(context, context->conf.getAcctSpool(), context->conf.getAcctSpoolSize(), context->conf.getAcctSpoolSync());
+		if (context->acctspool.start() != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Spool could not be opened, the packets are sent directly.\n";
+		}
+	}
+
+	//stop the sessions which weren't stopped by the last accounting process
+	if (context->conf.getSessionState() != "") {
+		if (scheduler.recoverSessions(context) < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Journal could not be opened, the sessions are not saved.\n";
+		}
+	}
+
+	//without the spool file the interim updates and the stop packets are spooled in the memory,
+	//so a slow radius server doesn't delay the commands of the foreground process,
+	//the recovered sessions were stopped directly before
+	if (!context->acctspool.isOpen()) {
+		long size = context->conf.getAcctSpoolSize() > SPOOL_MEMORY_SIZE ? context->conf.getAcctSpoolSize() : SPOOL_MEMORY_SIZE;
+		if (context->acctspool.open(context, "", size, context->conf.getAcctSpoolSync()) != 0 || context->acctspool.start() != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Spool in the memory could not be opened, the packets are sent directly.\n";
+		}
+	}
+
+
+	//open the stats socket
+	if (context->conf.getStatsSocket() != "") {
+		if (stats.open(context->conf.getStatsSocket()) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Stats socket " << context->conf.getStatsSocket() << " could not be opened.\n";
+		}
+	}
+
 
 	// Event loop
 	while (1) {
 		//create the informations for the result function
+		//wait 0,5s, but only STOP_IDLE if stops are queued, they are sent when no further command came
 		tv.tv_sec = 0;
-		tv.tv_usec = 500000; //wait 0,5s
+		tv.tv_usec = scheduler.getQueuedStops() > 0 ? STOP_IDLE : 500000;
 		FD_ZERO(&set); // clear out the set
-		FD_SET(context->acctsocketforegr.getSocket(), &set); // wait only on the socket from the foreground process
-		result = select(FD_SETSIZE, &set, NULL, NULL, &tv);
+		FD_ZERO(&writeset);
+		FD_SET(context->acctsocketforegr.getSocket(), &set); // wait on the socket from the foreground process
+		stats.fillSets(&set, &writeset); // and on the clients of the stats socket
+		result = select(FD_SETSIZE, &set, &writeset, NULL, &tv);
 		
+		//answer the clients of the stats socket with the last snapshot
+		if (result > 0) {
+			stats.handle(&set, &writeset);
+		}
 		
 		//if there is a data on the socket
-		if (result > 0) {
-			// get a command from foreground process
-			command = context->acctsocketforegr.recvInt();
+		if (result > 0 && FD_ISSET(context->acctsocketforegr.getSocket(), &set)) {
+			// get a command from foreground process, the users are stopped if the socket was closed
+			try {
+				command = context->acctsocketforegr.recvInt();
+			} catch (Exception &e) {
+				command = -1;
+			}
 
 			if (DEBUG (context->getVerbosity()))
 				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Get a command.\n";
@@ -78,29 +131,39 @@ void AccountingProcess::Accounting(PluginContext * context) {
 						if (DEBUG (context->getVerbosity()))
 							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: New User.\n";
 
+						//allocate memory
+						user = new UserAcct;
+
+
+						//get the slot from the foreground process and the information from the session table,
+						//the slot is read before the foreground process gets a response
+						slot = context->acctsocketforegr.recvInt();
+						if (context->sessions.readUser(slot, user) != 0) {
+							slot = -1;
+						}
+
 
 						// if accounting errors are non fatal return success and proceed with accounting
 						if (context->conf.getNonFatalAccounting() == true)
 							context->acctsocketforegr.send(RESPONSE_SUCCEEDED);
 
+						if (slot < 0) {
+							throw Exception("No user in the session table.\n");
+						}
 
-						//allocate memory
-						user = new UserAcct;
-
+						//a disconnected user with the same key is stopped first, the journal has one record per key,
+						//else only the routes of the disconnected users are deleted, the new user may get them
+						if (scheduler.isQueued(user->getKey())) {
+							scheduler.stopQueuedUsers(context);
+						} else {
+							scheduler.delQueuedRoutes(context);
+						}
 
-						//get the information from the foreground process
-						user->setUsername(context->acctsocketforegr.recvStr());
-						user->setSessionId(context->acctsocketforegr.recvStr());
-						user->setPortnumber(context->acctsocketforegr.recvInt());
-						user->setCallingStationId(context->acctsocketforegr.recvStr());
-						user->setFramedIp(context->acctsocketforegr.recvStr());
-						user->setCommonname(context->acctsocketforegr.recvStr());
-						user->setAcctInterimInterval(context->acctsocketforegr.recvInt());
-						user->setFramedRoutes(context->acctsocketforegr.recvStr());
-						user->setKey(context->acctsocketforegr.recvStr());
-						user->setStatusFileKey(context->acctsocketforegr.recvStr());
-						user->setUntrustedPort(context->acctsocketforegr.recvStr());
-						context->acctsocketforegr.recvBuf(user);
+						//the vendor specific attributes are in the attribute blob
+						string vsa = user->getAttributes()->getString(BLOB_VSA);
+						if (vsa.size() > 0) {
+							user->appendVsaBuf((Octet *) vsa.data(), vsa.size());
+						}
 						if (DEBUG (context->getVerbosity()))
 							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: New user acct: username: " << user->getUsername() << ", interval: "
 									<< user->getAcctInterimInterval() << ", calling station: " << user->getCallingStationId() << ", commonname: "
@@ -109,14 +172,18 @@ void AccountingProcess::Accounting(PluginContext * context) {
 
 						//set the starttime
 						user->setStarttime(time(NULL));
+						user->setLastUpdate(user->getStarttime());
 
 
 						//calculate the nextupdate
-						user->setNextUpdate(user->getStarttime() + user->getAcctInterimInterval());
+						scheduler.scheduleFirstUpdate(context, user);
 
 
 						//send the start packet
-						if (user->sendStartPacket(context) == 0) {
+						start = monotonicTime();
+						int sent = user->sendStartPacket(context);
+						traceSpan("acct start", user->getTraceId(), start);
+						if (sent == 0) {
 
 							if (DEBUG (context->getVerbosity()))
 								cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Start packet was send.\n";
@@ -125,15 +192,22 @@ void AccountingProcess::Accounting(PluginContext * context) {
 								cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: User was added to accounting scheduler.\n";
 
 
+							context->metrics.add(METRIC_ACCT_STARTED);
+
 							//set the system routes
+							start = monotonicTime();
 							user->addSystemRoutes(context);
+							context->metrics.record(METRIC_ROUTES, monotonicTime() - start);
 
 							string script = context->conf.getVsaScript();
 							//execute vendor specific attribute script
 							if (script.length() > 0) {
 								if (DEBUG (context->getVerbosity()))
 									cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Call vendor specific attribute script.\n";
-								if (callVsaScript(context, user, 1, 0) != 0) {
+								start = monotonicTime();
+								result = callVsaScript(context, user, 1, 0);
+								context->metrics.record(METRIC_VSA_SCRIPT, monotonicTime() - start);
+								if (result != 0) {
 									throw Exception("Vendor specific attribute script failed.\n");
 								}
 							}
@@ -178,14 +252,14 @@ void AccountingProcess::Accounting(PluginContext * context) {
 						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Delete user from accounting.\n";
 
 
-					// if accounting errors are non fatal return success
-					if (context->conf.getNonFatalAccounting() == true)
-						context->acctsocketforegr.send(RESPONSE_SUCCEEDED);
-
-
-					//receive the information
+					//receive the slot and read the key from the session table,
+					//the foreground process releases the slot after the response
+					key = "";
 					try {
-						key = context->acctsocketforegr.recvStr();
+						slot = context->acctsocketforegr.recvInt();
+						if (context->sessions.readUser(slot, &session) == 0) {
+							key = session.getKey();
+						}
 					} catch (Exception &e) {
 						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: " << e << "!\n";
 						//close the background process, if the ipc socket is bad
@@ -197,6 +271,11 @@ void AccountingProcess::Accounting(PluginContext * context) {
 					}
 
 
+					// if accounting errors are non fatal return success
+					if (context->conf.getNonFatalAccounting() == true)
+						context->acctsocketforegr.send(RESPONSE_SUCCEEDED);
+
+
 					//find the user, he must be already there
 					user = scheduler.findUser(key.c_str());
 
@@ -204,10 +283,12 @@ void AccountingProcess::Accounting(PluginContext * context) {
 						if (DEBUG (context->getVerbosity()))
 							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Stop acct: username: " << user->getUsername() << ", calling station: "
 									<< user->getCallingStationId() << ", commonname: " << user->getCommonname() << ".\n";
+						long long stopstart = monotonicTime();
 
 
-						//delete the system routes
-						user->delSystemRoutes(context);
+						//send the parent process the ok, the user is stopped with the next batch
+						if (context->conf.getNonFatalAccounting() == false)
+							context->acctsocketforegr.send(RESPONSE_SUCCEEDED);
 
 
 						//delete the ccd file which was created at authentication
@@ -219,29 +300,21 @@ void AccountingProcess::Accounting(PluginContext * context) {
 							//string command= context->conf.getVsaScript() + string(" ") + string("ACTION=CLIENT_CONNECT")+string(" ")+string("USERNAME=")+user->getUsername()+string(" ")+string("COMMONNAME=")+user->getCommonname()+string(" ")+string("UNTRUSTED_IP=")+user->getCallingStationId() + string(" ") + string("UNTRUSTED_PORT=") + user->getUntrustedPort() + user->getVsaString();
 							if (DEBUG (context->getVerbosity()))
 								cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Call vendor specific attribute script.\n";
-							if (callVsaScript(context, user, 2, 0) != 0) {
-								throw Exception("Vendor specific attribute script failed.\n");
+							start = monotonicTime();
+							result = callVsaScript(context, user, 2, 0);
+							context->metrics.record(METRIC_VSA_SCRIPT, monotonicTime() - start);
+							if (result != 0) {
+								cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Vendor specific attribute script failed.\n";
 							}
 						}
 
-						try {
-							//delete the user from the accounting scheduler
-							scheduler.delUser(context, user);
-
-							if (DEBUG (context->getVerbosity()))
-								cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: User with key: " << key << " was deleted from accounting.\n";
-
+						//remove the user from the accounting scheduler, the routes are deleted
+						//and the stop packet is sent with the other disconnected users
+						scheduler.queueStop(user);
+						traceSpan("acct stop", session.getTraceId(), stopstart);
 
-							//send the parent process the ok
-							if (context->conf.getNonFatalAccounting() == false)
-								context->acctsocketforegr.send(RESPONSE_SUCCEEDED);
-
-						} catch (Exception &e) {
-							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: " << e << "\n";
-							goto done;
-						} catch (...) {
-							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Unknown Exception!\n";
-						}
+						if (DEBUG (context->getVerbosity()))
+							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: User with key: " << key << " was queued for the stop.\n";
 					} else {
 						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: No user with this key " << key << ".\n";
 						if (context->conf.getNonFatalAccounting() == false)
@@ -259,7 +332,7 @@ void AccountingProcess::Accounting(PluginContext * context) {
 
 				case -1:
 					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND: read error on command channel.\n";
-					break;
+					goto done;
 
 				default:
 					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND: unknown command code: code= " << command << ", exiting.\n";
@@ -267,14 +340,49 @@ void AccountingProcess::Accounting(PluginContext * context) {
 
 			}
 		}
+		//stop the disconnected users if no command came for STOP_IDLE, the batch is full or the first one waited STOP_DELAY
+		if (scheduler.getQueuedStops() > 0 && (result == 0 || scheduler.getQueuedStops() >= STOP_BATCH || monotonicTime() - scheduler.getQueuedSince() >= STOP_DELAY)) {
+			scheduler.stopQueuedUsers(context);
+		}
+
 		//after 0,5sec without a command call the scheduler
 		scheduler.doAccounting(context);
 
+		//renew the snapshots of the stats socket, a request only copies them
+		if (stats.isOpen() && monotonicTime() >= nextstats) {
+			context->metrics.set(METRIC_STOP_QUEUE_LENGTH, scheduler.getQueuedStops());
+			context->metrics.set(METRIC_SPOOL_PENDING, context->acctspool.isOpen() ? context->acctspool.getPending() : 0);
+			context->metrics.set(METRIC_SCHEDULED_USERS, scheduler.getUsers());
+			context->metrics.set(METRIC_NEXT_UPDATE, scheduler.getNextUpdate());
+			stats.setSnapshots(context->metrics.formatPrometheus(context->radiusconf.getRadiusServer()),
+					context->metrics.formatJson(context->radiusconf.getRadiusServer()));
+			nextstats = monotonicTime() + STATS_REFRESH;
+		}
+
+		//log a snapshot of the metrics of all processes
+		if (context->conf.getMetricsInterval() > 0 && monotonicTime() >= nextmetrics) {
+			if (nextmetrics > 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Metrics:\n" << context->metrics.format(context->radiusconf.getRadiusServer());
+			}
+			nextmetrics = monotonicTime() + context->conf.getMetricsInterval() * 1000000LL;
+		}
 	}
 	done:
-	//end the process
+	//end the process, the stop packets are sent until the shutdown deadline
+	if (context->conf.getShutdownDeadline() > 0) {
+		long long deadline = monotonicTime() + context->conf.getShutdownDeadline() * 1000000LL;
+		scheduler.setDeadline(deadline);
+		context->acctspool.setDeadline(deadline);
+	}
+	//the spool in the memory is lost at the exit, it is closed first and the stop packets of the users
+	//are sent directly until the deadline, so the unanswered ones stay in the journal
+	if (!context->acctspool.isDurable())
+		context->acctspool.close();
 	if (1)
 		scheduler.delallUsers(context);
+	scheduler.closeJournal();
+	context->acctspool.close();
+	stats.close();
 	cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: EXIT\n";
 	return;
 }
@@ -302,6 +410,7 @@ void AccountingProcess::Accounting(PluginContext * context) {
 
 int AccountingProcess::callVsaScript(PluginContext * context, User * user, unsigned int action, unsigned int rekeying) {
 	char * route;
+	char * save;
 	int buflen = 3 * sizeof(int);
 	if (user->getUsername().length() != 0) {
 		buflen = buflen + user->getUsername().length() + 2 * sizeof(int);
@@ -325,9 +434,9 @@ int AccountingProcess::callVsaScript(PluginContext * context, User * user, unsig
 	char routes[user->getFramedRoutes().length() + 1];
 	strncpy(routes, user->getFramedRoutes().c_str(), user->getFramedRoutes().length());
 	routes[user->getFramedRoutes().length()] = 0;
-	if ((route = strtok(routes, ";")) != NULL) {
+	if ((route = strtok_r(routes, ";", &save)) != NULL) {
 		buflen = buflen + strlen(route) + 2 * sizeof(int);
-		while ((route = strtok(NULL, ";")) != NULL) {
+		while ((route = strtok_r(NULL, ";", &save)) != NULL) {
 			buflen = buflen + strlen(route) + 2 * sizeof(int);
 		}
 	}
@@ -397,7 +506,7 @@ int AccountingProcess::callVsaScript(PluginContext * context, User * user, unsig
 	strncpy(routes, user->getFramedRoutes().c_str(), user->getFramedRoutes().length());
 
 	routes[user->getFramedRoutes().length()] = 0;
-	if ((route = strtok(routes, ";")) != NULL) {
+	if ((route = strtok_r(routes, ";", &save)) != NULL) {
 		value = htonl(106);
 		memcpy(buf + i, &value, 4);
 		i += 4;
@@ -406,7 +515,7 @@ int AccountingProcess::callVsaScript(PluginContext * context, User * user, unsig
 		i += 4;
 		memcpy(buf + i, route, strlen(route));
 		i = i + strlen(route);
-		while ((route = strtok(NULL, ";")) != NULL) {
+		while ((route = strtok_r(NULL, ";", &save)) != NULL) {
 			value = htonl(106);
 			memcpy(buf + i, &value, 4);
 			i += 4;
@@ -444,13 +553,12 @@ int AccountingProcess::callVsaScript(PluginContext * context, User * user, unsig
 		cerr << getTime() << "RADIUS-PLUGIN: Error in opening pipe to VSAScript.";
 		return -1;
 	}
-	string exe = string(context->conf.getVsaScript()) + " " + string(context->conf.getVsaNamedPipe());
 	if (write(fd_fifo, buf, buflen) != buflen) {
 		cerr << getTime() << "RADIUS-PLUGIN: Could not write in Pipe to VSAScript!";
 		return -1;
 	}
 
-	if (system(exe.c_str()) != 0) {
+	if (context->privhelper.vsaScript() != 0) {
 		cerr << getTime() << "RADIUS-PLUGIN: Error in VSAScript!";
 		return -1;
 	}
@@ -26,6 +26,7 @@
 #include "PluginContext.h"
 #include "UserAcct.h"
 #include "AcctScheduler.h"
+#include "StatsServer.h"
 #include "radiusplugin.h"
 
 /** The class represents the background process for accounting. */
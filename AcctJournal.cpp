@@ -0,0 +1,556 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "AcctJournal.h"
+#include "UserAcct.h"
+#include "radiusplugin.h"
+#include <fstream>
+#include <sstream>
+
+/** The header of the snapshot file.*/
+struct JournalHeader {
+	uint32_t magic; /**< JOURNAL_MAGIC.*/
+	uint32_t version; /**< JOURNAL_VERSION.*/
+	uint32_t count; /**< The number of sessions.*/
+	uint32_t generation; /**< The generation of the snapshot, the snapshot file with the higher one is newer.*/
+};
+
+/** The constructor of the class, the journal isn't open.*/
+AcctJournal::AcctJournal() {
+	this->fd = -1;
+	this->snapfd[0] = -1;
+	this->snapfd[1] = -1;
+	this->current = 0;
+	this->generation = 0;
+	this->records = 0;
+}
+
+/** The destructor closes the log.*/
+AcctJournal::~AcctJournal() {
+	this->close();
+}
+
+/** The method opens or creates the snapshot files and the log, they are read by load().
+ * In the thread model it is called before OpenVPN drops the root rights.
+ * @param filename The name of the snapshot file, the second snapshot has the suffix .alt, the log .wal.
+ * @return 0 or -1 if a file can't be opened.
+ */
+int AcctJournal::open(string filename) {
+	int i;
+
+	this->filename = filename;
+	for (i = 0; i < 2; i++) {
+		this->snapfd[i] = ::open(this->getSnapshotName(i).c_str(), O_RDWR | O_CREAT, 0600);
+		if (this->snapfd[i] < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal snapshot " << this->getSnapshotName(i) << " could not opened: " << strerror(errno) << ".\n";
+			this->close();
+			return -1;
+		}
+		fcntl(this->snapfd[i], F_SETFD, FD_CLOEXEC);
+	}
+	this->fd = ::open((filename + ".wal").c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (this->fd < 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << filename << ".wal could not opened: " << strerror(errno) << ".\n";
+		this->close();
+		return -1;
+	}
+	fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+
+	//the files may be new
+	this->syncDirectory();
+	return 0;
+}
+
+/** The method reads the newer complete snapshot and the log.
+ * @param sessions The map for the sessions which were active when the journal was written last.
+ */
+void AcctJournal::load(map<string, UserAcct> * sessions) {
+	map<string, UserAcct> snapshots[2];
+	uint32_t generations[2];
+	bool valid[2];
+	string data;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		valid[i] = readFile(this->snapfd[i], &data) == 0 && this->parse(data, this->getSnapshotName(i), true, &snapshots[i], &generations[i]) >= 0;
+	}
+
+	//the next checkpoint overwrites the other snapshot
+	this->current = 0;
+	this->generation = 0;
+	if (valid[1] && (!valid[0] || (int32_t) (generations[1] - generations[0]) > 0)) {
+		this->current = 1;
+	}
+	if (valid[this->current]) {
+		*sessions = snapshots[this->current];
+		this->generation = generations[this->current];
+	}
+
+	this->records = 0;
+	if (readFile(this->fd, &data) == 0) {
+		this->records = this->parse(data, this->filename + ".wal", false, sessions, NULL);
+	}
+
+	//an empty log or a log of another version starts again with the version
+	if (this->records == 0) {
+		if (ftruncate(this->fd, 0) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal could not cleared: " << strerror(errno) << ".\n";
+		}
+		this->appendFormat();
+	}
+}
+
+/** The method closes the log and the snapshot files.*/
+void AcctJournal::close(void) {
+	int i;
+
+	if (this->fd >= 0) {
+		::close(this->fd);
+		this->fd = -1;
+	}
+	for (i = 0; i < 2; i++) {
+		if (this->snapfd[i] >= 0) {
+			::close(this->snapfd[i]);
+			this->snapfd[i] = -1;
+		}
+	}
+}
+
+/** The method checks if the journal is open.
+ * @return True if the journal is open.
+ */
+bool AcctJournal::isOpen(void) {
+	return (this->fd >= 0);
+}
+
+/** The getter method for the number of records in the log.
+ * @return The number of records.
+ */
+int AcctJournal::getRecords(void) {
+	return this->records;
+}
+
+/** The method returns the name of a snapshot file.
+ * @param i The index of the file, 0 or 1.
+ * @return The name.
+ */
+string AcctJournal::getSnapshotName(int i) {
+	return i == 0 ? this->filename : this->filename + ".alt";
+}
+
+/** The method reads a whole file.
+ * @param f The file descriptor.
+ * @param data The content of the file.
+ * @return 0 or -1 if the file can't be read.
+ */
+int AcctJournal::readFile(int f, string * data) {
+	struct stat st;
+	ssize_t n;
+	off_t offset = 0;
+
+	data->clear();
+	if (fstat(f, &st) != 0) {
+		return -1;
+	}
+	data->resize(st.st_size);
+	while (offset < st.st_size) {
+		n = pread(f, &(*data)[offset], st.st_size - offset, offset);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			data->resize(offset);
+			break;
+		}
+		offset += n;
+	}
+	return 0;
+}
+
+/** The method reads the records of the snapshot or the log and applies
+ * them to the sessions. The log is read until the first incomplete record,
+ * a snapshot with an incomplete record is not used.
+ * @param data The content of the file.
+ * @param name The name of the file.
+ * @param snapshot True if the file is a snapshot with a header.
+ * @param sessions The map of the sessions.
+ * @param generation The generation of the snapshot, NULL for the log.
+ * @return The number of records which were read, -1 if the snapshot is incomplete or has another version.
+ */
+int AcctJournal::parse(string & data, string name, bool snapshot, map<string, UserAcct> * sessions, uint32_t * generation) {
+	const char * p, *end;
+	JournalHeader header;
+	JournalRecord record;
+	int n = 0;
+
+	p = data.data();
+	end = p + data.size();
+
+	if (snapshot) {
+		if (data.size() < sizeof(header)) {
+			return -1;
+		}
+		memcpy(&header, p, sizeof(header));
+		if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << name << " has an unknown format, it is ignored.\n";
+			return -1;
+		}
+		*generation = header.generation;
+		p += sizeof(header);
+	}
+
+	while (p + sizeof(record) <= end) {
+		memcpy(&record, p, sizeof(record));
+		p += sizeof(record);
+		if (record.length > (size_t) (end - p) || hash(p, record.length) != record.checksum) {
+			if (snapshot) {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << name << " has an incomplete record, the snapshot is ignored.\n";
+				return -1;
+			}
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << name << " has an incomplete record, the following records are ignored.\n";
+			break;
+		}
+		const char * q = p, *rend = p + record.length;
+		p = rend;
+
+		//the log starts with its version
+		if (!snapshot && n == 0) {
+			uint64_t version;
+			if (record.type != JOURNAL_FORMAT || !getInt(&q, rend, &version, 4) || version != JOURNAL_VERSION) {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << name << " has an unknown format, it is ignored.\n";
+				return 0;
+			}
+		}
+		n++;
+		if (record.type == JOURNAL_ADD) {
+			UserAcct user;
+			if (deserialize(q, rend, &user)) {
+				(*sessions)[user.getKey()] = user;
+			}
+		} else if (record.type == JOURNAL_UPDATE) {
+			string key;
+			uint64_t bytesin, bytesout, gigain, gigaout, nextupdate, lastupdate;
+			if (getStr(&q, rend, &key) && getInt(&q, rend, &bytesin, 4) && getInt(&q, rend, &bytesout, 4) && getInt(&q, rend, &gigain, 4)
+					&& getInt(&q, rend, &gigaout, 4) && getInt(&q, rend, &nextupdate, 8) && getInt(&q, rend, &lastupdate, 8)) {
+				map<string, UserAcct>::iterator it = sessions->find(key);
+				if (it != sessions->end()) {
+					it->second.setBytesIn(bytesin);
+					it->second.setBytesOut(bytesout);
+					it->second.setGigaIn(gigain);
+					it->second.setGigaOut(gigaout);
+					it->second.setNextUpdate(nextupdate);
+					it->second.setLastUpdate(lastupdate);
+				}
+			}
+		} else if (record.type == JOURNAL_DEL) {
+			string key;
+			if (getStr(&q, rend, &key)) {
+				sessions->erase(key);
+			}
+		}
+	}
+
+	//a snapshot which was written incompletely has less sessions than its header
+	if (snapshot && (p != end || (uint32_t) n != header.count)) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal " << name << " is incomplete, the snapshot is ignored.\n";
+		return -1;
+	}
+	return n;
+}
+
+/** The method appends a record to the log.
+ * @param type The type of the record.
+ * @param data The data of the record.
+ * @param sync True if the log is written to disk immediately.
+ */
+void AcctJournal::append(uint32_t type, string & data, bool sync) {
+	JournalRecord record;
+	string buf;
+
+	if (this->fd < 0) {
+		return;
+	}
+	record.type = type;
+	record.length = data.size();
+	record.checksum = hash(data.data(), data.size());
+	buf.assign((char *) &record, sizeof(record));
+	buf.append(data);
+
+	//one write, so a crash leaves at most one incomplete record at the end
+	if (write(this->fd, buf.data(), buf.size()) != (ssize_t) buf.size()) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal could not written: " << strerror(errno) << ".\n";
+		return;
+	}
+	if (sync) {
+		fdatasync(this->fd);
+	}
+	this->records++;
+}
+
+/** The method appends the version of the format to the empty log.*/
+void AcctJournal::appendFormat(void) {
+	string data;
+	putInt(data, JOURNAL_VERSION, 4);
+	this->append(JOURNAL_FORMAT, data, true);
+}
+
+/** The method logs a new session, the log is written to disk immediately.
+ * @param user The user of the session.
+ */
+void AcctJournal::logAdd(UserAcct * user) {
+	string data;
+	serialize(data, user);
+	this->append(JOURNAL_ADD, data, true);
+}
+
+/** The method logs the counters of a session and the time when they were read after an update.
+ * The log isn't written to disk immediately, after a crash the
+ * counters of the previous update may be used.
+ * @param user The user of the session.
+ */
+void AcctJournal::logUpdate(UserAcct * user) {
+	string data;
+	putStr(data, user->getKey());
+	putInt(data, user->getBytesIn(), 4);
+	putInt(data, user->getBytesOut(), 4);
+	putInt(data, user->getGigaIn(), 4);
+	putInt(data, user->getGigaOut(), 4);
+	putInt(data, user->getNextUpdate(), 8);
+	putInt(data, user->getLastUpdate(), 8);
+	this->append(JOURNAL_UPDATE, data, false);
+}
+
+/** The method logs the end of a session, the log is written to disk immediately.
+ * @param key The key of the user.
+ */
+void AcctJournal::logDel(string key) {
+	string data;
+	putStr(data, key);
+	this->append(JOURNAL_DEL, data, true);
+}
+
+/** The method writes a new snapshot of the sessions and clears the log.
+ * The snapshot overwrites the older snapshot file and gets the next generation,
+ * so the newer snapshot file is complete until the new one is on disk.
+ * @param active The users with an interim interval.
+ * @param passive The users without an interim interval.
+ * @return 0 or -1 if the snapshot can't be written, the log is kept then.
+ */
+int AcctJournal::checkpoint(map<string, UserAcct> & active, map<string, UserAcct> & passive) {
+	map<string, UserAcct> * lists[2] = { &active, &passive };
+	map<string, UserAcct>::iterator it;
+	JournalHeader header;
+	JournalRecord record;
+	string buf, data;
+	int i, target;
+
+	if (this->fd < 0) {
+		return -1;
+	}
+	target = 1 - this->current;
+	header.magic = JOURNAL_MAGIC;
+	header.version = JOURNAL_VERSION;
+	header.count = active.size() + passive.size();
+	header.generation = this->generation + 1;
+	buf.assign((char *) &header, sizeof(header));
+	for (i = 0; i < 2; i++) {
+		for (it = lists[i]->begin(); it != lists[i]->end(); it++) {
+			data.clear();
+			serialize(data, &(it->second));
+			record.type = JOURNAL_ADD;
+			record.length = data.size();
+			record.checksum = hash(data.data(), data.size());
+			buf.append((char *) &record, sizeof(record));
+			buf.append(data);
+		}
+	}
+
+	if (ftruncate(this->snapfd[target], 0) != 0 || pwrite(this->snapfd[target], buf.data(), buf.size(), 0) != (ssize_t) buf.size()
+			|| fsync(this->snapfd[target]) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal snapshot " << this->getSnapshotName(target) << " could not written: " << strerror(errno) << ".\n";
+		return -1;
+	}
+	this->current = target;
+	this->generation++;
+
+	//the log is applied to the snapshot again if the process crashes before it is cleared,
+	//this is no problem, because the records set the state and don't change it
+	if (ftruncate(this->fd, 0) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal could not cleared: " << strerror(errno) << ".\n";
+		return -1;
+	}
+	this->records = 0;
+	this->appendFormat();
+	return 0;
+}
+
+/** The method writes the directory of the snapshot to disk, so new files survive a crash.*/
+void AcctJournal::syncDirectory(void) {
+	string::size_type pos = this->filename.rfind('/');
+	string dir = (pos == string::npos) ? string(".") : this->filename.substr(0, pos + 1);
+	int dirfd;
+
+	dirfd = ::open(dir.c_str(), O_RDONLY);
+	if (dirfd < 0 || fsync(dirfd) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal directory " << dir << " could not synchronized: " << strerror(errno) << ".\n";
+	}
+	if (dirfd >= 0) {
+		::close(dirfd);
+	}
+}
+
+/** The method calculates the FNV-1a hash of a buffer.
+ * @param data The buffer.
+ * @param len The length of the buffer.
+ * @return The hash.
+ */
+uint32_t AcctJournal::hash(const char * data, size_t len) {
+	uint32_t h = 2166136261U;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		h = (h ^ (unsigned char) data[i]) * 16777619U;
+	}
+	return h;
+}
+
+/** The method appends an integer in little endian byte order to a buffer.
+ * @param buf The buffer.
+ * @param value The integer.
+ * @param size The number of bytes, 4 or 8.
+ */
+void AcctJournal::putInt(string & buf, uint64_t value, int size) {
+	int i;
+	for (i = 0; i < size; i++) {
+		buf += (char) ((value >> (8 * i)) & 0xFF);
+	}
+}
+
+/** The method appends a string with its length to a buffer.
+ * @param buf The buffer.
+ * @param str The string.
+ */
+void AcctJournal::putStr(string & buf, string str) {
+	putInt(buf, str.size(), 4);
+	buf.append(str);
+}
+
+/** The method reads an integer from a buffer.
+ * @param p The position in the buffer, it is moved behind the integer.
+ * @param end The end of the buffer.
+ * @param value The integer.
+ * @param size The number of bytes, 4 or 8.
+ * @return False if the buffer is too short.
+ */
+bool AcctJournal::getInt(const char ** p, const char * end, uint64_t * value, int size) {
+	int i;
+	if (end - *p < size) {
+		return false;
+	}
+	*value = 0;
+	for (i = 0; i < size; i++) {
+		*value |= ((uint64_t) (unsigned char) (*p)[i]) << (8 * i);
+	}
+	*p += size;
+	return true;
+}
+
+/** The method reads a string from a buffer.
+ * @param p The position in the buffer, it is moved behind the string.
+ * @param end The end of the buffer.
+ * @param str The string.
+ * @return False if the buffer is too short.
+ */
+bool AcctJournal::getStr(const char ** p, const char * end, string * str) {
+	uint64_t len;
+	if (!getInt(p, end, &len, 4) || len > (uint64_t) (end - *p)) {
+		return false;
+	}
+	str->assign(*p, len);
+	*p += len;
+	return true;
+}
+
+/** The method appends the state of a session to a buffer, this
+ * is everything which is needed to send the stop packet and to delete the routes.
+ * @param buf The buffer.
+ * @param user The user of the session.
+ */
+void AcctJournal::serialize(string & buf, UserAcct * user) {
+	putStr(buf, user->getKey());
+	putStr(buf, user->getUsername());
+	putStr(buf, user->getSessionId());
+	putStr(buf, user->getCommonname());
+	putStr(buf, user->getFramedIp());
+	putStr(buf, user->getAttributes()->getBuf());
+	putStr(buf, user->getCallingStationId());
+	putStr(buf, user->getStatusFileKey());
+	putStr(buf, user->getUntrustedPort());
+	putInt(buf, user->getPortnumber(), 4);
+	putInt(buf, user->getAcctInterimInterval(), 8);
+	putInt(buf, user->getStarttime(), 8);
+	putInt(buf, user->getNextUpdate(), 8);
+	putInt(buf, user->getBytesIn(), 4);
+	putInt(buf, user->getBytesOut(), 4);
+	putInt(buf, user->getGigaIn(), 4);
+	putInt(buf, user->getGigaOut(), 4);
+	putInt(buf, user->getLastUpdate(), 8);
+	putInt(buf, user->getStoptime(), 8);
+}
+
+/** The method reads the state of a session from a buffer.
+ * @param p The begin of the buffer.
+ * @param end The end of the buffer.
+ * @param user The user of the session.
+ * @return False if the buffer is too short.
+ */
+bool AcctJournal::deserialize(const char * p, const char * end, UserAcct * user) {
+	string key, username, sessionid, commonname, framedip, attributes, callingstationid, statusfilekey, untrustedport;
+	uint64_t portnumber, interval, starttime, nextupdate, bytesin, bytesout, gigain, gigaout, lastupdate, stoptime;
+
+	if (!(getStr(&p, end, &key) && getStr(&p, end, &username) && getStr(&p, end, &sessionid) && getStr(&p, end, &commonname)
+			&& getStr(&p, end, &framedip) && getStr(&p, end, &attributes) && getStr(&p, end, &callingstationid)
+			&& getStr(&p, end, &statusfilekey) && getStr(&p, end, &untrustedport) && getInt(&p, end, &portnumber, 4)
+			&& getInt(&p, end, &interval, 8) && getInt(&p, end, &starttime, 8) && getInt(&p, end, &nextupdate, 8)
+			&& getInt(&p, end, &bytesin, 4) && getInt(&p, end, &bytesout, 4) && getInt(&p, end, &gigain, 4) && getInt(&p, end, &gigaout, 4)
+			&& getInt(&p, end, &lastupdate, 8) && getInt(&p, end, &stoptime, 8))) {
+		return false;
+	}
+	user->setKey(key);
+	user->setUsername(username);
+	user->setSessionId(sessionid);
+	user->setCommonname(commonname);
+	user->setFramedIp(framedip);
+	user->getAttributes()->setBuf(attributes);
+	user->setCallingStationId(callingstationid);
+	user->setStatusFileKey(statusfilekey);
+	user->setUntrustedPort(untrustedport);
+	user->setPortnumber(portnumber);
+	user->setAcctInterimInterval(interval);
+	user->setStarttime(starttime);
+	user->setNextUpdate(nextupdate);
+	user->setBytesIn(bytesin);
+	user->setBytesOut(bytesout);
+	user->setGigaIn(gigain);
+	user->setGigaOut(gigaout);
+	user->setLastUpdate(lastupdate);
+	user->setStoptime(stoptime);
+	return true;
+}
@@ -0,0 +1,102 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _ACCT_JOURNAL_H_
+#define _ACCT_JOURNAL_H_
+
+#include <string>
+#include <map>
+#include <stdint.h>
+
+using namespace std;
+
+class UserAcct;
+
+#define JOURNAL_MAGIC		0x52504a31 /**< The magic number of the snapshot file ("RPJ1").*/
+#define JOURNAL_VERSION		2	/**< The version of the format of the snapshot and the log.*/
+#define JOURNAL_ADD			1	/**< A session was started, the record contains the whole session.*/
+#define JOURNAL_UPDATE		2	/**< The counters of a session were updated.*/
+#define JOURNAL_DEL			3	/**< A session was stopped, the record contains the key.*/
+#define JOURNAL_FORMAT		4	/**< The first record of the log, it contains the version.*/
+#define JOURNAL_CHECKPOINT	1024 /**< The number of log records (plus two per session) after which a new snapshot is written.*/
+
+/** The header of a record in the snapshot and in the log.*/
+struct JournalRecord {
+	uint32_t type; /**< JOURNAL_ADD, JOURNAL_UPDATE or JOURNAL_DEL.*/
+	uint32_t length; /**< The length of the data behind the header.*/
+	uint32_t checksum; /**< The FNV-1a hash of the data.*/
+};
+
+/** The class saves the state of the accounting sessions, so the sessions can be stopped
+ * after a crash of the accounting process or OpenVPN. The state is kept in a binary
+ * snapshot file and a write-ahead log (the file with the suffix .wal), every change of a
+ * session is appended to the log. The log is replaced by a new snapshot when it is too long.
+ * There are two snapshot files, the second one has the suffix .alt. A new snapshot overwrites
+ * the older one and has the next generation, so there is always a complete snapshot and
+ * no file is created after the open, the files can be opened before the root rights are dropped.
+ * The snapshot has a header and the log a first record with the version of the format,
+ * a file of another version is ignored.
+ * At startup the newer complete snapshot and the log are read in one pass, a record which was written
+ * incompletely ends the log.
+ */
+class AcctJournal {
+private:
+	string filename; /**< The name of the snapshot file.*/
+	int fd; /**< The file descriptor of the log, -1 if the journal isn't open.*/
+	int snapfd[2]; /**< The file descriptors of the two snapshot files.*/
+	int current; /**< The index of the snapshot file with the newest snapshot.*/
+	uint32_t generation; /**< The generation of the newest snapshot.*/
+	int records; /**< The number of records in the log.*/
+
+	void append(uint32_t, string &, bool);
+	void appendFormat(void);
+	int parse(string &, string, bool, map<string, UserAcct> *, uint32_t *);
+	string getSnapshotName(int);
+	void syncDirectory(void);
+
+	static int readFile(int, string *);
+
+	static uint32_t hash(const char *, size_t);
+	static void putInt(string &, uint64_t, int);
+	static void putStr(string &, string);
+	static bool getInt(const char **, const char *, uint64_t *, int);
+	static bool getStr(const char **, const char *, string *);
+	static void serialize(string &, UserAcct *);
+	static bool deserialize(const char *, const char *, UserAcct *);
+
+public:
+	AcctJournal();
+	~AcctJournal();
+
+	int open(string);
+	void load(map<string, UserAcct> *);
+	void close(void);
+	bool isOpen(void);
+
+	void logAdd(UserAcct *);
+	void logUpdate(UserAcct *);
+	void logDel(string);
+	int checkpoint(map<string, UserAcct> &, map<string, UserAcct> &);
+
+	int getRecords(void);
+};
+
+#endif //_ACCT_JOURNAL_H_
@@ -28,10 +28,18 @@
 using namespace std;
 
 /** The constructor of the class.
- * Nothing happens here.
+ * The token bucket for the interim updates is empty.
+ * @param j The journal of the sessions, it is opened by the owner of the plugin context.
  */
 
-AcctScheduler::AcctScheduler() {
+AcctScheduler::AcctScheduler(AcctJournal * j) {
+	this->journal = j;
+	this->updatetokens = 0;
+	this->lastrefill = monotonicTime();
+	this->deadline = 0;
+	this->routedstops = 0;
+	this->queuedsince = 0;
+	srandom(time(NULL) ^ getpid());
 }
 
 /**The destructor of the class.
@@ -54,154 +62,519 @@ void AcctScheduler::addUser(UserAcct *user) {
 	} else {
 		this->activeuserlist.insert(make_pair(user->getKey(), *user));
 	}
+	this->journal->logAdd(user);
 }
 
-/** The method deletes an user from the user lists. Before 
- * the user is deleted the status file is parsed for the sent and received bytes
- * and the stop accounting ticket is send to the server.
+/** The method removes an user from the user lists and queues the user for
+ * stopQueuedUsers(), which sends the stop packets of many users at once.
+ * The user stays in the journal until the stop packet is sent.
+ * @param user A pointer to an object from the class UserAcct, it is invalid after the call.
+ */
+void AcctScheduler::queueStop(UserAcct *user) {
+	string key = user->getKey();
+	
+	if (this->stopqueue.empty()) {
+		this->queuedsince = monotonicTime();
+	}
+	this->stopqueue.push_back(*user);
+	this->stopqueue.back().setStoptime(time(NULL));
+	if (user->getAcctInterimInterval() == 0) {
+		passiveuserlist.erase(key);
+	} else {
+		activeuserlist.erase(key);
+	}
+}
+
+/** The getter method for the number of queued users.
+ * @return The number of users who wait for the stop packet.
+ */
+int AcctScheduler::getQueuedStops(void) {
+	return this->stopqueue.size();
+}
+
+/** The getter method for the time when the first queued user was queued.
+ * @return The time (monotonic, in microseconds), it is only valid if users are queued.
+ */
+long long AcctScheduler::getQueuedSince(void) {
+	return this->queuedsince;
+}
+
+/** The method checks if a user with the key waits for the stop packet.
+ * @param key The key of the user.
+ * @return True if the user is queued.
+ */
+bool AcctScheduler::isQueued(string key) {
+	unsigned int i;
+	
+	for (i = 0; i < this->stopqueue.size(); i++) {
+		if (this->stopqueue[i].getKey() == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** The method deletes the system routes of the queued users, the stop packets are
+ * sent later by stopQueuedUsers(). A new user may get the routes of a disconnected user,
+ * they are deleted before the routes of the new user are set.
  * @param context The plugin context as an object from the class PluginContext.
- * @param user A pointer to an object from the class UserAcct
  */
-void AcctScheduler::delUser(PluginContext * context, UserAcct *user) {
-	uint64_t bytesin = 0, bytesout = 0;
+void AcctScheduler::delQueuedRoutes(PluginContext * context) {
+	vector<UserAcct *> users;
+	long long start;
+	unsigned int i;
+	
+	for (i = this->routedstops; i < this->stopqueue.size(); i++) {
+		users.push_back(&this->stopqueue[i]);
+	}
+	if (users.empty()) {
+		return;
+	}
+	start = monotonicTime();
+	this->delRoutes(context, users);
+	context->metrics.record(METRIC_ROUTES, monotonicTime() - start);
+	this->routedstops = this->stopqueue.size();
+}
 
+/** The getter method for the number of users in the scheduler.
+ * @return The number of active and passive users.
+ */
+int AcctScheduler::getUsers(void) {
+	return this->activeuserlist.size() + this->passiveuserlist.size();
+}
 
-	//get the sent and received bytes
-	this->parseStatusFile(context, &bytesin, &bytesout, user->getStatusFileKey().c_str());
+/** The method searches the time of the next interim update.
+ * @return The time of the next update or 0 if no user has an acct interim interval.
+ */
+time_t AcctScheduler::getNextUpdate(void) {
+	map<string, UserAcct>::iterator iter;
+	time_t next = 0;
 	
-	user->setBytesIn(bytesin & 0xFFFFFFFF);
-	user->setBytesOut(bytesout & 0xFFFFFFFF);
-	user->setGigaIn(bytesin >> 32);
-	user->setGigaOut(bytesout >> 32);
+	for (iter = this->activeuserlist.begin(); iter != this->activeuserlist.end(); iter++) {
+		if (next == 0 || iter->second.getNextUpdate() < next) {
+			next = iter->second.getNextUpdate();
+		}
+	}
+	return next;
+}
+
+/** The method stops the queued users. The status file is parsed once for the sent and
+ * received bytes of all users, the stop packets are sent all at once by the spool or
+ * in a RadiusBatch and the system routes which weren't deleted by delQueuedRoutes() are
+ * deleted by one request to the privileged helper.
+ * If a deadline is set, the users whose stop packets weren't answered until the deadline
+ * stay in the journal, so their stop packets are sent at the next start.
+ * @param context The plugin context as an object from the class PluginContext.
+ */
+void AcctScheduler::stopQueuedUsers(PluginContext * context) {
+	map<string, pair<uint64_t, uint64_t> > counters;
+	map<string, pair<uint64_t, uint64_t> >::iterator found;
+	vector<UserAcct *> users, unanswered;
+	map<string, UserAcct *> kept;
+	long long start;
+	unsigned int i;
 	
+	if (this->stopqueue.empty()) {
+		return;
+	}
 	if (DEBUG (context->getVerbosity()))
-		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Got accounting data from file, CN: " << user->getCommonname() << " in: " << user->getBytesIn()
-				<< " out: " << user->getBytesOut() << ".\n";
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Stop " << this->stopqueue.size() << " users.\n";
 	
+	//get the sent and received bytes of all users
+	start = monotonicTime();
+	this->readStatusFile(context, &counters);
+	context->metrics.record(METRIC_STATUS_FILE, monotonicTime() - start);
 	
-	//send the stop ticket
-	if (user->sendStopPacket(context) == 0) {
-		if (DEBUG (context->getVerbosity()))
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Stop packet was sent. CN: " << user->getCommonname() << ".\n";
-	} else {
-		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Error on sending stop packet.";
+	for (i = 0; i < this->stopqueue.size(); i++) {
+		UserAcct * user = &this->stopqueue[i];
+		if (user->getStoptime() == 0) {
+			user->setStoptime(time(NULL));
+		}
+		found = counters.find(user->getStatusFileKey());
+		if (found != counters.end()) {
+			user->setLastUpdate(user->getStoptime());
+			user->setBytesIn(found->second.first & 0xFFFFFFFF);
+			user->setBytesOut(found->second.second & 0xFFFFFFFF);
+			user->setGigaIn(found->second.first >> 32);
+			user->setGigaOut(found->second.second >> 32);
+			
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Got accounting data from file, CN: " << user->getCommonname() << " in: " << user->getBytesIn()
+						<< " out: " << user->getBytesOut() << ".\n";
+		} else {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: No accounting data was found for " << user->getStatusFileKey() << ".\n";
+		}
+		users.push_back(user);
 	}
 	
-	if (user->getAcctInterimInterval() == 0) {
-		passiveuserlist.erase(user->getKey());
-	} else {
-		
-		activeuserlist.erase(user->getKey());
+	this->sendStops(context, users, "", &unanswered);
+	this->delQueuedRoutes(context);
+	
+	//keep the users without response in the lists, so they are in the snapshot of the journal
+	if (!unanswered.empty()) {
+		if (this->journal->isOpen()) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: " << unanswered.size() << " stop packets weren't answered until the deadline, they are sent at the next start.\n";
+			for (i = 0; i < unanswered.size(); i++) {
+				kept[unanswered[i]->getKey()] = unanswered[i];
+				if (unanswered[i]->getAcctInterimInterval() == 0) {
+					this->passiveuserlist.insert(make_pair(unanswered[i]->getKey(), *unanswered[i]));
+				} else {
+					this->activeuserlist.insert(make_pair(unanswered[i]->getKey(), *unanswered[i]));
+				}
+			}
+		} else {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: " << unanswered.size() << " stop packets weren't answered until the deadline, they are lost.\n";
+		}
+	}
+	
+	for (i = 0; i < users.size(); i++) {
+		if (kept.find(users[i]->getKey()) == kept.end()) {
+			this->journal->logDel(users[i]->getKey());
+		}
 	}
+	this->stopqueue.clear();
+	this->routedstops = 0;
+}
 
+/** The setter method for the deadline of the stop packets, it is set at the shutdown.
+ * @param d The time (monotonic, in microseconds), 0 is unlimited.
+ */
+void AcctScheduler::setDeadline(long long d) {
+	this->deadline = d;
 }
 
-/** The method deletes all users from the user lists. Before 
- * the user is deleted the status file is parsed for the sent and received bytes
- * and the stop accounting ticket is send to the server.
+/** The method stops all users, before the accounting process ends.
  * @param context The plugin context as an object from the class PluginContext.
  */
 void AcctScheduler::delallUsers(PluginContext * context) {
-	map<string, UserAcct>::iterator iter1, iter2;
+	map<string, UserAcct>::iterator iter;
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Delete all users.";
-	iter1 = activeuserlist.begin();
-	iter2 = activeuserlist.end();
 	
-	while (iter1 != iter2) {
-		this->delUser(context, &(iter1->second));
-		iter1++;
+	for (iter = activeuserlist.begin(); iter != activeuserlist.end(); iter++) {
+		this->stopqueue.push_back(iter->second);
+	}
+	for (iter = passiveuserlist.begin(); iter != passiveuserlist.end(); iter++) {
+		this->stopqueue.push_back(iter->second);
+	}
+	activeuserlist.clear();
+	passiveuserlist.clear();
+	this->stopQueuedUsers(context);
+}
+
+/** The method deletes the system routes of many users. The routes are
+ * sent to the privileged helper at once, so there is one request for all users.
+ * @param context The plugin context as an object from the class PluginContext.
+ * @param users The users.
+ */
+void AcctScheduler::delRoutes(PluginContext * context, vector<UserAcct *> & users) {
+	vector<FramedRoute> routes;
+	FramedRoute fr;
+	unsigned int i;
+	int offset, result;
+	
+	for (i = 0; i < users.size(); i++) {
+		AttributeBlob * attributes = users[i]->getAttributes();
+		for (offset = attributes->find(BLOB_ROUTE); offset >= 0; offset = attributes->find(BLOB_ROUTE, attributes->next(offset))) {
+			//the value may be unaligned
+			memcpy(&fr, attributes->getValue(offset), sizeof(fr));
+			
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Create route string " << formatRouteCommand(&fr, false) << ".\n";
+			
+			routes.push_back(fr);
+		}
+	}
+	result = context->privhelper.routes(routes, false);
+	if (result == -1) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Routes could not deleted, the privileged helper failed.\n";
+	} else if (result != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: " << result << " of " << routes.size() << " routes could not deleted. Route not set or bad route string.\n";
 	}
+}
+
+/** The method sends the stop packets of many users, all at once by the spool
+ * or in a RadiusBatch, which ends at the deadline.
+ * @param context The plugin context as an object from the class PluginContext.
+ * @param users The users.
+ * @param cause The value of the Acct-Terminate-Cause attribute, an empty string adds no attribute.
+ * @param unanswered If not NULL, the users whose packets weren't answered because the deadline was reached are added.
+ */
+void AcctScheduler::sendStops(PluginContext * context, vector<UserAcct *> & users, string cause, vector<UserAcct *> * unanswered) {
+	RadiusBatch batch(context->radiusconf.getRadiusServer(), &context->radiusconf);
+	vector<RadiusPacket *> packets;
+	vector<UserAcct *> sent;
+	unsigned int i;
+	
+	for (i = 0; i < users.size(); i++) {
+		RadiusPacket * packet = new RadiusPacket(ACCOUNTING_REQUEST);
+		users[i]->buildStopPacket(context, packet);
+		if (cause.size() > 0) {
+			RadiusAttribute ra(ATTRIB_Acct_Terminate_Cause, cause);
+			packet->addRadiusAttribute(&ra);
+		}
+		
+		if (context->acctspool.isOpen()) {
+			if (context->acctspool.enqueue(packet, true) != 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Stop packet for User " << users[i]->getUsername() << " could not be spooled.\n";
+			}
+			delete packet;
+		} else if (batch.addPacket(packet, context->radiusconf.selectServer(context->radiusconf.getAcctLoadBalance(), users[i]->getUsername())) < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Stop packet for User " << users[i]->getUsername() << " could not be sent.\n";
+			delete packet;
+		} else {
+			packets.push_back(packet);
+			sent.push_back(users[i]);
+		}
+	}
+	
+	if (!packets.empty()) {
+		batch.setDeadline(this->deadline);
+		batch.run();
+	}
+	for (i = 0; i < packets.size(); i++) {
+		if (batch.getResult(i) == 0 && packets[i]->getCode() == ACCOUNTING_RESPONSE) {
+			context->metrics.add(METRIC_ACCT_STOPPED);
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Stop packet was sent. CN: " << sent[i]->getCommonname() << ".\n";
+		} else if (unanswered != NULL && this->deadline > 0 && monotonicTime() >= this->deadline) {
+			unanswered->push_back(sent[i]);
+		} else {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: No response on stop packet for User " << sent[i]->getUsername() << ".\n";
+		}
+		delete packets[i];
+	}
+}
+
+/** The method reads the journal of the sessions, if sessionstate is set. The sessions
+ * in the journal were active when the accounting process ended without stopping them, e.g. after a crash.
+ * Their system routes are deleted and their stop packets are sent
+ * with the last known counters and the time of the last update as the end of the session,
+ * all at once by the spool or in a RadiusBatch.
+ * @param context The plugin context as an object from the class PluginContext.
+ * @return The number of recovered sessions or -1 if the journal can't be opened.
+ */
+int AcctScheduler::recoverSessions(PluginContext * context) {
+	map<string, UserAcct> sessions;
+	map<string, UserAcct>::iterator iter;
+	vector<UserAcct *> users;
+	
+	//in the thread model the journal was opened before OpenVPN dropped the root rights
+	if (!this->journal->isOpen() && this->journal->open(context->conf.getSessionState()) != 0) {
+		return -1;
+	}
+	this->journal->load(&sessions);
+	if (sessions.empty()) {
+		return 0;
+	}
+	cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Journal contains " << sessions.size() << " sessions which weren't stopped, they are stopped now.\n";
+	
+	//a session ended with the last update before the crash, the downtime isn't billed
+	for (iter = sessions.begin(); iter != sessions.end(); iter++) {
+		if (iter->second.getStoptime() == 0) {
+			iter->second.setStoptime(iter->second.getLastUpdate() != 0 ? iter->second.getLastUpdate() : iter->second.getStarttime());
+		}
+		users.push_back(&(iter->second));
+	}
+	
+	//delete the routes of the old sessions and stop them
+	this->delRoutes(context, users);
+	this->sendStops(context, users, "11", NULL); //NAS-Reboot
+	
+	//the recovered sessions are stopped, the new snapshot contains no session
+	this->journal->checkpoint(this->activeuserlist, this->passiveuserlist);
+	return sessions.size();
+}
+
+/** The method writes a snapshot of the sessions and closes the journal.
+ */
+void AcctScheduler::closeJournal(void) {
+	if (this->journal->isOpen()) {
+		this->journal->checkpoint(this->activeuserlist, this->passiveuserlist);
+		this->journal->close();
+	}
+}
+
+/** The method sets the time of the first interim update of a new user.
+ * Without updatespreading the update is sent one interval after the start. Else
+ * it is moved forward by up to updatejitter percent of the interval, by a random
+ * time or by a time from the hash of the session id. So users who connected at the
+ * same time, e.g. after a restart of OpenVPN, don't send their updates at the same time.
+ * @param context The plugin context as an object from the class PluginContext.
+ * @param user The user, the start time and the interval must be set.
+ */
+void AcctScheduler::scheduleFirstUpdate(PluginContext * context, UserAcct *user) {
+	time_t span = user->getAcctInterimInterval() * context->conf.getUpdateJitter() / 100;
+	time_t offset = 0;
+	uint32_t hash = 2166136261U;
+	string sessionid;
+	unsigned int i;
 	
+	if (span > 0) {
+		if (context->conf.getUpdateSpreading() == SPREAD_RANDOM) {
+			offset = random() % span;
+		} else if (context->conf.getUpdateSpreading() == SPREAD_HASH) {
+			//FNV-1a, the same session gets always the same offset
+			sessionid = user->getSessionId();
+			for (i = 0; i < sessionid.size(); i++) {
+				hash = (hash ^ (unsigned char) sessionid[i]) * 16777619U;
+			}
+			offset = hash % span;
+		}
+	}
+	//the offset is smaller than the interval, the first update is sent after the start
+	user->setNextUpdate(user->getStarttime() + user->getAcctInterimInterval() - offset);
 }
 
 /** The accounting method. When the method is called it
  * searches for users in activeuserlist for users who need an update.
- * If a user is found the sent and received bytes are read from the
- * OpenVpn status file.
+ * The sent and received bytes of all users are read from the OpenVpn
+ * status file once, when the first due user is found. The update packets of all users are sent
+ * together in a RadiusBatch, so the users don't wait for each other's responses.
+ * If maxupdaterate is set, not more updates per second are sent, the
+ * other users stay due until the next call.
  * @param context The plugin context as an object from the class PluginContext.
  */
 
 void AcctScheduler::doAccounting(PluginContext * context) {
 	time_t t;
 
-	uint64_t bytesin = 0, bytesout = 0;
+	map<string, pair<uint64_t, uint64_t> > counters;
+	map<string, pair<uint64_t, uint64_t> >::iterator found;
+	bool statusread = false;
 	map<string, UserAcct>::iterator iter1, iter2;
+	RadiusBatch batch(context->radiusconf.getRadiusServer(), &context->radiusconf);
+	vector<RadiusPacket *> packets;
+	vector<UserAcct *> users;
+	unsigned int i;
+	int rate = context->conf.getMaxUpdateRate();
+	long long now = monotonicTime();
+	
+	//fill the token bucket, it holds the updates of one second
+	if (rate > 0) {
+		this->updatetokens += rate * (now - this->lastrefill) / 1000000.0;
+		if (this->updatetokens > rate) {
+			this->updatetokens = rate;
+		}
+	}
+	this->lastrefill = now;
 	
 	iter1 = activeuserlist.begin();
 	iter2 = activeuserlist.end();
 	
+	//get the time
+	time(&t);
+	
 	while (iter1 != iter2) {
-		//get the time
-		time(&t);
-		//if the user needs an update
-		if (t >= iter1->second.getNextUpdate()) {
+		//if the user needs an update and the rate limit allows it,
+		//else the update is sent on the next call
+		if (t >= iter1->second.getNextUpdate() && (rate == 0 || this->updatetokens >= 1)) {
+			this->updatetokens -= 1;
 			if (DEBUG (context->getVerbosity()))
 				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: Update for User " << iter1->second.getUsername() << ".\n";
 
-			this->parseStatusFile(context, &bytesin, &bytesout, iter1->second.getStatusFileKey().c_str());
-			iter1->second.setBytesIn(bytesin & 0xFFFFFFFF);
-			iter1->second.setBytesOut(bytesout & 0xFFFFFFFF);
-			iter1->second.setGigaIn(bytesin >> 32);
-			iter1->second.setGigaOut(bytesout >> 32);
-			iter1->second.sendUpdatePacket(context);
+			//the status file is read once for all due users
+			if (!statusread) {
+				long long start = monotonicTime();
+				this->readStatusFile(context, &counters);
+				context->metrics.record(METRIC_STATUS_FILE, monotonicTime() - start);
+				statusread = true;
+			}
+			//without a row the update carries the last counters
+			found = counters.find(iter1->second.getStatusFileKey());
+			if (found != counters.end()) {
+				iter1->second.setBytesIn(found->second.first & 0xFFFFFFFF);
+				iter1->second.setBytesOut(found->second.second & 0xFFFFFFFF);
+				iter1->second.setGigaIn(found->second.first >> 32);
+				iter1->second.setGigaOut(found->second.second >> 32);
+			} else {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: No accounting data was found for " << iter1->second.getStatusFileKey() << ".\n";
+			}
+			iter1->second.setLastUpdate(t);
 			
-			if (DEBUG (context->getVerbosity()))
-				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: Update packet for User " << iter1->second.getUsername() << " was send.\n";
-
+			//build the packet, it is spooled or sent with the others
+			RadiusPacket * packet = new RadiusPacket(ACCOUNTING_REQUEST);
+			iter1->second.buildUpdatePacket(context, packet);
+			if (context->acctspool.isOpen()) {
+				if (context->acctspool.enqueue(packet, false) != 0) {
+					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: Update packet for User " << iter1->second.getUsername() << " could not be spooled.\n";
+				}
+				delete packet;
+			} else if (batch.addPacket(packet, context->radiusconf.selectServer(context->radiusconf.getAcctLoadBalance(), iter1->second.getUsername())) < 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: Update packet for User " << iter1->second.getUsername() << " could not be sent.\n";
+				delete packet;
+			} else {
+				packets.push_back(packet);
+				users.push_back(&(iter1->second));
+			}
 
-			//calculate the next update
-			iter1->second.setNextUpdate(iter1->second.getNextUpdate() + iter1->second.getAcctInterimInterval());
+			//calculate the next update, a delayed update moves the following updates
+			if (t > iter1->second.getNextUpdate() + 1) {
+				iter1->second.setNextUpdate(t + iter1->second.getAcctInterimInterval());
+			} else {
+				iter1->second.setNextUpdate(iter1->second.getNextUpdate() + iter1->second.getAcctInterimInterval());
+			}
+			this->journal->logUpdate(&(iter1->second));
 		}
 		iter1++;
 	}
+	
+	//replace the log by a snapshot, if the log is much longer than the snapshot
+	if (this->journal->getRecords() > JOURNAL_CHECKPOINT + 2 * (int) (this->activeuserlist.size() + this->passiveuserlist.size())) {
+		this->journal->checkpoint(this->activeuserlist, this->passiveuserlist);
+	}
+	
+	if (packets.empty()) {
+		return;
+	}
+	
+	//send all packets and wait for the responses
+	batch.run();
+	
+	for (i = 0; i < packets.size(); i++) {
+		if (batch.getResult(i) == 0 && packets[i]->getCode() == ACCOUNTING_RESPONSE) {
+			context->metrics.add(METRIC_ACCT_UPDATES);
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: Update packet for User " << users[i]->getUsername() << " was send.\n";
+		} else {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Scheduler: No response on update packet for User " << users[i]->getUsername() << ".\n";
+		}
+		delete packets[i];
+	}
 }
 
-/**The method parses the status file for accounting information. It reads the bytes sent
- * and received from the status file. It finds the values about the commonname. The method will
- * only work if there are no changes in the structure of the status file.
- * The method is test with OpenVpn 2.0.
+/**The method reads the bytes sent and received of all clients from the status file at once.
+ * The key of a client is the beginning of its row up to the second ',', it looks like: "commonname,ip:port".
  * @param context The plugin context as an object from the class PluginContext.
- * @param bytesin An int pointer for the received bytes.
- * @param bytesout An int pointer for the sent bytes.
- * @param key  A key which identifies the row in the statusfile, it looks like: "commonname,ip:port".
+ * @param counters The map for the received and the sent bytes of the clients.
  */
-void AcctScheduler::parseStatusFile(PluginContext *context, uint64_t *bytesin, uint64_t *bytesout, string key) {
-	char line[512], newline[512];
-	memset(newline, 0, 512);
+void AcctScheduler::readStatusFile(PluginContext *context, map<string, pair<uint64_t, uint64_t> > *counters) {
+	string line;
+	string::size_type pos;
+	char * end;
+	uint64_t bytesin, bytesout;
 	
-
-	//open the status file to read
 	ifstream file(context->conf.getStatusFile().c_str(), ios::in);
-	if (file.is_open()) {
-		if (DEBUG (context->getVerbosity()))
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Scheduler: Read Statusfile.\n";
-
-		
-		//find the key, is delimited with a ',' from the informations
-
-		//loop until the name is found, there is no delimiter, the string
-		//"ROUTING TABLE" is found or EOF
-
-		do {
-			file.getline(line, 512);
-			
-		} while (line != NULL && strncmp(line, key.c_str(), key.length()) != 0 && strcmp(line, "ROUTING TABLE") != 0 && file.eof() == false);
-
-		//the information is after the next delimiters
-		if (line != NULL && strncmp(line, key.c_str(), key.length()) == 0) {
-			memcpy(newline, line + key.length(), strlen(line) - key.length() + 1);
-			*bytesin = strtoull(strtok(newline, ","), NULL, 10);
-			*bytesout = strtoull(strtok(NULL, ","), NULL, 10);
-		} else {
-			
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: No accounting data was found for " << key << ".\n";
-			
-		}
-		file.close();
-	} else {
+	if (!file.is_open()) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Statusfile " << context->conf.getStatusFile() << " could not opened.\n";
+		return;
+	}
+	if (DEBUG (context->getVerbosity()))
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND ACCT: Scheduler: Read Statusfile.\n";
+	
+	while (getline(file, line) && line != "ROUTING TABLE") {
+		pos = line.find(',');
+		if (pos == string::npos || (pos = line.find(',', pos + 1)) == string::npos) {
+			continue;
+		}
+		bytesin = strtoull(line.c_str() + pos + 1, &end, 10);
+		if (*end != ',') {
+			continue;
+		}
+		bytesout = strtoull(end + 1, NULL, 10);
+		(*counters)[line.substr(0, pos)] = make_pair(bytesin, bytesout);
 	}
+	file.close();
 }
 
 /** The method finds an user.
@@ -29,11 +29,23 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
 #include <fstream>
 #include "UserAcct.h"
+#include "AcctJournal.h"
+#include "RadiusClass/RadiusBatch.h"
 
 using std::map;
 
+/** The number of queued stops which are sent at once, even if more disconnects are waiting.*/
+#define STOP_BATCH	4096
+
+/** The time in microseconds without a command after which the queued stops are sent.*/
+#define STOP_IDLE	50000
+
+/** The maximal time in microseconds a queued stop waits for further disconnects.*/
+#define STOP_DELAY	1000000
+
 /**The class is a scheduler for accounting radius users. It calculates the 
  * accounting interval if the ACCT-INTERIM-INTERVAL was present in the
  * authentication response from the radius server. 
@@ -48,19 +60,40 @@ class AcctScheduler {
 private:
 	map<string, UserAcct> activeuserlist; /**<The map for user with a acct interim interval.*/
 	map<string, UserAcct> passiveuserlist; /**<The map for user without a acct interim interval.*/
+	double updatetokens; /**<The token bucket for the rate limit of the interim updates.*/
+	long long lastrefill; /**<The time (monotonic, in microseconds) when tokens were added to the bucket.*/
+	AcctJournal * journal; /**<The journal of the sessions, it is only open if sessionstate is set.*/
+	vector<UserAcct> stopqueue; /**<The users who disconnected, their stop packets are sent by stopQueuedUsers().*/
+	unsigned int routedstops; /**<The number of queued users at the front of stopqueue whose routes are deleted.*/
+	long long queuedsince; /**<The time (monotonic, in microseconds) when the first user of stopqueue was queued.*/
+	long long deadline; /**<The time (monotonic, in microseconds) when the sending of stop packets ends, 0 is unlimited.*/
+	
+	void readStatusFile(PluginContext *, map<string, pair<uint64_t, uint64_t> > *);
+	void delRoutes(PluginContext *, vector<UserAcct *> &);
+	void sendStops(PluginContext *, vector<UserAcct *> &, string, vector<UserAcct *> *);
 	
 public:
-	AcctScheduler();
+	AcctScheduler(AcctJournal *);
 	~AcctScheduler();
 
 	void addUser(UserAcct *user);
-	void delUser(PluginContext * context, UserAcct *user);
+	void queueStop(UserAcct *user);
+	int getQueuedStops(void);
+	long long getQueuedSince(void);
+	bool isQueued(string);
+	void delQueuedRoutes(PluginContext * context);
+	int getUsers(void);
+	time_t getNextUpdate(void);
+	void stopQueuedUsers(PluginContext * context);
 	void delallUsers(PluginContext * context);
+	void setDeadline(long long);
+
+	int recoverSessions(PluginContext *);
+	void closeJournal(void);
 
 	UserAcct * findUser(string);
 
+	void scheduleFirstUpdate(PluginContext *, UserAcct *);
 	void doAccounting(PluginContext *);
-
-	void parseStatusFile(PluginContext *, uint64_t *, uint64_t *, string);
 };
 #endif //_ACCT_SCHEDULER_H_
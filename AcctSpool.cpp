@@ -0,0 +1,567 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "AcctSpool.h"
+#include "PluginContext.h"
+#include "RadiusClass/RadiusBatch.h"
+#include "radiusplugin.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+/** A copy of a record, the sender thread works on copies,
+ * because the records can be moved by the compaction.*/
+struct SpoolCopy {
+	uint64_t seq; /**< The sequence number of the record.*/
+	int64_t enqueued; /**< The time when the packet was spooled.*/
+	string attributes; /**< The attributes in the wire format.*/
+	int index; /**< The index of the packet in the batch, -1 if it wasn't added, the record waits then.*/
+};
+
+/** The constructor of the class, the spool isn't open.*/
+AcctSpool::AcctSpool() {
+	this->context = NULL;
+	this->fd = -1;
+	this->map = NULL;
+	this->size = 0;
+	this->syncinterval = 1000;
+	this->pending = 0;
+	this->dirty = false;
+	this->stop = false;
+	this->running = false;
+	this->deadline = 0;
+	pthread_mutex_init(&this->mutex, NULL);
+	pthread_cond_init(&this->cond, NULL);
+}
+
+/** The destructor closes the spool.*/
+AcctSpool::~AcctSpool() {
+	this->close();
+	pthread_mutex_destroy(&this->mutex);
+	pthread_cond_destroy(&this->cond);
+}
+
+/** The method opens or creates the spool file and maps it into the memory.
+ * The records of an existing file are checked, the records which weren't answered
+ * are sent again when the sender thread is started by start(). In the thread model
+ * the spool is opened before OpenVPN drops the root rights.
+ * Without a file name the spool is only in the memory, the records are lost when the process ends.
+ * @param context The plugin context.
+ * @param filename The name of the spool file, an empty string for a spool in the memory.
+ * @param size The size of a new file in bytes.
+ * @param syncinterval The time in milliseconds between two synchronizations.
+ * @return 0 or -1 if the file can't be used.
+ */
+int AcctSpool::open(PluginContext * context, string filename, size_t size, int syncinterval) {
+	struct stat st;
+	SpoolHeader * header;
+
+	this->context = context;
+	this->syncinterval = syncinterval;
+
+	if (filename.size() == 0) {
+		this->size = size;
+		this->map = (char *) mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (this->map == MAP_FAILED) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool could not mapped: " << strerror(errno) << ".\n";
+			this->map = NULL;
+			return -1;
+		}
+		header = this->getHeader();
+		header->magic = SPOOL_MAGIC;
+		header->version = 1;
+		header->size = this->size;
+		header->head = this->getDataStart();
+		header->tail = this->getDataStart();
+		header->nextseq = 1;
+		this->pending = 0;
+		return 0;
+	}
+
+	this->fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+	if (this->fd < 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file " << filename << " could not opened: " << strerror(errno) << ".\n";
+		return -1;
+	}
+	fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+	if (fstat(this->fd, &st) < 0) {
+		::close(this->fd);
+		this->fd = -1;
+		return -1;
+	}
+
+	//an existing spool keeps its size, a new one gets the configured size
+	if ((size_t) st.st_size >= sizeof(SpoolHeader)) {
+		this->size = st.st_size;
+	} else {
+		this->size = size;
+		if (ftruncate(this->fd, this->size) < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file " << filename << " could not resized: " << strerror(errno) << ".\n";
+			::close(this->fd);
+			this->fd = -1;
+			return -1;
+		}
+	}
+
+	this->map = (char *) mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (this->map == MAP_FAILED) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file " << filename << " could not mapped: " << strerror(errno) << ".\n";
+		this->map = NULL;
+		::close(this->fd);
+		this->fd = -1;
+		return -1;
+	}
+
+	header = this->getHeader();
+	if (header->magic != SPOOL_MAGIC || header->size != this->size || this->recover() != 0) {
+		if (header->magic == SPOOL_MAGIC) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file " << filename << " is corrupt, it is initialized again.\n";
+		}
+		memset(header, 0, sizeof(SpoolHeader));
+		header->magic = SPOOL_MAGIC;
+		header->version = 1;
+		header->size = this->size;
+		header->head = this->getDataStart();
+		header->tail = this->getDataStart();
+		header->nextseq = 1;
+		this->pending = 0;
+		msync(this->map, this->size, MS_SYNC);
+	}
+
+	if (this->pending > 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file " << filename << " contains " << this->pending << " unsent accounting packets, they are sent again.\n";
+	}
+
+	return 0;
+}
+
+/** The method starts the sender thread of the open spool. The spool is closed if the thread can't be started.
+ * @return 0 or -1 if the thread can't be started.
+ */
+int AcctSpool::start(void) {
+	if (this->map == NULL) {
+		return -1;
+	}
+	this->stop = false;
+	if (pthread_create(&this->thread, NULL, &AcctSpool::run, this) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool thread could not started.\n";
+		this->close();
+		return -1;
+	}
+	this->running = true;
+	return 0;
+}
+
+/** The method stops the sender thread, synchronizes the file and closes it.
+ * The records which weren't answered stay in the file.
+ */
+void AcctSpool::close(void) {
+	if (this->map == NULL) {
+		return;
+	}
+	if (this->running) {
+		pthread_mutex_lock(&this->mutex);
+		this->stop = true;
+		pthread_cond_signal(&this->cond);
+		pthread_mutex_unlock(&this->mutex);
+		pthread_join(this->thread, NULL);
+		this->running = false;
+	}
+
+	if (this->fd >= 0) {
+		msync(this->map, this->size, MS_SYNC);
+		::close(this->fd);
+	}
+	munmap(this->map, this->size);
+	this->map = NULL;
+	this->fd = -1;
+}
+
+/** The method checks if the spool is open.
+ * @return True if the spool is open.
+ */
+bool AcctSpool::isOpen(void) {
+	return (this->map != NULL);
+}
+
+/** The method checks if the records are kept in a file.
+ * @return True if the spool is open with a file, false if it is only in the memory or closed.
+ */
+bool AcctSpool::isDurable(void) {
+	return (this->fd >= 0);
+}
+
+/** The method returns the number of records which wait for a response.
+ * @return The number of records.
+ */
+int AcctSpool::getPending(void) {
+	int n;
+	pthread_mutex_lock(&this->mutex);
+	n = this->pending;
+	pthread_mutex_unlock(&this->mutex);
+	return n;
+}
+
+/** The setter method for the shutdown deadline. With a deadline the sender thread
+ * sends the waiting records at close() until the deadline as long as the server answers,
+ * without a deadline it tries only once. The records which weren't answered stay in the file.
+ * @param d The time (monotonic, in microseconds), 0 is unlimited.
+ */
+void AcctSpool::setDeadline(long long d) {
+	pthread_mutex_lock(&this->mutex);
+	this->deadline = d;
+	pthread_mutex_unlock(&this->mutex);
+}
+
+/** The method returns the header of the mapped file.
+ * @return A pointer to the header.
+ */
+SpoolHeader * AcctSpool::getHeader(void) {
+	return (SpoolHeader *) this->map;
+}
+
+/** The method returns a record of the mapped file.
+ * @param offset The offset of the record.
+ * @return A pointer to the record.
+ */
+SpoolRecord * AcctSpool::getRecord(uint64_t offset) {
+	return (SpoolRecord *) (this->map + offset);
+}
+
+/** The method returns the offset of the first record.
+ * @return The offset behind the header.
+ */
+uint64_t AcctSpool::getDataStart(void) {
+	return (sizeof(SpoolHeader) + 63) & ~63;
+}
+
+/** The method checks the records of an existing file and counts the records
+ * which wait for a response. If a record is incomplete, e.g. because of a crash
+ * while it was written, the file ends before this record.
+ * @return 0 or -1 if the header is corrupt.
+ */
+int AcctSpool::recover(void) {
+	SpoolHeader * header = this->getHeader();
+	SpoolRecord * record;
+	uint64_t offset;
+
+	if (header->head < this->getDataStart() || header->head > header->tail || header->tail > this->size) {
+		return -1;
+	}
+	this->pending = 0;
+	offset = header->head;
+	while (offset < header->tail) {
+		record = this->getRecord(offset);
+		if (offset + sizeof(SpoolRecord) > header->tail || record->magic != SPOOL_RECORD_MAGIC || record->length < sizeof(SpoolRecord)
+				|| record->length % 8 != 0 || offset + record->length > header->tail || record->attrlen > record->length - sizeof(SpoolRecord)) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool file has an incomplete record, the following records are dropped.\n";
+			header->tail = offset;
+			break;
+		}
+		if (record->state == SPOOL_PENDING) {
+			this->pending++;
+		}
+		offset += record->length;
+	}
+	return 0;
+}
+
+/** The method moves the records which wait for a response to the beginning
+ * of the file, the space of the answered records can be used again.
+ * The mutex must be locked.
+ */
+void AcctSpool::compact(void) {
+	SpoolHeader * header = this->getHeader();
+	SpoolRecord * record;
+	uint64_t offset, pos = this->getDataStart();
+
+	offset = header->head;
+	while (offset < header->tail) {
+		record = this->getRecord(offset);
+		offset += record->length;
+		if (record->state == SPOOL_PENDING) {
+			if ((char *) record != this->map + pos) {
+				memmove(this->map + pos, record, record->length);
+			}
+			pos += this->getRecord(pos)->length;
+		}
+	}
+	header->head = this->getDataStart();
+	header->tail = pos;
+	this->dirty = true;
+}
+
+/** The method drops the oldest interim update which waits for a response,
+ * if the file is full. Start and stop packets are never dropped.
+ * The mutex must be locked.
+ * @return True if a record was dropped.
+ */
+bool AcctSpool::dropUpdate(void) {
+	SpoolHeader * header = this->getHeader();
+	SpoolRecord * record;
+	uint64_t offset;
+
+	for (offset = header->head; offset < header->tail; offset += record->length) {
+		record = this->getRecord(offset);
+		if (record->state == SPOOL_PENDING && !(record->flags & SPOOL_STOP)) {
+			//only updates are dropped, the acct status type is in the attributes
+			RadiusPacket packet(ACCOUNTING_REQUEST);
+			packet.loadAttributes((Octet *) (record + 1), record->attrlen);
+			pair<multimap<Octet, RadiusAttribute>::iterator, multimap<Octet, RadiusAttribute>::iterator> p = packet.findAttributes(ATTRIB_Acct_Status_Type);
+			if (p.first != p.second && p.first->second.intFromBuf() == 3) {
+				record->state = SPOOL_DONE;
+				this->pending--;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/** The method writes the changes of the mapped file to the disk.
+ * The mutex must be locked.
+ */
+void AcctSpool::sync(void) {
+	if (this->fd >= 0) {
+		msync(this->map, this->size, MS_SYNC);
+	}
+	this->dirty = false;
+}
+
+/** The method appends a packet to the spool. Stop packets are
+ * written to disk immediately, the other packets with the next synchronization.
+ * @param packet The packet with the attributes.
+ * @param stop True if the packet is a stop packet.
+ * @return 0 or -1 if the file is full or the packet can't be stored.
+ */
+int AcctSpool::enqueue(RadiusPacket * packet, bool stop) {
+	SpoolHeader * header;
+	SpoolRecord * record;
+	uint64_t length = (sizeof(SpoolRecord) + packet->getAttributesLength() + 7) & ~7;
+	int attrlen;
+
+	if (this->map == NULL) {
+		return -1;
+	}
+	pthread_mutex_lock(&this->mutex);
+	header = this->getHeader();
+
+	//make space, first by compaction, then by dropping old updates
+	if (header->tail + length > this->size) {
+		this->compact();
+		while (header->tail + length > this->size && this->dropUpdate()) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool is full, the oldest interim update is dropped.\n";
+			this->compact();
+		}
+	}
+	if (header->tail + length > this->size) {
+		pthread_mutex_unlock(&this->mutex);
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool is full, the accounting packet is dropped.\n";
+		return -1;
+	}
+
+	//write the record before the tail is moved, a record behind the tail doesn't exist
+	record = this->getRecord(header->tail);
+	attrlen = packet->serializeAttributes((Octet *) (record + 1), length - sizeof(SpoolRecord));
+	if (attrlen < 0) {
+		pthread_mutex_unlock(&this->mutex);
+		return -1;
+	}
+	record->magic = SPOOL_RECORD_MAGIC;
+	record->length = length;
+	record->seq = header->nextseq++;
+	record->state = SPOOL_PENDING;
+	record->flags = stop ? SPOOL_STOP : 0;
+	record->enqueued = time(NULL);
+	record->attrlen = attrlen;
+	record->reserved = 0;
+	header->tail += length;
+	this->pending++;
+
+	if (stop) {
+		this->sync();
+	} else {
+		this->dirty = true;
+	}
+	pthread_cond_signal(&this->cond);
+	pthread_mutex_unlock(&this->mutex);
+	return 0;
+}
+
+/** The method sends up to SPOOL_BATCH records which wait for a response
+ * in a RadiusBatch. The answered records are marked, the others are sent again later.
+ * The mutex must be locked, it is unlocked while the packets are sent.
+ * @param retry The time in seconds until the next attempt, it is doubled if no packet was answered
+ * and set to 0 if all packets were answered.
+ */
+void AcctSpool::sendRecords(int * retry) {
+	SpoolHeader * header = this->getHeader();
+	SpoolRecord * record;
+	vector<SpoolCopy> copies;
+	vector<RadiusPacket *> packets;
+	SpoolCopy copy;
+	uint64_t offset;
+	unsigned int i;
+	int answered = 0;
+	string username;
+
+	//copy the records, the file can change while the packets are sent
+	for (offset = header->head; offset < header->tail && copies.size() < SPOOL_BATCH; offset += record->length) {
+		record = this->getRecord(offset);
+		if (record->state == SPOOL_PENDING) {
+			copy.seq = record->seq;
+			copy.enqueued = record->enqueued;
+			copy.attributes.assign((char *) (record + 1), record->attrlen);
+			copy.index = -1;
+			copies.push_back(copy);
+		}
+	}
+	pthread_mutex_unlock(&this->mutex);
+
+	RadiusBatch batch(this->context->radiusconf.getRadiusServer(), &this->context->radiusconf);
+	batch.setDeadline(this->deadline);
+	for (i = 0; i < copies.size(); i++) {
+		RadiusPacket * packet = new RadiusPacket(ACCOUNTING_REQUEST);
+		packet->loadAttributes((Octet *) copies[i].attributes.data(), copies[i].attributes.size());
+
+		//tell the server how long the packet was delayed (RFC 2866)
+		RadiusAttribute ra(ATTRIB_Acct_Delay);
+		ra.setValue((uint32_t) (time(NULL) - copies[i].enqueued));
+		packet->addRadiusAttribute(&ra);
+
+		pair<multimap<Octet, RadiusAttribute>::iterator, multimap<Octet, RadiusAttribute>::iterator> p = packet->findAttributes(ATTRIB_User_Name);
+		username = "";
+		if (p.first != p.second) {
+			username.assign((char *) p.first->second.getValue(), p.first->second.getLength() - 2);
+		}
+		copies[i].index = batch.addPacket(packet, this->context->radiusconf.selectServer(this->context->radiusconf.getAcctLoadBalance(), username));
+		if (copies[i].index < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool: Packet for User " << username << " could not be sent, it is sent again later.\n";
+			delete packet;
+		} else {
+			packets.push_back(packet);
+		}
+	}
+	batch.run();
+
+	pthread_mutex_lock(&this->mutex);
+	header = this->getHeader();
+
+	//mark the answered records, the compaction keeps the order of the records
+	i = 0;
+	for (offset = header->head; offset < header->tail && i < copies.size(); offset += record->length) {
+		record = this->getRecord(offset);
+		while (i < copies.size() && copies[i].seq < record->seq) {
+			i++;
+		}
+		if (i < copies.size() && copies[i].seq == record->seq) {
+			if (copies[i].index >= 0 && batch.getResult(copies[i].index) == 0 && packets[copies[i].index]->getCode() == ACCOUNTING_RESPONSE
+					&& record->state == SPOOL_PENDING) {
+				record->state = SPOOL_DONE;
+				this->pending--;
+				answered++;
+				if (record->flags & SPOOL_STOP) {
+					this->context->metrics.add(METRIC_ACCT_STOPPED);
+				} else {
+					//an interim update has the status type 3 (RFC 2866)
+					pair<multimap<Octet, RadiusAttribute>::iterator, multimap<Octet, RadiusAttribute>::iterator> status = packets[copies[i].index]->findAttributes(ATTRIB_Acct_Status_Type);
+					if (status.first != status.second && status.first->second.getLength() == 6 && status.first->second.getValue()[3] == 3) {
+						this->context->metrics.add(METRIC_ACCT_UPDATES);
+					}
+				}
+			}
+			i++;
+		}
+	}
+
+	//move the head behind the answered records
+	while (header->head < header->tail && this->getRecord(header->head)->state == SPOOL_DONE) {
+		header->head += this->getRecord(header->head)->length;
+	}
+	if (header->head == header->tail) {
+		header->head = this->getDataStart();
+		header->tail = this->getDataStart();
+	}
+	this->dirty = true;
+
+	if (DEBUG (this->context->getVerbosity()))
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Spool: " << answered << " of " << copies.size() << " packets were answered, " << this->pending
+				<< " are waiting.\n";
+
+	if (answered < (int) copies.size()) {
+		*retry = (*retry == 0) ? 1 : min(*retry * 2, SPOOL_MAX_RETRY);
+	} else {
+		*retry = 0;
+	}
+
+	for (i = 0; i < packets.size(); i++) {
+		delete packets[i];
+	}
+}
+
+/** The sender thread. It synchronizes the file every syncinterval milliseconds and
+ * sends the records which wait for a response. If the server doesn't answer,
+ * it waits up to SPOOL_MAX_RETRY seconds until the next attempt.
+ * When the thread is stopped it tries to send the records a last time, or until
+ * the shutdown deadline if it is set. A spool in the memory sends all its records.
+ * @param arg A pointer to the spool.
+ * @return NULL
+ */
+void * AcctSpool::run(void * arg) {
+	AcctSpool * spool = (AcctSpool *) arg;
+	struct timespec ts;
+	long long nextsend = 0, now;
+	int retry = 0;
+
+	pthread_mutex_lock(&spool->mutex);
+	while (1) {
+		now = monotonicTime();
+		if (spool->pending > 0 && (now >= nextsend || spool->stop)) {
+			spool->sendRecords(&retry);
+			nextsend = monotonicTime() + retry * 1000000LL;
+		}
+		if (spool->dirty) {
+			spool->sync();
+		}
+		if (spool->stop) {
+			//with a deadline the records are sent as long as the server answers them all,
+			//a spool in the memory sends all records once, they are lost after the close
+			if ((spool->deadline > 0 || spool->fd < 0) && spool->pending > 0 && retry == 0 && (spool->deadline == 0 || monotonicTime() < spool->deadline)) {
+				continue;
+			}
+			break;
+		}
+
+		//wait for new records or the next synchronization
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += spool->syncinterval / 1000;
+		ts.tv_nsec += (spool->syncinterval % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		if (spool->pending == 0 || retry > 0) {
+			pthread_cond_timedwait(&spool->cond, &spool->mutex, &ts);
+		}
+	}
+	pthread_mutex_unlock(&spool->mutex);
+	return NULL;
+}
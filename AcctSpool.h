@@ -0,0 +1,117 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _ACCT_SPOOL_H_
+#define _ACCT_SPOOL_H_
+
+#include <string>
+#include <pthread.h>
+#include <stdint.h>
+#include "RadiusClass/RadiusPacket.h"
+
+using namespace std;
+
+class PluginContext;
+
+#define SPOOL_MAGIC			0x52505331 /**< The magic number of the spool file ("RPS1").*/
+#define SPOOL_RECORD_MAGIC	0x52505352 /**< The magic number of a record ("RPSR").*/
+#define SPOOL_PENDING		0	/**< The record waits for a response.*/
+#define SPOOL_DONE			1	/**< The record was answered or dropped.*/
+#define SPOOL_STOP			1	/**< Flag for records of stop packets, they are never dropped.*/
+#define SPOOL_BATCH			256	/**< The maximal number of records which are sent at once.*/
+#define SPOOL_MAX_RETRY		60	/**< The maximal time in seconds between two send attempts.*/
+#define SPOOL_MEMORY_SIZE	16777216	/**< The minimal size of a spool in the memory, it holds the stop packets of a mass disconnect.*/
+
+/** The header at the beginning of the spool file.*/
+struct SpoolHeader {
+	uint32_t magic; /**< SPOOL_MAGIC.*/
+	uint32_t version; /**< The version of the format.*/
+	uint64_t size; /**< The size of the file.*/
+	uint64_t head; /**< The offset of the first record which may wait for a response.*/
+	uint64_t tail; /**< The offset where the next record is appended.*/
+	uint64_t nextseq; /**< The sequence number of the next record.*/
+};
+
+/** The header of a record in the spool file, the attributes of the packet follow in the wire format.*/
+struct SpoolRecord {
+	uint32_t magic; /**< SPOOL_RECORD_MAGIC.*/
+	uint32_t length; /**< The length of the record with the header, a multiple of 8.*/
+	uint64_t seq; /**< The sequence number of the record.*/
+	uint32_t state; /**< SPOOL_PENDING or SPOOL_DONE.*/
+	uint32_t flags; /**< SPOOL_STOP for stop packets.*/
+	int64_t enqueued; /**< The time when the packet was spooled.*/
+	uint32_t attrlen; /**< The length of the attributes.*/
+	uint32_t reserved; /**< Unused.*/
+};
+
+/** The class implements a durable journal for accounting packets. The packets are
+ * appended to a memory mapped file and a thread sends them in the background,
+ * so the accounting process never waits for a slow radius server.
+ * The file is synchronized to disk every syncinterval milliseconds and
+ * immediately for stop packets. After a restart the packets which weren't answered are sent again.
+ * The size of the file is fixed, answered records are removed by compaction and if the
+ * file is full the oldest interim updates are dropped.
+ * Without acctspool the spool is kept in the memory only, so the interim updates and
+ * the stop packets don't block the accounting process either.
+ */
+class AcctSpool {
+private:
+	PluginContext * context; /**< The plugin context, the radius config is used by the sender thread.*/
+	int fd; /**< The file descriptor of the spool file, -1 if the spool isn't open.*/
+	char * map; /**< The mapped file.*/
+	size_t size; /**< The size of the file.*/
+	int syncinterval; /**< The time in milliseconds between two synchronizations.*/
+	int pending; /**< The number of records which wait for a response.*/
+	bool dirty; /**< True if the file was changed since the last synchronization.*/
+	bool stop; /**< True if the sender thread should stop.*/
+	bool running; /**< True if the sender thread was started.*/
+	long long deadline; /**< The time (monotonic, in microseconds) when the sending ends at the shutdown, 0 is unlimited.*/
+	pthread_t thread; /**< The sender thread.*/
+	pthread_mutex_t mutex; /**< The mutex for the mapped file.*/
+	pthread_cond_t cond; /**< The condition for new records.*/
+
+	SpoolHeader * getHeader(void);
+	SpoolRecord * getRecord(uint64_t);
+	uint64_t getDataStart(void);
+	int recover(void);
+	void compact(void);
+	bool dropUpdate(void);
+	void sync(void);
+	void sendRecords(int *);
+
+	static void * run(void *);
+
+public:
+	AcctSpool();
+	~AcctSpool();
+
+	int open(PluginContext *, string, size_t, int);
+	int start(void);
+	void close(void);
+	bool isOpen(void);
+	bool isDurable(void);
+
+	int enqueue(RadiusPacket *, bool);
+	int getPending(void);
+	void setDeadline(long long);
+};
+
+#endif //_ACCT_SPOOL_H_
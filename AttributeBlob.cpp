@@ -0,0 +1,168 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "AttributeBlob.h"
+#include <string.h>
+
+/** The length of the header of an entry, the type and the length.*/
+#define BLOB_HEADER 5
+
+/** The constructor of the class, the blob is empty.*/
+AttributeBlob::AttributeBlob() {
+}
+
+/** The destructor of the class.*/
+AttributeBlob::~AttributeBlob() {
+}
+
+/** The method appends an entry.
+ * @param type The type of the entry.
+ * @param value The value.
+ * @param len The length of the value.
+ */
+void AttributeBlob::add(int type, const void * value, uint32_t len) {
+	char header[BLOB_HEADER];
+
+	header[0] = (char) type;
+	memcpy(header + 1, &len, 4);
+	this->buf.append(header, BLOB_HEADER);
+	this->buf.append((const char *) value, len);
+}
+
+/** The method appends an entry with a string.
+ * @param type The type of the entry.
+ * @param value The string.
+ */
+void AttributeBlob::addString(int type, string value) {
+	this->add(type, value.data(), value.size());
+}
+
+/** The method appends an entry with an integer.
+ * @param type The type of the entry.
+ * @param value The integer.
+ */
+void AttributeBlob::addInt(int type, uint32_t value) {
+	this->add(type, &value, sizeof(value));
+}
+
+/** The method searches an entry.
+ * @param type The type of the entry.
+ * @param offset The offset where the search starts, it must be the offset of an entry.
+ * @return The offset of the first entry of the type at or after offset, -1 if there is none.
+ */
+int AttributeBlob::find(int type, int offset) {
+	while (offset >= 0 && offset + BLOB_HEADER <= (int) this->buf.size()) {
+		//an entry which is longer than the buffer ends the search
+		if ((uint64_t) offset + BLOB_HEADER + this->getLength(offset) > this->buf.size()) {
+			return -1;
+		}
+		if (this->getType(offset) == type) {
+			return offset;
+		}
+		offset = this->next(offset);
+	}
+	return -1;
+}
+
+/** The method returns the offset of the next entry.
+ * @param offset The offset of an entry.
+ * @return The offset of the following entry, it is the size of the buffer after the last entry.
+ */
+int AttributeBlob::next(int offset) {
+	return offset + BLOB_HEADER + this->getLength(offset);
+}
+
+/** The getter method for the type of an entry.
+ * @param offset The offset of the entry.
+ * @return The type.
+ */
+int AttributeBlob::getType(int offset) {
+	return (unsigned char) this->buf[offset];
+}
+
+/** The getter method for the length of the value of an entry.
+ * @param offset The offset of the entry.
+ * @return The length.
+ */
+uint32_t AttributeBlob::getLength(int offset) {
+	uint32_t len;
+	memcpy(&len, this->buf.data() + offset + 1, 4);
+	return len;
+}
+
+/** The getter method for the value of an entry.
+ * @param offset The offset of the entry.
+ * @return A pointer to the value, it may be unaligned.
+ */
+const char * AttributeBlob::getValue(int offset) {
+	return this->buf.data() + offset + BLOB_HEADER;
+}
+
+/** The method returns the value of the first entry of a type as string.
+ * @param type The type.
+ * @return The value or an empty string if there is no entry.
+ */
+string AttributeBlob::getString(int type) {
+	int offset = this->find(type);
+	if (offset < 0) {
+		return string();
+	}
+	return string(this->getValue(offset), this->getLength(offset));
+}
+
+/** The method returns the value of the first entry of a type as integer.
+ * @param type The type.
+ * @return The value or 0 if there is no entry.
+ */
+uint32_t AttributeBlob::getInt(int type) {
+	uint32_t value = 0;
+	int offset = this->find(type);
+	if (offset >= 0 && this->getLength(offset) == sizeof(value)) {
+		memcpy(&value, this->getValue(offset), sizeof(value));
+	}
+	return value;
+}
+
+/** The getter method for the buffer, it is sent to the other processes.
+ * @return The buffer.
+ */
+string AttributeBlob::getBuf(void) {
+	return this->buf;
+}
+
+/** The setter method for the buffer.
+ * @param b The buffer from getBuf().
+ */
+void AttributeBlob::setBuf(string b) {
+	this->buf = b;
+}
+
+/** The method removes all entries.*/
+void AttributeBlob::clear(void) {
+	this->buf.clear();
+}
+
+/** The method checks if the blob has no entries.
+ * @return True if there is no entry.
+ */
+bool AttributeBlob::empty(void) {
+	return this->buf.empty();
+}
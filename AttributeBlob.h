@@ -0,0 +1,69 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _ATTRIBUTE_BLOB_H_
+#define _ATTRIBUTE_BLOB_H_
+
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+#define BLOB_FRAMED_ROUTE			1	/**< The text of a Framed-Route or Framed-IPv6-Route.*/
+#define BLOB_ROUTE					2	/**< A parsed route as struct FramedRoute.*/
+#define BLOB_FRAMED_IP				3	/**< The framed ip address as text.*/
+#define BLOB_ACCT_INTERIM_INTERVAL	4	/**< The acct interim interval as uint32_t.*/
+#define BLOB_CLASS					5	/**< The value of the Class attribute.*/
+#define BLOB_VSA					6	/**< The buffer of the vendor specific attributes.*/
+
+/** The class keeps the parsed attributes of an Access-Accept in one buffer,
+ * every entry has a type (1 octet), a length (4 octets) and the value.
+ * The authentication process creates the buffer, the foreground process and the accounting
+ * process get it unchanged over the ipc socket and read the entries at their offsets.
+ */
+class AttributeBlob {
+private:
+	string buf; /**< The entries.*/
+
+public:
+	AttributeBlob();
+	~AttributeBlob();
+
+	void add(int, const void *, uint32_t);
+	void addString(int, string);
+	void addInt(int, uint32_t);
+
+	int find(int, int = 0);
+	int next(int);
+	int getType(int);
+	uint32_t getLength(int);
+	const char * getValue(int);
+
+	string getString(int);
+	uint32_t getInt(int);
+
+	string getBuf(void);
+	void setBuf(string);
+	void clear(void);
+	bool empty(void);
+};
+
+#endif //_ATTRIBUTE_BLOB_H_
@@ -30,18 +30,24 @@
  * it parses the response from the radius server for the following attributes and 
  * send them to the foregroundprocess too.:
  * - FramedIpAddress
- * - FramedRoutes
+ * - FramedRoutes (as text and parsed)
  * - AcctInterimInterval
+ * - Class
+ * - Vendor specific attributes
+ * They are written in one AttributeBlob to the slot of the user in the session table.
  * @param context The plugin context as an object from the class PluginContext.
  */
 
 void AuthenticationProcess::Authentication(PluginContext * context) {
-	/** The user to authenticate.*/
-	UserAuth * user;
-
 	/** A command from the parent process.*/
 	int command;
 
+	/** The slot of the user in the session table.*/
+	int slot;
+
+	/** The password of the user.*/
+	string password;
+
 	/** Whether the command loop should keep running */
 	running = true;
 
@@ -58,87 +64,30 @@ void AuthenticationProcess::Authentication(PluginContext * context) {
 
 	// Event loop
 	while (this->running) {
-		// get a command from foreground process
-		command = context->authsocketforegr.recvInt();
+		// get a command from foreground process, the loop ends if the socket was closed
+		try {
+			command = context->authsocketforegr.recvInt();
+		} catch (Exception &e) {
+			command = -1;
+		}
 
 		switch (command) {
 			// authenticate the user
 			case COMMAND_VERIFY:
-				// allocate memory for the new user
-				user = new UserAuth();
-				
 				try {
-					//get the user informations
-					user->setUsername(context->authsocketforegr.recvStr());
-					user->setPassword(context->authsocketforegr.recvStr());
-					user->setPortnumber(context->authsocketforegr.recvInt());
-					user->setSessionId(context->authsocketforegr.recvStr());
-					user->setCallingStationId(context->authsocketforegr.recvStr());
-					user->setCommonname(context->authsocketforegr.recvStr());
-
-					// framed-ip is an @IP if we're re-negotiating, "" otherwise
-					user->setFramedIp(context->authsocketforegr.recvStr());
-
-					if (DEBUG(context->getVerbosity()) && (user->getFramedIp().compare("") == 0))
-						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: New user auth: username: " << user->getUsername()
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: password: *****"
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: calling station: " << user->getCallingStationId()
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: commonname: " << user->getCommonname() << endl;
-
-					if (DEBUG(context->getVerbosity()) && (user->getFramedIp().compare("") != 0))
-						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: Old user ReAuth: username: " << user->getUsername()
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: password: *****"
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: calling station: " << user->getCallingStationId()
-								<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: commonname: " << user->getCommonname() << endl;
-					
-					// send the AcceptRequestPacket
-					if (user->sendAcceptRequestPacket(context) == 0) { /* Succeeded */
-						// if the authentication succeeded
-						// create the user configuration file
-						// Unless this is a renegotiation (ie: if FramedIP is already set)
-						if (user->createCcdFile(context) > 0 && (user->getFramedIp().compare("") == 0)) {
-							throw Exception("RADIUS-PLUGIN: BACKGROUND AUTH: Ccd-file could not created for user with commonname: " + user->getCommonname() + "!\n");
-						}
-
-						// tell the parent process
-						context->authsocketforegr.send(RESPONSE_SUCCEEDED);
-
-
-						// send the routes to the parent process
-						context->authsocketforegr.send(user->getFramedRoutes());
-
-
-						// send the framed ip to the parent process
-						context->authsocketforegr.send(user->getFramedIp());
-
-
-						// send the interval to the parent process
-						context->authsocketforegr.send(user->getAcctInterimInterval());
-
-
-						// send the vsa buffer
-						context->authsocketforegr.send(user->getVsaBuf(), user->getVsaBufLen());
-
+					//get the slot of the user and the password
+					slot = context->authsocketforegr.recvInt();
+					password = context->authsocketforegr.recvStr();
 
-						// free user_context_auth
-						delete user;
-
-						if (DEBUG (context->getVerbosity()))
-							cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: Auth succeeded in radius_server().\n";
-
-					} else { /* Failed */
-						context->authsocketforegr.send(RESPONSE_FAILED);
-						throw Exception("RADIUS-PLUGIN: BACKGROUND  AUTH: Auth failed!.\n");
-					}
+					// tell the parent process
+					context->authsocketforegr.send(this->verify(context, slot, password));
 				} catch (Exception &e) {
 					cerr << getTime() << e;
-					delete user;
 
 					if (e.getErrnum() == Exception::SOCKETSEND || e.getErrnum() == Exception::SOCKETRECV) {
 						this->running = false;
 					}
 				} catch (...) {
-					delete user;
 					this->running = false;
 				}
 
@@ -168,3 +117,85 @@ void AuthenticationProcess::Authentication(PluginContext * context) {
 	return;
 }
 
+
+/** The method authenticates a user with the radius protocol. If the response is an
+ * access accept ticket, it creates the client config file and writes the parsed attributes
+ * to the slot of the user in the session table. The method is called by the background process
+ * for every COMMAND_VERIFY and directly by the authentication thread of the thread model.
+ * @param context The plugin context as an object from the class PluginContext.
+ * @param slot The slot of the user in the session table.
+ * @param password The password of the user, it isn't written to the session table.
+ * @return RESPONSE_SUCCEEDED or RESPONSE_FAILED.
+ */
+int AuthenticationProcess::verify(PluginContext * context, int slot, string password) {
+	/** The user to authenticate.*/
+	UserAuth * user = new UserAuth();
+
+	/** The response for the foreground process.*/
+	int response = RESPONSE_FAILED;
+
+	try {
+		user->setPassword(password);
+
+		//get the user informations from the session table,
+		// framed-ip is an @IP if we're re-negotiating, "" otherwise
+		if (context->sessions.readUser(slot, user) != 0) {
+			throw Exception("RADIUS-PLUGIN: BACKGROUND AUTH: No user in the session table.\n");
+		}
+
+		if (DEBUG(context->getVerbosity()) && (user->getFramedIp().compare("") == 0))
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: New user auth: username: " << user->getUsername()
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: password: *****"
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: calling station: " << user->getCallingStationId()
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: commonname: " << user->getCommonname() << endl;
+
+		if (DEBUG(context->getVerbosity()) && (user->getFramedIp().compare("") != 0))
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: Old user ReAuth: username: " << user->getUsername()
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: password: *****"
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: calling station: " << user->getCallingStationId()
+					<< "\nRADIUS-PLUGIN: BACKGROUND  AUTH: commonname: " << user->getCommonname() << endl;
+
+		// send the AcceptRequestPacket
+		long long start = monotonicTime();
+		int result = user->sendAcceptRequestPacket(context);
+		traceSpan("authenticate", user->getTraceId(), start);
+		if (result == 0) { /* Succeeded */
+			// if the authentication succeeded
+			// create the user configuration file
+			// Unless this is a renegotiation (ie: if FramedIP is already set)
+			start = monotonicTime();
+			int ccd = user->createCcdFile(context);
+			context->metrics.record(METRIC_CCD_WRITE, monotonicTime() - start);
+			traceSpan("ccd write", user->getTraceId(), start);
+			if (ccd > 0 && (user->getFramedIp().compare("") == 0)) {
+				throw Exception("RADIUS-PLUGIN: BACKGROUND AUTH: Ccd-file could not created for user with commonname: " + user->getCommonname() + "!\n");
+			}
+
+			// write the parsed attributes (routes, framed ip, interval, class, vsa buffer)
+			// to the session table
+			int length = context->sessions.writeUser(slot, user);
+			if (length != 0) {
+				ostringstream msg;
+				msg << "RADIUS-PLUGIN: BACKGROUND AUTH: The record of " << length << " bytes doesn't fit in the session table, a slot holds "
+						<< SESSION_SLOT_DATA << " bytes and there are not enough free slots for the rest.\n";
+				throw Exception(msg.str());
+			}
+
+			response = RESPONSE_SUCCEEDED;
+
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND  AUTH: Auth succeeded in radius_server().\n";
+
+		} else { /* Failed */
+			throw Exception("RADIUS-PLUGIN: BACKGROUND  AUTH: Auth failed!.\n");
+		}
+	} catch (Exception &e) {
+		cerr << getTime() << e;
+	} catch (...) {
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Unknown Exception!\n";
+	}
+
+	// free user_context_auth
+	delete user;
+	return response;
+}
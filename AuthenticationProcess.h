@@ -30,6 +30,7 @@
 class AuthenticationProcess {
 public:
 	void Authentication(PluginContext *);
+	int verify(PluginContext *, int, string);
 
 private:
 	bool running;
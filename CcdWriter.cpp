@@ -0,0 +1,153 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CcdWriter.h"
+#include "radiusplugin.h"
+#include <sys/stat.h>
+
+/** The constructor of the class.*/
+CcdWriter::CcdWriter() {
+}
+
+/** The destructor of the class.*/
+CcdWriter::~CcdWriter() {
+}
+
+/** The method checks if a file has already the content.
+ * @param filename The name of the file.
+ * @param content The content.
+ * @return True if the file exists and has the content.
+ */
+bool CcdWriter::isUnchanged(string filename, string & content) {
+	struct stat st;
+	char * buf;
+	ssize_t n;
+	bool unchanged;
+	int fd;
+
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size != (off_t) content.size()) {
+		close(fd);
+		return false;
+	}
+	buf = new char[content.size() + 1];
+	n = read(fd, buf, content.size() + 1);
+	unchanged = (n == (ssize_t) content.size() && memcmp(buf, content.data(), n) == 0);
+	delete[] buf;
+	close(fd);
+	return unchanged;
+}
+
+/** The method calculates the FNV-1a hash of a content.
+ * @param content The content.
+ * @return The hash.
+ */
+uint64_t CcdWriter::hash(string & content) {
+	uint64_t h = 14695981039346656037ULL;
+	string::size_type i;
+	for (i = 0; i < content.size(); i++) {
+		h = (h ^ (unsigned char) content[i]) * 1099511628211ULL;
+	}
+	return h;
+}
+
+/** The method adds a file with the current attributes to the cache.
+ * @param filename The name of the file.
+ * @param h The hash of the content.
+ */
+void CcdWriter::addCache(string filename, uint64_t h) {
+	struct stat st;
+	CcdCacheEntry entry;
+
+	if (stat(filename.c_str(), &st) != 0) {
+		this->cache.erase(filename);
+		return;
+	}
+	if (this->cache.size() >= CCD_CACHE_SIZE && this->cache.find(filename) == this->cache.end()) {
+		this->cache.clear();
+	}
+	entry.hash = h;
+	entry.inode = st.st_ino;
+	entry.size = st.st_size;
+	entry.mtime = st.st_mtime;
+	this->cache[filename] = entry;
+}
+
+/** The method writes a client config file. The content is written
+ * to a temporary file, which replaces the file. If the file already has the content,
+ * it isn't written. If the cache has the hash of the content and the file wasn't changed since,
+ * the file isn't read.
+ * @param filename The name of the file.
+ * @param content The content of the file.
+ * @return 0 or 1 if the file could not be written.
+ */
+int CcdWriter::write(string filename, string & content) {
+	string tmp;
+	string::size_type pos;
+	map<string, CcdCacheEntry>::iterator it;
+	struct stat st;
+	uint64_t h = hash(content);
+	int fd;
+
+	//the file was written with this content and wasn't changed since
+	it = this->cache.find(filename);
+	if (it != this->cache.end() && it->second.hash == h && stat(filename.c_str(), &st) == 0 && st.st_ino == it->second.inode
+			&& st.st_size == it->second.size && st.st_mtime == it->second.mtime) {
+		return 0;
+	}
+
+	if (this->isUnchanged(filename, content)) {
+		this->addCache(filename, h);
+		return 0;
+	}
+
+	//the temporary file is hidden, so OpenVPN doesn't take it for the file of a common name
+	pos = filename.rfind('/');
+	if (pos == string::npos) {
+		tmp = ".radiusplugin." + filename + ".tmp";
+	} else {
+		tmp = filename.substr(0, pos + 1) + ".radiusplugin." + filename.substr(pos + 1) + ".tmp";
+	}
+
+	fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: Could not open file " << tmp << ": " << strerror(errno) << "." << endl;
+		return 1;
+	}
+	if (::write(fd, content.data(), content.size()) != (ssize_t) content.size()) {
+		cerr << getTime() << "RADIUS-PLUGIN: Could not write file " << tmp << ": " << strerror(errno) << "." << endl;
+		close(fd);
+		unlink(tmp.c_str());
+		return 1;
+	}
+	close(fd);
+
+	if (rename(tmp.c_str(), filename.c_str()) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: Could not rename file " << tmp << " to " << filename << ": " << strerror(errno) << "." << endl;
+		unlink(tmp.c_str());
+		return 1;
+	}
+	this->addCache(filename, h);
+	return 0;
+}
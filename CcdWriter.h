@@ -0,0 +1,64 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CCD_WRITER_H_
+#define _CCD_WRITER_H_
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include <sys/types.h>
+
+using namespace std;
+
+#define CCD_CACHE_SIZE	65536	/**< The maximal number of files in the cache, the cache is cleared if it is full.*/
+
+/** The content hash of a written file and the attributes of the file after it was written.*/
+struct CcdCacheEntry {
+	uint64_t hash; /**< The FNV-1a hash of the content.*/
+	ino_t inode; /**< The inode of the file.*/
+	off_t size; /**< The size of the file.*/
+	time_t mtime; /**< The modification time of the file.*/
+};
+
+/** The class writes the client config files. A file is written with one
+ * write() to a temporary file in the same directory, which replaces the
+ * old file by rename(), so OpenVPN never reads a partly written file.
+ * If the file already has the content, it isn't written again. The hash of the
+ * content of every written file is cached, so on a renegotiation with the same framed ip and routes
+ * the file isn't even read, only stat() checks that nobody else changed the file.
+ */
+class CcdWriter {
+private:
+	map<string, CcdCacheEntry> cache; /**< The cache of the written files, the key is the filename.*/
+
+	bool isUnchanged(string, string &);
+	void addCache(string, uint64_t);
+	static uint64_t hash(string &);
+
+public:
+	CcdWriter();
+	~CcdWriter();
+
+	int write(string, string &);
+};
+
+#endif //_CCD_WRITER_H_
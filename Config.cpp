@@ -22,6 +22,8 @@
 #include <sstream>
 
 #include "Config.h"
+#include "SessionTable.h"
+#include "CpuAffinity.h"
 
 /** The constructor initializes all char arrays with 0. After the initialization
  * the configfile is parsed and the information which are
@@ -36,6 +38,25 @@ Config::Config(char* configfile) {
 	this->useauthcontrolfile = false;
 	this->accountingonly = false;
 	this->nonfatalaccounting = false;
+	this->updatespreading = SPREAD_NONE;
+	this->updatejitter = 100;
+	this->maxupdaterate = 0;
+	this->acctspool = "";
+	this->acctspoolsize = 1048576;
+	this->acctspoolsync = 1000;
+	this->sessionstate = "";
+	this->sessionslots = SESSION_DEFAULT_SLOTS;
+	this->shutdowndeadline = 0;
+	this->metricsinterval = 0;
+	this->statssocket = "";
+	this->asynclog = false;
+	this->tracefile = "";
+	this->processmodel = PROCESS_FORK;
+	this->daemonsocket = "";
+	this->authcpus = "";
+	this->acctcpus = "";
+	this->authnumanode = -1;
+	this->acctnumanode = -1;
 	this->ccdPath = "";
 	this->openvpnconfig = "";
 	this->vsanamedpipe = "";
@@ -122,6 +143,104 @@ int Config::parseConfigFile(const char * configfile) {
 						return BAD_FILE;
 				} else if (strncmp(line.c_str(), "classlist=", 10) == 0) {
 					this->setClassList(line.substr(10, line.size() - 10));
+				} else if (strncmp(line.c_str(), "updatespreading=", 16) == 0) {
+					string stmp = line.substr(16, line.size() - 16);
+					deletechars(&stmp);
+					if (stmp == "none")
+						this->updatespreading = SPREAD_NONE;
+					else if (stmp == "random")
+						this->updatespreading = SPREAD_RANDOM;
+					else if (stmp == "hash")
+						this->updatespreading = SPREAD_HASH;
+					else
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "updatejitter=", 13) == 0) {
+					this->updatejitter = atoi(line.substr(13, line.size() - 13).c_str());
+					if (this->updatejitter < 0 || this->updatejitter > 100)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "maxupdaterate=", 14) == 0) {
+					this->maxupdaterate = atoi(line.substr(14, line.size() - 14).c_str());
+					if (this->maxupdaterate < 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "acctspool=", 10) == 0) {
+					this->acctspool = line.substr(10, line.size() - 10);
+					deletechars(&this->acctspool);
+				} else if (strncmp(line.c_str(), "acctspoolsize=", 14) == 0) {
+					string stmp = line.substr(14, line.size() - 14);
+					deletechars(&stmp);
+					this->acctspoolsize = atol(stmp.c_str());
+					if (stmp.size() > 0 && (stmp[stmp.size() - 1] == 'k' || stmp[stmp.size() - 1] == 'K'))
+						this->acctspoolsize *= 1024;
+					else if (stmp.size() > 0 && (stmp[stmp.size() - 1] == 'm' || stmp[stmp.size() - 1] == 'M'))
+						this->acctspoolsize *= 1048576;
+					if (this->acctspoolsize < 4096)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "acctspoolsync=", 14) == 0) {
+					this->acctspoolsync = atoi(line.substr(14, line.size() - 14).c_str());
+					if (this->acctspoolsync <= 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "sessionstate=", 13) == 0) {
+					this->sessionstate = line.substr(13, line.size() - 13);
+					deletechars(&this->sessionstate);
+				} else if (strncmp(line.c_str(), "sessionslots=", 13) == 0) {
+					this->sessionslots = atoi(line.substr(13, line.size() - 13).c_str());
+					if (this->sessionslots <= 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "shutdowndeadline=", 17) == 0) {
+					this->shutdowndeadline = atoi(line.substr(17, line.size() - 17).c_str());
+					if (this->shutdowndeadline < 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "statssocket=", 12) == 0) {
+					this->statssocket = line.substr(12, line.size() - 12);
+					deletechars(&this->statssocket);
+				} else if (strncmp(line.c_str(), "asynclog=", 9) == 0) {
+					string stmp = line.substr(9, line.size() - 9);
+					deletechars(&stmp);
+					if (stmp == "true")
+						this->asynclog = true;
+					else if (stmp == "false")
+						this->asynclog = false;
+					else
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "processmodel=", 13) == 0) {
+					string stmp = line.substr(13, line.size() - 13);
+					deletechars(&stmp);
+					if (stmp == "fork")
+						this->processmodel = PROCESS_FORK;
+					else if (stmp == "thread")
+						this->processmodel = PROCESS_THREAD;
+					else
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "daemonsocket=", 13) == 0) {
+					this->daemonsocket = line.substr(13, line.size() - 13);
+					deletechars(&this->daemonsocket);
+				} else if (strncmp(line.c_str(), "authcpus=", 9) == 0) {
+					vector<int> cpus;
+					this->authcpus = line.substr(9, line.size() - 9);
+					deletechars(&this->authcpus);
+					if (parseCpuList(this->authcpus, &cpus) != 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "acctcpus=", 9) == 0) {
+					vector<int> cpus;
+					this->acctcpus = line.substr(9, line.size() - 9);
+					deletechars(&this->acctcpus);
+					if (parseCpuList(this->acctcpus, &cpus) != 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "authnumanode=", 13) == 0) {
+					this->authnumanode = atoi(line.substr(13, line.size() - 13).c_str());
+					if (this->authnumanode < 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "acctnumanode=", 13) == 0) {
+					this->acctnumanode = atoi(line.substr(13, line.size() - 13).c_str());
+					if (this->acctnumanode < 0)
+						return BAD_FILE;
+				} else if (strncmp(line.c_str(), "tracefile=", 10) == 0) {
+					this->tracefile = line.substr(10, line.size() - 10);
+					deletechars(&this->tracefile);
+				} else if (strncmp(line.c_str(), "metricsinterval=", 16) == 0) {
+					this->metricsinterval = atoi(line.substr(16, line.size() - 16).c_str());
+					if (this->metricsinterval < 0)
+						return BAD_FILE;
 				}
 			}
 		}
@@ -439,6 +558,158 @@ void Config::setNonFatalAccounting(bool b) {
 	this->nonfatalaccounting = b;
 }
 
+int Config::getUpdateSpreading(void) {
+	return this->updatespreading;
+}
+
+void Config::setUpdateSpreading(int s) {
+	this->updatespreading = s;
+}
+
+int Config::getUpdateJitter(void) {
+	return this->updatejitter;
+}
+
+void Config::setUpdateJitter(int j) {
+	this->updatejitter = j;
+}
+
+int Config::getMaxUpdateRate(void) {
+	return this->maxupdaterate;
+}
+
+void Config::setMaxUpdateRate(int r) {
+	this->maxupdaterate = r;
+}
+
+string Config::getAcctSpool(void) {
+	return this->acctspool;
+}
+
+void Config::setAcctSpool(string s) {
+	this->acctspool = s;
+}
+
+long Config::getAcctSpoolSize(void) {
+	return this->acctspoolsize;
+}
+
+void Config::setAcctSpoolSize(long s) {
+	this->acctspoolsize = s;
+}
+
+int Config::getAcctSpoolSync(void) {
+	return this->acctspoolsync;
+}
+
+void Config::setAcctSpoolSync(int s) {
+	this->acctspoolsync = s;
+}
+
+string Config::getSessionState(void) {
+	return this->sessionstate;
+}
+
+void Config::setSessionState(string s) {
+	this->sessionstate = s;
+}
+
+int Config::getSessionSlots(void) {
+	return this->sessionslots;
+}
+
+void Config::setSessionSlots(int n) {
+	this->sessionslots = n;
+}
+
+int Config::getShutdownDeadline(void) {
+	return this->shutdowndeadline;
+}
+
+void Config::setShutdownDeadline(int d) {
+	this->shutdowndeadline = d;
+}
+
+int Config::getMetricsInterval(void) {
+	return this->metricsinterval;
+}
+
+void Config::setMetricsInterval(int i) {
+	this->metricsinterval = i;
+}
+
+string Config::getStatsSocket(void) {
+	return this->statssocket;
+}
+
+void Config::setStatsSocket(string s) {
+	this->statssocket = s;
+}
+
+bool Config::getAsyncLog(void) {
+	return this->asynclog;
+}
+
+void Config::setAsyncLog(bool b) {
+	this->asynclog = b;
+}
+
+string Config::getTraceFile(void) {
+	return this->tracefile;
+}
+
+void Config::setTraceFile(string s) {
+	this->tracefile = s;
+}
+
+int Config::getProcessModel(void) {
+	return this->processmodel;
+}
+
+void Config::setProcessModel(int m) {
+	this->processmodel = m;
+}
+
+string Config::getDaemonSocket(void) {
+	return this->daemonsocket;
+}
+
+void Config::setDaemonSocket(string s) {
+	this->daemonsocket = s;
+}
+
+string Config::getAuthCpus(void) {
+	return this->authcpus;
+}
+
+void Config::setAuthCpus(string s) {
+	this->authcpus = s;
+}
+
+string Config::getAcctCpus(void) {
+	return this->acctcpus;
+}
+
+void Config::setAcctCpus(string s) {
+	this->acctcpus = s;
+}
+
+int Config::getAuthNumaNode(void) {
+	return this->authnumanode;
+}
+
+void Config::setAuthNumaNode(int n) {
+	this->authnumanode = n;
+}
+
+int Config::getAcctNumaNode(void) {
+	return this->acctnumanode;
+}
+
+void Config::setAcctNumaNode(int n) {
+	this->acctnumanode = n;
+}
+
 list<string> Config::getClassList() {
 	return this->classList;
 }
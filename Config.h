@@ -32,6 +32,15 @@
 #include <utility> 
 using namespace std;
 
+/** The ways to spread the first interim updates of the users.*/
+#define SPREAD_NONE		0	/**< The first update is sent one interval after the start.*/
+#define SPREAD_RANDOM	1	/**< The first update is moved forward by a random time.*/
+#define SPREAD_HASH		2	/**< The first update is moved forward by a time from the hash of the session id.*/
+
+/** The ways to run the authentication and the accounting.*/
+#define PROCESS_FORK	0	/**< In background processes, which are forked when the plugin is opened.*/
+#define PROCESS_THREAD	1	/**< In threads of the OpenVPN process, a privileged helper process does the routes, the client config files and the vsa script.*/
+
 /**This class represents the configurations attributes (without radius configuration) which 
  * can set in the configuration file and methods for the attributes.
  */
@@ -86,6 +95,63 @@ public:
 	list<string> getClassList(void);
 	void setClassList(string);
 
+	int getUpdateSpreading(void);
+	void setUpdateSpreading(int);
+
+	int getUpdateJitter(void);
+	void setUpdateJitter(int);
+
+	int getMaxUpdateRate(void);
+	void setMaxUpdateRate(int);
+
+	string getAcctSpool(void);
+	void setAcctSpool(string);
+
+	long getAcctSpoolSize(void);
+	void setAcctSpoolSize(long);
+
+	int getAcctSpoolSync(void);
+	void setAcctSpoolSync(int);
+
+	string getSessionState(void);
+	void setSessionState(string);
+
+	int getSessionSlots(void);
+	void setSessionSlots(int);
+
+	int getShutdownDeadline(void);
+	void setShutdownDeadline(int);
+
+	int getMetricsInterval(void);
+	void setMetricsInterval(int);
+
+	string getStatsSocket(void);
+	void setStatsSocket(string);
+
+	bool getAsyncLog(void);
+	void setAsyncLog(bool);
+
+	string getTraceFile(void);
+	void setTraceFile(string);
+
+	int getProcessModel(void);
+	void setProcessModel(int);
+
+	string getDaemonSocket(void);
+	void setDaemonSocket(string);
+
+	string getAuthCpus(void);
+	void setAuthCpus(string);
+
+	string getAcctCpus(void);
+	void setAcctCpus(string);
+
+	int getAuthNumaNode(void);
+	void setAuthNumaNode(int);
+
+	int getAcctNumaNode(void);
+	void setAcctNumaNode(int);
+
 private:
 	/** The client config dir, where the plugin writes the config informations (framed routes & ip address of the client)*/
 	string ccdPath;
@@ -129,6 +195,55 @@ private:
 	/** Comma-separated list of valid Class values */
 	list<string> classList;
 
+	/** How the first interim updates are spread: SPREAD_NONE, SPREAD_RANDOM or SPREAD_HASH.*/
+	int updatespreading;
+
+	/** The part of the interim interval (in percent) over which the first updates are spread.*/
+	int updatejitter;
+
+	/** The maximal number of interim updates per second, 0 is unlimited.*/
+	int maxupdaterate;
+
+	/** The spool file for accounting packets, an empty string disables the spool.*/
+	string acctspool;
+
+	/** The size of the spool file in bytes.*/
+	long acctspoolsize;
+
+	/** The time in milliseconds between two synchronizations of the spool file.*/
+	int acctspoolsync;
+
+	/** The journal file for the state of the accounting sessions, an empty string disables the journal.*/
+	string sessionstate;
+
+	/** The number of slots in the shared session table, the maximal number of users.*/
+	int sessionslots;
+
+	/** The time in seconds for the stop packets at the shutdown, 0 is unlimited.*/
+	int shutdowndeadline;
+
+	/** The interval in seconds for logging the metrics, 0 is off.*/
+	int metricsinterval;
+
+	/** The path of the stats socket, an empty string is off.*/
+	string statssocket;
+
+	/** If true the log lines are written asynchronously.*/
+	bool asynclog;
+
+	/** The path of the trace file, an empty string is off.*/
+	string tracefile;
+	/** How the authentication and the accounting run: PROCESS_FORK or PROCESS_THREAD.*/
+	int processmodel;
+	/** The socket of the radius daemon, an empty string runs the authentication and the accounting in the plugin.*/
+	string daemonsocket;
+	/** The cpus of the authentication and the accounting, an empty string is the affinity of OpenVPN.*/
+	string authcpus;
+	string acctcpus;
+	/** The numa nodes of the authentication and the accounting, -1 is none.*/
+	int authnumanode;
+	int acctnumanode;
+
 	/** */
 	void deletechars(string *);
 };
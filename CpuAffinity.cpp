@@ -0,0 +1,185 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "CpuAffinity.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/** The memory policy of the kernel which allocates the pages on a node as long as it has free memory (see set_mempolicy(2)).*/
+#define AFFINITY_MPOL_PREFERRED	1
+#endif
+
+/** The highest cpu in a list.*/
+#define AFFINITY_MAX_CPU	65535
+
+/** The highest node for the memory policy, the node mask is one unsigned long.*/
+#define AFFINITY_MAX_NODE	((int) (8 * sizeof(unsigned long)) - 1)
+
+/** The function parses a list of cpus in the format of the kernel, e.g. "0-3,8,10-11".
+ * @param list The list.
+ * @param cpus The numbers of the cpus.
+ * @return 0 or -1 if the list is invalid.
+ */
+int parseCpuList(string list, vector<int> * cpus) {
+	const char * p = list.c_str();
+	char * end;
+	long first, last, i;
+
+	cpus->clear();
+	while (1) {
+		first = strtol(p, &end, 10);
+		if (end == p || first < 0 || first > AFFINITY_MAX_CPU) {
+			return -1;
+		}
+		last = first;
+		p = end;
+		if (*p == '-') {
+			last = strtol(p + 1, &end, 10);
+			if (end == p + 1 || last < first || last > AFFINITY_MAX_CPU) {
+				return -1;
+			}
+			p = end;
+		}
+		for (i = first; i <= last; i++) {
+			cpus->push_back((int) i);
+		}
+		if (*p == ',') {
+			p++;
+		} else if (*p != '\0' && *p != '\n') {
+			return -1;
+		} else {
+			return 0;
+		}
+	}
+}
+
+/** The function reads the cpus of a numa node from sysfs.
+ * @param node The node.
+ * @param cpus The numbers of the cpus.
+ * @return 0 or -1 if the node doesn't exist.
+ */
+int getNodeCpus(int node, vector<int> * cpus) {
+	ifstream file;
+	string list;
+	char path[64];
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	file.open(path, ios::in);
+	if (!file.is_open()) {
+		errno = ENOENT;
+		return -1;
+	}
+	getline(file, list);
+	file.close();
+	if (parseCpuList(list, cpus) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/** The function pins the calling thread to cpus and lets the kernel allocate its memory on a numa node.
+ * Threads which are started by the thread later inherit both. Without cpus the thread is pinned to the
+ * cpus of the node. It works only on Linux.
+ * @param cpus The list of the cpus, an empty string leaves the affinity alone unless a node is given.
+ * @param node The numa node, -1 is none.
+ * @return 0 or -1 if the affinity or the memory policy could not be set, errno is ENOSYS on other systems.
+ */
+int pinThread(string cpus, int node) {
+#ifdef __linux__
+	vector<int> list;
+	cpu_set_t set;
+	unsigned long mask;
+	unsigned int i;
+
+	if (cpus.size() > 0) {
+		if (parseCpuList(cpus, &list) != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+	} else if (node >= 0 && getNodeCpus(node, &list) != 0) {
+		return -1;
+	}
+	if (list.size() > 0) {
+		CPU_ZERO(&set);
+		for (i = 0; i < list.size(); i++) {
+			if (list[i] < CPU_SETSIZE)
+				CPU_SET(list[i], &set);
+		}
+
+		// 0 is the calling thread
+		if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+			return -1;
+		}
+	}
+	if (node >= 0) {
+		if (node > AFFINITY_MAX_NODE) {
+			errno = EINVAL;
+			return -1;
+		}
+		mask = 1UL << node;
+		if (syscall(SYS_set_mempolicy, AFFINITY_MPOL_PREFERRED, &mask, 8 * sizeof(mask) + 1) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+#else
+	if (cpus.size() == 0 && node < 0) {
+		return 0;
+	}
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/** The function lets the kernel allocate the pages of a mapping on a numa node,
+ * it must be called before the pages are used the first time. The policy of a
+ * shared mapping holds for all processes which map it. It works only on Linux.
+ * @param addr The start of the mapping.
+ * @param len The length of the mapping.
+ * @param node The numa node.
+ * @return 0 or -1 if the policy could not be set, errno is ENOSYS on other systems.
+ */
+int bindMemory(void * addr, size_t len, int node) {
+#ifdef __linux__
+	unsigned long mask;
+
+	if (node < 0 || node > AFFINITY_MAX_NODE) {
+		errno = EINVAL;
+		return -1;
+	}
+	mask = 1UL << node;
+	if (syscall(SYS_mbind, addr, len, AFFINITY_MPOL_PREFERRED, &mask, 8 * sizeof(mask) + 1, 0) != 0) {
+		return -1;
+	}
+	return 0;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
@@ -0,0 +1,37 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _CPU_AFFINITY_H_
+#define _CPU_AFFINITY_H_
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+int parseCpuList(string, vector<int> *);
+int getNodeCpus(int, vector<int> *);
+int pinThread(string, int);
+int bindMemory(void *, size_t, int);
+
+#endif //_CPU_AFFINITY_H_
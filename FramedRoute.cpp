@@ -0,0 +1,206 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FramedRoute.h"
+#include "radiusplugin.h"
+#include <sstream>
+
+/** The function parses a route, the format is "network[/bits] [gateway[/bits]] [metric]",
+ * e.g. "192.168.1.0/24 10.8.0.1 1" or "2001:db8::/48 :: 1". The family is taken
+ * from the network. The host bits of the network are cleared.
+ * A gateway 0.0.0.0 or :: means the route has no gateway.
+ * @param route The route.
+ * @param fr The parsed route.
+ * @return 0 or -1 if the route is invalid.
+ */
+int parseFramedRoute(string route, FramedRoute * fr) {
+	istringstream in(route);
+	string network, gateway, metric, bits;
+	string::size_type pos;
+	unsigned int maxlen, len, i;
+	char * end;
+
+	memset(fr, 0, sizeof(FramedRoute));
+	if (!(in >> network)) {
+		return -1;
+	}
+	in >> gateway;
+	in >> metric;
+
+	//the network and the prefix length
+	pos = network.find('/');
+	if (pos != string::npos) {
+		bits = network.substr(pos + 1);
+		network = network.substr(0, pos);
+	}
+	fr->family = (network.find(':') != string::npos) ? AF_INET6 : AF_INET;
+	maxlen = (fr->family == AF_INET) ? 32 : 128;
+	if (inet_pton(fr->family, network.c_str(), fr->prefix) != 1) {
+		return -1;
+	}
+	len = maxlen;
+	if (bits.size() > 0) {
+		len = strtoul(bits.c_str(), &end, 10);
+		if (*end != '\0' || len > maxlen) {
+			return -1;
+		}
+	}
+	fr->prefixlen = len;
+	for (i = 0; i < maxlen / 8; i++) {
+		if (len < 8 * i + 8) {
+			fr->prefix[i] &= (len <= 8 * i) ? 0 : (uint8_t) (0xFF << (8 * i + 8 - len));
+		}
+	}
+
+	//the gateway, a prefix length of the gateway is ignored
+	if (gateway.size() > 0) {
+		pos = gateway.find('/');
+		if (pos != string::npos) {
+			gateway = gateway.substr(0, pos);
+		}
+		if (inet_pton(fr->family, gateway.c_str(), fr->gateway) != 1) {
+			return -1;
+		}
+		for (i = 0; i < maxlen / 8; i++) {
+			if (fr->gateway[i] != 0) {
+				fr->hasgateway = 1;
+			}
+		}
+	}
+
+	//the metric
+	if (metric.size() > 0) {
+		fr->metric = strtoul(metric.c_str(), &end, 10);
+		if (*end != '\0') {
+			return -1;
+		}
+		fr->hasmetric = 1;
+	}
+	return 0;
+}
+
+/** The function creates the iroute option of a route for the client config file.
+ * @param fr The route.
+ * @return "iroute network netmask" or "iroute-ipv6 network/bits".
+ */
+string formatIroute(FramedRoute * fr) {
+	char addr[INET6_ADDRSTRLEN], maskaddr[INET_ADDRSTRLEN];
+	struct in_addr mask;
+	ostringstream out;
+
+	inet_ntop(fr->family, fr->prefix, addr, sizeof(addr));
+	if (fr->family == AF_INET) {
+		mask.s_addr = htonl(fr->prefixlen == 0 ? 0 : 0xFFFFFFFFU << (32 - fr->prefixlen));
+		inet_ntop(AF_INET, &mask, maskaddr, sizeof(maskaddr));
+		out << "iroute " << addr << " " << maskaddr;
+	} else {
+		out << "iroute-ipv6 " << addr << "/" << (int) fr->prefixlen;
+	}
+	return out.str();
+}
+
+/** The function checks a route which was received from another process,
+ * so only a complete route is passed to the route command.
+ * @param fr The route.
+ * @return True if the family, the prefix length and the flags are valid.
+ */
+bool isValidFramedRoute(FramedRoute * fr) {
+	if (fr->family == AF_INET) {
+		if (fr->prefixlen > 32) {
+			return false;
+		}
+	} else if (fr->family == AF_INET6) {
+		if (fr->prefixlen > 128) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+	return fr->hasgateway <= 1 && fr->hasmetric <= 1;
+}
+
+/** The function creates the arguments of the command which adds or deletes a route in the system
+ * routing table, the route command of net-tools or the ip command of iproute2.
+ * The arguments are passed to the command without a shell.
+ * @param fr The route.
+ * @param add True to add the route, false to delete it.
+ * @param iproute True for the ip command, false for the route command.
+ * @return The arguments, the first one is the name of the command.
+ */
+vector<string> formatRouteArgs(FramedRoute * fr, bool add, bool iproute) {
+	char addr[INET6_ADDRSTRLEN];
+	vector<string> args;
+	ostringstream out;
+
+	inet_ntop(fr->family, fr->prefix, addr, sizeof(addr));
+	out << addr << "/" << (int) fr->prefixlen;
+	if (iproute) {
+		args.push_back("ip");
+		if (fr->family == AF_INET6) {
+			args.push_back("-6");
+		}
+		args.push_back("route");
+		args.push_back(add ? "add" : "del");
+		args.push_back(out.str());
+	} else {
+		args.push_back("route");
+		if (fr->family == AF_INET6) {
+			args.push_back("-A");
+			args.push_back("inet6");
+		}
+		args.push_back(add ? "add" : "del");
+		if (fr->family == AF_INET) {
+			args.push_back("-net");
+		}
+		args.push_back(out.str());
+	}
+	if (fr->hasgateway) {
+		inet_ntop(fr->family, fr->gateway, addr, sizeof(addr));
+		args.push_back(iproute ? "via" : "gw");
+		args.push_back(addr);
+	}
+	if (fr->hasmetric) {
+		out.str("");
+		out << fr->metric;
+		args.push_back("metric");
+		args.push_back(out.str());
+	}
+	return args;
+}
+
+/** The function creates the route command which adds or deletes a route for the log.
+ * @param fr The route.
+ * @param add True to add the route, false to delete it.
+ * @return The command.
+ */
+string formatRouteCommand(FramedRoute * fr, bool add) {
+	vector<string> args = formatRouteArgs(fr, add, false);
+	string command;
+	unsigned int i;
+
+	for (i = 0; i < args.size(); i++) {
+		if (i > 0) {
+			command += " ";
+		}
+		command += args[i];
+	}
+	return command;
+}
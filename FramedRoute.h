@@ -0,0 +1,49 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FRAMED_ROUTE_H_
+#define _FRAMED_ROUTE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+/** A parsed Framed-Route (RFC 2865) or Framed-IPv6-Route (RFC 3162) attribute.
+ * The struct has no pointers, so a route can be sent as a buffer between the processes.*/
+struct FramedRoute {
+	uint8_t family; /**< AF_INET or AF_INET6.*/
+	uint8_t prefixlen; /**< The length of the prefix in bits.*/
+	uint8_t hasgateway; /**< 1 if the route has a gateway.*/
+	uint8_t hasmetric; /**< 1 if the route has a metric.*/
+	uint32_t metric; /**< The metric.*/
+	uint8_t prefix[16]; /**< The network address in network byte order, the host bits are 0.*/
+	uint8_t gateway[16]; /**< The gateway in network byte order.*/
+};
+
+int parseFramedRoute(string, FramedRoute *);
+string formatIroute(FramedRoute *);
+bool isValidFramedRoute(FramedRoute *);
+vector<string> formatRouteArgs(FramedRoute *, bool, bool);
+string formatRouteCommand(FramedRoute *, bool);
+
+#endif //_FRAMED_ROUTE_H_
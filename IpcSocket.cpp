@@ -160,7 +160,8 @@ string IpcSocket::recvStr(void) {
 		if (size != len) {
 			throw Exception(Exception::SOCKETRECV);
 		}
-		str = buffer;
+		//the string can contain binary data, e.g. the parsed routes
+		str.assign(buffer, len);
 		delete[] buffer;
 	}
 	return str;
@@ -193,3 +194,63 @@ void IpcSocket::recvBuf(User * user) {
 
 }
 
+
+/**The method sends a descriptor via the socket (SCM_RIGHTS), the
+ * receiver gets a new descriptor of the same file.
+ * @param fd The descriptor to send.
+ * @throws Exception::SOCKETSEND if the descriptor could not be sent.
+ */
+void IpcSocket::sendFd(int fd) {
+	struct msghdr msg;
+	struct iovec iov;
+	char data = 0;
+	char control[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr * cmsg;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = &data;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	if (sendmsg(this->socket, &msg, 0) != 1) {
+		throw Exception(Exception::SOCKETSEND);
+	}
+}
+
+/**The method receives a descriptor from the socket, see sendFd().
+ * @return The new descriptor.
+ * @throws Exception::SOCKETRECV If no descriptor was received.
+ */
+int IpcSocket::recvFd(void) {
+	struct msghdr msg;
+	struct iovec iov;
+	char data;
+	char control[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr * cmsg;
+	int fd;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &data;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(this->socket, &msg, 0) != 1) {
+		throw Exception(Exception::SOCKETRECV);
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+		throw Exception(Exception::SOCKETRECV);
+	}
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
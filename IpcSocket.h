@@ -64,6 +64,10 @@ public:
 	string recvStr(void);
 
 	void recvBuf(User *);
+
+	void sendFd(int);
+
+	int recvFd(void);
 	
 };
 
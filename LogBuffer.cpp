@@ -0,0 +1,266 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "LogBuffer.h"
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+
+/** The line buffer of the thread.*/
+static __thread char line[LOG_LINE];
+
+/** The length of the line in the buffer of the thread.*/
+static __thread int linelen;
+
+/** The buffer which replaces the stream buffer of cerr.*/
+static LogBuffer logbuffer;
+
+/** The function writes a buffer completely to stderr.
+ * @param buf The buffer.
+ * @param len The length.
+ */
+static void writeStderr(const char * buf, int len) {
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(STDERR_FILENO, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+/** The constructor of the class, the buffer isn't started.*/
+LogBuffer::LogBuffer() {
+	pthread_mutex_init(&this->mutex, NULL);
+	pthread_cond_init(&this->flush, NULL);
+	pthread_cond_init(&this->drained, NULL);
+	this->active = NULL;
+	this->spare = NULL;
+	this->used = 0;
+	this->stopping = false;
+	this->users = 0;
+	this->previous = NULL;
+	pthread_atfork(&LogBuffer::lockBeforeFork, &LogBuffer::unlockAfterFork, &LogBuffer::resetAfterFork);
+}
+
+/** The destructor of the class.*/
+LogBuffer::~LogBuffer() {
+	pthread_cond_destroy(&this->drained);
+	pthread_cond_destroy(&this->flush);
+	pthread_mutex_destroy(&this->mutex);
+}
+
+/** The method starts the flusher thread and replaces the stream buffer of cerr.
+ * A second call only counts the users. If the thread can't be started cerr isn't changed.
+ */
+void LogBuffer::start(void) {
+	if (this->users++ > 0) {
+		return;
+	}
+	this->active = new char[LOG_BUFFER];
+	this->spare = new char[LOG_BUFFER];
+	this->used = 0;
+	this->stopping = false;
+	if (pthread_create(&this->thread, NULL, &LogBuffer::run, this) != 0) {
+		delete[] this->active;
+		delete[] this->spare;
+		this->active = NULL;
+		this->spare = NULL;
+		this->users = 0;
+		return;
+	}
+	this->previous = cerr.rdbuf(this);
+}
+
+/** The method restores the stream buffer of cerr, stops the flusher thread
+ * and writes the rest of the lines. The last user stops the buffer.
+ */
+void LogBuffer::stop(void) {
+	if (this->users == 0 || --this->users > 0) {
+		return;
+	}
+	if (linelen > 0) {
+		this->commit();
+	}
+	cerr.rdbuf(this->previous);
+
+	pthread_mutex_lock(&this->mutex);
+	this->stopping = true;
+	pthread_cond_signal(&this->flush);
+	pthread_mutex_unlock(&this->mutex);
+	pthread_join(this->thread, NULL);
+
+	writeStderr(this->active, this->used);
+	delete[] this->active;
+	delete[] this->spare;
+	this->active = NULL;
+	this->spare = NULL;
+	this->used = 0;
+}
+
+/** The function of the flusher thread, it writes the buffered lines.
+ * @param arg A pointer to the LogBuffer.
+ * @return NULL.
+ */
+void * LogBuffer::run(void * arg) {
+	LogBuffer * log = (LogBuffer *) arg;
+	struct timespec ts;
+	struct timeval now;
+	char * buf;
+	int n;
+
+	pthread_mutex_lock(&log->mutex);
+	while (!log->stopping) {
+		if (log->used < LOG_BUFFER / 2) {
+			gettimeofday(&now, NULL);
+			ts.tv_sec = now.tv_sec + (now.tv_usec + LOG_FLUSH) / 1000000;
+			ts.tv_nsec = ((now.tv_usec + LOG_FLUSH) % 1000000) * 1000;
+			pthread_cond_timedwait(&log->flush, &log->mutex, &ts);
+		}
+		if (log->used > 0) {
+			//swap the buffers, the lines are written without the lock
+			buf = log->active;
+			n = log->used;
+			log->active = log->spare;
+			log->spare = buf;
+			log->used = 0;
+			pthread_cond_broadcast(&log->drained);
+			pthread_mutex_unlock(&log->mutex);
+			writeStderr(buf, n);
+			pthread_mutex_lock(&log->mutex);
+		}
+	}
+	pthread_mutex_unlock(&log->mutex);
+	return NULL;
+}
+
+/** The function is called before a fork, the buffers are consistent while the mutex is held.*/
+void LogBuffer::lockBeforeFork(void) {
+	pthread_mutex_lock(&logbuffer.mutex);
+}
+
+/** The function is called in the parent process after a fork.*/
+void LogBuffer::unlockAfterFork(void) {
+	pthread_mutex_unlock(&logbuffer.mutex);
+}
+
+/** The function is called in the child process after a fork. Only the forking thread exists
+ * in the child, so the mutex and the conditions are initialized again. The lines in the buffers
+ * are written by the parent, the child drops them, restores cerr and counts no users, so
+ * start() starts an own flusher thread in the child.
+ */
+void LogBuffer::resetAfterFork(void) {
+	LogBuffer * log = &logbuffer;
+
+	pthread_mutex_init(&log->mutex, NULL);
+	pthread_cond_init(&log->flush, NULL);
+	pthread_cond_init(&log->drained, NULL);
+	linelen = 0;
+	if (log->users == 0) {
+		return;
+	}
+	cerr.rdbuf(log->previous);
+	delete[] log->active;
+	delete[] log->spare;
+	log->active = NULL;
+	log->spare = NULL;
+	log->used = 0;
+	log->stopping = false;
+	log->users = 0;
+}
+
+/** The method copies the line of the thread to the buffer of the process.
+ * If there is no space the thread waits for the flusher thread.
+ */
+void LogBuffer::commit(void) {
+	pthread_mutex_lock(&this->mutex);
+	while (this->used + linelen > LOG_BUFFER) {
+		pthread_cond_signal(&this->flush);
+		pthread_cond_wait(&this->drained, &this->mutex);
+	}
+	memcpy(this->active + this->used, line, linelen);
+	this->used += linelen;
+	if (this->used >= LOG_BUFFER / 2) {
+		pthread_cond_signal(&this->flush);
+	}
+	pthread_mutex_unlock(&this->mutex);
+	linelen = 0;
+}
+
+/** The method appends a character to the line of the thread.
+ * @param c The character.
+ * @return The character.
+ */
+int LogBuffer::overflow(int c) {
+	if (c != EOF) {
+		line[linelen++] = (char) c;
+		if (c == '\n' || linelen == LOG_LINE) {
+			this->commit();
+		}
+	}
+	return c;
+}
+
+/** The method appends characters to the line of the thread,
+ * every complete line is copied to the buffer of the process.
+ * @param s The characters.
+ * @param n The number of characters.
+ * @return The number of characters.
+ */
+streamsize LogBuffer::xsputn(const char * s, streamsize n) {
+	streamsize i, len;
+	const char * end;
+
+	for (i = 0; i < n; i += len) {
+		len = min((streamsize) (LOG_LINE - linelen), n - i);
+		end = (const char *) memchr(s + i, '\n', len);
+		if (end != NULL) {
+			len = end - (s + i) + 1;
+		}
+		memcpy(line + linelen, s + i, len);
+		linelen += len;
+		if (end != NULL || linelen == LOG_LINE) {
+			this->commit();
+		}
+	}
+	return n;
+}
+
+/** The function starts the asynchronous log of the process, the output of cerr is
+ * buffered until stopAsyncLog() is called. It must be called after the fork of the background processes,
+ * a process which is forked later logs synchronously until it calls the function itself.
+ */
+void startAsyncLog(void) {
+	logbuffer.start();
+}
+
+/** The function stops the asynchronous log of the process, the buffered lines are written.*/
+void stopAsyncLog(void) {
+	logbuffer.stop();
+}
@@ -0,0 +1,78 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _LOG_BUFFER_H_
+#define _LOG_BUFFER_H_
+
+#include <streambuf>
+#include <pthread.h>
+
+using namespace std;
+
+#define LOG_LINE	1024	/**< The size of the line buffer of a thread, a longer line is split.*/
+#define LOG_BUFFER	65536	/**< The size of each of the two buffers of the process.*/
+#define LOG_FLUSH	100000	/**< The interval in microseconds for writing the buffered lines.*/
+
+/** The class is a stream buffer for cerr, which writes the log lines asynchronously.
+ * Every thread collects its line in an own buffer without any lock, a complete line
+ * is copied to the buffer of the process. A flusher thread swaps the buffer of the
+ * process with a second one and writes it to the file descriptor of stderr every LOG_FLUSH
+ * microseconds or when it is half full, so logging doesn't cost a system call per line.
+ * If the buffer is full a thread waits until it is written, no line is lost.
+ * A child process which is forked while the buffer is started, e.g. by a second plugin
+ * instance, has no flusher thread, so the buffer is reset in the child and cerr is restored
+ * until the child starts the buffer itself.
+ */
+class LogBuffer: public streambuf {
+private:
+	pthread_mutex_t mutex; /**< The mutex for the buffers.*/
+	pthread_cond_t flush; /**< The condition to wake up the flusher thread.*/
+	pthread_cond_t drained; /**< The condition for the threads which wait for space in the buffer.*/
+	pthread_t thread; /**< The flusher thread.*/
+	char * active; /**< The buffer for new lines.*/
+	char * spare; /**< The buffer which is written by the flusher thread.*/
+	int used; /**< The number of bytes in the active buffer.*/
+	bool stopping; /**< True if the flusher thread must end.*/
+	int users; /**< The number of plugin instances which use the buffer.*/
+	streambuf * previous; /**< The stream buffer of cerr before the start.*/
+
+	static void * run(void *);
+	static void lockBeforeFork(void);
+	static void unlockAfterFork(void);
+	static void resetAfterFork(void);
+	void commit(void);
+
+protected:
+	int overflow(int);
+	streamsize xsputn(const char *, streamsize);
+
+public:
+	LogBuffer();
+	~LogBuffer();
+
+	void start(void);
+	void stop(void);
+};
+
+void startAsyncLog(void);
+void stopAsyncLog(void);
+
+#endif //_LOG_BUFFER_H_
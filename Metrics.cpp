@@ -0,0 +1,351 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Metrics.h"
+#include <sys/mman.h>
+#include <sstream>
+
+/** The names of the histograms.*/
+static const char * histogramnames[METRIC_HISTOGRAMS] = { "auth_queue", "auth_ipc", "acct_ipc", "ccd_write", "routes", "status_file", "vsa_script" };
+
+/** The names of the counters.*/
+static const char * counternames[METRIC_COUNTERS] = { "auth_accepted", "auth_rejected", "acct_started", "acct_stopped", "acct_updates" };
+
+/** The names of the gauges.*/
+static const char * gaugenames[METRIC_GAUGES] = { "auth_queue_length", "stop_queue_length", "spool_pending", "scheduled_users", "next_update" };
+
+/** The percentiles of a histogram in the snapshots.*/
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+
+/** The function escapes a string for a label of the Prometheus text format or a JSON string.
+ * @param s The string.
+ * @return The escaped string.
+ */
+static string escape(string s) {
+	string out;
+	unsigned int i;
+
+	for (i = 0; i < s.size(); i++) {
+		if (s[i] == '\\' || s[i] == '"') {
+			out += '\\';
+			out += s[i];
+		} else if (s[i] == '\n') {
+			out += "\\n";
+		} else {
+			out += s[i];
+		}
+	}
+	return out;
+}
+
+/** The constructor of the class, the metrics aren't mapped.*/
+Metrics::Metrics() {
+	this->data = NULL;
+	this->owner = false;
+}
+
+/** The destructor unmaps the metrics.*/
+Metrics::~Metrics() {
+	this->close();
+}
+
+/** The method maps the metrics, it must be called before the processes are forked.
+ * @return 0 or -1 if the metrics could not be mapped, then nothing is recorded.
+ */
+int Metrics::open(void) {
+	void * p;
+
+	p = mmap(NULL, sizeof(MetricsData), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	this->data = (MetricsData *) p;
+	this->owner = true;
+	return 0;
+}
+
+/** The method uses the mapping of other metrics, e.g. in the context of the accounting thread.
+ * The other metrics must stay open until these are closed.
+ * @param metrics The other metrics.
+ */
+void Metrics::attach(Metrics * metrics) {
+	this->data = metrics->data;
+	this->owner = false;
+}
+
+/** The method unmaps the metrics, attached metrics only forget the mapping.*/
+void Metrics::close(void) {
+	if (this->data != NULL) {
+		if (this->owner)
+			munmap(this->data, sizeof(MetricsData));
+		this->data = NULL;
+	}
+}
+
+/** The method records a time in a histogram.
+ * @param histogram The histogram, e.g. METRIC_AUTH_IPC.
+ * @param usec The time in microseconds.
+ */
+void Metrics::record(int histogram, long usec) {
+	if (this->data != NULL) {
+		this->data->histograms[histogram].record(usec);
+	}
+}
+
+/** The method increments a counter.
+ * @param counter The counter, e.g. METRIC_AUTH_ACCEPTED.
+ * @param n The increment.
+ */
+void Metrics::add(int counter, uint64_t n) {
+	if (this->data != NULL) {
+		__sync_fetch_and_add(&this->data->counters[counter], n);
+	}
+}
+
+/** The method sets a gauge.
+ * @param gauge The gauge, e.g. METRIC_AUTH_QUEUE_LENGTH.
+ * @param value The value.
+ */
+void Metrics::set(int gauge, int64_t value) {
+	if (this->data != NULL) {
+		this->data->gauges[gauge] = value;
+	}
+}
+
+/** The getter method for a histogram.
+ * @param histogram The histogram, e.g. METRIC_AUTH_IPC.
+ * @return A pointer to the histogram or NULL if the metrics aren't mapped.
+ */
+RadiusHistogram * Metrics::getHistogram(int histogram) {
+	if (this->data == NULL) {
+		return NULL;
+	}
+	return &this->data->histograms[histogram];
+}
+
+/** The getter method for the histogram of the response times of a server.
+ * @param server The position of the server in the config.
+ * @return A pointer to the histogram or NULL if there is no histogram for the server.
+ */
+RadiusHistogram * Metrics::getServerHistogram(int server) {
+	if (this->data == NULL || server >= METRICS_MAX_SERVERS) {
+		return NULL;
+	}
+	return &this->data->servers[server];
+}
+
+/** The getter method for a counter.
+ * @param counter The counter, e.g. METRIC_AUTH_ACCEPTED.
+ * @return The value.
+ */
+uint64_t Metrics::getCounter(int counter) {
+	if (this->data == NULL) {
+		return 0;
+	}
+	return this->data->counters[counter];
+}
+
+/** The getter method for a gauge.
+ * @param gauge The gauge, e.g. METRIC_AUTH_QUEUE_LENGTH.
+ * @return The value.
+ */
+int64_t Metrics::getGauge(int gauge) {
+	if (this->data == NULL) {
+		return 0;
+	}
+	return this->data->gauges[gauge];
+}
+
+/** The getter method for the shared counter of the requests which wait for a response of a server.
+ * @param server The position of the server in the config.
+ * @return A pointer to the counter or NULL if there is no counter for the server.
+ */
+volatile int * Metrics::getInflightCounter(int server) {
+	if (this->data == NULL || server >= METRICS_MAX_SERVERS) {
+		return NULL;
+	}
+	return &this->data->inflight[server];
+}
+
+/** The getter method for the name of a histogram.
+ * @param histogram The histogram.
+ * @return The name, e.g. "auth_ipc".
+ */
+const char * Metrics::getHistogramName(int histogram) {
+	return histogramnames[histogram];
+}
+
+/** The getter method for the name of a counter.
+ * @param counter The counter.
+ * @return The name, e.g. "auth_accepted".
+ */
+const char * Metrics::getCounterName(int counter) {
+	return counternames[counter];
+}
+
+/** The getter method for the name of a gauge.
+ * @param gauge The gauge.
+ * @return The name, e.g. "auth_queue_length".
+ */
+const char * Metrics::getGaugeName(int gauge) {
+	return gaugenames[gauge];
+}
+
+/** The method creates a text snapshot of the metrics, one line per histogram
+ * with the count and the percentiles in microseconds and one line with the counters.
+ * @param servers The radius servers, for the names of the server histograms.
+ * @return The snapshot.
+ */
+string Metrics::format(list<RadiusServer> * servers) {
+	ostringstream out;
+	list<RadiusServer>::iterator server;
+	RadiusHistogram * h;
+	int i;
+
+	if (this->data == NULL) {
+		return string();
+	}
+	for (i = 0; i < METRIC_HISTOGRAMS + METRICS_MAX_SERVERS; i++) {
+		if (i < METRIC_HISTOGRAMS) {
+			h = &this->data->histograms[i];
+			out << histogramnames[i];
+		} else {
+			h = &this->data->servers[i - METRIC_HISTOGRAMS];
+			if (h->getCount() == 0) {
+				continue;
+			}
+			server = servers->begin();
+			advance(server, i - METRIC_HISTOGRAMS);
+			out << "radius_rtt{" << server->getName() << "}";
+		}
+		out << " count=" << h->getCount() << " p50=" << h->getPercentile(50) << " p90=" << h->getPercentile(90) << " p99="
+				<< h->getPercentile(99) << " p99.9=" << h->getPercentile(99.9) << " max=" << h->getMax() << "\n";
+	}
+	for (i = 0; i < METRIC_COUNTERS; i++) {
+		out << (i > 0 ? " " : "") << counternames[i] << "=" << this->data->counters[i];
+	}
+	out << "\n";
+	return out.str();
+}
+
+/** The function writes a histogram as summary in the Prometheus text format.
+ * @param out The stream.
+ * @param name The name of the metric.
+ * @param label A label, e.g. "server=\"127.0.0.1\"", or an empty string.
+ * @param h The histogram.
+ */
+static void writeSummary(ostringstream & out, string name, string label, RadiusHistogram * h) {
+	unsigned int i;
+
+	for (i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+		out << name << "{" << label << (label.size() > 0 ? "," : "") << "quantile=\"" << percentiles[i] / 100 << "\"} " << h->getPercentile(percentiles[i]) << "\n";
+	}
+	if (label.size() > 0) {
+		label = "{" + label + "}";
+	}
+	out << name << "_sum" << label << " " << h->getSum() << "\n";
+	out << name << "_count" << label << " " << h->getCount() << "\n";
+}
+
+/** The function writes a histogram as JSON object.
+ * @param out The stream.
+ * @param h The histogram.
+ */
+static void writeJsonHistogram(ostringstream & out, RadiusHistogram * h) {
+	unsigned int i;
+
+	out << "{\"count\":" << h->getCount() << ",\"sum\":" << h->getSum() << ",\"max\":" << h->getMax();
+	for (i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+		out << ",\"p" << percentiles[i] << "\":" << h->getPercentile(percentiles[i]);
+	}
+	out << "}";
+}
+
+/** The method creates a snapshot of the metrics in the Prometheus text format.
+ * The histograms are summaries with quantiles in microseconds.
+ * @param servers The radius servers, for the names of the server metrics.
+ * @return The snapshot.
+ */
+string Metrics::formatPrometheus(list<RadiusServer> * servers) {
+	ostringstream out;
+	list<RadiusServer>::iterator server;
+	int i;
+
+	if (this->data == NULL) {
+		return string();
+	}
+	for (i = 0; i < METRIC_COUNTERS; i++) {
+		out << "# TYPE radiusplugin_" << counternames[i] << "_total counter\n";
+		out << "radiusplugin_" << counternames[i] << "_total " << this->data->counters[i] << "\n";
+	}
+	for (i = 0; i < METRIC_GAUGES; i++) {
+		out << "# TYPE radiusplugin_" << gaugenames[i] << " gauge\n";
+		out << "radiusplugin_" << gaugenames[i] << " " << this->data->gauges[i] << "\n";
+	}
+	for (i = 0; i < METRIC_HISTOGRAMS; i++) {
+		out << "# TYPE radiusplugin_" << histogramnames[i] << "_microseconds summary\n";
+		writeSummary(out, string("radiusplugin_") + histogramnames[i] + "_microseconds", "", &this->data->histograms[i]);
+	}
+	out << "# TYPE radiusplugin_radius_inflight gauge\n";
+	for (i = 0, server = servers->begin(); server != servers->end() && i < METRICS_MAX_SERVERS; server++, i++) {
+		out << "radiusplugin_radius_inflight{server=\"" << escape(server->getName()) << "\"} " << this->data->inflight[i] << "\n";
+	}
+	out << "# TYPE radiusplugin_radius_rtt_microseconds summary\n";
+	for (i = 0, server = servers->begin(); server != servers->end() && i < METRICS_MAX_SERVERS; server++, i++) {
+		writeSummary(out, "radiusplugin_radius_rtt_microseconds", "server=\"" + escape(server->getName()) + "\"", &this->data->servers[i]);
+	}
+	return out.str();
+}
+
+/** The method creates a snapshot of the metrics in JSON.
+ * @param servers The radius servers, for the names of the server metrics.
+ * @return The snapshot, an object with the counters, the gauges, the histograms and the servers.
+ */
+string Metrics::formatJson(list<RadiusServer> * servers) {
+	ostringstream out;
+	list<RadiusServer>::iterator server;
+	int i;
+
+	if (this->data == NULL) {
+		return string("{}\n");
+	}
+	out << "{\"counters\":{";
+	for (i = 0; i < METRIC_COUNTERS; i++) {
+		out << (i > 0 ? "," : "") << "\"" << counternames[i] << "\":" << this->data->counters[i];
+	}
+	out << "},\"gauges\":{";
+	for (i = 0; i < METRIC_GAUGES; i++) {
+		out << (i > 0 ? "," : "") << "\"" << gaugenames[i] << "\":" << this->data->gauges[i];
+	}
+	out << "},\"histograms\":{";
+	for (i = 0; i < METRIC_HISTOGRAMS; i++) {
+		out << (i > 0 ? "," : "") << "\"" << histogramnames[i] << "\":";
+		writeJsonHistogram(out, &this->data->histograms[i]);
+	}
+	out << "},\"servers\":[";
+	for (i = 0, server = servers->begin(); server != servers->end() && i < METRICS_MAX_SERVERS; server++, i++) {
+		out << (i > 0 ? "," : "") << "{\"name\":\"" << escape(server->getName()) << "\",\"inflight\":" << this->data->inflight[i] << ",\"rtt\":";
+		writeJsonHistogram(out, &this->data->servers[i]);
+		out << "}";
+	}
+	out << "]}\n";
+	return out.str();
+}
@@ -0,0 +1,105 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <string>
+#include <list>
+#include <stdint.h>
+#include "RadiusClass/RadiusHistogram.h"
+#include "RadiusClass/RadiusServer.h"
+
+using namespace std;
+
+#define METRIC_AUTH_QUEUE	0	/**< The time a user waits in the queue of the authentication thread.*/
+#define METRIC_AUTH_IPC		1	/**< The round trip of COMMAND_VERIFY to the authentication process.*/
+#define METRIC_ACCT_IPC		2	/**< The round trip of ADD_USER and DEL_USER to the accounting process.*/
+#define METRIC_CCD_WRITE	3	/**< The time to write a client config file.*/
+#define METRIC_ROUTES		4	/**< The time to add or delete the system routes.*/
+#define METRIC_STATUS_FILE	5	/**< The time to parse the status file.*/
+#define METRIC_VSA_SCRIPT	6	/**< The time to call the vendor specific attribute script.*/
+#define METRIC_HISTOGRAMS	7	/**< The number of histograms.*/
+
+#define METRIC_AUTH_ACCEPTED	0	/**< The number of accepted authentications.*/
+#define METRIC_AUTH_REJECTED	1	/**< The number of rejected authentications.*/
+#define METRIC_ACCT_STARTED		2	/**< The number of sent start packets.*/
+#define METRIC_ACCT_STOPPED		3	/**< The number of answered stop packets.*/
+#define METRIC_ACCT_UPDATES		4	/**< The number of answered interim updates.*/
+#define METRIC_COUNTERS			5	/**< The number of counters.*/
+
+#define METRIC_AUTH_QUEUE_LENGTH	0	/**< The number of users waiting for the authentication thread.*/
+#define METRIC_STOP_QUEUE_LENGTH	1	/**< The number of disconnected users waiting for the stop.*/
+#define METRIC_SPOOL_PENDING		2	/**< The number of spooled packets waiting for a response.*/
+#define METRIC_SCHEDULED_USERS		3	/**< The number of users in the accounting scheduler.*/
+#define METRIC_NEXT_UPDATE			4	/**< The time (unix time) of the next interim update, 0 if there is none.*/
+#define METRIC_GAUGES				5	/**< The number of gauges.*/
+
+#define METRICS_MAX_SERVERS		16	/**< The number of radius servers with a histogram of the response times.*/
+
+/** The metrics in the shared mapping.*/
+struct MetricsData {
+	RadiusHistogram histograms[METRIC_HISTOGRAMS]; /**< The histograms of the stages in microseconds.*/
+	RadiusHistogram servers[METRICS_MAX_SERVERS]; /**< The response times of the radius servers in microseconds.*/
+	volatile uint64_t counters[METRIC_COUNTERS]; /**< The counters.*/
+	volatile int64_t gauges[METRIC_GAUGES]; /**< The gauges.*/
+	volatile int inflight[METRICS_MAX_SERVERS]; /**< The requests of all processes which wait for a response of a radius server.*/
+};
+
+/** The class keeps latency histograms and counters of the authentication and
+ * accounting pipelines. The data is in a shared anonymous mapping, which is created
+ * before the background processes are forked, so all processes record into the same
+ * histograms with atomic operations and every process can read a snapshot at any time
+ * without stopping the others.
+ */
+class Metrics {
+private:
+	MetricsData * data; /**< The mapped metrics, NULL if the mapping failed.*/
+	bool owner; /**< True if the metrics were mapped by this object and are unmapped by close().*/
+
+public:
+	Metrics();
+	~Metrics();
+
+	int open(void);
+	void attach(Metrics *);
+	void close(void);
+
+	void record(int, long);
+	void add(int, uint64_t = 1);
+	void set(int, int64_t);
+
+	RadiusHistogram * getHistogram(int);
+	RadiusHistogram * getServerHistogram(int);
+	uint64_t getCounter(int);
+	int64_t getGauge(int);
+	volatile int * getInflightCounter(int);
+
+	static const char * getHistogramName(int);
+	static const char * getCounterName(int);
+	static const char * getGaugeName(int);
+
+	string format(list<RadiusServer> *);
+	string formatPrometheus(list<RadiusServer> *);
+	string formatJson(list<RadiusServer> *);
+};
+
+#endif //_METRICS_H_
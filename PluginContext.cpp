@@ -38,6 +38,7 @@ PluginContext::PluginContext() {
 
 	this->stopthread = false;
 	this->startthread = true;
+	this->acctcontext = NULL;
 }
 
 /** The destructor clears the users and nasportlist.*/
@@ -86,7 +87,8 @@ void PluginContext::delNasPort(int num) {
 }
 
 /**The method adds an user to the user map of the foreground
- * process.
+ * process and allocates a slot in the session table for the user.
+ * The slot of the user is -1 if the table is full.
  * @param newuser A pointer to the user.
  * @throws Exception::ALREADYAUTHENTICATED if the user could not add to the map, this happens if a user with the key is already in the list.
  */
@@ -99,15 +101,21 @@ void PluginContext::addUser(UserPlugin * newuser) {
 		throw Exception(Exception::ALREADYAUTHENTICATED);
 	} else {
 		this->sessionid++;
+		newuser->setSlot(sessions.alloc());
 	}
 	
 }
 
-/**The method deletes the user from the map with the key.
+/**The method deletes the user from the map with the key
+ * and releases the slot of the user in the session table.
  * @param key The key of the user.
  */
 void PluginContext::delUser(string key) {
-	users.erase(key);
+	map<string, UserPlugin *>::iterator iter = users.find(key);
+	if (iter != users.end()) {
+		sessions.release(iter->second->getSlot());
+		users.erase(iter);
+	}
 }
 
 /**The method finds a user in the user map.
@@ -122,6 +130,20 @@ UserPlugin * PluginContext::findUser(string key) {
 	return NULL;
 }
 
+/**The method returns the users which are accounted.
+ * @return A list of the users.
+ */
+list<UserPlugin *> PluginContext::getAccountedUsers(void) {
+	list<UserPlugin *> accounted;
+	map<string, UserPlugin *>::iterator iter;
+
+	for (iter = users.begin(); iter != users.end(); iter++) {
+		if (iter->second->isAccounted())
+			accounted.push_back(iter->second);
+	}
+	return accounted;
+}
+
 /** The getter method for the verbosity level.
  * @return The verbosity level.
  */
@@ -179,7 +201,9 @@ int PluginContext::getSessionId(void) {
  * @param newuser A pointer to the user.
  */
 void PluginContext::addNewUser(UserPlugin * newuser) {
+	newuser->setQueueTime(monotonicTime());
 	this->newusers.push_back(newuser);
+	this->metrics.set(METRIC_AUTH_QUEUE_LENGTH, this->newusers.size());
 }
 
 /**The method return the first element in the list of waiting users.
@@ -188,6 +212,9 @@ UserPlugin * PluginContext::getNewUser() {
 
 	UserPlugin * user = this->newusers.front();
 	this->newusers.pop_front();
+	this->metrics.set(METRIC_AUTH_QUEUE_LENGTH, this->newusers.size());
+	this->metrics.record(METRIC_AUTH_QUEUE, monotonicTime() - user->getQueueTime());
+	traceSpan("auth queue", user->getTraceId(), user->getQueueTime());
 	return user;
 	
 }
@@ -211,6 +238,32 @@ pthread_t * PluginContext::getThread() {
 	return &thread;
 }
 
+pthread_t * PluginContext::getAcctThread() {
+	return &acctthread;
+}
+
+PluginContext * PluginContext::getAcctContext(void) {
+	return this->acctcontext;
+}
+
+void PluginContext::setAcctContext(PluginContext * c) {
+	this->acctcontext = c;
+}
+
+/** The getter method for the config file.
+ * @return The absolute path of the config file.
+ */
+string PluginContext::getConfigFile(void) {
+	return this->configfile;
+}
+
+/** The setter method for the config file.
+ * @param file The absolute path of the config file.
+ */
+void PluginContext::setConfigFile(string file) {
+	this->configfile = file;
+}
+
 int PluginContext::getResult() {
 	return result;
 }
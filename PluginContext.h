@@ -26,6 +26,11 @@
 #include "UserPlugin.h"
 #include "IpcSocket.h"
 #include "Config.h"
+#include "AcctSpool.h"
+#include "AcctJournal.h"
+#include "PrivHelper.h"
+#include "SessionTable.h"
+#include "Metrics.h"
 #include <sys/types.h>
 #include <list>
 #include <map>
@@ -63,6 +68,9 @@ private:
 	pthread_cond_t condrecv;
 	pthread_mutex_t mutexrecv;
 	pthread_t thread;
+	pthread_t acctthread; /**< The accounting thread of the thread model.*/
+	PluginContext * acctcontext; /**< The context of the accounting thread of the thread model, NULL in the fork model.*/
+	string configfile; /**< The absolute path of the config file, it is sent to the radius daemon.*/
 	bool stopthread;
 	bool startthread;
 	int result;
@@ -76,6 +84,11 @@ public:
 	
 	RadiusConfig radiusconf; /**< The object saves the radius configuration from the config file.*/
 	Config conf; /**< The object saves the configuration from the config file.*/
+	PrivHelper privhelper; /**< The object does the routes, the client config files and the vsa script, directly or by the privileged helper process.*/
+	AcctSpool acctspool; /**< The spool for accounting packets, it is only open in the accounting background process or thread.*/
+	AcctJournal acctjournal; /**< The journal of the accounting sessions, it is only open in the accounting background process or thread.*/
+	SessionTable sessions; /**< The sessions, the table is shared by the foreground and the background processes.*/
+	Metrics metrics; /**< The latency histograms and counters, they are shared by the foreground and the background processes.*/
 	
 	PluginContext(void);
 	~PluginContext(void);
@@ -86,6 +99,7 @@ public:
 	UserPlugin * findUser(string);
 	void addUser(UserPlugin *);
 	void delUser(string);
+	list<UserPlugin *> getAccountedUsers(void);
 
 	int getVerbosity(void);
 	void setVerbosity(int);
@@ -110,6 +124,13 @@ public:
 	void addNewUser(UserPlugin * newuser);
 
 	pthread_t * getThread();
+	pthread_t * getAcctThread();
+
+	PluginContext * getAcctContext(void);
+	void setAcctContext(PluginContext *);
+
+	string getConfigFile(void);
+	void setConfigFile(string);
 
 	int getResult();
 	void setResult(int);
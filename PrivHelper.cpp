@@ -0,0 +1,365 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "PrivHelper.h"
+#include "radiusplugin.h"
+#include <poll.h>
+#include <spawn.h>
+
+extern char ** environ;
+
+/** The constructor, the operations are done directly.*/
+PrivHelper::PrivHelper() {
+	this->pid = 0;
+	this->iproute = false;
+}
+
+/** The destructor of the class.*/
+PrivHelper::~PrivHelper() {
+}
+
+/** The method takes the client config dir and the vsa script from the config
+ * and looks for the route command. It must be called before the helper process is forked,
+ * the helper only uses these values.
+ * @param conf The config.
+ */
+void PrivHelper::configure(Config & conf) {
+	this->ccdpath = conf.getCcdPath();
+	this->vsascript = conf.getVsaScript();
+	this->vsanamedpipe = conf.getVsaNamedPipe();
+	this->routecommand = findCommand("route");
+	this->iproute = false;
+	if (this->routecommand.empty()) {
+		this->routecommand = findCommand("ip");
+		this->iproute = true;
+	}
+}
+
+/** The getter method for the socket to the helper process.
+ * @return The socket, -1 if the operations are done directly.
+ */
+int PrivHelper::getSocket(void) {
+	return this->socket.getSocket();
+}
+
+/** The setter method for the socket to the helper process.
+ * @param s The socket.
+ */
+void PrivHelper::setSocket(int s) {
+	this->socket.setSocket(s);
+}
+
+/** The getter method for the process id of the helper process.
+ * @return The process id, 0 if there is none.
+ */
+pid_t PrivHelper::getPid(void) {
+	return this->pid;
+}
+
+/** The setter method for the process id of the helper process.
+ * @param p The process id.
+ */
+void PrivHelper::setPid(pid_t p) {
+	this->pid = p;
+}
+
+/** The method looks for a command in the directories of the system commands.
+ * @param name The name of the command.
+ * @return The path of the command or an empty string if it wasn't found.
+ */
+string PrivHelper::findCommand(const char * name) {
+	const char * dirs[] = { "/sbin/", "/usr/sbin/", "/bin/", "/usr/bin/", NULL };
+	string path;
+	int i;
+
+	for (i = 0; dirs[i] != NULL; i++) {
+		path = string(dirs[i]) + name;
+		if (access(path.c_str(), X_OK) == 0) {
+			return path;
+		}
+	}
+	return "";
+}
+
+/** The method executes a command without a shell and waits for it.
+ * @param path The path of the command.
+ * @param args The arguments, the first one is the name of the command.
+ * @param quiet True if the output of the command is discarded.
+ * @return The exit status of the command or -1 if it could not be executed.
+ */
+int PrivHelper::execute(string path, vector<string> & args, bool quiet) {
+	posix_spawn_file_actions_t actions;
+	vector<char *> argv;
+	unsigned int i;
+	pid_t child;
+	int status, result;
+
+	for (i = 0; i < args.size(); i++) {
+		argv.push_back((char *) args[i].c_str());
+	}
+	argv.push_back(NULL);
+
+	posix_spawn_file_actions_init(&actions);
+	if (quiet) {
+		posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+		posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+	}
+	result = posix_spawn(&child, path.c_str(), &actions, NULL, &argv[0], environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (result != 0) {
+		return -1;
+	}
+	while (waitpid(child, &status, 0) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/** The method adds or deletes routes in the system routing table, every route is checked
+ * and the command is built from its fields.
+ * @param frs The routes.
+ * @param n The number of routes.
+ * @param add True to add the routes, false to delete them.
+ * @return The number of routes which could not be added or deleted.
+ */
+int PrivHelper::runRoutes(FramedRoute * frs, int n, bool add) {
+	vector<string> args;
+	int i, failed = 0;
+
+	for (i = 0; i < n; i++) {
+		if (!isValidFramedRoute(&frs[i])) {
+			cerr << getTime() << "RADIUS-PLUGIN: Invalid route, it is not " << (add ? "added" : "deleted") << ".\n";
+			failed++;
+			continue;
+		}
+		if (this->routecommand.empty()) {
+			cerr << getTime() << "RADIUS-PLUGIN: Neither the route command nor the ip command was found.\n";
+			failed++;
+			continue;
+		}
+		args = formatRouteArgs(&frs[i], add, this->iproute);
+		if (execute(this->routecommand, args, true) != 0) {
+			failed++;
+		}
+	}
+	return failed;
+}
+
+/** The method writes the client config file of a common name in the client config dir.
+ * A common name which could leave the directory is rejected.
+ * @param commonname The common name.
+ * @param content The content.
+ * @return The result of CcdWriter::write or 1 if the common name is invalid.
+ */
+int PrivHelper::runCcd(string commonname, string & content) {
+	if (commonname.empty() || commonname == "." || commonname.find('/') != string::npos || commonname.find("..") != string::npos
+			|| commonname.find('\0') != string::npos) {
+		cerr << getTime() << "RADIUS-PLUGIN: Client config file was not written, the common name " << commonname << " is invalid.\n";
+		return 1;
+	}
+	return this->ccdwriter.write(this->ccdpath + commonname, content);
+}
+
+/** The method executes the vsa script of the config with the named pipe as argument.
+ * @return The exit status of the script or -1 if it could not be executed.
+ */
+int PrivHelper::runVsaScript(void) {
+	vector<string> args;
+
+	if (this->vsascript.empty()) {
+		return -1;
+	}
+	args.push_back(this->vsascript);
+	args.push_back(this->vsanamedpipe);
+	return execute(this->vsascript, args, false);
+}
+
+/** The method sends an operation to the helper process and waits for the result.
+ * @param command The command, e.g. PRIV_CCD.
+ * @param args The number of arguments, 0, 1 or 2.
+ * @param arg The first argument.
+ * @param arg2 The second argument.
+ * @return The result of the operation or -1 if the helper could not be reached.
+ */
+int PrivHelper::request(int command, int args, string arg, string arg2) {
+	try {
+		this->socket.send(command);
+		if (args > 0) {
+			this->socket.send(arg);
+		}
+		if (args > 1) {
+			this->socket.send(arg2);
+		}
+		return this->socket.recvInt();
+	} catch (Exception &e) {
+		cerr << getTime() << "RADIUS-PLUGIN: Privileged helper failed: " << e;
+	}
+	return -1;
+}
+
+/** The method adds or deletes a route in the system routing table with the root rights.
+ * @param fr The route.
+ * @param add True to add the route, false to delete it.
+ * @return 0, 1 if the route could not be added or deleted or -1 if the helper could not be reached.
+ */
+int PrivHelper::route(FramedRoute * fr, bool add) {
+	vector<FramedRoute> frs(1, *fr);
+	return this->routes(frs, add);
+}
+
+/** The method adds or deletes many routes in the system routing table with the root rights,
+ * the routes are sent to the helper process at once, in parts of PRIV_ROUTES routes.
+ * @param frs The routes.
+ * @param add True to add the routes, false to delete them.
+ * @return The number of routes which could not be added or deleted or -1 if the helper could not be reached.
+ */
+int PrivHelper::routes(vector<FramedRoute> & frs, bool add) {
+	unsigned int start, n;
+	int result, failed = 0;
+
+	if (frs.empty()) {
+		return 0;
+	}
+	if (this->socket.getSocket() < 0) {
+		return this->runRoutes(&frs[0], frs.size(), add);
+	}
+	for (start = 0; start < frs.size(); start += n) {
+		n = min((unsigned int) PRIV_ROUTES, (unsigned int) frs.size() - start);
+		result = this->request(add ? PRIV_ROUTE_ADD : PRIV_ROUTE_DEL, 1, string((char *) &frs[start], n * sizeof(FramedRoute)), "");
+		if (result < 0) {
+			return -1;
+		}
+		failed += result;
+	}
+	return failed;
+}
+
+/** The method writes the client config file of a common name with the root rights, see CcdWriter::write.
+ * @param commonname The common name, the file is in the client config dir.
+ * @param content The content.
+ * @return The result of CcdWriter::write, 1 if the common name is invalid.
+ */
+int PrivHelper::writeCcd(string commonname, string & content) {
+	if (this->socket.getSocket() < 0) {
+		return this->runCcd(commonname, content);
+	}
+	return this->request(PRIV_CCD, 2, commonname, content);
+}
+
+/** The method executes the vsa script with the root rights, the named pipe is its argument.
+ * @return The exit status of the script or -1 if it could not be executed.
+ */
+int PrivHelper::vsaScript(void) {
+	if (this->socket.getSocket() < 0) {
+		return this->runVsaScript();
+	}
+	return this->request(PRIV_VSA, 0, "", "");
+}
+
+/** The method tells the helper process to exit, the caller waits for the process.*/
+void PrivHelper::stop(void) {
+	if (this->socket.getSocket() >= 0) {
+		try {
+			this->socket.send(PRIV_EXIT);
+		} catch (Exception &e) {
+			cerr << getTime() << e;
+		}
+	}
+}
+
+/** The method receives an operation, checks its arguments and sends the result back.
+ * @param s The socket.
+ * @return False if the socket is closed.
+ */
+bool PrivHelper::handle(IpcSocket & s) {
+	vector<FramedRoute> frs;
+	string arg, content;
+	int command;
+
+	try {
+		command = s.recvInt();
+		switch (command) {
+			case PRIV_ROUTE_ADD:
+			case PRIV_ROUTE_DEL:
+				arg = s.recvStr();
+				if (arg.size() == 0 || arg.size() % sizeof(FramedRoute) != 0 || arg.size() > PRIV_ROUTES * sizeof(FramedRoute)) {
+					cerr << getTime() << "RADIUS-PLUGIN: PRIVILEGED HELPER: Invalid routes: length=" << arg.size() << ".\n";
+					s.send(-1);
+					return true;
+				}
+				//the string may be unaligned
+				frs.resize(arg.size() / sizeof(FramedRoute));
+				memcpy(&frs[0], arg.data(), arg.size());
+				s.send(this->runRoutes(&frs[0], frs.size(), command == PRIV_ROUTE_ADD));
+				return true;
+			case PRIV_CCD:
+				arg = s.recvStr();
+				content = s.recvStr();
+				s.send(this->runCcd(arg, content));
+				return true;
+			case PRIV_VSA:
+				s.send(this->runVsaScript());
+				return true;
+			case PRIV_EXIT:
+				return false;
+			default:
+				cerr << getTime() << "RADIUS-PLUGIN: PRIVILEGED HELPER: unknown command code: code=" << command << ".\n";
+				return false;
+		}
+	} catch (Exception &e) {
+		//the other end was closed
+		return false;
+	}
+}
+/** The method is the loop of the helper process, it serves the sockets of the
+ * authentication thread and of the accounting thread until both are closed.
+ * @param authfd The socket of the authentication thread.
+ * @param acctfd The socket of the accounting thread.
+ */
+void PrivHelper::serve(int authfd, int acctfd) {
+	IpcSocket sockets[2];
+	struct pollfd fds[2];
+	int i, open = 2;
+
+	sockets[0].setSocket(authfd);
+	sockets[1].setSocket(acctfd);
+	for (i = 0; i < 2; i++) {
+		fds[i].fd = sockets[i].getSocket();
+		fds[i].events = POLLIN;
+	}
+	while (open > 0) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < 2; i++) {
+			if (fds[i].fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !this->handle(sockets[i])) {
+				//poll ignores a negative descriptor
+				fds[i].fd = -1;
+				open--;
+			}
+		}
+	}
+}
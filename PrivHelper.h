@@ -0,0 +1,96 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _PRIV_HELPER_H_
+#define _PRIV_HELPER_H_
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "IpcSocket.h"
+#include "CcdWriter.h"
+#include "Config.h"
+#include "FramedRoute.h"
+
+using namespace std;
+
+/* Command codes for the privileged helper process */
+#define PRIV_ROUTE_ADD	20 /**< Add system routes, the FramedRoute structs are sent as a string.*/
+#define PRIV_ROUTE_DEL	21 /**< Delete system routes, the FramedRoute structs are sent as a string.*/
+#define PRIV_CCD		22 /**< Write the client config file of a common name, the common name and the content are sent as strings.*/
+#define PRIV_VSA		23 /**< Execute the vsa script of the config with the named pipe as argument.*/
+#define PRIV_EXIT		24 /**< Close the socket, the helper exits when all sockets are closed.*/
+
+#define PRIV_ROUTES	1024 /**< The maximal number of routes which are sent to the helper at once, more routes are sent in parts.*/
+
+/** The class does the operations which need the root rights: the system routes,
+ * the client config files and the vsa script. In the fork model the background
+ * processes keep the root rights and the operations are done directly.
+ * In the thread model the plugin runs in the OpenVPN process, which drops its rights,
+ * so the operations are sent to a small helper process, which is forked when the plugin
+ * is opened. Every thread which uses the helper has its own socket to it.
+ * The helper never executes a command line or writes a path it receives: it gets the routes,
+ * the common name and the content of a client config file, checks them and builds the arguments
+ * of the commands and the path itself from the config it had before the fork. The commands are
+ * executed without a shell.
+ */
+class PrivHelper {
+private:
+	IpcSocket socket; /**< The socket to the helper process, -1 if the operations are done directly.*/
+	pid_t pid; /**< The process id of the helper process, 0 if there is none.*/
+	CcdWriter ccdwriter; /**< The writer of the client config files, it is used by the process which writes the files.*/
+	string ccdpath; /**< The client config dir of OpenVPN.*/
+	string vsascript; /**< The vsa script.*/
+	string vsanamedpipe; /**< The named pipe of the vsa script.*/
+	string routecommand; /**< The path of the route command or of the ip command, empty if none was found.*/
+	bool iproute; /**< True if the routes are set with the ip command.*/
+
+	static string findCommand(const char *);
+	static int execute(string, vector<string> &, bool);
+	int runRoutes(FramedRoute *, int, bool);
+	int runCcd(string, string &);
+	int runVsaScript(void);
+	int request(int, int, string, string);
+	bool handle(IpcSocket &);
+
+public:
+	PrivHelper();
+	~PrivHelper();
+
+	void configure(Config &);
+
+	int getSocket(void);
+	void setSocket(int);
+
+	pid_t getPid(void);
+	void setPid(pid_t);
+
+	void serve(int, int);
+	void stop(void);
+
+	int route(FramedRoute *, bool);
+	int routes(vector<FramedRoute> &, bool);
+	int writeCcd(string, string &);
+	int vsaScript(void);
+};
+
+#endif //_PRIV_HELPER_H_
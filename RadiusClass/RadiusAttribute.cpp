@@ -523,6 +523,28 @@ int RadiusAttribute::setValue(string s)
 	return ret;
 }
 
+/** The method sets the value of an attribute with the data type octets, e.g. Class.
+ * The value is copied as it is, it may contain null octets.
+ * @param value The value.
+ * @param len The length of the value, at most 253 octets.
+ * @return 0 or BAD_LENGTH if the value is too long.
+ */
+int RadiusAttribute::setValue(const Octet *value, int len)
+{
+	if (len<0 || len>RADIUS_MAX_ATTRIBUTE_VALUE)
+	{
+		return BAD_LENGTH;
+	}
+	if (this->value!=NULL)
+	{
+		delete [] this->value;
+	}
+	this->value=new Octet[len];
+	memcpy(this->value, value, len);
+	this->length=len+sizeof(Octet)+sizeof(Octet);
+	return 0;
+}
+
 /** The method sets the value for an integer. The method
  * writes the integer in a string and calls the method
  * setValue(char *).
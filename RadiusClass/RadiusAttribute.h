@@ -62,6 +62,7 @@ public:
 	int			    setValue(char *);
 	int			    setValue(string);
 	int			    setValue(uint32_t);
+	int			    setValue(const Octet *, int);
 		
 	int 			setRecvValue(char *value);
 	
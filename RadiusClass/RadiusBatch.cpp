@@ -0,0 +1,519 @@
+/*
+ *  RadiusClass -- An C++-Library for radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RadiusBatch.h"
+#include <poll.h>
+#include <sys/socket.h>
+
+/** The constructor of the class.
+ * @param serverlist The list of radius servers, the packets are sent to the next
+ * server in the list if a server doesn't answer.
+ * @param config The radius config with the timeout settings, can be NULL.
+ */
+RadiusBatch::RadiusBatch(list<RadiusServer> *serverlist, RadiusConfig *config)
+{
+	this->serverlist=serverlist;
+	this->config=config;
+	this->deadline=0;
+}
+
+/** The destructor of the class. The sockets are closed,
+ * the packets are not freed.
+ */
+RadiusBatch::~RadiusBatch()
+{
+	vector<int>::iterator	sock;
+	vector<RadiusBatchEntry>::iterator	entry;
+
+	for (entry=this->entries.begin(); entry!=this->entries.end(); entry++)
+	{
+		if (entry->result==RADIUS_BATCH_PENDING)
+		{
+			entry->attempt.server->decOutstanding();
+		}
+	}
+	for (sock=this->sockets.begin(); sock!=this->sockets.end(); sock++)
+	{
+		close(*sock);
+	}
+}
+
+/** The method adds a packet to the batch. The packet gets an identifier which is
+ * unique for its socket. A new socket is opened for every RADIUS_BATCH_IDS packets.
+ * @param packet The packet, it must exist until the batch is destroyed.
+ * @param server The server the packet is sent to first.
+ * @return The index of the packet in the batch, SOCKET_ERROR or BIND_ERROR.
+ */
+int RadiusBatch::addPacket(RadiusPacket *packet, list<RadiusServer>::iterator server)
+{
+	RadiusBatchEntry	entry;
+	struct sockaddr_in	cliAddr;
+	int					sock, index=this->entries.size();
+
+	if (index%RADIUS_BATCH_IDS==0)
+	{
+		if((sock = socket(AF_INET, SOCK_DGRAM, 0))<0)
+		{
+			cerr <<  "Cannot open socket: "<< strerror(errno) <<"\n";
+			return SOCKET_ERROR;
+		}
+		memset(&cliAddr, 0, sizeof(struct sockaddr_in));
+		cliAddr.sin_family=AF_INET;
+		cliAddr.sin_addr.s_addr=htonl(INADDR_ANY);
+		cliAddr.sin_port=htons(0);
+		if(bind(sock,(struct sockaddr*)&cliAddr,sizeof(struct sockaddr))<0)
+		{
+			cerr << "Cannot bind port: " << strerror(errno) << "\n";
+			close(sock);
+			return BIND_ERROR;
+		}
+		this->sockets.push_back(sock);
+	}
+
+	packet->identifier=index%RADIUS_BATCH_IDS;
+	entry.packet=packet;
+	entry.servers=0;
+	entry.result=RADIUS_BATCH_PENDING;
+	entry.attempt.sock=this->sockets[index/RADIUS_BATCH_IDS];
+	if (this->startEntry(&entry, server)!=0)
+	{
+		entry.result=this->nextServer(&entry);
+	}
+	this->entries.push_back(entry);
+	return index;
+}
+
+/** The method shapes the packet of an entry for a server and
+ * prepares the transmission, the packet is sent by run().
+ * @param entry The entry.
+ * @param server The server.
+ * @return 0 or SHAPE_ERROR or UNKNOWN_HOST in case of error.
+ */
+int RadiusBatch::startEntry(RadiusBatchEntry *entry, list<RadiusServer>::iterator server)
+{
+	RadiusPacket		*packet=entry->packet;
+	map<string, struct sockaddr_in>::iterator	addr;
+
+	entry->attempt.server=server;
+	entry->servers++;
+	if(packet->shapeRadiusPacket(server->getSharedSecret().c_str())!=0)
+	{
+		return SHAPE_ERROR;
+	}
+	if (packet->code==ACCOUNTING_REQUEST)
+	{
+		packet->calcacctdigest(server->getSharedSecret().c_str());
+	}
+
+	//resolve the name of the server only once per batch
+	addr=this->addresses.find(server->getName());
+	if (addr==this->addresses.end())
+	{
+		if(resolveServer(server->getName(), &entry->attempt.addr)!=0)
+		{
+			return UNKNOWN_HOST;
+		}
+		this->addresses.insert(make_pair(server->getName(), entry->attempt.addr));
+	}
+	else
+	{
+		entry->attempt.addr=addr->second;
+	}
+	if (packet->code==ACCOUNTING_REQUEST)
+	{
+		entry->attempt.addr.sin_port=htons(server->getAcctPort());
+	}
+	else
+	{
+		entry->attempt.addr.sin_port=htons(server->getAuthPort());
+	}
+
+	entry->attempt.buffer=packet->sendbuffer;
+	entry->attempt.bufferlen=packet->sendbufferlen;
+	entry->attempt.tries=0;
+	entry->attempt.first=0;
+	entry->attempt.sent=0;
+	entry->attempt.probe=false;
+	entry->attempt.deadline=0;
+	server->incOutstanding();
+	return 0;
+}
+
+/** The method sets the result of an entry which doesn't wait for a response anymore.
+ * @param entry The entry.
+ * @param result 0 or an error code.
+ */
+void RadiusBatch::finishEntry(RadiusBatchEntry *entry, int result)
+{
+	entry->attempt.server->decOutstanding();
+	entry->result=result;
+}
+
+/** The method prepares the transmission of an entry to the next server in the list,
+ * the list starts again at the beginning after the last server. Servers with an
+ * open circuit breaker are skipped as long as another server is available.
+ * @param entry The entry, its current server is given up and must not count as outstanding.
+ * @return RADIUS_BATCH_PENDING if the packet is sent to another server, else NO_RESPONSE.
+ */
+int RadiusBatch::nextServer(RadiusBatchEntry *entry)
+{
+	list<RadiusServer>::iterator	server;
+	int		size=this->serverlist->size();
+	bool	skip=false;
+
+	for (server=this->serverlist->begin(); server!=this->serverlist->end(); server++)
+	{
+		if (server->isAvailable())
+		{
+			skip=true;
+		}
+	}
+
+	server=entry->attempt.server;
+	while (entry->servers<size)
+	{
+		server++;
+		if (server==this->serverlist->end())
+		{
+			server=this->serverlist->begin();
+		}
+		if (skip && !server->isAvailable())
+		{
+			entry->servers++;
+			continue;
+		}
+		if (this->startEntry(entry, server)==0)
+		{
+			return RADIUS_BATCH_PENDING;
+		}
+	}
+	return NO_RESPONSE;
+}
+
+/** The method sends the packets of the entries with sendmmsg(), entries which
+ * follow each other in the list and share a socket are sent with one system call.
+ * A packet which couldn't be sent is handled like a lost packet.
+ * @param due The entries to send, sorted by their index.
+ */
+void RadiusBatch::transmit(vector<RadiusBatchEntry *> &due)
+{
+	struct mmsghdr	msgs[RADIUS_BATCH_MMSG];
+	struct iovec	iov[RADIUS_BATCH_MMSG];
+	unsigned int	i, j, n=0, sent;
+	int				result;
+	long long		now=monotonicTime();
+
+	for (i=0; i<due.size(); i++)
+	{
+		memset(&msgs[n], 0, sizeof(struct mmsghdr));
+		iov[n].iov_base=due[i]->attempt.buffer;
+		iov[n].iov_len=due[i]->attempt.bufferlen;
+		msgs[n].msg_hdr.msg_iov=&iov[n];
+		msgs[n].msg_hdr.msg_iovlen=1;
+		msgs[n].msg_hdr.msg_name=&due[i]->attempt.addr;
+		msgs[n].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+		n++;
+
+		//send if the array is full or the next entry uses another socket
+		if (n==RADIUS_BATCH_MMSG || i+1==due.size() || due[i+1]->attempt.sock!=due[i]->attempt.sock)
+		{
+			sent=0;
+			while (sent<n)
+			{
+				result=sendmmsg(due[i]->attempt.sock, msgs+sent, n-sent, 0);
+				if (result<=0)
+				{
+					break;
+				}
+				sent+=result;
+			}
+			n=0;
+		}
+	}
+
+	for (j=0; j<due.size(); j++)
+	{
+		due[j]->attempt.tries++;
+		due[j]->attempt.sent=now;
+		due[j]->attempt.deadline=0;
+		if (due[j]->attempt.first==0)
+		{
+			due[j]->attempt.first=now;
+		}
+	}
+}
+
+/** The method reads the waiting packets from a socket with recvmmsg() and
+ * assigns them by their identifier to the entries. A packet which isn't from the
+ * server of the entry or which has a wrong authenticator is ignored.
+ * @param index The index of the socket.
+ * @param buffers The space for RADIUS_BATCH_MMSG packets of RADIUS_MAX_PACKET_LEN bytes.
+ * @return The number of received packets.
+ */
+int RadiusBatch::receive(int index, Octet *buffers)
+{
+	struct mmsghdr		msgs[RADIUS_BATCH_MMSG];
+	struct iovec		iov[RADIUS_BATCH_MMSG];
+	struct sockaddr_in	addrs[RADIUS_BATCH_MMSG];
+	RadiusBatchEntry	*entry;
+	RadiusPacket		*packet;
+	Octet				*buffer;
+	unsigned int		i, n;
+	int					result;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i=0; i<RADIUS_BATCH_MMSG; i++)
+	{
+		iov[i].iov_base=buffers+i*RADIUS_MAX_PACKET_LEN;
+		iov[i].iov_len=RADIUS_MAX_PACKET_LEN;
+		msgs[i].msg_hdr.msg_iov=&iov[i];
+		msgs[i].msg_hdr.msg_iovlen=1;
+		msgs[i].msg_hdr.msg_name=&addrs[i];
+		msgs[i].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+	}
+
+	result=recvmmsg(this->sockets[index], msgs, RADIUS_BATCH_MMSG, MSG_DONTWAIT, NULL);
+	if (result<=0)
+	{
+		return 0;
+	}
+	n=result;
+
+	for (i=0; i<n; i++)
+	{
+		buffer=buffers+i*RADIUS_MAX_PACKET_LEN;
+		if (msgs[i].msg_len<RADIUS_PACKET_AUTHENTICATOR_LEN+4 ||
+			(unsigned int)index*RADIUS_BATCH_IDS+buffer[1]>=this->entries.size())
+		{
+			continue;
+		}
+		entry=&this->entries[index*RADIUS_BATCH_IDS+buffer[1]];
+		if (entry->result!=RADIUS_BATCH_PENDING || entry->attempt.tries==0 ||
+			addrs[i].sin_addr.s_addr!=entry->attempt.addr.sin_addr.s_addr ||
+			addrs[i].sin_port!=entry->attempt.addr.sin_port)
+		{
+			continue;
+		}
+
+		packet=entry->packet;
+		if(!packet->recvbuffer)
+		{
+			packet->recvbuffer=new Octet[RADIUS_MAX_PACKET_LEN];
+		}
+		memcpy(packet->recvbuffer, buffer, msgs[i].msg_len);
+		packet->recvbufferlen=msgs[i].msg_len;
+		if (packet->authenticateReceivedPacket(entry->attempt.server->getSharedSecret().c_str())!=0)
+		{
+			continue;
+		}
+
+		//the response time is only clear if the packet was sent once
+		if (entry->attempt.tries==1)
+		{
+			entry->attempt.server->addRttSample(monotonicTime()-entry->attempt.sent);
+		}
+		entry->attempt.server->recordSuccess();
+
+		packet->attribs.clear();
+		if (packet->unShapeRadiusPacket()!=0)
+		{
+			this->finishEntry(entry, UNSHAPE_ERROR);
+		}
+		else
+		{
+			this->finishEntry(entry, 0);
+		}
+	}
+	return n;
+}
+
+/** The method sends all packets and waits for the responses. A packet without
+ * response is sent again until it was sent server->retry times to the server, then
+ * it is sent to the next server. The timeouts are calculated like in
+ * RadiusPacket::radiusReceive(), requestdeadline limits the whole batch.
+ * The received packets are unshaped into the packets of the batch.
+ * @return The number of packets which were answered.
+ */
+int RadiusBatch::run(void)
+{
+	vector<RadiusBatchEntry *>	due;
+	vector<RadiusBatchEntry>::iterator	entry;
+	struct pollfd	*fds;
+	Octet			*buffers;
+	int				i, pending, answered=0, threshold=0, opentime=0;
+	long long		now, timeout, requestdeadline=0;
+
+	if (this->config!=NULL)
+	{
+		threshold=this->config->getFailureThreshold();
+		opentime=this->config->getOpenTime();
+		if (this->config->getRequestDeadline()>0)
+		{
+			requestdeadline=monotonicTime()+this->config->getRequestDeadline()*1000LL;
+		}
+	}
+	if (this->deadline>0 && (requestdeadline==0 || this->deadline<requestdeadline))
+	{
+		requestdeadline=this->deadline;
+	}
+
+	fds=new struct pollfd[this->sockets.size()];
+	buffers=new Octet[RADIUS_BATCH_MMSG*RADIUS_MAX_PACKET_LEN];
+
+	while (1)
+	{
+		//find the packets which must be sent (again)
+		now=monotonicTime();
+		due.clear();
+		for (entry=this->entries.begin(); entry!=this->entries.end(); entry++)
+		{
+			if (entry->result!=RADIUS_BATCH_PENDING)
+			{
+				continue;
+			}
+			if (entry->attempt.tries==0)
+			{
+				due.push_back(&(*entry));
+			}
+			else if (now>=entry->packet->getDeadline(&entry->attempt, this->config))
+			{
+				if (entry->attempt.tries<entry->attempt.server->getRetry())
+				{
+					due.push_back(&(*entry));
+				}
+				else
+				{
+					entry->attempt.server->recordTimeout(now, threshold, opentime);
+					entry->attempt.server->decOutstanding();
+					entry->result=this->nextServer(&(*entry));
+					if (entry->result==RADIUS_BATCH_PENDING)
+					{
+						due.push_back(&(*entry));
+					}
+				}
+			}
+		}
+		this->transmit(due);
+
+		//find the time of the next timeout
+		pending=0;
+		timeout=-1;
+		for (entry=this->entries.begin(); entry!=this->entries.end(); entry++)
+		{
+			if (entry->result==RADIUS_BATCH_PENDING)
+			{
+				pending++;
+				if (timeout<0 || entry->packet->getDeadline(&entry->attempt, this->config)<timeout)
+				{
+					timeout=entry->packet->getDeadline(&entry->attempt, this->config);
+				}
+			}
+		}
+		if (pending==0)
+		{
+			break;
+		}
+
+		//the budget of the batch is used up
+		now=monotonicTime();
+		if (requestdeadline>0 && now>=requestdeadline)
+		{
+			for (entry=this->entries.begin(); entry!=this->entries.end(); entry++)
+			{
+				if (entry->result==RADIUS_BATCH_PENDING)
+				{
+					this->finishEntry(&(*entry), NO_RESPONSE);
+				}
+			}
+			break;
+		}
+		if (requestdeadline>0 && requestdeadline<timeout)
+		{
+			timeout=requestdeadline;
+		}
+		if (timeout<now)
+		{
+			timeout=now;
+		}
+
+		// wait for the responses
+		for (i=0; i<(int)this->sockets.size(); i++)
+		{
+			fds[i].fd=this->sockets[i];
+			fds[i].events=POLLIN;
+			fds[i].revents=0;
+		}
+		if (poll(fds, this->sockets.size(), (timeout-now+999)/1000)>0)
+		{
+			for (i=0; i<(int)this->sockets.size(); i++)
+			{
+				if (fds[i].revents & POLLIN)
+				{
+					while (this->receive(i, buffers)==RADIUS_BATCH_MMSG);
+				}
+			}
+		}
+	}
+
+	delete [] fds;
+	delete [] buffers;
+
+	for (entry=this->entries.begin(); entry!=this->entries.end(); entry++)
+	{
+		if (entry->result==0)
+		{
+			answered++;
+		}
+	}
+	return answered;
+}
+
+/** The setter method for the deadline of the batch. The packets which
+ * aren't answered at the deadline get the result NO_RESPONSE. A requestdeadline
+ * from the config which ends earlier is still used.
+ * @param d The time (monotonic, in microseconds), 0 is unlimited.
+ */
+void RadiusBatch::setDeadline(long long d)
+{
+	this->deadline=d;
+}
+
+/** The getter method for the number of packets in the batch.
+ * @return The number of packets.
+ */
+int RadiusBatch::getSize(void)
+{
+	return this->entries.size();
+}
+
+/** The getter method for the result of a packet.
+ * @param index The index of the packet from addPacket().
+ * @return 0 if the packet was answered, RADIUS_BATCH_PENDING if run() wasn't called,
+ * BAD_INDEX if there is no such packet or an error code.
+ */
+int RadiusBatch::getResult(int index)
+{
+	if (index<0 || index>=(int)this->entries.size())
+	{
+		return BAD_INDEX;
+	}
+	return this->entries[index].result;
+}
@@ -0,0 +1,88 @@
+/*
+ *  RadiusClass -- An C++-Library for radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RADIUSBATCH_H_
+#define _RADIUSBATCH_H_
+
+#include <vector>
+#include <map>
+#include <list>
+#include <string>
+#include "RadiusPacket.h"
+#include "RadiusServer.h"
+#include "RadiusConfig.h"
+
+using namespace std;
+
+/** The number of packets which share a socket, the identifier of a packet
+ * is unique per socket.*/
+#define RADIUS_BATCH_IDS		256
+
+/** The number of packets which are sent or received with one system call.*/
+#define RADIUS_BATCH_MMSG		64
+
+/** The result of a packet in a batch which isn't answered yet.*/
+#define RADIUS_BATCH_PENDING	1
+
+/** A packet in a batch with the transmission to its current server.*/
+struct RadiusBatchEntry
+{
+	RadiusPacket	*packet;		/**<The packet, it isn't freed by the batch.*/
+	RadiusAttempt	attempt;		/**<The transmission to the current server, the buffer is the sendbuffer of the packet.*/
+	int				servers;		/**<The number of servers the packet was sent to.*/
+	int				result;			/**<RADIUS_BATCH_PENDING, 0 if the packet was answered or an error code.*/
+};
+
+/** The class sends many radius packets at once and collects the responses.
+ * The packets share a few sockets and are sent and received with sendmmsg() and
+ * recvmmsg(), so a batch of thousands packets costs only a few system calls per round trip.
+ * Every packet is retransmitted and sent to the next server on its own, like
+ * in RadiusPacket::radiusReceive().
+ */
+class RadiusBatch
+{
+private:
+	list<RadiusServer>			*serverlist;	/**<The list of radius servers.*/
+	RadiusConfig				*config;		/**<The radius config with the timeout settings.*/
+	vector<RadiusBatchEntry>	entries;		/**<The packets of the batch.*/
+	vector<int>					sockets;		/**<The sockets, one for RADIUS_BATCH_IDS packets.*/
+	map<string, struct sockaddr_in>	addresses;	/**<The resolved addresses of the servers.*/
+	long long					deadline;		/**<The time (monotonic, in microseconds) when run() gives up, 0 is unlimited.*/
+
+	int		startEntry(RadiusBatchEntry *, list<RadiusServer>::iterator);
+	void	finishEntry(RadiusBatchEntry *, int);
+	int		nextServer(RadiusBatchEntry *);
+	void	transmit(vector<RadiusBatchEntry *> &);
+	int		receive(int, Octet *);
+
+public:
+	RadiusBatch(list<RadiusServer> *, RadiusConfig *);
+	~RadiusBatch();
+
+	int		addPacket(RadiusPacket *, list<RadiusServer>::iterator);
+	int		run(void);
+	void	setDeadline(long long);
+
+	int		getSize(void);
+	int		getResult(int);
+};
+
+#endif //_RADIUSBATCH_H_
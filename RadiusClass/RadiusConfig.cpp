@@ -20,6 +20,11 @@
  */
  
 #include "RadiusConfig.h"
+#include <math.h>
+#include <pthread.h>
+
+/** The lock of the load balancing, the servers of a config may be shared by the threads of the radius daemon.*/
+static pthread_mutex_t selectlock=PTHREAD_MUTEX_INITIALIZER;
 
 
 /** The constructor The constructor initializes all char arrays with 0.
@@ -33,6 +38,18 @@ RadiusConfig::RadiusConfig(void)
 	memset(this->serviceType,0,2);
 	memset(this->nasIdentifier,0,128);
 	memset(this->nasIpAddress,0,16);
+	this->hedgedelay=0;
+	this->failurethreshold=0;
+	this->opentime=30;
+	this->adaptivewait=false;
+	this->minwait=50;
+	this->retrybackoff=1;
+	this->retryjitter=0;
+	this->requestdeadline=0;
+	this->authloadbalance=LB_FAILOVER;
+	this->acctloadbalance=LB_FAILOVER;
+	this->roundrobin=0;
+	this->shared=NULL;
 	
 }
 
@@ -49,6 +66,18 @@ RadiusConfig::RadiusConfig(string configfile)
 	memset(this->serviceType,0,2);
 	memset(this->nasIdentifier,0,128);
 	memset(this->nasIpAddress,0,16);
+	this->hedgedelay=0;
+	this->failurethreshold=0;
+	this->opentime=30;
+	this->adaptivewait=false;
+	this->minwait=50;
+	this->retrybackoff=1;
+	this->retryjitter=0;
+	this->requestdeadline=0;
+	this->authloadbalance=LB_FAILOVER;
+	this->acctloadbalance=LB_FAILOVER;
+	this->roundrobin=0;
+	this->shared=NULL;
 	this->parseConfigFile(configfile.c_str());
 }
 
@@ -66,9 +95,23 @@ RadiusConfig::~RadiusConfig(void)
 
 list<RadiusServer> * RadiusConfig::getRadiusServer(void)
 {
+	if (this->shared!=NULL)
+	{
+		return this->shared->getRadiusServer();
+	}
 	return (&server);
 }
 
+/** The method lets the config use the servers of another config instead of its own,
+ * the health of the servers and the load balancing are shared, e.g. by the
+ * instances of the radius daemon. The other config must exist as long as this one.
+ * @param config The other config or NULL for the own servers.
+ */
+void RadiusConfig::shareServers(RadiusConfig * config)
+{
+	this->shared=config;
+}
+
 /** The method parse the configfile for attributes and 
  * radius server, the attributes are copied to the
  * member variables.
@@ -128,6 +171,100 @@ int RadiusConfig::parseConfigFile(const char * configfile)
 				}
 				line.copy(this->nasIpAddress,line.size()-15,15);
 			}
+			if (strncmp(line.c_str(),"hedgedelay=",11)==0)
+			{
+				if (line.substr(11)=="p95")
+				{
+					this->hedgedelay=HEDGE_P95;
+				}
+				else
+				{
+					this->hedgedelay=atoi(line.substr(11).c_str());
+					if (this->hedgedelay<0)
+					{
+						return BAD_FILE;
+					}
+				}
+			}
+			if (strncmp(line.c_str(),"failurethreshold=",17)==0)
+			{
+				this->failurethreshold=atoi(line.substr(17).c_str());
+				if (this->failurethreshold<0)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"opentime=",9)==0)
+			{
+				this->opentime=atoi(line.substr(9).c_str());
+				if (this->opentime<0)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"adaptivewait=",13)==0)
+			{
+				if (line.substr(13)=="true")
+				{
+					this->adaptivewait=true;
+				}
+				else if (line.substr(13)=="false")
+				{
+					this->adaptivewait=false;
+				}
+				else
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"minwait=",8)==0)
+			{
+				this->minwait=atoi(line.substr(8).c_str());
+				if (this->minwait<0)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"retrybackoff=",13)==0)
+			{
+				this->retrybackoff=atof(line.substr(13).c_str());
+				if (this->retrybackoff<1)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"retryjitter=",12)==0)
+			{
+				this->retryjitter=atoi(line.substr(12).c_str());
+				if (this->retryjitter<0 || this->retryjitter>100)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"requestdeadline=",16)==0)
+			{
+				this->requestdeadline=atoi(line.substr(16).c_str());
+				if (this->requestdeadline<0)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"authloadbalance=",16)==0)
+			{
+				this->authloadbalance=this->parseLoadBalance(line.substr(16));
+				if (this->authloadbalance<0)
+				{
+					return BAD_FILE;
+				}
+			}
+			if (strncmp(line.c_str(),"acctloadbalance=",16)==0)
+			{
+				this->acctloadbalance=this->parseLoadBalance(line.substr(16));
+				if (this->acctloadbalance<0)
+				{
+					return BAD_FILE;
+				}
+			}
 			if(strncmp(line.c_str(),"server",6)==0)
 			{
 				tmpServer=new RadiusServer;
@@ -149,11 +286,11 @@ int RadiusConfig::parseConfigFile(const char * configfile)
 						
 					if (strncmp(line.c_str(),"authport=",9)==0) 
 					{
-						tmpServer->setAuthPort(atoi(line.substr(9,4).c_str()));
+						tmpServer->setAuthPort(atoi(line.substr(9).c_str()));
 					}
 					if (strncmp(line.c_str(),"acctport=",9)==0)
 					{
-						tmpServer->setAcctPort(atoi(line.substr(9,4).c_str()));
+						tmpServer->setAcctPort(atoi(line.substr(9).c_str()));
 					}
 					if (strncmp(line.c_str(),"name=",5)==0)
 					{
@@ -169,7 +306,19 @@ int RadiusConfig::parseConfigFile(const char * configfile)
 					}
 					if (strncmp(line.c_str(),"wait=",5)==0)
 					{
-						tmpServer->setWait(atoi(line.substr(5).c_str()));
+						//the time is given in seconds or with the suffix ms in milliseconds
+						if (line.size()>2 && line.substr(line.size()-2)=="ms")
+						{
+							tmpServer->setWait(atoi(line.substr(5).c_str()));
+						}
+						else
+						{
+							tmpServer->setWait(atoi(line.substr(5).c_str())*1000);
+						}
+					}
+					if (strncmp(line.c_str(),"weight=",7)==0)
+					{
+						tmpServer->setWeight(atoi(line.substr(7).c_str()));
 					}
 				}
 				if(strstr(line.c_str(),"}"))
@@ -338,6 +487,330 @@ char * RadiusConfig::getNASIpAddress(void)
 	return this->nasIpAddress;
 }
 
+/** The getter method for the hedge delay.
+ * @return The delay in milliseconds, 0 if hedging is disabled
+ * or HEDGE_P95 if the 95th percentile of the response times is used.
+ */
+int RadiusConfig::getHedgeDelay(void)
+{
+	return this->hedgedelay;
+}
+
+/** The setter method for the hedge delay.
+ * @param delay The delay in milliseconds, 0 disables hedging,
+ * HEDGE_P95 uses the 95th percentile of the response times.
+ */
+void RadiusConfig::setHedgeDelay(int delay)
+{
+	this->hedgedelay=delay;
+}
+
+/** The getter method for the failure threshold.
+ * @return The number of requests in a row without a response after which
+ * a server is skipped, 0 if the circuit breaker is disabled.
+ */
+int RadiusConfig::getFailureThreshold(void)
+{
+	return this->failurethreshold;
+}
+
+/** The setter method for the failure threshold.
+ * @param threshold The number of requests in a row without a response, 0 disables the circuit breaker.
+ */
+void RadiusConfig::setFailureThreshold(int threshold)
+{
+	this->failurethreshold=threshold;
+}
+
+/** The getter method for the open time.
+ * @return The time in seconds a server is skipped until it is probed.
+ */
+int RadiusConfig::getOpenTime(void)
+{
+	return this->opentime;
+}
+
+/** The setter method for the open time.
+ * @param t The time in seconds a server is skipped until it is probed.
+ */
+void RadiusConfig::setOpenTime(int t)
+{
+	this->opentime=t;
+}
+
+/** The getter method for adaptivewait.
+ * @return True if the time to wait is calculated from the response times.
+ */
+bool RadiusConfig::getAdaptiveWait(void)
+{
+	return this->adaptivewait;
+}
+
+/** The setter method for adaptivewait.
+ * @param b True if the time to wait is calculated from the response times.
+ */
+void RadiusConfig::setAdaptiveWait(bool b)
+{
+	this->adaptivewait=b;
+}
+
+/** The getter method for the minimal time to wait.
+ * @return The time in milliseconds.
+ */
+int RadiusConfig::getMinWait(void)
+{
+	return this->minwait;
+}
+
+/** The setter method for the minimal time to wait.
+ * @param t The time in milliseconds.
+ */
+void RadiusConfig::setMinWait(int t)
+{
+	this->minwait=t;
+}
+
+/** The getter method for the retry backoff.
+ * @return The factor the time to wait is multiplied with for every retry.
+ */
+double RadiusConfig::getRetryBackoff(void)
+{
+	return this->retrybackoff;
+}
+
+/** The setter method for the retry backoff.
+ * @param f The factor the time to wait is multiplied with for every retry, at least 1.
+ */
+void RadiusConfig::setRetryBackoff(double f)
+{
+	this->retrybackoff=f;
+}
+
+/** The getter method for the retry jitter.
+ * @return The percentage the time to wait is varied randomly.
+ */
+int RadiusConfig::getRetryJitter(void)
+{
+	return this->retryjitter;
+}
+
+/** The setter method for the retry jitter.
+ * @param j The percentage the time to wait is varied randomly (0-100).
+ */
+void RadiusConfig::setRetryJitter(int j)
+{
+	this->retryjitter=j;
+}
+
+/** The getter method for the request deadline.
+ * @return The time in milliseconds for a request over all servers and retries, 0 is unlimited.
+ */
+int RadiusConfig::getRequestDeadline(void)
+{
+	return this->requestdeadline;
+}
+
+/** The setter method for the request deadline.
+ * @param t The time in milliseconds for a request over all servers and retries, 0 is unlimited.
+ */
+void RadiusConfig::setRequestDeadline(int t)
+{
+	this->requestdeadline=t;
+}
+
+/** The getter method for the load balancing policy of authentication packets.
+ * @return LB_FAILOVER, LB_ROUNDROBIN, LB_WEIGHTED, LB_LEASTOUTSTANDING or LB_HASH.
+ */
+int RadiusConfig::getAuthLoadBalance(void)
+{
+	return this->authloadbalance;
+}
+
+/** The setter method for the load balancing policy of authentication packets.
+ * @param policy LB_FAILOVER, LB_ROUNDROBIN, LB_WEIGHTED, LB_LEASTOUTSTANDING or LB_HASH.
+ */
+void RadiusConfig::setAuthLoadBalance(int policy)
+{
+	this->authloadbalance=policy;
+}
+
+/** The getter method for the load balancing policy of accounting packets.
+ * @return LB_FAILOVER, LB_ROUNDROBIN, LB_WEIGHTED, LB_LEASTOUTSTANDING or LB_HASH.
+ */
+int RadiusConfig::getAcctLoadBalance(void)
+{
+	return this->acctloadbalance;
+}
+
+/** The setter method for the load balancing policy of accounting packets.
+ * @param policy LB_FAILOVER, LB_ROUNDROBIN, LB_WEIGHTED, LB_LEASTOUTSTANDING or LB_HASH.
+ */
+void RadiusConfig::setAcctLoadBalance(int policy)
+{
+	this->acctloadbalance=policy;
+}
+
+/** The method converts the name of a load balancing policy from the configfile.
+ * @param policy The name: failover, roundrobin, weighted, leastoutstanding or hash.
+ * @return The policy or -1 if the name is unknown.
+ */
+int RadiusConfig::parseLoadBalance(string policy)
+{
+	if (policy=="failover")
+	{
+		return LB_FAILOVER;
+	}
+	if (policy=="roundrobin")
+	{
+		return LB_ROUNDROBIN;
+	}
+	if (policy=="weighted")
+	{
+		return LB_WEIGHTED;
+	}
+	if (policy=="leastoutstanding")
+	{
+		return LB_LEASTOUTSTANDING;
+	}
+	if (policy=="hash")
+	{
+		return LB_HASH;
+	}
+	return -1;
+}
+
+/** The method selects the server a packet is sent to first. If the server
+ * doesn't answer, the next servers in the list are used.
+ * Servers with an open circuit breaker are skipped as long as another server is available.
+ * The hash policy uses weighted rendezvous hashing over the key, so a user
+ * stays on the same server and only the users of a removed server move.
+ * @param policy The load balancing policy.
+ * @param key The key for the hash policy, normally the username.
+ * @return An iterator to the server, the end of the list if the list is empty.
+ */
+list<RadiusServer>::iterator RadiusConfig::selectServer(int policy, string key)
+{
+	list<RadiusServer>::iterator	server;
+	
+	if (this->shared!=NULL)
+	{
+		return this->shared->selectServer(policy, key);
+	}
+	pthread_mutex_lock(&selectlock);
+	server=this->pickServer(policy, key);
+	pthread_mutex_unlock(&selectlock);
+	return server;
+}
+
+/** The method implements the load balancing policies for selectServer(), it is called under the lock.
+ * @param policy The load balancing policy.
+ * @param key The key for the hash policy.
+ * @return An iterator to the server, the end of the list if the list is empty.
+ */
+list<RadiusServer>::iterator RadiusConfig::pickServer(int policy, string key)
+{
+	list<RadiusServer>::iterator	server, selected=this->server.end();
+	int			available=0, totalweight=0, n;
+	unsigned long long	hash;
+	double		score, best=0;
+	string::size_type	i;
+	
+	for (server=this->server.begin(); server!=this->server.end(); server++)
+	{
+		if (server->isAvailable())
+		{
+			available++;
+		}
+	}
+	
+	switch (policy)
+	{
+	case LB_ROUNDROBIN:
+		if (available>0)
+		{
+			n=this->roundrobin++%available;
+			for (server=this->server.begin(); server!=this->server.end(); server++)
+			{
+				if (server->isAvailable() && n--==0)
+				{
+					return server;
+				}
+			}
+		}
+		break;
+		
+	case LB_WEIGHTED:
+		//smooth weighted round robin, every server gets its weight
+		//and the server with the highest current weight is used
+		for (server=this->server.begin(); server!=this->server.end(); server++)
+		{
+			if (available==0 || server->isAvailable())
+			{
+				server->setCurrentWeight(server->getCurrentWeight()+server->getWeight());
+				totalweight+=server->getWeight();
+				if (selected==this->server.end() || server->getCurrentWeight()>selected->getCurrentWeight())
+				{
+					selected=server;
+				}
+			}
+		}
+		if (selected!=this->server.end())
+		{
+			selected->setCurrentWeight(selected->getCurrentWeight()-totalweight);
+			return selected;
+		}
+		break;
+		
+	case LB_LEASTOUTSTANDING:
+		for (server=this->server.begin(); server!=this->server.end(); server++)
+		{
+			if ((available==0 || server->isAvailable()) && 
+				(selected==this->server.end() || 
+				server->getOutstanding()*selected->getWeight()<selected->getOutstanding()*server->getWeight()))
+			{
+				selected=server;
+			}
+		}
+		return selected;
+		
+	case LB_HASH:
+		for (server=this->server.begin(); server!=this->server.end(); server++)
+		{
+			if (available==0 || server->isAvailable())
+			{
+				//FNV-1a over the key and the name of the server
+				hash=14695981039346656037ULL;
+				for (i=0; i<key.size(); i++)
+				{
+					hash=(hash^(unsigned char)key[i])*1099511628211ULL;
+				}
+				hash=(hash^0xff)*1099511628211ULL;
+				for (i=0; i<server->getName().size(); i++)
+				{
+					hash=(hash^(unsigned char)server->getName()[i])*1099511628211ULL;
+				}
+				score=-server->getWeight()/log(((hash>>11)+0.5)/9007199254740992.0);
+				if (selected==this->server.end() || score>best)
+				{
+					selected=server;
+					best=score;
+				}
+			}
+		}
+		return selected;
+	}
+	
+	//failover: the first available server
+	for (server=this->server.begin(); server!=this->server.end(); server++)
+	{
+		if (server->isAvailable())
+		{
+			return server;
+		}
+	}
+	return this->server.begin();
+}
+
 ostream& operator << (ostream& os, RadiusConfig& config)
 {
      list<RadiusServer> * serverlist;
@@ -348,6 +821,16 @@ ostream& operator << (ostream& os, RadiusConfig& config)
      os << "\nNASIpAdress: "<< config.getNASIpAddress();
      os << "\nNASPortTyoe: "<< config.getNASPortType();
      os << "\nServiceType: " << config.getServiceType();
+     os << "\nHedgeDelay: " << config.getHedgeDelay();
+     os << "\nFailureThreshold: " << config.getFailureThreshold();
+     os << "\nOpenTime: " << config.getOpenTime();
+     os << "\nAdaptiveWait: " << config.getAdaptiveWait();
+     os << "\nMinWait: " << config.getMinWait();
+     os << "\nRetryBackoff: " << config.getRetryBackoff();
+     os << "\nRetryJitter: " << config.getRetryJitter();
+     os << "\nRequestDeadline: " << config.getRequestDeadline();
+     os << "\nAuthLoadBalance: " << config.getAuthLoadBalance();
+     os << "\nAcctLoadBalance: " << config.getAcctLoadBalance();
     
 	//get the server list
 	serverlist=config.getRadiusServer();
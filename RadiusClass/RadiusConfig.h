@@ -37,6 +37,16 @@
 using std::list;
 using namespace std;
 
+/** Value of the hedge delay if the delay is taken from the 95th percentile of the response times.*/
+#define HEDGE_P95 -1
+
+/** The load balancing policies for the server list.*/
+#define LB_FAILOVER			0	/**< The first available server is used.*/
+#define LB_ROUNDROBIN		1	/**< The servers are used one after another.*/
+#define LB_WEIGHTED			2	/**< The servers are used one after another according to their weights.*/
+#define LB_LEASTOUTSTANDING	3	/**< The server with the fewest requests (per weight) without a response is used.*/
+#define LB_HASH				4	/**< The server is selected by a consistent hash over the username.*/
+
 /**This class represents the configurations attributes which 
  * can set in the configuration file and methods for the attributes.
  */
@@ -49,8 +59,22 @@ private:
     char nasPortType[2]; 			/**<The nas port type which is set in radius packet.*/
     char nasIdentifier[128]; 		/**<The nas identifier which is set in the radius packet.*/
     char nasIpAddress[16]; 			/**<The nas ipaddress which is set in the radius packet.*/
+    int hedgedelay;					/**<The time in milliseconds after which a request is also sent to the next server, 0 is disabled.*/
+    int failurethreshold;			/**<The number of requests in a row without a response after which a server is skipped, 0 is disabled.*/
+    int opentime;					/**<The time in seconds a skipped server is not used until it is probed.*/
+    bool adaptivewait;				/**<If true the time to wait for a response is calculated from the response times of the server.*/
+    int minwait;					/**<The minimal time in milliseconds to wait for a response if adaptivewait is used.*/
+    double retrybackoff;			/**<The factor the time to wait for a response is multiplied with for every retry.*/
+    int retryjitter;				/**<The time to wait for a response is varied randomly by this percentage.*/
+    int requestdeadline;			/**<The time in milliseconds for a request over all servers and retries, 0 is unlimited.*/
+    int authloadbalance;			/**<The load balancing policy for authentication packets.*/
+    int acctloadbalance;			/**<The load balancing policy for accounting packets.*/
+    unsigned int roundrobin;		/**<The counter for the round robin policy.*/
+    RadiusConfig * shared;			/**<The config whose servers are used instead of the own ones, NULL if there is none.*/
     
 	void deletechars(string *);
+	int parseLoadBalance(string);
+	list<RadiusServer>::iterator pickServer(int, string);
 	
 	
 public:
@@ -65,6 +89,8 @@ public:
 	void getValue(const char * text, char * value);
 	
 	list<RadiusServer>* getRadiusServer(void);
+	list<RadiusServer>::iterator selectServer(int, string);
+	void shareServers(RadiusConfig *);
 	
 	
 	void setServiceType(char *);
@@ -83,6 +109,36 @@ public:
     char * getNASIpAddress(void);
 	void setNASIpAddress(char * );
 	
+	int getHedgeDelay(void);
+	void setHedgeDelay(int);
+	
+	int getFailureThreshold(void);
+	void setFailureThreshold(int);
+	
+	int getOpenTime(void);
+	void setOpenTime(int);
+	
+	bool getAdaptiveWait(void);
+	void setAdaptiveWait(bool);
+	
+	int getMinWait(void);
+	void setMinWait(int);
+	
+	double getRetryBackoff(void);
+	void setRetryBackoff(double);
+	
+	int getRetryJitter(void);
+	void setRetryJitter(int);
+	
+	int getRequestDeadline(void);
+	void setRequestDeadline(int);
+	
+	int getAuthLoadBalance(void);
+	void setAuthLoadBalance(int);
+	
+	int getAcctLoadBalance(void);
+	void setAcctLoadBalance(int);
+	
 	
 	
 	friend ostream& operator << (ostream& os, RadiusConfig& config);
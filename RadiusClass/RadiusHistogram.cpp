@@ -0,0 +1,146 @@
+/*
+ *  RadiusClass -- An C++-Library for radius authentication 
+ *					and accounting.
+ * 
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RadiusHistogram.h"
+#include <string.h>
+
+/** The method calculates the bucket of a value.
+ * @param value The value.
+ * @return The index of the bucket.
+ */
+int RadiusHistogram::getBucket(uint64_t value)
+{
+	int	exponent=0;
+
+	if (value<2*HISTOGRAM_SUB_BUCKETS)
+	{
+		return value;
+	}
+	//the position of the highest bit, at least log2(2*HISTOGRAM_SUB_BUCKETS)
+	while ((value>>exponent)>=2*HISTOGRAM_SUB_BUCKETS)
+	{
+		exponent++;
+	}
+	if (exponent>36)
+	{
+		return HISTOGRAM_BUCKETS-1;
+	}
+	return exponent*HISTOGRAM_SUB_BUCKETS+(value>>exponent);
+}
+
+/** The method calculates the largest value of a bucket.
+ * @param bucket The index of the bucket.
+ * @return The value.
+ */
+uint64_t RadiusHistogram::getBucketValue(int bucket)
+{
+	int	exponent;
+
+	if (bucket<2*HISTOGRAM_SUB_BUCKETS)
+	{
+		return bucket;
+	}
+	exponent=bucket/HISTOGRAM_SUB_BUCKETS-1;
+	return ((uint64_t) (HISTOGRAM_SUB_BUCKETS+bucket%HISTOGRAM_SUB_BUCKETS+1)<<exponent)-1;
+}
+
+/** The method records a value, it can be called by many threads and processes at once.
+ * @param usec The value in microseconds, a negative value is recorded as 0.
+ */
+void RadiusHistogram::record(long usec)
+{
+	uint64_t	value=(usec<0) ? 0 : usec, old;
+
+	__sync_fetch_and_add(&this->buckets[getBucket(value)], 1);
+	__sync_fetch_and_add(&this->sum, value);
+	__sync_fetch_and_add(&this->count, 1);
+	old=this->max;
+	while (value>old && !__sync_bool_compare_and_swap(&this->max, old, value))
+	{
+		old=this->max;
+	}
+}
+
+/** The method removes all values.
+ */
+void RadiusHistogram::reset(void)
+{
+	memset((void *) this, 0, sizeof(RadiusHistogram));
+}
+
+/** The getter method for the number of values.
+ * @return The number of values.
+ */
+uint64_t RadiusHistogram::getCount(void)
+{
+	return this->count;
+}
+
+/** The getter method for the sum of the values.
+ * @return The sum in microseconds.
+ */
+uint64_t RadiusHistogram::getSum(void)
+{
+	return this->sum;
+}
+
+/** The getter method for the largest value.
+ * @return The value in microseconds.
+ */
+uint64_t RadiusHistogram::getMax(void)
+{
+	return this->max;
+}
+
+/** The method calculates a percentile of the values.
+ * The result is the largest value of the bucket of the percentile, but never more than the largest value.
+ * @param percent The percentile, e.g. 99.9.
+ * @return The value in microseconds or 0 if there is no value.
+ */
+uint64_t RadiusHistogram::getPercentile(double percent)
+{
+	uint64_t	total=0, rank, seen=0, value;
+	int			i;
+
+	for (i=0; i<HISTOGRAM_BUCKETS; i++)
+	{
+		total+=this->buckets[i];
+	}
+	if (total==0)
+	{
+		return 0;
+	}
+	rank=(uint64_t) (total*percent/100.0+0.5);
+	if (rank<1)
+	{
+		rank=1;
+	}
+	for (i=0; i<HISTOGRAM_BUCKETS; i++)
+	{
+		seen+=this->buckets[i];
+		if (seen>=rank)
+		{
+			break;
+		}
+	}
+	value=getBucketValue(i<HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS-1);
+	return (value>this->max && this->max>0) ? this->max : value;
+}
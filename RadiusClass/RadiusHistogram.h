@@ -0,0 +1,61 @@
+/*
+ *  RadiusClass -- An C++-Library for radius authentication 
+ *					and accounting.
+ * 
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RADIUSHISTOGRAM_H_
+#define _RADIUSHISTOGRAM_H_
+
+#include <stdint.h>
+
+/** The number of buckets which cover a power of two, the relative error of a value is at most 1/8.*/
+#define HISTOGRAM_SUB_BUCKETS	8
+
+/** The number of buckets of a histogram, the largest value is about 2^40 microseconds.*/
+#define HISTOGRAM_BUCKETS		(2*HISTOGRAM_SUB_BUCKETS+36*HISTOGRAM_SUB_BUCKETS)
+
+/** A histogram of times in microseconds with logarithmic buckets (like HDR histograms):
+ * the values below 2*HISTOGRAM_SUB_BUCKETS have their own bucket, above every power of two
+ * is split into HISTOGRAM_SUB_BUCKETS buckets. The histogram has no pointers and an
+ * empty histogram is all zero, so it can be placed in shared memory.
+ * Values are recorded with atomic operations, a reader never blocks a writer, but a
+ * snapshot which is taken while values are recorded may be slightly inconsistent.
+ */
+class RadiusHistogram
+{
+private:
+	volatile uint64_t	count;						/**<The number of values.*/
+	volatile uint64_t	sum;						/**<The sum of the values.*/
+	volatile uint64_t	max;						/**<The largest value.*/
+	volatile uint64_t	buckets[HISTOGRAM_BUCKETS];	/**<The number of values per bucket.*/
+
+	static int		getBucket(uint64_t);
+	static uint64_t	getBucketValue(int);
+
+public:
+	void		record(long);
+	void		reset(void);
+
+	uint64_t	getCount(void);
+	uint64_t	getSum(void);
+	uint64_t	getMax(void);
+	uint64_t	getPercentile(double);
+};
+
+#endif //_RADIUSHISTOGRAM_H_
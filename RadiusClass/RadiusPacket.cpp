@@ -25,6 +25,47 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 
 using namespace std;
 
+/** The probes to skipped servers which still wait for a response after their request was
+ * answered by another server. They are finished by the following requests, see RadiusPacket::pollProbes.*/
+static list<RadiusAttempt> probes;
+
+/** The lock of the probes, the servers are shared by the threads of the radius daemon.*/
+static pthread_mutex_t probelock=PTHREAD_MUTEX_INITIALIZER;
+
+/** Returns the time of the monotonic clock.
+ * @return The time in microseconds.
+ */
+long long monotonicTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec*1000000LL+ts.tv_nsec/1000;
+}
+
+/** Resolves the name or the ip address of a radius server. Unlike gethostbyname()
+ * the function is reentrant, threads which share the servers resolve them at the same time.
+ * @param name The name or the ip address.
+ * @param addr The address, the family and the ip address are set, the port is 0.
+ * @return 0 or -1 if the name can't be resolved.
+ */
+int resolveServer(string name, struct sockaddr_in * addr)
+{
+	struct addrinfo hints, *res;
+	
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family=AF_INET;
+	hints.ai_socktype=SOCK_DGRAM;
+	if (getaddrinfo(name.c_str(), NULL, &hints, &res)!=0)
+	{
+		return -1;
+	}
+	memset(addr, 0, sizeof(struct sockaddr_in));
+	addr->sin_family=AF_INET;
+	addr->sin_addr=((struct sockaddr_in *)res->ai_addr)->sin_addr;
+	freeaddrinfo(res);
+	return 0;
+}
+
 /** The destructur frees the dynamic allocated memory of the buffers,
  * closes the socket and clears the attribute multimap.
  */
@@ -42,10 +83,7 @@ RadiusPacket::~RadiusPacket()
 	}
 	
 	
-	if (this->sock)
-	{
-		close (this->sock);
-	}
+	this->closeAttempts();
 	this->attribs.clear();
 	
 }
@@ -67,7 +105,7 @@ RadiusPacket::RadiusPacket(Octet code)
 	this->sendbufferlen=0;
 	this->recvbuffer=NULL;
 	this->recvbufferlen=0;
-	this->sock=0;
+	this->traceid=0;
 	
 }
 
@@ -87,7 +125,7 @@ RadiusPacket::RadiusPacket(void)
 	this->sendbufferlen=0;
 	this->recvbuffer=NULL;
 	this->recvbufferlen=0;
-	this->sock=0;
+	this->traceid=0;
 	
 }
 
@@ -380,20 +418,33 @@ int RadiusPacket::unShapeRadiusPacket(void)
 }
 
 /**	The method sends the packet to a radius server.
+ * Transmissions of an earlier call are cancelled.
  * @param server A iterator to a server.
  * @return Returns the number of bytes successfully sent, 
- * SOCKET_ERROR or UNKNOWN_HOST in case of error.
+ * SHAPE_ERROR, SOCKET_ERROR, BIND_ERROR or UNKNOWN_HOST in case of error.
  */
 int RadiusPacket::radiusSend(list<RadiusServer>::iterator server)
 {
- 
-	int					socket2Radius;
-    struct hostent		*h;
-    struct sockaddr_in	cliAddr,remoteServAddr;
-    
-    //the packet is shaped here, the authenticator gets
-    //a new random value and then the buffer must be shaped again
-    //the password field depends on the authenticator field
+	this->closeAttempts();
+	return this->startAttempt(server);
+}
+
+
+/**	The method shapes the packet for a server, opens a socket and sends the
+ * packet to the server. The transmission is added to the list of attempts
+ * which wait for a response.
+ * @param server A iterator to a server.
+ * @return Returns the number of bytes successfully sent, 
+ * SHAPE_ERROR, SOCKET_ERROR, BIND_ERROR or UNKNOWN_HOST in case of error.
+ */
+int RadiusPacket::startAttempt(list<RadiusServer>::iterator server)
+{
+	RadiusAttempt		attempt;
+	struct sockaddr_in	cliAddr;
+	
+	//the packet is shaped here, the authenticator gets
+	//a new random value and then the buffer must be shaped again
+	//the password field depends on the authenticator field
 	if(this->shapeRadiusPacket(server->getSharedSecret().c_str())!=0)
 	{
 		return SHAPE_ERROR;
@@ -411,150 +462,572 @@ int RadiusPacket::radiusSend(list<RadiusServer>::iterator server)
 	memcpy(this->authenticator, this->req_authenticator, 16);
 		
 	//	Get server IP address (no check if input is IP address or DNS name
-    if(!(h=gethostbyname(server->getName().c_str())))
+	if(resolveServer(server->getName(), &attempt.addr)!=0)
 	{
 		return UNKNOWN_HOST;
 	}
-    
-    remoteServAddr.sin_family=h->h_addrtype;
-    memcpy((char*)&(remoteServAddr.sin_addr.s_addr),h->h_addr_list[0],h->h_length);
-    
-    //set the port, they are differnt for accounting and authentication
-    if (this->code==ACCOUNTING_REQUEST)
+	
+	//set the port, they are differnt for accounting and authentication
+	if (this->code==ACCOUNTING_REQUEST)
 	{
-    	remoteServAddr.sin_port=htons(server->getAcctPort());
+		attempt.addr.sin_port=htons(server->getAcctPort());
 	}
 	else
 	{
-		remoteServAddr.sin_port=htons(server->getAuthPort());
+		attempt.addr.sin_port=htons(server->getAuthPort());
 	}
-    
-    //	Socket creation
-    if((socket2Radius = socket(AF_INET, SOCK_DGRAM, 0))<0)
+	
+	//	Socket creation
+	if((attempt.sock = socket(AF_INET, SOCK_DGRAM, 0))<0)
 	{
 		cerr <<  "Cannot open socket: "<< strerror(errno) <<"\n";
 		return SOCKET_ERROR;
 	}
-    
+	
 	//	Bind any port
-    cliAddr.sin_family=AF_INET;
-    cliAddr.sin_addr.s_addr=htonl(INADDR_ANY);
-    cliAddr.sin_port=htons(0);
- 	 	
+	memset(&cliAddr, 0, sizeof(struct sockaddr_in));
+	cliAddr.sin_family=AF_INET;
+	cliAddr.sin_addr.s_addr=htonl(INADDR_ANY);
+	cliAddr.sin_port=htons(0);
+	
 	//Bind the socket port,
-    if(bind(socket2Radius,(struct sockaddr*)&cliAddr,sizeof(struct sockaddr))<0)
+	if(bind(attempt.sock,(struct sockaddr*)&cliAddr,sizeof(struct sockaddr))<0)
 	{
 		cerr << "Cannot bind port: " << strerror(errno) << "\n";
-		socket2Radius=-1;
+		close(attempt.sock);
 		return BIND_ERROR;
 	}
 	
-	//safe the socket for receiving packets
-	this->sock=socket2Radius;
-	//sent the buffer
-	return sendto(socket2Radius,this->sendbuffer,this->sendbufferlen,0,(struct sockaddr*)&remoteServAddr,sizeof(struct sockaddr));
+	//keep a copy of the packet, it is shaped again for every server
+	attempt.server=server;
+	attempt.bufferlen=this->sendbufferlen;
+	attempt.buffer=new Octet[this->sendbufferlen];
+	memcpy(attempt.buffer, this->sendbuffer, this->sendbufferlen);
+	attempt.tries=0;
+	attempt.probe=false;
+	attempt.first=monotonicTime();
+	attempt.sent=attempt.first;
+	
+	this->attempts.push_back(attempt);
+	server->incOutstanding();
+	return this->transmitAttempt(&(this->attempts.back()));
+}
+
+
+/**	The method sends the packet of an attempt (again) to its server.
+ * A retransmission uses the same identifier, authenticator and socket, so
+ * a late response to an earlier transmission is accepted, too.
+ * @param attempt The attempt to send.
+ * @return Returns the number of bytes successfully sent or -1 in case of error.
+ */
+int RadiusPacket::transmitAttempt(RadiusAttempt *attempt)
+{
+	attempt->tries++;
+	attempt->sent=monotonicTime();
+	attempt->deadline=0;
+	return sendto(attempt->sock,attempt->buffer,attempt->bufferlen,0,(struct sockaddr*)&(attempt->addr),sizeof(struct sockaddr_in));
+}
+
+
+/**	The method reads a packet from the socket of an attempt into the recvbuffer
+ * and checks if it is the response to the request.
+ * @param attempt The attempt with a readable socket.
+ * @return Returns 0 if the packet is a valid response, UNEXPECTED_RECV_PACKET if the 
+ * packet is from another host or is no response to the request 
+ * or WRONG_AUTHENTICATOR_IN_RECV_PACKET.
+ */
+int RadiusPacket::receiveAttempt(RadiusAttempt *attempt)
+{
+	struct sockaddr_in	remoteServAddr;
+	socklen_t			len=sizeof(struct sockaddr_in);
+	
+	//allocate enough space for the buffer (RFC says maximum 4096=RADIUS_MAX_PACKET_LEN Bytes)
+	if(!this->recvbuffer)
+	{
+		this->recvbuffer=new Octet[RADIUS_MAX_PACKET_LEN];
+	}
+	//set the buffer to 0
+	memset(this->recvbuffer,0,RADIUS_MAX_PACKET_LEN);
+	this->recvbufferlen=recvfrom(attempt->sock,this->recvbuffer,RADIUS_MAX_PACKET_LEN,0,(struct sockaddr*)&remoteServAddr,&len);
+	
+	//the packet must come from the server and must be a response to the request
+	if (this->recvbufferlen<RADIUS_PACKET_AUTHENTICATOR_LEN+4 || 
+		remoteServAddr.sin_addr.s_addr!=attempt->addr.sin_addr.s_addr ||
+		remoteServAddr.sin_port!=attempt->addr.sin_port ||
+		this->recvbuffer[1]!=this->identifier)
+	{
+		this->recvbufferlen=0;
+		return UNEXPECTED_RECV_PACKET;
+	}
+	
+	//the response authenticator depends on the request which was sent to this server
+	memcpy(this->sendbuffer, attempt->buffer, attempt->bufferlen);
+	this->sendbufferlen=attempt->bufferlen;
+	if (this->authenticateReceivedPacket(attempt->server->getSharedSecret().c_str())!=0)
+	{
+		return WRONG_AUTHENTICATOR_IN_RECV_PACKET;
+	}
+	
+	//the response time is only clear if the packet was sent once
+	if (attempt->tries==1)
+	{
+		attempt->server->addRttSample(monotonicTime()-attempt->sent);
+	}
+	traceSpan("radius response", this->traceid, attempt->sent);
+	return 0;
+}
+
+
+/**	The method cancels all transmissions which wait for a response.
+ * The probes aren't cancelled, they are kept until they are answered or timed out,
+ * so a recovered server is available again, even if it answers slower than the other servers.
+ */
+void RadiusPacket::closeAttempts(void)
+{
+	list<RadiusAttempt>::iterator attempt;
+	for (attempt=this->attempts.begin(); attempt!=this->attempts.end(); attempt++)
+	{
+		if (attempt->probe)
+		{
+			pthread_mutex_lock(&probelock);
+			probes.push_back(*attempt);
+			pthread_mutex_unlock(&probelock);
+		}
+		else
+		{
+			this->closeAttempt(&(*attempt));
+		}
+	}
+	this->attempts.clear();
+}
+
+
+/**	The method finishes the probes whose request was answered by another server.
+ * It doesn't wait: a probe with a response closes the circuit breaker of its server,
+ * a probe without a response is sent again after its timeout or opens the circuit breaker
+ * again after the last retry, like in radiusReceive().
+ * @param config The radius config with the circuit breaker settings, can be NULL.
+ */
+void RadiusPacket::pollProbes(RadiusConfig *config)
+{
+	list<RadiusAttempt>::iterator	attempt;
+	RadiusPacket	response;
+	int				maxfd=0, threshold=0, opentime=0;
+	long long		now;
+	fd_set			set;
+	struct timeval	tv;
+	
+	pthread_mutex_lock(&probelock);
+	if (probes.empty())
+	{
+		pthread_mutex_unlock(&probelock);
+		return;
+	}
+	if (config!=NULL)
+	{
+		threshold=config->getFailureThreshold();
+		opentime=config->getOpenTime();
+	}
+	FD_ZERO(&set);
+	for (attempt=probes.begin(); attempt!=probes.end(); attempt++)
+	{
+		FD_SET(attempt->sock, &set);
+		maxfd=max(maxfd, attempt->sock);
+	}
+	tv.tv_sec=0;
+	tv.tv_usec=0;
+	if (select(maxfd+1, &set, NULL, NULL, &tv)<0)
+	{
+		FD_ZERO(&set);
+	}
+	
+	now=monotonicTime();
+	attempt=probes.begin();
+	while (attempt!=probes.end())
+	{
+		//the response is checked with the identifier and the authenticator of the probe
+		response.identifier=attempt->buffer[1];
+		delete [] response.sendbuffer;
+		response.sendbuffer=new Octet[attempt->bufferlen];
+		if (FD_ISSET(attempt->sock, &set) && response.receiveAttempt(&(*attempt))==0)
+		{
+			attempt->server->recordSuccess();
+		}
+		else if (now<response.getDeadline(&(*attempt), config))
+		{
+			attempt++;
+			continue;
+		}
+		else if (attempt->tries<attempt->server->getRetry())
+		{
+			response.transmitAttempt(&(*attempt));
+			attempt++;
+			continue;
+		}
+		else
+		{
+			attempt->server->recordTimeout(now, threshold, opentime);
+		}
+		response.closeAttempt(&(*attempt));
+		attempt=probes.erase(attempt);
+	}
+	pthread_mutex_unlock(&probelock);
+}
+
+
+/**	The function closes the probes of a server which is destroyed.
+ * @param server The server.
+ */
+void dropProbes(RadiusServer *server)
+{
+	list<RadiusAttempt>::iterator attempt;
+	
+	pthread_mutex_lock(&probelock);
+	attempt=probes.begin();
+	while (attempt!=probes.end())
+	{
+		if (&(*attempt->server)==server)
+		{
+			close(attempt->sock);
+			delete [] attempt->buffer;
+			attempt=probes.erase(attempt);
+		}
+		else
+		{
+			attempt++;
+		}
+	}
+	pthread_mutex_unlock(&probelock);
+}
+
+
+/**	The method closes the socket of an attempt and frees the buffer.
+ * The attempt is not removed from the list.
+ * @param attempt The attempt.
+ */
+void RadiusPacket::closeAttempt(RadiusAttempt *attempt)
+{
+	attempt->server->decOutstanding();
+	close(attempt->sock);
+	delete [] attempt->buffer;
+}
+
+
+/**	The method calculates until when to wait for a response to the last 
+ * transmission of an attempt. If adaptivewait is set in the config, the time
+ * is calculated from the response times of the server, else the wait time of
+ * the server is used. The time is multiplied by retrybackoff for every
+ * retransmission and varied randomly by retryjitter percent. 
+ * The adaptive time is never longer than the wait time of the server.
+ * The result is kept until the next transmission.
+ * @param attempt The attempt.
+ * @param config The radius config, can be NULL.
+ * @return The time (monotonic, in microseconds).
+ */
+long long RadiusPacket::getDeadline(RadiusAttempt *attempt, RadiusConfig *config)
+{
+	long long	wait=attempt->server->getWait()*1000LL;
+	double		timeout=wait;
+	int			i, jitter;
+	
+	if (attempt->deadline!=0)
+	{
+		return attempt->deadline;
+	}
+	if (config!=NULL)
+	{
+		if (config->getAdaptiveWait())
+		{
+			timeout=attempt->server->getTimeout(config->getMinWait()*1000L);
+		}
+		for (i=1; i<attempt->tries && timeout<RADIUS_MAX_WAIT*1000000.0; i++)
+		{
+			timeout*=config->getRetryBackoff();
+		}
+		if (config->getAdaptiveWait() && timeout>wait)
+		{
+			timeout=wait;
+		}
+		if (timeout>RADIUS_MAX_WAIT*1000000.0)
+		{
+			timeout=RADIUS_MAX_WAIT*1000000.0;
+		}
+		jitter=config->getRetryJitter();
+		if (jitter>0)
+		{
+			timeout+=timeout*((int)(random()%(2*jitter+1))-jitter)/100.0;
+		}
+	}
+	attempt->deadline=attempt->sent+(long long)timeout;
+	return attempt->deadline;
 }
 
 
 /**	Receives a packet from a radius server, and copies it into recvbuffer.
- * If there is no response the packet is send again if the server->retry 
- * is bigger than 0. 1 means the packet is send
- * one more time. If a packet is received the received data is write to the recvbuffer
+ * If there is no response the packet is send again until the packet
+ * was sent server->retry times to the server. Then the next server in 
+ * the list is used, the list starts again at the beginning
+ * after the last server. The first server is the server from radiusSend().
+ * If the hedge delay is set in the config and the server doesn't answer within 
+ * the delay, the packet is also sent to the next server. The first valid
+ * response wins, the other transmission is cancelled.
+ * Servers which didn't answer failurethreshold requests in a row are skipped, 
+ * after opentime seconds the packet is sent to them as a probe in parallel.
+ * A probe which is still waiting when the request ends is finished by the following requests.
+ * If requestdeadline is set, the method gives up after the deadline over all 
+ * servers and retries.
+ * If a packet is received the received data is write to the recvbuffer
  * and the length is written to recvbufferlen. 
  * The attributes are cleared if a packet is received.
  * @param serverlist : A list of radius server. 
- * @return Returns 0 if everything is ok, else ALLOC_ERROR,  UNKNOWN_HOST, WRONG_AUTHENTICATOR_IN_RECV_PACKET or NO_RESPONSE in case of error.
+ * @param config : The radius config with the hedge delay and the 
+ * circuit breaker settings, can be NULL.
+ * @return Returns 0 if everything is ok, else UNSHAPE_ERROR, WRONG_AUTHENTICATOR_IN_RECV_PACKET or NO_RESPONSE in case of error.
  */
-int RadiusPacket::radiusReceive(list<RadiusServer> *serverlist)
+int RadiusPacket::radiusReceive(list<RadiusServer> *serverlist, RadiusConfig *config)
 {
+	list<RadiusAttempt>::iterator	attempt;
+	list<RadiusServer>::iterator	next, server;
+	int				result, error=NO_RESPONSE, maxfd;
+	int				i_server=serverlist->size(), i=0, live;
+	int				hedgedelay=0, threshold=0, opentime=0;
+	bool			skip=false;
+	long long		now, timeout, hedge, requestdeadline=0, started;
+	const char		*span=(this->code==ACCOUNTING_REQUEST) ? "radius accounting request" : "radius access request";
+	fd_set			set;
+	struct timeval	tv;
 	
-	list<RadiusServer>::iterator server;
+	//the span of the request starts with the first transmission
+	started=this->attempts.empty() ? monotonicTime() : this->attempts.front().first;
 	
-	int 			result, retries=1; //for the first try retries=1, because the first packet was send in radiusSend()
-	socklen_t		len;
-	struct hostent	*h;
-	fd_set  		set; 
-	struct timeval 	tv;
-	struct sockaddr_in	remoteServAddr;
-	int i_server=serverlist->size(),i=0;
-	server=serverlist->begin();
+	if (config!=NULL)
+	{
+		hedgedelay=config->getHedgeDelay();
+		threshold=config->getFailureThreshold();
+		opentime=config->getOpenTime();
+		requestdeadline=config->getRequestDeadline()*1000LL;
+	}
+	
+	//the budget for the whole request starts with the first transmission
+	if (requestdeadline>0)
+	{
+		if (this->attempts.empty())
+		{
+			requestdeadline+=monotonicTime();
+		}
+		else
+		{
+			requestdeadline+=this->attempts.front().first;
+		}
+	}
+	
+	//finish the probes of the previous requests, they may close a circuit breaker
+	pollProbes(config);
+	
+	//skip the servers with an open circuit breaker,
+	//if all are open they are used anyway
+	for (server=serverlist->begin(); server!=serverlist->end(); server++)
+	{
+		if (server->isAvailable())
+		{
+			skip=true;
+		}
+	}
 	
-	while (i<i_server)
-	{		
-		//	Get server IP address (no check if input is IP address or DNS name
-	    if(!(h=gethostbyname(server->getName().c_str())))
+	//the first server is the server which was used in radiusSend()
+	if (this->attempts.empty())
+	{
+		next=serverlist->begin();
+	}
+	else
+	{
+		next=this->attempts.front().server;
+		next++;
+		i++;
+		if (skip && !this->attempts.front().server->isAvailable())
 		{
-			return UNKNOWN_HOST;
+			this->closeAttempts();
+		}
+	}
+	
+	//probe the skipped servers in parallel
+	now=monotonicTime();
+	for (server=serverlist->begin(); server!=serverlist->end(); server++)
+	{
+		if (skip && server->isProbeDue(now) && this->startAttempt(server)>=0)
+		{
+			server->startProbe();
+			this->attempts.back().probe=true;
+		}
+	}
+	
+	while (1)
+	{
+		//count the transmissions which are no probes
+		live=0;
+		for (attempt=this->attempts.begin(); attempt!=this->attempts.end(); attempt++)
+		{
+			if (!attempt->probe)
+			{
+				live++;
+			}
 		}
 		
-	    remoteServAddr.sin_family=h->h_addrtype;
-	    
-	    remoteServAddr.sin_port=htons(server->getAuthPort());
+		//no transmission waits for a response, use the next server
+		while (live==0 && i<i_server)
+		{
+			if (next==serverlist->end())
+			{
+				next=serverlist->begin();
+			}
+			if ((!skip || next->isAvailable()) && this->startAttempt(next)>=0)
+			{
+				live++;
+			}
+			next++;
+			i++;
+		}
+		if (live==0)
+		{
+			break;
+		}
 		
+		//find the time of the next timeout
+		timeout=-1;
+		maxfd=0;
+		FD_ZERO(&set);
+		for (attempt=this->attempts.begin(); attempt!=this->attempts.end(); attempt++)
+		{
+			if (timeout<0 || this->getDeadline(&(*attempt), config)<timeout)
+			{
+				timeout=this->getDeadline(&(*attempt), config);
+			}
+			FD_SET(attempt->sock, &set);
+			maxfd=max(maxfd, attempt->sock);
+		}
 		
-	    //retry the sending if there is no result
-	    while (retries<=server->getRetry())
-	    {
-		    // wait for the specified time for a response
-			tv.tv_sec = server->getWait();  
-		    tv.tv_usec = 0;
-		    FD_ZERO(&set);				// clear out the set 
-		    FD_SET(this->sock, &set);	// wait only for the RADIUS UDP socket 
-			result = select(FD_SETSIZE, &set, NULL, NULL, &tv);
-			
-					
-			if (result>0)
+		//the time when the packet is sent to the next server, too
+		hedge=-1;
+		if (hedgedelay!=0 && live==1 && i<i_server)
+		{
+			for (attempt=this->attempts.begin(); attempt->probe; attempt++);
+			if (hedgedelay==HEDGE_P95)
 			{
-				
-				//clear the attributes
-				attribs.clear();
+				if (attempt->server->getRttPercentile(95)>0)
+				{
+					hedge=attempt->first+attempt->server->getRttPercentile(95);
+				}
+			}
+			else
+			{
+				hedge=attempt->first+hedgedelay*1000LL;
+			}
+			if (hedge>=0 && hedge<timeout)
+			{
+				timeout=hedge;
+			}
+		}
 		
-				
-				//allocate enough space for the buffer (RFC says maximum 4096=RADIUS_MAX_PACKET_LEN Bytes)
-				if(!(this->recvbuffer=new Octet[RADIUS_MAX_PACKET_LEN]))
+		//don't wait longer than the budget of the request
+		if (requestdeadline>0 && requestdeadline<timeout)
+		{
+			timeout=requestdeadline;
+		}
+		
+		// wait for the specified time for a response
+		now=monotonicTime();
+		if (timeout<now)
+		{
+			timeout=now;
+		}
+		tv.tv_sec=(timeout-now)/1000000LL;
+		tv.tv_usec=(timeout-now)%1000000LL;
+		result=select(maxfd+1, &set, NULL, NULL, &tv);
+		
+		if (result>0)
+		{
+			for (attempt=this->attempts.begin(); attempt!=this->attempts.end(); attempt++)
+			{
+				if (FD_ISSET(attempt->sock, &set))
 				{
-					return (ALLOC_ERROR);
+					result=this->receiveAttempt(&(*attempt));
+					if (result==0)
+					{
+						//the first valid response wins
+						attempt->server->recordSuccess();
+						this->closeAttempts();
+						
+						//clear the attributes
+						attribs.clear();
+						
+						//unshape the packet
+						if(this->unShapeRadiusPacket()!=0)
+						{
+							return UNSHAPE_ERROR;
+						}
+						traceSpan(span, this->traceid, started);
+						return 0;
+					}
+					//remember the error, maybe a valid response is received later
+					if (result==WRONG_AUTHENTICATOR_IN_RECV_PACKET)
+					{
+						error=result;
+					}
 				}
-				//set the buffer to 0
-				memset(this->recvbuffer,0,RADIUS_MAX_PACKET_LEN); 	
-				len=sizeof(struct sockaddr_in);
-				this->recvbufferlen=recvfrom(this->sock,this->recvbuffer,RADIUS_MAX_PACKET_LEN,0,(struct sockaddr*)&remoteServAddr,&len);
-				close(this->sock);
-				this->sock=0;
-				//unshape the packet
-				if(this->unShapeRadiusPacket()!=0)
+			}
+		}
+		
+		//the budget of the request is used up
+		now=monotonicTime();
+		if (requestdeadline>0 && now>=requestdeadline)
+		{
+			break;
+		}
+		
+		//send the packet again or give up the server
+		attempt=this->attempts.begin();
+		while (attempt!=this->attempts.end())
+		{
+			if (now>=this->getDeadline(&(*attempt), config))
+			{
+				if (attempt->tries<attempt->server->getRetry())
 				{
-					return UNSHAPE_ERROR;
+					this->transmitAttempt(&(*attempt));
 				}
-				
-				if (this->authenticateReceivedPacket(server->getSharedSecret().c_str())!=0)
+				else
 				{
-					
-					return WRONG_AUTHENTICATOR_IN_RECV_PACKET;
+					attempt->server->recordTimeout(now, threshold, opentime);
+					this->closeAttempt(&(*attempt));
+					attempt=this->attempts.erase(attempt);
+					continue;
 				}
-				return 0;
 			}
-			else
+			attempt++;
+		}
+		
+		//send the packet to the next available server, too
+		if (hedge>=0 && now>=hedge && live==1 && i<i_server)
+		{
+			for (; i<i_server; i++)
 			{
-				close(this->sock);
-				this->sock=0;
-				//retry only if the retries are less than
-				//the server retries
-				if(retries <= server->getRetry())
+				if (next==serverlist->end())
+				{
+					next=serverlist->begin();
+				}
+				server=next;
+				next++;
+				if ((!skip || server->isAvailable()) && this->startAttempt(server)>=0)
 				{
-					this->radiusSend(server);
+					i++;
+					break;
 				}
 			}
-			retries++;
-	    }
-	    
-		server++;
-		i++;
-		//set the retries=0, for the new server
-		retries=0;
+		}
 	}
 	
-	return NO_RESPONSE;
+	this->closeAttempts();
+	traceSpan(span, this->traceid, started);
+	return error;
   	
 }
 
@@ -703,3 +1176,80 @@ int	RadiusPacket::authenticateReceivedPacket(const char *secret)
 }
 
 
+/** The getter method for the request id of the spans in the trace.
+ * @return The id, 0 if the packet belongs to no request.
+ */
+uint32_t RadiusPacket::getTraceId(void)
+{
+	return this->traceid;
+}
+
+/** The setter method for the request id of the spans in the trace.
+ * @param id The id.
+ */
+void RadiusPacket::setTraceId(uint32_t id)
+{
+	this->traceid=id;
+}
+
+/** Returns the length of the attributes in the wire format.
+ * @return The length in bytes.
+ */
+int RadiusPacket::getAttributesLength(void)
+{
+	return this->length-(RADIUS_PACKET_AUTHENTICATOR_LEN+4);
+}
+
+
+/** Writes the attributes of the packet in the wire format (type, length, value)
+ * into a buffer, so the packet can be stored and sent later. The values
+ * of password attributes are written in plaintext.
+ * @param buffer The buffer.
+ * @param len The size of the buffer.
+ * @return The number of bytes written or BAD_LENGTH if the buffer is too small.
+ */
+int RadiusPacket::serializeAttributes(Octet *buffer, int len)
+{
+	multimap<Octet, RadiusAttribute>::iterator	it;
+	int		pos=0;
+	
+	if (len<this->getAttributesLength())
+	{
+		return BAD_LENGTH;
+	}
+	for (it=attribs.begin(); it!=attribs.end(); it++)
+	{
+		buffer[pos++]=it->second.getType();
+		buffer[pos++]=it->second.getLength();
+		memcpy(buffer+pos, it->second.getValue(), it->second.getLength()-2);
+		pos+=it->second.getLength()-2;
+	}
+	return pos;
+}
+
+
+/** Adds the attributes from a buffer in the wire format, which was
+ * written by serializeAttributes(), to the packet.
+ * @param buffer The buffer.
+ * @param len The length of the attributes in the buffer.
+ * @return 0 or BAD_LENGTH if the buffer is corrupt.
+ */
+int RadiusPacket::loadAttributes(Octet *buffer, int len)
+{
+	int				pos=0;
+	
+	while (pos<len)
+	{
+		if (pos+2>len || buffer[pos+1]<3 || pos+buffer[pos+1]>len)
+		{
+			return BAD_LENGTH;
+		}
+		RadiusAttribute	ra;
+		ra.setType(buffer[pos]);
+		ra.setLength(buffer[pos+1]);
+		ra.setRecvValue((char *)buffer+pos+2);
+		this->addRadiusAttribute(&ra);
+		pos+=buffer[pos+1];
+	}
+	return 0;
+}
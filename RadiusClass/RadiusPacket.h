@@ -42,6 +42,8 @@
 #include "radius.h"
 #include "RadiusAttribute.h"
 #include "RadiusServer.h"
+#include "RadiusConfig.h"
+#include "RadiusTrace.h"
 
 
 #include <map>
@@ -51,6 +53,28 @@
 using namespace std;
 using std::multimap;
 
+/** The maximal time in seconds to wait for a response to one transmission.*/
+#define RADIUS_MAX_WAIT 3600
+
+/** A transmission of the packet to one radius server, which waits for a response.*/
+struct RadiusAttempt
+{
+	list<RadiusServer>::iterator server;	/**<The server the packet was sent to.*/
+	int					sock;				/**<The socket the response is received on.*/
+	struct sockaddr_in	addr;				/**<The address of the server.*/
+	Octet				*buffer;			/**<The packet as it was shaped for this server.*/
+	int					bufferlen;			/**<Length of the buffer.*/
+	int					tries;				/**<How many times the packet was sent to the server.*/
+	long long			first;				/**<Time of the first transmission in microseconds.*/
+	long long			sent;				/**<Time of the last transmission in microseconds.*/
+	bool				probe;				/**<True if the packet is a probe to a skipped server.*/
+	long long			deadline;			/**<Time until the response to the last transmission is awaited, 0 if not calculated yet.*/
+};
+
+long long monotonicTime(void);
+int resolveServer(string, struct sockaddr_in *);
+void dropProbes(RadiusServer *);
+
 /** The class represents a radius packet with additional variables*/
 
 class RadiusPacket
@@ -58,7 +82,7 @@ class RadiusPacket
 private:
 	
 	multimap<Octet,RadiusAttribute> attribs; 	/**The multimap for the radius attributes.*/
-	int					sock; 					/**<The socket which is used.*/
+	list<RadiusAttempt>	attempts;				/**<The transmissions which wait for a response.*/
 	Octet				code; 					/**< The code of the packet, see the Radius RFC or radius.h*/
 	Octet				identifier; 			/**<The identifier of the packet, it is generated randomly.*/			
 	unsigned short int	length;					/**<The length of the packet on the network in bytes. */			
@@ -75,6 +99,7 @@ private:
 	int					sendbufferlen; 			/**<Length of the buffer.*/
 	Octet				*recvbuffer;  			/**<Buffer for recveing the packet over the network.*/
 	int					recvbufferlen; 			/**<Length of the buffer.*/
+	uint32_t			traceid;				/**<The request id of the spans in the trace, 0 if the packet belongs to no request.*/
 	void            	calcacctdigest(const char *secret); /**Method to generate the hash 
 	for the authenticator in Accounting-Requests.*/
 	
@@ -82,6 +107,16 @@ private:
 	void 			getRandom(int len, Octet *num);
 	int				shapeRadiusPacket(const char *);
 	int				unShapeRadiusPacket(void);
+	int				startAttempt(list<RadiusServer>::iterator);
+	int				transmitAttempt(RadiusAttempt *);
+	int				receiveAttempt(RadiusAttempt *);
+	void			closeAttempts(void);
+	void			closeAttempt(RadiusAttempt *);
+	long long		getDeadline(RadiusAttempt *, RadiusConfig *);
+	static void		pollProbes(RadiusConfig *);
+	
+	friend class RadiusBatch;
+	friend class RadiusPacketBench;
 	
 public:
 					RadiusPacket(void);
@@ -94,7 +129,7 @@ public:
 	void			dumpShapedRadiusPacket(void);
 	
 	int				radiusSend(list<RadiusServer>::iterator);
-	int				radiusReceive(list<RadiusServer> *);
+	int				radiusReceive(list<RadiusServer> *, RadiusConfig *config=NULL);
 	
 	int				getRadiusAttribNumber(void);
 	char *			getAuthenticator(void);
@@ -105,6 +140,13 @@ public:
 	
 	pair<multimap<Octet,RadiusAttribute>::iterator,multimap<Octet,RadiusAttribute>::iterator> findAttributes(int type);
 	
+	uint32_t		getTraceId(void);
+	void			setTraceId(uint32_t);
+	
+	int				getAttributesLength(void);
+	int				serializeAttributes(Octet *, int);
+	int				loadAttributes(Octet *, int);
+	
 };
 
 
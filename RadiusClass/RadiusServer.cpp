@@ -20,7 +20,15 @@
  */
  
 #include "RadiusServer.h"
+#include "RadiusPacket.h"
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <pthread.h>
+
+/** The lock of the response times, the outstanding requests and the circuit breakers,
+ * the servers are shared by the threads of the radius daemon.*/
+static pthread_mutex_t serverlock=PTHREAD_MUTEX_INITIALIZER;
 
 
 /** The constructer of the class.
@@ -29,7 +37,7 @@
 	 * @param int authport : The UDP port for authentication, the default is 1812.
 	 * @param int acctport : The UDP port for accounting, the default is 1813.
 	 * @param int retry : How many times the client should try to send a packet if he doesn't get an answer.
-	 * @param int wait : The time (in seconds) to wait on a response of the radius server.
+	 * @param int wait : The time (in milliseconds) to wait on a response of the radius server.
 	 */
 RadiusServer::RadiusServer(string name, string secret,
 	int authport,  int acctport, int retry, int wait)
@@ -40,16 +48,28 @@ RadiusServer::RadiusServer(string name, string secret,
 	this->retry=retry;
 	this->wait=wait;
 	this->sharedsecret=secret;
-	
+	this->rttcount=0;
+	memset(this->rttsamples,0,sizeof(this->rttsamples));
+	this->srtt=0;
+	this->rttvar=0;
+	this->rtthistogram=NULL;
+	this->timeouts=0;
+	this->totaltimeouts=0;
+	this->state=SERVER_CLOSED;
+	this->openuntil=0;
+	this->weight=1;
+	this->currentweight=0;
+	this->outstanding=0;
+	this->inflight=NULL;
 	
 }
 
 /** The destructur of the class.
- * It does nothing.
+ * The probes to the server which are still waiting are closed.
  */
 RadiusServer::~RadiusServer()
 {
-	
+	dropProbes(this);
 }
 
 /** The allocation operator.
@@ -63,6 +83,19 @@ RadiusServer &RadiusServer::operator=(const RadiusServer &s)
 	this->acctport=s.acctport;
 	this->authport=s.authport;
 	this->sharedsecret=s.sharedsecret;
+	this->rttcount=s.rttcount;
+	memcpy(this->rttsamples,s.rttsamples,sizeof(this->rttsamples));
+	this->srtt=s.srtt;
+	this->rttvar=s.rttvar;
+	this->rtthistogram=s.rtthistogram;
+	this->timeouts=s.timeouts;
+	this->totaltimeouts=s.totaltimeouts;
+	this->state=s.state;
+	this->openuntil=s.openuntil;
+	this->weight=s.weight;
+	this->currentweight=s.currentweight;
+	this->outstanding=s.outstanding;
+	this->inflight=s.inflight;
 	return (*this);
 }
 
@@ -70,7 +103,7 @@ RadiusServer &RadiusServer::operator=(const RadiusServer &s)
  * There is no correctness checking.
  *@param port The number of the UDP port.
  */
-void RadiusServer::setAuthPort(short int port)
+void RadiusServer::setAuthPort(unsigned short port)
 {
 	this->authport=port;
 }
@@ -88,7 +121,7 @@ int RadiusServer::getAuthPort()
  * There is no correctness checking.
  * @param port The number of the UDP port.
  */
-void RadiusServer::setAcctPort(short int port)
+void RadiusServer::setAcctPort(unsigned short port)
 {
 	this->acctport=port;
 }
@@ -163,7 +196,7 @@ string RadiusServer::getSharedSecret(void)
 
 
 /** The getter method for the private member wait*
- * @return A interger of the time to wait for a resopnse.
+ * @return A interger of the time in milliseconds to wait for a resopnse.
  */
 int RadiusServer::getWait(void)
 {
@@ -172,7 +205,7 @@ int RadiusServer::getWait(void)
 
 
 /** The setter method for the private member wait
- * @param w The seconds to wait for response of the server. If w is less or equal 0 it is set to 1.
+ * @param w The milliseconds to wait for response of the server. If w is less or equal 0 it is set to 1000.
  */
 void RadiusServer::setWait(int w)
 {
@@ -182,8 +215,289 @@ void RadiusServer::setWait(int w)
 	}
 	else
 	{
-		this->wait=1;
+		this->wait=1000;
+	}
+}
+
+/** The method records the response time of a request to the server.
+ * Only the last RADIUS_RTT_SAMPLES response times are kept.
+ * @param usec The time between sending the request and receiving the response in microseconds.
+ */
+void RadiusServer::addRttSample(long usec)
+{
+	pthread_mutex_lock(&serverlock);
+	this->rttsamples[this->rttcount%RADIUS_RTT_SAMPLES]=usec;
+	this->rttcount++;
+	if (this->rtthistogram!=NULL)
+	{
+		this->rtthistogram->record(usec);
+	}
+	
+	//smoothed response time and variation like the TCP retransmission timer (RFC 6298)
+	if (this->srtt==0)
+	{
+		this->srtt=usec;
+		this->rttvar=usec/2;
+	}
+	else
+	{
+		this->rttvar=(3*this->rttvar+labs(this->srtt-usec))/4;
+		this->srtt=(7*this->srtt+usec)/8;
+	}
+	pthread_mutex_unlock(&serverlock);
+}
+
+/** The setter method for the histogram of the response times. The histogram
+ * keeps all response times and may be shared between processes.
+ * @param h A pointer to the histogram or NULL.
+ */
+void RadiusServer::setRttHistogram(RadiusHistogram * h)
+{
+	this->rtthistogram=h;
+}
+
+/** The getter method for the histogram of the response times.
+ * @return A pointer to the histogram or NULL.
+ */
+RadiusHistogram * RadiusServer::getRttHistogram(void)
+{
+	return this->rtthistogram;
+}
+
+/** The method calculates a percentile of the recorded response times.
+ * @param percent The percentile, e.g. 95.
+ * @return The response time in microseconds or 0 if no response time was recorded.
+ */
+long RadiusServer::getRttPercentile(int percent)
+{
+	long	sorted[RADIUS_RTT_SAMPLES];
+	int		n, i;
+	
+	pthread_mutex_lock(&serverlock);
+	n=min(this->rttcount,RADIUS_RTT_SAMPLES);
+	memcpy(sorted,this->rttsamples,n*sizeof(long));
+	pthread_mutex_unlock(&serverlock);
+	if (n==0)
+	{
+		return 0;
+	}
+	sort(sorted,sorted+n);
+	i=(n*percent+99)/100-1;
+	if (i<0)
+	{
+		i=0;
+	}
+	return sorted[i];
+}
+
+/** The getter method for the smoothed response time.
+ * @return The response time in microseconds, 0 if no response time was recorded.
+ */
+long RadiusServer::getSrtt(void)
+{
+	return this->srtt;
+}
+
+/** The getter method for the smoothed variation of the response time.
+ * @return The variation in microseconds.
+ */
+long RadiusServer::getRttVar(void)
+{
+	return this->rttvar;
+}
+
+/** The method calculates how long to wait for a response of the server
+ * from the observed response times (srtt+4*rttvar). The time is never
+ * shorter than minwait and never longer than wait.
+ * @param minwait The minimal time in microseconds.
+ * @return The time in microseconds, wait if no response time was recorded.
+ */
+long RadiusServer::getTimeout(long minwait)
+{
+	long timeout, srtt;
+	
+	pthread_mutex_lock(&serverlock);
+	srtt=this->srtt;
+	timeout=this->srtt+4*this->rttvar;
+	pthread_mutex_unlock(&serverlock);
+	if (srtt==0 || timeout>this->wait*1000L)
+	{
+		return this->wait*1000L;
+	}
+	if (timeout<minwait)
+	{
+		return minwait;
+	}
+	return timeout;
+}
+
+/** The getter method for the number of requests in a row without a response.
+ * @return The number of timeouts.
+ */
+int RadiusServer::getTimeouts(void)
+{
+	return this->timeouts;
+}
+
+/** The getter method for the number of all requests without a response.
+ * @return The number of timeouts.
+ */
+int RadiusServer::getTotalTimeouts(void)
+{
+	return this->totaltimeouts;
+}
+
+/** The getter method for the state of the circuit breaker.
+ * @return SERVER_CLOSED, SERVER_OPEN or SERVER_HALFOPEN.
+ */
+int RadiusServer::getState(void)
+{
+	return this->state;
+}
+
+/** The getter method for the weight of the server.
+ * @return The weight.
+ */
+int RadiusServer::getWeight(void)
+{
+	return this->weight;
+}
+
+/** The setter method for the weight of the server.
+ * If the weight is not greater than 0, it is set to 1.
+ * @param w The weight.
+ */
+void RadiusServer::setWeight(int w)
+{
+	if (w>0)
+	{
+		this->weight=w;
+	}
+	else
+	{
+		this->weight=1;
+	}
+}
+
+/** The getter method for the current weight of the weighted round robin.
+ * @return The current weight.
+ */
+int RadiusServer::getCurrentWeight(void)
+{
+	return this->currentweight;
+}
+
+/** The setter method for the current weight of the weighted round robin.
+ * @param w The current weight.
+ */
+void RadiusServer::setCurrentWeight(int w)
+{
+	this->currentweight=w;
+}
+
+/** The getter method for the number of requests which wait for a response.
+ * @return The number of requests.
+ */
+int RadiusServer::getOutstanding(void)
+{
+	return this->outstanding;
+}
+
+/** The method is called if a request is sent to the server.
+ */
+void RadiusServer::incOutstanding(void)
+{
+	__sync_fetch_and_add(&this->outstanding,1);
+	if (this->inflight!=NULL)
+	{
+		__sync_fetch_and_add(this->inflight,1);
+	}
+}
+
+/** The method is called if a request to the server is answered or given up.
+ */
+void RadiusServer::decOutstanding(void)
+{
+	int n=this->outstanding;
+	
+	//don't go below 0, another thread may decrement at the same time
+	while (n>0)
+	{
+		if (__sync_bool_compare_and_swap(&this->outstanding,n,n-1))
+		{
+			if (this->inflight!=NULL)
+			{
+				__sync_fetch_and_sub(this->inflight,1);
+			}
+			return;
+		}
+		n=this->outstanding;
+	}
+}
+
+/** The setter method for the shared counter of the requests which wait for a response.
+ * The counter is changed with the outstanding requests of this process, so it counts
+ * the requests of all processes which share it.
+ * @param counter A pointer to the counter or NULL.
+ */
+void RadiusServer::setInflightCounter(volatile int * counter)
+{
+	this->inflight=counter;
+}
+
+/** The method checks if requests can be sent to the server.
+ * @return True if the circuit breaker is closed.
+ */
+bool RadiusServer::isAvailable(void)
+{
+	return (this->state==SERVER_CLOSED);
+}
+
+/** The method checks if the server should be probed, this
+ * is the case if the circuit breaker is open and the open time is over.
+ * @param now The current time (monotonic, in microseconds).
+ * @return True if a probe should be sent.
+ */
+bool RadiusServer::isProbeDue(long long now)
+{
+	return (this->state==SERVER_OPEN && now>=this->openuntil);
+}
+
+/** The method sets the circuit breaker to half-open, while a probe is sent
+ * no other probe is started.
+ */
+void RadiusServer::startProbe(void)
+{
+	this->state=SERVER_HALFOPEN;
+}
+
+/** The method records a response of the server, the circuit breaker is closed.
+ */
+void RadiusServer::recordSuccess(void)
+{
+	pthread_mutex_lock(&serverlock);
+	this->timeouts=0;
+	this->state=SERVER_CLOSED;
+	pthread_mutex_unlock(&serverlock);
+}
+
+/** The method records a request without a response. The circuit breaker is opened
+ * if threshold requests in a row weren't answered or a probe wasn't answered.
+ * @param now The current time (monotonic, in microseconds).
+ * @param threshold The number of timeouts in a row, 0 disables the circuit breaker.
+ * @param opentime The time in seconds until the server is probed.
+ */
+void RadiusServer::recordTimeout(long long now, int threshold, int opentime)
+{
+	pthread_mutex_lock(&serverlock);
+	this->timeouts++;
+	this->totaltimeouts++;
+	if (threshold>0 && (this->timeouts>=threshold || this->state==SERVER_HALFOPEN))
+	{
+		this->state=SERVER_OPEN;
+		this->openuntil=now+opentime*1000000LL;
 	}
+	pthread_mutex_unlock(&serverlock);
 }
 
 ostream& operator << (ostream& os, RadiusServer& server)
@@ -193,7 +507,8 @@ ostream& operator << (ostream& os, RadiusServer& server)
      os << "\nAuthentication-Port: " << server.authport;
      os << "\nAccounting-Port: " << server.acctport;
      os << "\nRetries: " << server.retry;
-     os << "\nWait: " << server.wait;
+     os << "\nWait: " << server.wait << "ms";
+     os << "\nWeight: " << server.weight;
      os << "\nSharedSecret: *******";
  	return os;
  	
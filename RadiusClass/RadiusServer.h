@@ -23,24 +23,47 @@
 #define _RADIUSSERVER_H_
 #include <string>
 #include <iostream>
+#include "RadiusHistogram.h"
 
 using namespace std;
+
+/** The number of response times which are kept for a server.*/
+#define RADIUS_RTT_SAMPLES 32
+
+/** The states of the circuit breaker of a server.*/
+#define SERVER_CLOSED	0	/**< The server answers, it is used.*/
+#define SERVER_OPEN		1	/**< The server doesn't answer, it is skipped.*/
+#define SERVER_HALFOPEN	2	/**< A probe is sent to the server.*/
+
 /** This class represents a radius server.*/
 
 class RadiusServer
 {
 private:
-	short int authport; 		/**< The UDP port for authentication packets.*/
-	short int acctport; 		/**< The UDP port for accounting packets.*/
+	unsigned short authport;		/**< The UDP port for authentication packets.*/
+	unsigned short acctport;		/**< The UDP port for accounting packets.*/
 	string name;				/**< The name or the ip address of the server.*/
 	int 	retry; 				/**< The number of retries how many times a radius ticket is send to the server, if it doesn#t answer.*/
 	string sharedsecret;		/**< The sharedsecret, the maximum space is 16 chars.*/
-	int 	wait;				/**< The time to wait for a response of the server.*/
+	int 	wait;				/**< The time in milliseconds to wait for a response of the server.*/
+	long	rttsamples[RADIUS_RTT_SAMPLES]; /**< The last response times of the server in microseconds.*/
+	int		rttcount;			/**< The number of response times which were recorded.*/
+	long	srtt;				/**< The smoothed response time in microseconds, 0 if there is no sample.*/
+	long	rttvar;				/**< The smoothed variation of the response time in microseconds.*/
+	RadiusHistogram * rtthistogram; /**< The shared histogram of all response times, NULL if there is none.*/
+	int		timeouts;			/**< The number of requests in a row without a response.*/
+	int		totaltimeouts;		/**< The number of requests without a response.*/
+	int		state;				/**< The state of the circuit breaker.*/
+	long long	openuntil;		/**< The time (monotonic, in microseconds) when the server is probed again.*/
+	int		weight;				/**< The weight of the server for load balancing.*/
+	int		currentweight;		/**< The current weight for the weighted round robin.*/
+	int		outstanding;		/**< The number of requests which wait for a response of the server.*/
+	volatile int * inflight;	/**< The shared number of requests of all processes which wait for a response, NULL if there is none.*/
 
 public:
 	
 	
-	RadiusServer(string name="127.0.0.1",string secret = "", int authport=1812, int acctport=1813, int retry=3, int wait=1);
+	RadiusServer(string name="127.0.0.1",string secret = "", int authport=1812, int acctport=1813, int retry=3, int wait=1000);
 	~RadiusServer();
 	RadiusServer &operator=(const RadiusServer &);
 	
@@ -54,14 +77,45 @@ public:
 	string getSharedSecret(void);
 	
 	int getAuthPort();
-	void setAuthPort(short int);
+	void setAuthPort(unsigned short);
 	
 	int getAcctPort();
-	void setAcctPort(short int);
+	void setAcctPort(unsigned short);
 	
 	string getName();
 	void setName(string);
 	
+	void addRttSample(long);
+	long getRttPercentile(int);
+	
+	void setRttHistogram(RadiusHistogram *);
+	RadiusHistogram * getRttHistogram(void);
+	
+	long getSrtt(void);
+	long getRttVar(void);
+	long getTimeout(long);
+	
+	int getTimeouts(void);
+	int getTotalTimeouts(void);
+	int getState(void);
+	
+	int getWeight(void);
+	void setWeight(int);
+	
+	int getCurrentWeight(void);
+	void setCurrentWeight(int);
+	
+	int getOutstanding(void);
+	void incOutstanding(void);
+	void decOutstanding(void);
+	void setInflightCounter(volatile int *);
+	
+	bool isAvailable(void);
+	bool isProbeDue(long long);
+	void startProbe(void);
+	void recordSuccess(void);
+	void recordTimeout(long long, int, int);
+	
 	friend ostream& operator << (ostream& os, RadiusServer& server);
 };
 
@@ -0,0 +1,323 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RadiusTrace.h"
+#include "RadiusPacket.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/** The trace of the process.*/
+static RadiusTrace radiustrace;
+
+/** The last request id.*/
+static volatile uint32_t lastid=0;
+
+/** The number of the thread in the trace, 0 if it isn't known yet.*/
+static __thread int tracetid=0;
+
+/** Returns the number of the calling thread, on Linux it is the thread id of the kernel.
+ * @return The number.
+ */
+static int getTraceTid(void)
+{
+	if (tracetid==0)
+	{
+#ifdef __linux__
+		tracetid=(int)syscall(SYS_gettid);
+#else
+		static volatile int lasttid=0;
+		tracetid=__sync_add_and_fetch(&lasttid, 1);
+#endif
+	}
+	return tracetid;
+}
+
+/** The constructor, tracing is off.*/
+RadiusTrace::RadiusTrace(void)
+{
+	this->fd=-1;
+	this->users=0;
+	this->active=NULL;
+	this->spare=NULL;
+	this->used=0;
+	this->dropped=0;
+	pthread_mutex_init(&this->mutex, NULL);
+	pthread_mutex_init(&this->writing, NULL);
+}
+
+/** The destructor.*/
+RadiusTrace::~RadiusTrace(void)
+{
+	delete [] this->active;
+	delete [] this->spare;
+	pthread_mutex_destroy(&this->writing);
+	pthread_mutex_destroy(&this->mutex);
+}
+
+/** The method creates the trace file and starts the JSON array.
+ * A second call only counts the users.
+ * @param p The path of the file.
+ * @return 0 or -1 if the file can't be created.
+ */
+int RadiusTrace::open(string p)
+{
+	if (this->users>0)
+	{
+		this->users++;
+		return 0;
+	}
+	this->fd=::open(p.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0600);
+	if (this->fd<0)
+	{
+		return -1;
+	}
+	fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+	this->path=p;
+	this->users=1;
+	this->used=0;
+	this->dropped=0;
+	this->active=new RadiusTraceEvent[TRACE_EVENTS];
+	this->spare=new RadiusTraceEvent[TRACE_EVENTS];
+	this->writeString("[\n");
+	return 0;
+}
+
+/** The method opens the trace file again in a forked process, whose descriptors were closed.
+ * The spans which were inherited from the parent are discarded, the parent writes them.
+ * @return 0 or -1 if the file can't be opened.
+ */
+int RadiusTrace::reopen(void)
+{
+	if (this->users==0)
+	{
+		return 0;
+	}
+	::close(this->fd);
+	this->used=0;
+	this->dropped=0;
+	tracetid=0;
+	this->fd=::open(this->path.c_str(), O_WRONLY|O_APPEND);
+	if (this->fd<0)
+	{
+		this->users=0;
+		return -1;
+	}
+	fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+	return 0;
+}
+
+/** The method writes the buffered spans and the name of the process and closes the file,
+ * if the last user closes the trace.
+ * @param name The name of the process.
+ * @param last True if the process is the last one which writes to the file, the JSON array is closed.
+ */
+void RadiusTrace::close(const char * name, bool last)
+{
+	char	buf[256];
+
+	if (this->users==0 || --this->users>0)
+	{
+		return;
+	}
+	this->flush();
+	snprintf(buf, sizeof(buf), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"%s\",\"dropped\":%llu}}%s",
+			(int)getpid(), name, (unsigned long long)this->dropped, last ? "\n]\n" : ",\n");
+	this->writeString(buf);
+	::close(this->fd);
+	this->fd=-1;
+}
+
+/** The method checks if tracing is on.
+ * @return True if the spans are written to a file.
+ */
+bool RadiusTrace::isOpen(void)
+{
+	return this->fd>=0;
+}
+
+/** The method records a span.
+ * @param name The name of the span, it must be a constant string.
+ * @param id The request id.
+ * @param start The start (monotonic, in microseconds).
+ * @param end The end (monotonic, in microseconds).
+ */
+void RadiusTrace::record(const char * name, uint32_t id, long long start, long long end)
+{
+	RadiusTraceEvent	*event, *tmp;
+	int					n;
+
+	pthread_mutex_lock(&this->mutex);
+	if (this->used<TRACE_EVENTS)
+	{
+		event=&this->active[this->used++];
+		event->name=name;
+		event->id=id;
+		event->tid=getTraceTid();
+		event->start=start;
+		event->duration=end-start;
+	}
+	else
+	{
+		this->dropped++;
+	}
+
+	//write the buffer if it is full or the first span waits too long, unless it is written already
+	if ((this->used==TRACE_EVENTS || end-(this->active[0].start+this->active[0].duration)>=TRACE_FLUSH) &&
+		pthread_mutex_trylock(&this->writing)==0)
+	{
+		tmp=this->active;
+		this->active=this->spare;
+		this->spare=tmp;
+		n=this->used;
+		this->used=0;
+		pthread_mutex_unlock(&this->mutex);
+		this->write(this->spare, n);
+		pthread_mutex_unlock(&this->writing);
+		return;
+	}
+	pthread_mutex_unlock(&this->mutex);
+}
+
+/** The method writes all buffered spans.*/
+void RadiusTrace::flush(void)
+{
+	RadiusTraceEvent	*tmp;
+	int					n;
+
+	pthread_mutex_lock(&this->writing);
+	pthread_mutex_lock(&this->mutex);
+	tmp=this->active;
+	this->active=this->spare;
+	this->spare=tmp;
+	n=this->used;
+	this->used=0;
+	pthread_mutex_unlock(&this->mutex);
+	this->write(this->spare, n);
+	pthread_mutex_unlock(&this->writing);
+}
+
+/** The method formats spans as complete events ("ph":"X") and appends them to the file.
+ * @param events The spans.
+ * @param n The number of spans.
+ */
+void RadiusTrace::write(RadiusTraceEvent * events, int n)
+{
+	string		out;
+	char		buf[256];
+	int			i, pid=getpid();
+
+	if (n==0)
+	{
+		return;
+	}
+	out.reserve(n*160);
+	for (i=0; i<n; i++)
+	{
+		snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"cat\":\"radiusplugin\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"request\":%u}},\n",
+				events[i].name, events[i].start, events[i].duration, pid, events[i].tid, events[i].id);
+		out+=buf;
+	}
+	this->writeString(out);
+}
+
+/** The method appends a string to the file with one write, so the lines of the processes aren't mixed.
+ * @param s The string.
+ */
+void RadiusTrace::writeString(string s)
+{
+	const char	*buf=s.data();
+	size_t		len=s.size();
+	ssize_t		n;
+
+	while (len>0)
+	{
+		n=::write(this->fd, buf, len);
+		if (n<0)
+		{
+			if (errno==EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+		buf+=n;
+		len-=n;
+	}
+}
+
+/** The function creates the trace file of the plugin, see RadiusTrace::open.
+ * @param path The path of the file.
+ * @return 0 or -1 if the file can't be created.
+ */
+int openTrace(string path)
+{
+	return radiustrace.open(path);
+}
+
+/** The function opens the trace file in a forked process, see RadiusTrace::reopen.
+ * @return 0 or -1 if the file can't be opened.
+ */
+int reopenTrace(void)
+{
+	return radiustrace.reopen();
+}
+
+/** The function writes the buffered spans and closes the trace, see RadiusTrace::close.
+ * @param name The name of the process.
+ * @param last True if the process is the last one which writes to the file.
+ */
+void closeTrace(const char * name, bool last)
+{
+	radiustrace.close(name, last);
+}
+
+/** The function returns a new request id. The ids are created in the foreground process.
+ * @return The id, it is never 0.
+ */
+uint32_t newTraceId(void)
+{
+	uint32_t	id;
+
+	do
+	{
+		id=__sync_add_and_fetch(&lastid, 1);
+	}
+	while (id==0);
+	return id;
+}
+
+/** The function records a span which ends now, if tracing is on.
+ * @param name The name of the span, it must be a constant string.
+ * @param id The request id, 0 if the span belongs to no request.
+ * @param start The start (monotonic, in microseconds).
+ */
+void traceSpan(const char * name, uint32_t id, long long start)
+{
+	if (radiustrace.isOpen())
+	{
+		radiustrace.record(name, id, start, monotonicTime());
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RADIUSTRACE_H_
+#define _RADIUSTRACE_H_
+
+#include <string>
+#include <stdint.h>
+#include <pthread.h>
+
+using namespace std;
+
+#define TRACE_EVENTS	4096	/**< The number of events in each of the two buffers of a process.*/
+#define TRACE_FLUSH		1000000	/**< The time in microseconds after which the buffered events are written.*/
+
+/** A span of a request in a thread.*/
+struct RadiusTraceEvent
+{
+	const char *	name;		/**<The name of the span, it must be a constant string.*/
+	uint32_t		id;			/**<The request id, 0 if the span belongs to no request.*/
+	int				tid;		/**<The thread.*/
+	long long		start;		/**<The start (monotonic, in microseconds).*/
+	long long		duration;	/**<The duration in microseconds.*/
+};
+
+/** The class collects the spans of a process and appends them to a trace file in the
+ * Chrome trace event format (JSON array), which is read by chrome://tracing and Perfetto.
+ * All processes append to the same file, the timestamps are taken from the monotonic
+ * clock, so the spans of a request line up across the processes.
+ * A span is copied to the active buffer under a mutex. A full buffer, or a buffer with
+ * events older than TRACE_FLUSH, is swapped with the spare buffer and written by the
+ * thread which recorded the last span, outside of the mutex. If the spare buffer is still
+ * being written the span is dropped, a thread never waits for the file.
+ */
+class RadiusTrace
+{
+private:
+	string				path;			/**<The path of the trace file.*/
+	int					fd;				/**<The trace file, -1 if tracing is off.*/
+	int					users;			/**<The number of plugin instances which use the trace.*/
+	pthread_mutex_t		mutex;			/**<The mutex for the active buffer.*/
+	pthread_mutex_t		writing;		/**<The mutex which is held while the spare buffer is written.*/
+	RadiusTraceEvent	*active;		/**<The buffer for new spans.*/
+	RadiusTraceEvent	*spare;			/**<The buffer which is written to the file.*/
+	int					used;			/**<The number of spans in the active buffer.*/
+	uint64_t			dropped;		/**<The number of dropped spans.*/
+
+	void		write(RadiusTraceEvent *, int);
+	void		writeString(string);
+
+public:
+				RadiusTrace(void);
+				~RadiusTrace(void);
+
+	int			open(string);
+	int			reopen(void);
+	void		close(const char *, bool);
+	bool		isOpen(void);
+
+	void		record(const char *, uint32_t, long long, long long);
+	void		flush(void);
+};
+
+int			openTrace(string);
+int			reopenTrace(void);
+void		closeTrace(const char *, bool);
+uint32_t	newTraceId(void);
+void		traceSpan(const char *, uint32_t, long long);
+
+#endif //_RADIUSTRACE_H_
@@ -41,4 +41,6 @@
 #define UNSHAPE_ERROR -15
 #define NO_VALUE_IN_ATTRIBUTE -16
 #define WRONG_AUTHENTICATOR_IN_RECV_PACKET -17
+#define UNEXPECTED_RECV_PACKET -18
+#define BAD_INDEX -19
 #endif //_ERROR_H_
@@ -43,6 +43,7 @@ typedef	unsigned char	Octet;
 /** Some length definitions */
 #define	RADIUS_PACKET_AUTHENTICATOR_LEN	16
 #define	RADIUS_MAX_PACKET_LEN			4096
+#define	RADIUS_MAX_ATTRIBUTE_VALUE		253
 #define RADIUS_PACKET_IDENTIFIER_LEN	1
 #define MD5_DIGEST_LENGTH 16
 
@@ -0,0 +1,419 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "RadiusDaemon.h"
+#include "radiusplugin.h"
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+/** The constructor of the class, the daemon isn't open.*/
+RadiusDaemon::RadiusDaemon() {
+	this->listenfd = -1;
+	this->verbosity = 0;
+	pthread_mutex_init(&this->mutex, NULL);
+	pthread_cond_init(&this->finished, NULL);
+}
+
+/** The destructor closes the socket.*/
+RadiusDaemon::~RadiusDaemon() {
+	this->close();
+	pthread_cond_destroy(&this->finished);
+	pthread_mutex_destroy(&this->mutex);
+}
+
+/** The method reads the radius servers, maps the metrics and listens on the socket.
+ * @param configfile The config file with the radius servers, it has the format of the plugin config.
+ * @param p The path of the socket.
+ * @param tracefile The path of the trace file, an empty string is off.
+ * @param verb The verbosity of the daemon.
+ * @return 0 or -1 if the daemon could not be opened.
+ */
+int RadiusDaemon::open(string configfile, string p, string tracefile, int verb) {
+	struct sockaddr_un addr;
+	list<RadiusServer>::iterator server;
+	int fd, i;
+
+	this->verbosity = verb;
+	if (this->radiusconf.parseConfigFile(configfile.c_str()) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Bad config file or error in config.\n";
+		return -1;
+	}
+	if (p.size() >= sizeof(addr.sun_path)) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: The path of the socket is too long.\n";
+		return -1;
+	}
+	this->path = p;
+
+	// every radius server gets a histogram of the response times and a counter of the outstanding requests
+	if (this->metrics.open() != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: metrics could not be mapped\n";
+	} else {
+		for (server = this->radiusconf.getRadiusServer()->begin(), i = 0; server != this->radiusconf.getRadiusServer()->end(); server++, i++) {
+			server->setRttHistogram(this->metrics.getServerHistogram(i));
+			server->setInflightCounter(this->metrics.getInflightCounter(i));
+		}
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, this->path.c_str(), sizeof(addr.sun_path) - 1);
+
+	// the message boundaries are kept like on the socket pairs of the background processes
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: socket call failed: " << strerror(errno) << "\n";
+		return -1;
+	}
+	unlink(this->path.c_str());
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || chmod(this->path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, DAEMON_BACKLOG) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Socket " << this->path << " could not be opened: " << strerror(errno) << "\n";
+		::close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	this->listenfd = fd;
+
+	// the spans of all connections are written to the trace file of the daemon
+	if (tracefile.size() > 0 && openTrace(tracefile) != 0)
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: trace file " << tracefile << " could not be created\n";
+
+	cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Listening on " << this->path << ".\n";
+	return 0;
+}
+
+/** The method accepts the connections of the plugins until stop is set by a signal,
+ * every connection is served by its own thread. Then the connections are stopped,
+ * see stopConnections().
+ * @param stop The flag which is set by the signal handler.
+ * @return The number of threads which didn't finish until the deadline.
+ */
+int RadiusDaemon::run(volatile sig_atomic_t * stop) {
+	RadiusDaemonConnection * connection;
+	int fd;
+
+	while (*stop == 0) {
+		// a signal interrupts the call
+		fd = accept(this->listenfd, NULL, NULL);
+		if (fd < 0) {
+			if (errno != EINTR) {
+				cerr << getTime() << "RADIUS-PLUGIN: DAEMON: accept failed: " << strerror(errno) << "\n";
+				usleep(100000);
+			}
+			continue;
+		}
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		// the plugin chooses the config file, which names the scripts the daemon runs as root
+		if (this->checkPeer(fd) == false) {
+			cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Connection of a process of another user was refused.\n";
+			::close(fd);
+			continue;
+		}
+
+		connection = new RadiusDaemonConnection;
+		connection->daemon = this;
+		connection->fd = fd;
+		connection->deadline = -1;
+		connection->done = false;
+		pthread_mutex_lock(&this->mutex);
+		if (pthread_create(&connection->thread, NULL, &RadiusDaemon::serve, (void *) connection) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Thread creation failed.\n";
+			::close(fd);
+			delete connection;
+		} else {
+			this->connections.push_back(connection);
+		}
+		pthread_mutex_unlock(&this->mutex);
+
+		// join the threads of the closed connections
+		this->reap();
+	}
+	return this->stopConnections();
+}
+
+/** The method joins the threads which finished and frees their connections.*/
+void RadiusDaemon::reap(void) {
+	list<RadiusDaemonConnection *>::iterator connection;
+
+	pthread_mutex_lock(&this->mutex);
+	connection = this->connections.begin();
+	while (connection != this->connections.end()) {
+		if ((*connection)->done) {
+			pthread_join((*connection)->thread, NULL);
+			delete *connection;
+			connection = this->connections.erase(connection);
+		} else {
+			connection++;
+		}
+	}
+	pthread_mutex_unlock(&this->mutex);
+}
+
+/** The method stops the connections at the exit of the daemon. Their sockets are shut down,
+ * so the event loops end like on a connection which the plugin closed and the accounting
+ * sends the stop packets of the users of the instance, checkpoints the journal and closes
+ * the spool. The threads are joined, the method waits for them until the longest shutdowndeadline
+ * of the instances and SHUTDOWN_GRACE seconds passed, without a deadline if an instance has none.
+ * @return The number of threads which are still running.
+ */
+int RadiusDaemon::stopConnections(void) {
+	list<RadiusDaemonConnection *>::iterator connection;
+	struct timeval now;
+	struct timespec ts;
+	int deadline = 0, running;
+	bool unlimited = false;
+
+	pthread_mutex_lock(&this->mutex);
+	for (connection = this->connections.begin(); connection != this->connections.end(); connection++) {
+		if ((*connection)->fd >= 0)
+			shutdown((*connection)->fd, SHUT_RDWR);
+		if ((*connection)->deadline == 0)
+			unlimited = true;
+		else if ((*connection)->deadline > deadline)
+			deadline = (*connection)->deadline;
+	}
+
+	gettimeofday(&now, NULL);
+	ts.tv_sec = now.tv_sec + deadline + SHUTDOWN_GRACE;
+	ts.tv_nsec = now.tv_usec * 1000;
+	while (true) {
+		running = 0;
+		for (connection = this->connections.begin(); connection != this->connections.end(); connection++) {
+			if ((*connection)->done == false)
+				running++;
+		}
+		if (running == 0)
+			break;
+		if (unlimited)
+			pthread_cond_wait(&this->finished, &this->mutex);
+		else if (pthread_cond_timedwait(&this->finished, &this->mutex, &ts) == ETIMEDOUT)
+			break;
+	}
+	pthread_mutex_unlock(&this->mutex);
+
+	this->reap();
+	return running;
+}
+
+/** The method closes the socket, removes the path and writes the buffered spans.*/
+void RadiusDaemon::close(void) {
+	if (this->listenfd >= 0) {
+		::close(this->listenfd);
+		unlink(this->path.c_str());
+		this->listenfd = -1;
+		closeTrace("radiusplugind", true);
+	}
+}
+
+/** The method checks the credentials of a connected process.
+ * @param fd The socket.
+ * @return True if the process runs as root or as the user of the daemon.
+ */
+bool RadiusDaemon::checkPeer(int fd) {
+	uid_t uid;
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return false;
+	uid = cred.uid;
+#else
+	gid_t gid;
+
+	if (getpeereid(fd, &uid, &gid) != 0)
+		return false;
+#endif
+	return uid == 0 || uid == geteuid();
+}
+
+/** The method is the thread of a connection. It serves the connection, see serveConnection(),
+ * closes the socket and marks the connection as done, so the main thread joins the thread.
+ * @param c The connection, it is freed by the main thread.
+ * @return NULL.
+ */
+void * RadiusDaemon::serve(void * c) {
+	RadiusDaemonConnection * connection = (RadiusDaemonConnection *) c;
+	RadiusDaemon * daemon = connection->daemon;
+	PluginContext * context = new PluginContext;
+
+	// the main thread handles the signals
+	sigset_t signal_mask;
+	sigemptyset(&signal_mask);
+	sigaddset(&signal_mask, SIGINT);
+	sigaddset(&signal_mask, SIGTERM);
+	sigaddset(&signal_mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+	daemon->serveConnection(connection, context);
+
+	// unmaps the session table, the socket is closed under the lock, the main thread shuts it down at the exit
+	context->authsocketforegr.setSocket(-1);
+	context->acctsocketforegr.setSocket(-1);
+	delete context;
+
+	pthread_mutex_lock(&daemon->mutex);
+	::close(connection->fd);
+	connection->fd = -1;
+	connection->done = true;
+	pthread_cond_signal(&daemon->finished);
+	pthread_mutex_unlock(&daemon->mutex);
+	return NULL;
+}
+
+/** The method serves a connection. It reads the hello of the plugin, creates the context
+ * of the connection and runs the event loop of the background process.
+ * The loop ends with COMMAND_EXIT or if the plugin closed the connection, the accounting
+ * stops the users of the instance before.
+ * @param connection The connection.
+ * @param context The context of the connection, the socket of the connection is set in it.
+ */
+void RadiusDaemon::serveConnection(RadiusDaemonConnection * connection, PluginContext * context) {
+	IpcSocket * sock = &context->authsocketforegr;
+	string configfile;
+	int channel = 0, fd = -1;
+
+	// the hello: the channel, the verbosity, the config file and the session table
+	sock->setSocket(connection->fd);
+	try {
+		channel = sock->recvInt();
+		if (channel == DAEMON_ACCT) {
+			context->acctsocketforegr.setSocket(sock->getSocket());
+			sock->setSocket(-1);
+			sock = &context->acctsocketforegr;
+		} else if (channel != DAEMON_AUTH) {
+			throw Exception("RADIUS-PLUGIN: DAEMON: Unknown channel.\n");
+		}
+		context->setVerbosity(sock->recvInt());
+		configfile = sock->recvStr();
+		fd = sock->recvFd();
+	} catch (Exception &e) {
+		cerr << getTime() << e;
+		return;
+	}
+
+	// the instance gets its own config, only the radius servers and the metrics are shared
+	if (context->sessions.map(fd) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Session table of " << configfile << " could not be mapped.\n";
+		::close(fd);
+		return;
+	}
+	if (context->radiusconf.parseConfigFile(configfile.c_str()) != 0 || context->conf.parseConfigFile(configfile.c_str()) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Bad config file " << configfile << ".\n";
+		return;
+	}
+	context->radiusconf.shareServers(&this->radiusconf);
+	context->metrics.attach(&this->metrics);
+	context->privhelper.configure(context->conf);
+
+	// the exit of the daemon waits for the stop packets of the instance until its deadline
+	pthread_mutex_lock(&this->mutex);
+	connection->deadline = context->conf.getShutdownDeadline();
+	pthread_mutex_unlock(&this->mutex);
+
+	// the thread is pinned like the background process of the instance
+	pin_worker(context, channel == DAEMON_ACCT);
+
+	if (DEBUG(this->verbosity))
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Start " << (channel == DAEMON_AUTH ? "authentication" : "accounting") << " for " << configfile << ".\n";
+
+	try {
+		if (channel == DAEMON_AUTH) {
+			AuthenticationProcess auth;
+			auth.Authentication(context);
+		} else {
+			AccountingProcess acct;
+			acct.Accounting(context);
+		}
+	} catch (Exception &e) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON:" << e;
+	} catch (...) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Unknown Exception!\n";
+	}
+
+	if (DEBUG(this->verbosity))
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Stop " << (channel == DAEMON_AUTH ? "authentication" : "accounting") << " for " << configfile << ".\n";
+}
+
+/** The flag is set by SIGTERM and SIGINT.*/
+static volatile sig_atomic_t stopdaemon = 0;
+
+/** The handler of SIGTERM and SIGINT.
+ * @param sig The signal.
+ */
+static void stop_daemon(int sig) {
+	stopdaemon = 1;
+}
+
+/** The radius daemon, usage: radiusplugind [-c configfile] [-s socket] [-t tracefile] [-v verbosity].
+ * It runs in the foreground, the log lines are written to stderr.
+ */
+int main(int argc, char * argv[]) {
+	RadiusDaemon daemon;
+	string configfile = "/etc/openvpn/radiusplugind.cnf";
+	string path = "/var/run/openvpn/radiusplugind.sock";
+	string tracefile;
+	struct sigaction action;
+	int verb = 0, opt;
+
+	while ((opt = getopt(argc, argv, "c:s:t:v:")) != -1) {
+		switch (opt) {
+			case 'c':
+				configfile = optarg;
+				break;
+			case 's':
+				path = optarg;
+				break;
+			case 't':
+				tracefile = optarg;
+				break;
+			case 'v':
+				verb = atoi(optarg);
+				break;
+			default:
+				cerr << "usage: " << argv[0] << " [-c configfile] [-s socket] [-t tracefile] [-v verbosity]\n";
+				return 1;
+		}
+	}
+
+	// accept() is interrupted by the signals, a write to a closed connection fails instead of killing the daemon
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stop_daemon;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGINT, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGHUP, SIG_IGN);
+
+	if (daemon.open(configfile, path, tracefile, verb) != 0)
+		return 1;
+
+	// the static objects must not be destroyed under threads which still run
+	if (daemon.run(&stopdaemon) > 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: DAEMON: Connections did not stop within the shutdown deadline, EXIT\n";
+		_exit(1);
+	}
+	daemon.close();
+	cerr << getTime() << "RADIUS-PLUGIN: DAEMON: EXIT\n";
+	return 0;
+}
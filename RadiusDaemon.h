@@ -0,0 +1,86 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _RADIUS_DAEMON_H_
+#define _RADIUS_DAEMON_H_
+
+#include <string>
+#include <list>
+#include <signal.h>
+#include <pthread.h>
+#include "RadiusClass/RadiusConfig.h"
+#include "Metrics.h"
+
+using namespace std;
+
+#define DAEMON_BACKLOG	64 /**< The number of connections which wait to be accepted.*/
+
+class RadiusDaemon;
+class PluginContext;
+
+/** A connection of an OpenVPN instance to the daemon, the fields are guarded by the mutex of the daemon.*/
+struct RadiusDaemonConnection {
+	RadiusDaemon * daemon; /**< The daemon.*/
+	int fd; /**< The accepted socket, -1 after the thread closed it.*/
+	pthread_t thread; /**< The thread which serves the connection.*/
+	int deadline; /**< The shutdowndeadline of the instance, -1 until the config is read.*/
+	bool done; /**< True if the thread finished and can be joined.*/
+};
+
+/** The class implements the radius daemon (radiusplugind), which serves the plugins of all
+ * OpenVPN instances on a host instead of their background processes. A plugin connects to the
+ * UNIX socket once for the authentication and once for the accounting, sends the channel,
+ * the verbosity, its config file and the descriptor of its session table and then the same
+ * commands as to a background process. Every connection is served by a thread which runs the
+ * event loop of AuthenticationProcess or AccountingProcess with its own context, like a background
+ * process of the instance. The radius servers are taken from the config of the daemon and shared by all
+ * connections, so the response times, the circuit breakers and the load balancing of a server
+ * cover the requests of all instances, and the metrics are shared too.
+ * Only processes of root or of the user of the daemon are accepted, they choose the config file.
+ */
+class RadiusDaemon {
+private:
+	RadiusConfig radiusconf; /**< The radius servers of all connections.*/
+	Metrics metrics; /**< The metrics of all connections.*/
+	int listenfd; /**< The listening socket, -1 if the daemon isn't open.*/
+	string path; /**< The path of the socket.*/
+	int verbosity; /**< The verbosity of the daemon.*/
+	list<RadiusDaemonConnection *> connections; /**< The connections, they are freed when their thread is joined.*/
+	pthread_mutex_t mutex; /**< The mutex of the connections.*/
+	pthread_cond_t finished; /**< Signaled when a thread finished.*/
+
+	bool checkPeer(int);
+	void serveConnection(RadiusDaemonConnection *, PluginContext *);
+	void reap(void);
+	int stopConnections(void);
+	static void * serve(void *);
+
+public:
+	RadiusDaemon();
+	~RadiusDaemon();
+
+	int open(string, string, string, int);
+	int run(volatile sig_atomic_t *);
+	void close(void);
+};
+
+#endif //_RADIUS_DAEMON_H_
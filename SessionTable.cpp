@@ -0,0 +1,373 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SessionTable.h"
+#include "CpuAffinity.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sched.h>
+#include <vector>
+
+/** The constructor of the class, the table isn't mapped.*/
+SessionTable::SessionTable() {
+	this->slots = NULL;
+	this->size = 0;
+	this->hint = 0;
+	this->owner = false;
+	this->fd = -1;
+}
+
+/** The destructor unmaps the table.*/
+SessionTable::~SessionTable() {
+	this->close();
+}
+
+/** The method maps the table, it must be called before the processes are forked.
+ * The pages are only allocated when a slot is used the first time.
+ * @param n The number of slots.
+ * @return 0 or -1 if the table could not be mapped.
+ */
+int SessionTable::open(int n) {
+	void * p;
+
+	p = mmap(NULL, (size_t) n * sizeof(SessionSlot), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	this->slots = (SessionSlot *) p;
+	this->size = n;
+	this->owner = true;
+	return 0;
+}
+
+/** The method maps the table in a shared memory object, which is passed to the radius daemon
+ * over its socket. The name of the object is removed at once, only the descriptor refers to it.
+ * @param n The number of slots.
+ * @return 0 or -1 if the table could not be mapped.
+ */
+int SessionTable::openShared(int n) {
+	static int last = 0;
+	char name[64];
+	void * p;
+
+	snprintf(name, sizeof(name), "/radiusplugin-%d-%d", (int) getpid(), __sync_add_and_fetch(&last, 1));
+	this->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (this->fd < 0) {
+		return -1;
+	}
+	shm_unlink(name);
+	fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+	if (ftruncate(this->fd, (off_t) n * sizeof(SessionSlot)) != 0) {
+		::close(this->fd);
+		this->fd = -1;
+		return -1;
+	}
+	p = mmap(NULL, (size_t) n * sizeof(SessionSlot), PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (p == MAP_FAILED) {
+		::close(this->fd);
+		this->fd = -1;
+		return -1;
+	}
+	this->slots = (SessionSlot *) p;
+	this->size = n;
+	this->owner = true;
+	return 0;
+}
+
+/** The method maps a table which was created by openShared() in another process,
+ * the number of slots is taken from the size of the object.
+ * @param f The descriptor of the shared memory object, it is closed by close().
+ * @return 0 or -1 if the table could not be mapped.
+ */
+int SessionTable::map(int f) {
+	struct stat st;
+	void * p;
+
+	if (fstat(f, &st) != 0 || st.st_size < (off_t) sizeof(SessionSlot)) {
+		return -1;
+	}
+	p = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, f, 0);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	this->slots = (SessionSlot *) p;
+	this->size = st.st_size / sizeof(SessionSlot);
+	this->owner = true;
+	this->fd = f;
+	return 0;
+}
+
+/** The method lets the kernel allocate the pages of the table on a numa node, it must be
+ * called before a slot is used. The policy holds for all processes which map the table.
+ * @param node The numa node.
+ * @return 0 or -1 if the policy could not be set.
+ */
+int SessionTable::setNumaNode(int node) {
+	return bindMemory(this->slots, (size_t) this->size * sizeof(SessionSlot), node);
+}
+
+/** The getter method for the descriptor of a shared table.
+ * @return The descriptor or -1 if the table isn't shared.
+ */
+int SessionTable::getFd(void) {
+	return this->fd;
+}
+
+/** The method uses the mapping of another table, e.g. in the context of the accounting thread.
+ * The other table must stay open until this one is closed.
+ * @param table The other table.
+ */
+void SessionTable::attach(SessionTable * table) {
+	this->slots = table->slots;
+	this->size = table->size;
+	this->owner = false;
+}
+
+/** The method unmaps the table and closes the descriptor of a shared table, an attached table only forgets the mapping.*/
+void SessionTable::close(void) {
+	if (this->slots != NULL) {
+		if (this->owner)
+			munmap(this->slots, (size_t) this->size * sizeof(SessionSlot));
+		this->slots = NULL;
+		this->size = 0;
+	}
+	if (this->fd >= 0) {
+		::close(this->fd);
+		this->fd = -1;
+	}
+}
+
+/** The getter method for the number of slots.
+ * @return The number of slots.
+ */
+int SessionTable::getSize(void) {
+	return this->size;
+}
+
+/** The method allocates a free slot. It is called from the threads of the foreground process.
+ * @return The index of the slot or -1 if the table is full.
+ */
+int SessionTable::alloc(void) {
+	int i, index;
+
+	for (i = 0; i < this->size; i++) {
+		index = (this->hint + i) % this->size;
+		if (__sync_bool_compare_and_swap(&this->slots[index].used, 0, 1)) {
+			this->hint = index + 1;
+			this->slots[index].length = 0;
+			this->slots[index].next = 0;
+			return index;
+		}
+	}
+	return -1;
+}
+
+/** The method releases a slot and the slots which continue its record.
+ * @param index The index of the slot.
+ */
+void SessionTable::release(int index) {
+	if (index >= 0 && index < this->size) {
+		this->releaseChain(this->slots[index].next);
+		this->slots[index].next = 0;
+		__sync_lock_release(&this->slots[index].used);
+	}
+}
+
+/** The method releases the slots which continue a record.
+ * @param next The index + 1 of the first slot, 0 if there is none.
+ */
+void SessionTable::releaseChain(uint32_t next) {
+	SessionSlot * slot;
+	int hops;
+
+	for (hops = 0; next != 0 && next <= (uint32_t) this->size && hops < this->size; hops++) {
+		slot = &this->slots[next - 1];
+		next = slot->next;
+		slot->next = 0;
+		__sync_lock_release(&slot->used);
+	}
+}
+
+/** The method writes a record to a slot. Concurrent writers wait until
+ * the sequence counter is even. If the record is longer than a slot, the rest is
+ * written to free slots, the slots of the previous record are released afterwards.
+ * @param index The index of the slot.
+ * @param record The record.
+ * @return 0 or -1 if the slot is invalid or there are not enough free slots for the record.
+ */
+int SessionTable::write(int index, string record) {
+	SessionSlot * slot, * part;
+	vector<int> parts;
+	uint32_t seq, old;
+	size_t offset, length;
+	unsigned int i;
+	int cont;
+
+	if (index < 0 || index >= this->size) {
+		return -1;
+	}
+	slot = &this->slots[index];
+
+	//allocate the slots for the rest of the record before the lock is taken,
+	//so the previous record stays valid if the table is full
+	for (offset = SESSION_SLOT_DATA; offset < record.size(); offset += SESSION_SLOT_DATA) {
+		cont = this->alloc();
+		if (cont < 0) {
+			for (i = 0; i < parts.size(); i++) {
+				this->release(parts[i]);
+			}
+			return -1;
+		}
+		parts.push_back(cont);
+	}
+
+	//take the seqlock, the counter is odd while the record is written
+	while (true) {
+		seq = slot->seq;
+		if ((seq & 1) == 0 && __sync_bool_compare_and_swap(&slot->seq, seq, seq + 1)) {
+			break;
+		}
+		sched_yield();
+	}
+	length = record.size() < SESSION_SLOT_DATA ? record.size() : SESSION_SLOT_DATA;
+	memcpy(slot->data, record.data(), length);
+	slot->length = length;
+	for (i = 0, offset = length; i < parts.size(); i++, offset += length) {
+		part = &this->slots[parts[i]];
+		length = record.size() - offset < SESSION_SLOT_DATA ? record.size() - offset : SESSION_SLOT_DATA;
+		memcpy(part->data, record.data() + offset, length);
+		part->length = length;
+		part->next = (i + 1 < parts.size()) ? parts[i + 1] + 1 : 0;
+	}
+	old = slot->next;
+	slot->next = parts.empty() ? 0 : parts[0] + 1;
+	__sync_synchronize();
+	slot->seq = seq + 2;
+
+	//readers of the previous record retry, because the counter has changed
+	this->releaseChain(old);
+	return 0;
+}
+
+/** The method reads the record of a slot. It retries if the record
+ * was written while it was copied.
+ * @param index The index of the slot.
+ * @param record The record.
+ * @return 0 or -1 if the slot is invalid or free.
+ */
+int SessionTable::read(int index, string * record) {
+	SessionSlot * slot, * part;
+	uint32_t seq, length, next;
+	int hops;
+
+	if (index < 0 || index >= this->size || this->slots[index].used == 0) {
+		return -1;
+	}
+	slot = &this->slots[index];
+
+	while (true) {
+		seq = slot->seq;
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+		length = slot->length;
+		if (length > sizeof(slot->data)) {
+			length = 0;
+		}
+		record->assign(slot->data, length);
+		next = slot->next;
+
+		//the continuation slots may be reused while they are copied, the counter is checked afterwards
+		for (hops = 0; next != 0 && next <= (uint32_t) this->size && hops < this->size; hops++) {
+			part = &this->slots[next - 1];
+			length = part->length;
+			if (length > sizeof(part->data)) {
+				length = 0;
+			}
+			record->append(part->data, length);
+			next = part->next;
+		}
+		__sync_synchronize();
+		if (slot->seq == seq) {
+			return 0;
+		}
+	}
+}
+
+/** The method writes the session informations of a user to a slot.
+ * @param index The index of the slot.
+ * @param user The user.
+ * @return 0 or the length of the record if the slot is invalid or there are not enough free slots for it.
+ */
+int SessionTable::writeUser(int index, User * user) {
+	AttributeBlob record;
+
+	record.addString(SESSION_USERNAME, user->getUsername());
+	record.addString(SESSION_SESSIONID, user->getSessionId());
+	record.addInt(SESSION_PORTNUMBER, user->getPortnumber());
+	record.addString(SESSION_CALLINGSTATIONID, user->getCallingStationId());
+	record.addString(SESSION_FRAMEDIP, user->getFramedIp());
+	record.addString(SESSION_COMMONNAME, user->getCommonname());
+	record.addInt(SESSION_INTERVAL, user->getAcctInterimInterval());
+	record.addString(SESSION_KEY, user->getKey());
+	record.addString(SESSION_STATUSFILEKEY, user->getStatusFileKey());
+	record.addString(SESSION_UNTRUSTEDPORT, user->getUntrustedPort());
+	record.addString(SESSION_ATTRIBUTES, user->getAttributes()->getBuf());
+	record.addInt(SESSION_TRACEID, user->getTraceId());
+	if (this->write(index, record.getBuf()) != 0) {
+		return record.getBuf().size();
+	}
+	return 0;
+}
+
+/** The method reads the session informations of a user from a slot.
+ * @param index The index of the slot.
+ * @param user The user.
+ * @return 0 or -1 if the slot is invalid or free.
+ */
+int SessionTable::readUser(int index, User * user) {
+	AttributeBlob record;
+	string buf;
+
+	if (this->read(index, &buf) < 0) {
+		return -1;
+	}
+	record.setBuf(buf);
+	user->setUsername(record.getString(SESSION_USERNAME));
+	user->setSessionId(record.getString(SESSION_SESSIONID));
+	user->setPortnumber(record.getInt(SESSION_PORTNUMBER));
+	user->setCallingStationId(record.getString(SESSION_CALLINGSTATIONID));
+	user->setFramedIp(record.getString(SESSION_FRAMEDIP));
+	user->setCommonname(record.getString(SESSION_COMMONNAME));
+	user->setAcctInterimInterval(record.getInt(SESSION_INTERVAL));
+	user->setKey(record.getString(SESSION_KEY));
+	user->setStatusFileKey(record.getString(SESSION_STATUSFILEKEY));
+	user->setUntrustedPort(record.getString(SESSION_UNTRUSTEDPORT));
+	user->getAttributes()->setBuf(record.getString(SESSION_ATTRIBUTES));
+	user->setTraceId(record.getInt(SESSION_TRACEID));
+	user->setSlot(index);
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _SESSION_TABLE_H_
+#define _SESSION_TABLE_H_
+
+#include <string>
+#include <stdint.h>
+#include "User.h"
+
+using namespace std;
+
+#define SESSION_SLOT_SIZE		8192	/**< The size of a slot in bytes.*/
+#define SESSION_SLOT_DATA		(SESSION_SLOT_SIZE - 16)	/**< The bytes of a record in a slot.*/
+#define SESSION_DEFAULT_SLOTS	4096	/**< The default number of slots.*/
+
+#define SESSION_USERNAME			1	/**< The username.*/
+#define SESSION_SESSIONID			2	/**< The acct session id.*/
+#define SESSION_PORTNUMBER			3	/**< The nas port as uint32_t.*/
+#define SESSION_CALLINGSTATIONID	4	/**< The calling station id.*/
+#define SESSION_FRAMEDIP			5	/**< The framed ip.*/
+#define SESSION_COMMONNAME			6	/**< The common name.*/
+#define SESSION_INTERVAL			7	/**< The acct interim interval as uint32_t.*/
+#define SESSION_KEY					8	/**< The key of the user.*/
+#define SESSION_STATUSFILEKEY		9	/**< The key in the status file.*/
+#define SESSION_UNTRUSTEDPORT		10	/**< The untrusted port.*/
+#define SESSION_ATTRIBUTES			11	/**< The AttributeBlob of the Access-Accept.*/
+#define SESSION_TRACEID				12	/**< The request id of the login in the trace as uint32_t.*/
+
+/** A slot of the session table. The record is an AttributeBlob with the SESSION_* entries,
+ * a record which is longer than a slot is continued in further slots.*/
+struct SessionSlot {
+	volatile uint32_t seq; /**< The sequence counter of the seqlock, it is odd while the slot is written.*/
+	volatile uint32_t used; /**< 1 if the slot belongs to a session.*/
+	uint32_t length; /**< The length of the part of the record in this slot.*/
+	uint32_t next; /**< The index + 1 of the slot with the rest of the record, 0 if there is none.*/
+	char data[SESSION_SLOT_DATA]; /**< The record.*/
+};
+
+/** The class implements a table of sessions in a shared anonymous mapping.
+ * The table is created before the background processes are forked, so the
+ * foreground process, the authentication process and the accounting process
+ * see the same slots and exchange only the index of a slot over the ipc sockets.
+ * The foreground process allocates and releases the slots. Every slot is protected
+ * by a seqlock: a writer makes the sequence counter odd, writes the record and makes it
+ * even again, a reader retries until it copied the record with the same even counter.
+ * A record which is longer than a slot, e.g. with many Framed-Routes, is continued in
+ * free slots, which are chained by the first slot and protected by its seqlock.
+ * The password is never written to the table.
+ * With the radius daemon the table is a shared memory object, its descriptor is sent to the daemon.
+ */
+class SessionTable {
+private:
+	SessionSlot * slots; /**< The mapped slots.*/
+	int size; /**< The number of slots.*/
+	int hint; /**< The slot where the search for a free slot starts.*/
+	bool owner; /**< True if the table was mapped by this object and is unmapped by close().*/
+	int fd; /**< The shared memory object of a table which is passed to the radius daemon, -1 if there is none.*/
+
+	int write(int, string);
+	int read(int, string *);
+	void releaseChain(uint32_t);
+
+public:
+	SessionTable();
+	~SessionTable();
+
+	int open(int);
+	int openShared(int);
+	int map(int);
+	int getFd(void);
+	int setNumaNode(int);
+	void attach(SessionTable *);
+	void close(void);
+	int getSize(void);
+
+	int alloc(void);
+	void release(int);
+
+	int writeUser(int, User *);
+	int readUser(int, User *);
+};
+
+#endif //_SESSION_TABLE_H_
@@ -0,0 +1,224 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StatsServer.h"
+#include "RadiusClass/RadiusPacket.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+/** The constructor of the class, the server isn't open.*/
+StatsServer::StatsServer() {
+	this->listenfd = -1;
+}
+
+/** The destructor closes the server.*/
+StatsServer::~StatsServer() {
+	this->close();
+}
+
+/** The method creates the socket, an old socket at the path is removed.
+ * Only the owner of the process can connect.
+ * @param p The path of the socket.
+ * @return 0 or -1 if the socket can't be created.
+ */
+int StatsServer::open(string p) {
+	struct sockaddr_un addr;
+	int fd;
+
+	if (p.size() >= sizeof(addr.sun_path)) {
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, p.c_str(), sizeof(addr.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	unlink(p.c_str());
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || chmod(p.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, STATS_MAX_CLIENTS) != 0) {
+		::close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	this->listenfd = fd;
+	this->path = p;
+	return 0;
+}
+
+/** The method closes the clients and the socket and removes the path.*/
+void StatsServer::close(void) {
+	unsigned int i;
+
+	for (i = 0; i < this->clients.size(); i++) {
+		::close(this->clients[i].fd);
+	}
+	this->clients.clear();
+	if (this->listenfd >= 0) {
+		::close(this->listenfd);
+		unlink(this->path.c_str());
+		this->listenfd = -1;
+	}
+}
+
+/** The method checks if the server is open.
+ * @return True if the socket is open.
+ */
+bool StatsServer::isOpen(void) {
+	return this->listenfd >= 0;
+}
+
+/** The setter method for the snapshots, the following requests get them.
+ * @param p The snapshot in the Prometheus text format.
+ * @param j The snapshot in JSON.
+ */
+void StatsServer::setSnapshots(string p, string j) {
+	this->prometheus = p;
+	this->json = j;
+}
+
+/** The method adds the sockets to the sets for select(), the clients which
+ * wait for the rest of the response are in the write set. Clients which need
+ * longer than STATS_TIMEOUT are closed.
+ * @param readset The set of the sockets to read.
+ * @param writeset The set of the sockets to write.
+ */
+void StatsServer::fillSets(fd_set * readset, fd_set * writeset) {
+	long long now = monotonicTime();
+	unsigned int i;
+
+	if (this->listenfd < 0) {
+		return;
+	}
+	FD_SET(this->listenfd, readset);
+	for (i = 0; i < this->clients.size();) {
+		if (now - this->clients[i].since > STATS_TIMEOUT) {
+			::close(this->clients[i].fd);
+			this->clients.erase(this->clients.begin() + i);
+			continue;
+		}
+		if (this->clients[i].response.empty()) {
+			FD_SET(this->clients[i].fd, readset);
+		} else {
+			FD_SET(this->clients[i].fd, writeset);
+		}
+		i++;
+	}
+}
+
+/** The method handles the sockets which are ready after select().
+ * @param readset The set of the sockets which can be read.
+ * @param writeset The set of the sockets which can be written.
+ */
+void StatsServer::handle(fd_set * readset, fd_set * writeset) {
+	unsigned int i;
+	bool done;
+
+	if (this->listenfd < 0) {
+		return;
+	}
+	for (i = 0; i < this->clients.size();) {
+		done = false;
+		if (this->clients[i].response.empty() && FD_ISSET(this->clients[i].fd, readset)) {
+			done = this->read(this->clients[i]);
+		}
+		if (!done && !this->clients[i].response.empty() && FD_ISSET(this->clients[i].fd, writeset)) {
+			done = this->write(this->clients[i]);
+		}
+		if (done) {
+			::close(this->clients[i].fd);
+			this->clients.erase(this->clients.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	if (FD_ISSET(this->listenfd, readset)) {
+		this->accept();
+	}
+}
+
+/** The method accepts the waiting clients, if there are more than
+ * STATS_MAX_CLIENTS clients the new ones are closed.
+ */
+void StatsServer::accept(void) {
+	StatsClient client;
+	int fd;
+
+	while ((fd = ::accept(this->listenfd, NULL, NULL)) >= 0) {
+		if (this->clients.size() >= STATS_MAX_CLIENTS) {
+			::close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		client.fd = fd;
+		client.sent = 0;
+		client.since = monotonicTime();
+		this->clients.push_back(client);
+	}
+}
+
+/** The method reads the request of a client. The request ends with a newline
+ * or when the client shuts down the sending side, then the response is selected.
+ * @param client The client.
+ * @return True if the client must be closed.
+ */
+bool StatsServer::read(StatsClient & client) {
+	char buf[STATS_REQUEST];
+	ssize_t n;
+
+	n = recv(client.fd, buf, sizeof(buf), 0);
+	if (n < 0) {
+		return errno != EAGAIN && errno != EINTR;
+	}
+	client.request.append(buf, n);
+	if (n > 0 && client.request.find('\n') == string::npos && client.request.size() < STATS_REQUEST) {
+		return false;
+	}
+	if (client.request.compare(0, 4, "json") == 0) {
+		client.response = this->json;
+	} else {
+		client.response = this->prometheus;
+	}
+	return client.response.empty() || this->write(client);
+}
+
+/** The method writes as much of the response as the socket takes.
+ * @param client The client.
+ * @return True if the response is complete or the client must be closed.
+ */
+bool StatsServer::write(StatsClient & client) {
+	ssize_t n;
+
+	n = send(client.fd, client.response.data() + client.sent, client.response.size() - client.sent, MSG_NOSIGNAL);
+	if (n < 0) {
+		return errno != EAGAIN && errno != EINTR;
+	}
+	client.sent += n;
+	return client.sent >= client.response.size();
+}
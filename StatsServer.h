@@ -0,0 +1,78 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _STATS_SERVER_H_
+#define _STATS_SERVER_H_
+
+#include <string>
+#include <vector>
+#include <sys/select.h>
+
+using namespace std;
+
+#define STATS_MAX_CLIENTS	16		/**< The number of clients which are served at the same time.*/
+#define STATS_TIMEOUT		1000000	/**< The time in microseconds a client has for its request and the response.*/
+#define STATS_REQUEST		64		/**< The maximal length of a request.*/
+#define STATS_REFRESH		1000000	/**< The interval in microseconds for new snapshots.*/
+
+/** A client of the stats socket.*/
+struct StatsClient {
+	int fd; /**< The socket.*/
+	string request; /**< The received part of the request.*/
+	string response; /**< The response, it is empty until the request is complete.*/
+	unsigned int sent; /**< The number of sent bytes of the response.*/
+	long long since; /**< The time (monotonic, in microseconds) when the client was accepted.*/
+};
+
+/** The class serves a read-only UNIX stream socket for the metrics. A client sends
+ * "json" for a JSON snapshot, any other request or none (only shutting down
+ * the sending side) gets the Prometheus text format. The snapshots are formatted by the
+ * owner of the server with setSnapshots(), a request only copies the buffer. All sockets
+ * are non-blocking and are handled in the select loop of the owner, so a slow client never
+ * blocks it.
+ */
+class StatsServer {
+private:
+	int listenfd; /**< The listening socket, -1 if the server isn't open.*/
+	string path; /**< The path of the socket.*/
+	vector<StatsClient> clients; /**< The connected clients.*/
+	string prometheus; /**< The snapshot in the Prometheus text format.*/
+	string json; /**< The snapshot in JSON.*/
+
+	void accept(void);
+	bool read(StatsClient &);
+	bool write(StatsClient &);
+
+public:
+	StatsServer();
+	~StatsServer();
+
+	int open(string);
+	void close(void);
+	bool isOpen(void);
+
+	void setSnapshots(string, string);
+
+	void fillSets(fd_set *, fd_set *);
+	void handle(fd_set *, fd_set *);
+};
+
+#endif //_STATS_SERVER_H_
@@ -24,7 +24,6 @@
 /** The constructor sets the acctinteriminterval and the portnumber to 0.*/
 User::User() {
 	this->framedip = "";
-	this->framedroutes = "";
 	this->key = "";
 	this->statusfilekey = "";
 	this->untrustedport = "";
@@ -34,6 +33,8 @@ User::User() {
 	this->portnumber = 0;
 	this->vsabuf = NULL;
 	this->vsabuflen = 0;
+	this->slot = -1;
+	this->traceid = 0;
 }
 
 /** The constructor sets the acctinteriminterval to 0 and the portnumber to num.
@@ -64,7 +65,7 @@ User::~User() {
 User & User::operator=(const User & u) {
 	this->username = u.username;
 	this->commonname = u.commonname;
-	this->framedroutes = u.framedroutes;
+	this->attributes = u.attributes;
 	this->framedip = u.framedip;
 	this->key = u.key;
 	this->statusfilekey = u.statusfilekey;
@@ -73,6 +74,8 @@ User & User::operator=(const User & u) {
 	this->acctinteriminterval = u.acctinteriminterval;
 	this->untrustedport = u.untrustedport;
 	this->sessionid = u.sessionid;
+	this->slot = u.slot;
+	this->traceid = u.traceid;
 	//         this->trustedport=u.trustedport;
 	//         this->trustedip=u.trustedip;
 	this->vsabuflen = u.vsabuflen;
@@ -92,7 +95,7 @@ User & User::operator=(const User & u) {
 User::User(const User & u) {
 	this->username = u.username;
 	this->commonname = u.commonname;
-	this->framedroutes = u.framedroutes;
+	this->attributes = u.attributes;
 	this->framedip = u.framedip;
 	this->key = u.key;
 	this->statusfilekey = u.statusfilekey;
@@ -101,6 +104,8 @@ User::User(const User & u) {
 	this->acctinteriminterval = u.acctinteriminterval;
 	this->untrustedport = u.untrustedport;
 	this->sessionid = u.sessionid;
+	this->slot = u.slot;
+	this->traceid = u.traceid;
 	//         this->trustedport=u.trustedport;
 	//         this->trustedip=u.trustedip;
 	this->vsabuflen = u.vsabuflen;
@@ -134,16 +139,24 @@ void User::setCommonname(string cn) {
 	this->commonname = cn;
 }
 
-/** The getter method for the framed routes.
- *  @return The framed routes as a string.*/
+/** The getter method for the framed routes, they are taken from the attribute blob.
+ *  @return The framed routes as a string, the routes are delimited by ';'.*/
 string User::getFramedRoutes(void) {
-	return this->framedroutes;
+	string froutes;
+	int offset;
+	
+	for (offset = this->attributes.find(BLOB_FRAMED_ROUTE); offset >= 0; offset = this->attributes.find(BLOB_FRAMED_ROUTE, this->attributes.next(offset))) {
+		froutes.append(this->attributes.getValue(offset), this->attributes.getLength(offset));
+		froutes.append(";");
+	}
+	return froutes;
 }
-/** The setter method for the framedroutes.
- * @param froutes The framedroutes, if there are more 
- * routes they are diveded through a ';'.*/
-void User::setFramedRoutes(string froutes) {
-	this->framedroutes = froutes;
+
+/** The getter method for the attribute blob.
+ * @return A pointer to the attribute blob.
+ */
+AttributeBlob * User::getAttributes(void) {
+	return &this->attributes;
 }
 
 /** The getter method for the framed ip.
@@ -291,6 +304,30 @@ void User::setSessionId(string id) {
 	this->sessionid = id;
 }
 
+/** The getter method for the slot in the session table.
+ * @return The index of the slot or -1.*/
+int User::getSlot(void) {
+	return this->slot;
+}
+
+/** The setter method for the slot in the session table.
+ * @param s The index of the slot.*/
+void User::setSlot(int s) {
+	this->slot = s;
+}
+
+/** The getter method for the request id in the trace.
+ * @return The id of the last login, 0 if there is none.*/
+uint32_t User::getTraceId(void) {
+	return this->traceid;
+}
+
+/** The setter method for the request id in the trace.
+ * @param id The id.*/
+void User::setTraceId(uint32_t id) {
+	this->traceid = id;
+}
+
 /** The getter method for trusted port.
  * @return trusted port
  */
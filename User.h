@@ -26,6 +26,8 @@
 #include <iostream>
 #include <cstdio>
 #include <cstring>
+#include "FramedRoute.h"
+#include "AttributeBlob.h"
 //#include "openvpn-plugin.h"
 
 /** The datatype for sending and receiving data to and from the network */
@@ -52,7 +54,8 @@ public:
 	void setCommonname(string);
 
 	string getFramedRoutes(void);
-	void setFramedRoutes(string);
+
+	AttributeBlob * getAttributes(void);
 
 	string getFramedIp(void);
 	void setFramedIp(string);
@@ -85,6 +88,12 @@ public:
 	string getSessionId(void);
 	void setSessionId(string);
 
+	int getSlot(void);
+	void setSlot(int);
+
+	uint32_t getTraceId(void);
+	void setTraceId(uint32_t);
+
 	//void setTrustedPort ( const string& theValue );
 	//string getTrustedPort() const;
 
@@ -98,8 +107,8 @@ protected:
 	/** The common name.*/
 	string commonname;
 
-	/** The framed-routes, they are stored as a string. if there are more routes, they must be delimited by an ';'*/
-	string framedroutes;
+	/** The parsed attributes of the Access-Accept, e.g. the framed routes.*/
+	AttributeBlob attributes;
 
 	/** The framed ip.*/
 	string framedip;
@@ -136,6 +145,12 @@ protected:
 
 	/** The user sessionid.*/
 	string sessionid;
+
+	/** The index of the slot in the session table, -1 if the user has no slot.*/
+	int slot;
+
+	/** The request id of the last login in the trace, 0 if there is none.*/
+	uint32_t traceid;
 };
 
 #endif //_USER_H_
@@ -23,7 +23,7 @@
 #include "radiusplugin.h"
 
 /** The constructor calls the super constructor of the class User and the variables
- * sessionid, bytesin, bytesout, nextupdate and starttime are set to 0.*/
+ * sessionid, bytesin, bytesout, nextupdate, starttime, lastupdate and stoptime are set to 0.*/
 UserAcct::UserAcct() :
 	User() {
 	gigain = 0;
@@ -32,6 +32,8 @@ UserAcct::UserAcct() :
 	bytesout = 0;
 	nextupdate = 0;
 	starttime = 0;
+	lastupdate = 0;
+	stoptime = 0;
 }
 
 /** The destructor. Nothing happens here.*/
@@ -50,6 +52,8 @@ UserAcct & UserAcct::operator=(const UserAcct &u) {
 		this->bytesout = u.bytesout;
 		this->nextupdate = u.nextupdate;
 		this->starttime = u.starttime;
+		this->lastupdate = u.lastupdate;
+		this->stoptime = u.stoptime;
 	}
 	return *this;
 }
@@ -65,10 +69,12 @@ UserAcct::UserAcct(const UserAcct &u) :
 	this->bytesout = u.bytesout;
 	this->nextupdate = u.nextupdate;
 	this->starttime = u.starttime;
+	this->lastupdate = u.lastupdate;
+	this->stoptime = u.stoptime;
 	
 }
 
-/** The method sends an accounting update packet for the user to the radius server.
+/** The method adds the attributes of an accounting update packet for the user to a packet.
  * The accounting information are read from the OpenVpn
  * status file. The following attributes are sent to the radius server:
  * - User_Name, 
@@ -81,6 +87,7 @@ UserAcct::UserAcct(const UserAcct &u) :
  * - Service_Type,
  * - Acct_Session_ID,
  * - Acct_Status_Type,
+ * - Class,
  * - Framed_Protocol,
  * - Acct_Input_Octets,
  * - Acct_Output_Octets,
@@ -88,13 +95,9 @@ UserAcct::UserAcct(const UserAcct &u) :
  * - Acct_Input_Gigawords,
  * - Acct_Output_Gigawords
  * @param context The context of the plugin.
- * @return An integer, 0 is everything is ok, else 1.*/
-int UserAcct::sendUpdatePacket(PluginContext *context) {
+ * @param packet The packet, it must be an ACCOUNTING_REQUEST.*/
+void UserAcct::buildUpdatePacket(PluginContext *context, RadiusPacket *packet) {
 	
-	list<RadiusServer> * serverlist;
-	list<RadiusServer>::iterator server;
-	
-	RadiusPacket packet(ACCOUNTING_REQUEST);
 	RadiusAttribute ra1(ATTRIB_User_Name, this->getUsername()), ra2(ATTRIB_Framed_IP_Address, this->getFramedIp()),
 			ra3(ATTRIB_NAS_Port, this->getPortnumber()), ra4(ATTRIB_Calling_Station_Id, this->getCallingStationId()), ra5(ATTRIB_NAS_Identifier), ra6(
 					ATTRIB_NAS_IP_Address), ra7(ATTRIB_NAS_Port_Type), ra8(ATTRIB_Service_Type), ra9(ATTRIB_Acct_Session_ID, this->getSessionId()), ra10(
@@ -103,35 +106,27 @@ int UserAcct::sendUpdatePacket(PluginContext *context) {
 					ATTRIB_Acct_Session_Time), ra15(ATTRIB_Acct_Input_Gigawords, this->gigain), ra16(ATTRIB_Acct_Output_Gigawords, this->gigaout);
 	
 	
-	//get the server list
-	serverlist = context->radiusconf.getRadiusServer();
-	
-	
-	//set server on the first server
-	server = serverlist->begin();
-
-	
 	//add the attributes to the radius packet		
-	if (packet.addRadiusAttribute(&ra1)) {
+	if (packet->addRadiusAttribute(&ra1)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT: Fail to add attribute ATTRIB_User_Name.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra2)) {
+	if (packet->addRadiusAttribute(&ra2)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_User_Password.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra3)) {
+	if (packet->addRadiusAttribute(&ra3)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra4)) {
+	if (packet->addRadiusAttribute(&ra4)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Calling_Station_Id.\n";
 	}
 
 	//get the values from the config and add them to the packet
 	if (strcmp(context->radiusconf.getNASIdentifier(), "")) {
 		ra5.setValue(context->radiusconf.getNASIdentifier());
-		if (packet.addRadiusAttribute(&ra5)) {
+		if (packet->addRadiusAttribute(&ra5)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Identifier.\n";
 		}
 	}
@@ -140,68 +135,103 @@ int UserAcct::sendUpdatePacket(PluginContext *context) {
 		if (ra6.setValue(context->radiusconf.getNASIpAddress()) != 0) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to set value ATTRIB_NAS_Ip_Address.\n";
 		}
-		if (packet.addRadiusAttribute(&ra6)) {
+		if (packet->addRadiusAttribute(&ra6)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Ip_Address.\n";
 		}
 	}
 
 	if (strcmp(context->radiusconf.getNASPortType(), "")) {
 		ra7.setValue(context->radiusconf.getNASPortType());
-		if (packet.addRadiusAttribute(&ra7)) {
+		if (packet->addRadiusAttribute(&ra7)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port_Type.\n";
 		}
 	}
 
 	if (strcmp(context->radiusconf.getServiceType(), "")) {
 		ra8.setValue(context->radiusconf.getServiceType());
-		if (packet.addRadiusAttribute(&ra8)) {
+		if (packet->addRadiusAttribute(&ra8)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Service_Type.\n";
 		}
 	}
 
-	if (packet.addRadiusAttribute(&ra9)) {
+	if (packet->addRadiusAttribute(&ra9)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra10)) {
+	if (packet->addRadiusAttribute(&ra10)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
+	this->addClassAttributes(packet);
 
 	if (strcmp(context->radiusconf.getFramedProtocol(), "")) {
 		ra11.setValue(context->radiusconf.getFramedProtocol());
-		if (packet.addRadiusAttribute(&ra11)) {
+		if (packet->addRadiusAttribute(&ra11)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Framed_Protocol.\n";
 		}
 	}
 
-	if (packet.addRadiusAttribute(&ra12)) {
+	if (packet->addRadiusAttribute(&ra12)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Input_Packets.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra13)) {
+	if (packet->addRadiusAttribute(&ra13)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Output_Packets.\n";
 	}
 	//calculate the session time
 	ra14.setValue((time(NULL) - this->starttime));
-	if (packet.addRadiusAttribute(&ra14)) {
+	if (packet->addRadiusAttribute(&ra14)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_Time.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra15)) {
+	if (packet->addRadiusAttribute(&ra15)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Input_Gigawords.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra16)) {
+	if (packet->addRadiusAttribute(&ra16)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Output_Gigawords.\n";
 	}
+}
 
+/** The method sends an accounting update packet for the user to the radius server.
+ * The accounting information are read from the OpenVpn
+ * status file. The attributes are added by buildUpdatePacket().
+ * If the accounting spool is open, the packet is only written to the spool.
+ * @param context The context of the plugin.
+ * @return An integer, 0 is everything is ok, else 1.*/
+int UserAcct::sendUpdatePacket(PluginContext *context) {
+	
+	list<RadiusServer> * serverlist;
+	list<RadiusServer>::iterator server;
+	
+	RadiusPacket packet(ACCOUNTING_REQUEST);
+	packet.setTraceId(this->getTraceId());
+	
+	//the packet is sent by the thread of the spool
+	if (context->acctspool.isOpen()) {
+		this->buildUpdatePacket(context, &packet);
+		if (context->acctspool.enqueue(&packet, false) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet could not be spooled.\n";
+			return 1;
+		}
+		return 0;
+	}
+	
+	//get the server list
+	serverlist = context->radiusconf.getRadiusServer();
+	
+	//select the server by the load balancing policy
+	server = context->radiusconf.selectServer(context->radiusconf.getAcctLoadBalance(), this->getUsername());
+	
+	//add the attributes to the radius packet
+	this->buildUpdatePacket(context, &packet);
+	
 	//send the packet to the server
 	if (packet.radiusSend(server) < 0) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet was not sent.\n";
 	}
 
 	//get the response
-	if (packet.radiusReceive(serverlist) >= 0) {
+	if (packet.radiusReceive(serverlist, &context->radiusconf) >= 0) {
 		//is the packet a ACCOUNTING_RESPONSE?
 		if (packet.getCode() == ACCOUNTING_RESPONSE) {
 			if (DEBUG (context->getVerbosity()))
@@ -219,7 +249,7 @@ int UserAcct::sendUpdatePacket(PluginContext *context) {
 	return 1;
 }
 
-/** The method sends an accounting start packet for the user to the radius server.
+/** The method adds the attributes of an accounting start packet for the user to a packet.
  *  The following attributes are sent to the radius server:
  * - User_Name, 
  * - Framed_IP_Address,
@@ -231,13 +261,11 @@ int UserAcct::sendUpdatePacket(PluginContext *context) {
  * - Service_Type,
  * - Acct_Session_ID,
  * - Acct_Status_Type,
+ * - Class,
  * - Framed_Protocol,
  * @param  context The context of the plugin.
- * @return An integer, 0 is everything is ok, else 1.*/
-int UserAcct::sendStartPacket(PluginContext * context) {
-	list<RadiusServer>* serverlist;
-	list<RadiusServer>::iterator server;
-	RadiusPacket packet(ACCOUNTING_REQUEST);
+ * @param packet The packet, it must be an ACCOUNTING_REQUEST.*/
+void UserAcct::buildStartPacket(PluginContext * context, RadiusPacket *packet) {
 	RadiusAttribute ra1(ATTRIB_User_Name, this->getUsername()), ra2(ATTRIB_Framed_IP_Address, this->getFramedIp()),
 			ra3(ATTRIB_NAS_Port, this->getPortnumber()), ra4(ATTRIB_Calling_Station_Id, this->getCallingStationId()), ra5(ATTRIB_NAS_Identifier), ra6(
 					ATTRIB_NAS_IP_Address), ra7(ATTRIB_NAS_Port_Type), ra8(ATTRIB_Service_Type), ra9(ATTRIB_Acct_Session_ID, this->getSessionId()), ra10(
@@ -245,33 +273,25 @@ int UserAcct::sendStartPacket(PluginContext * context) {
 			ra11(ATTRIB_Framed_Protocol);
 	
 	
-	//get the radius server from the config
-	serverlist = context->radiusconf.getRadiusServer();
-
-	
-	//set server to the first from the list
-	server = serverlist->begin();
-
-	
 	//add the attributes to the packet
-	if (packet.addRadiusAttribute(&ra1)) {
+	if (packet->addRadiusAttribute(&ra1)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_User_Name.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra2)) {
+	if (packet->addRadiusAttribute(&ra2)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_User_Password.\n";
 	}
-	if (packet.addRadiusAttribute(&ra3)) {
+	if (packet->addRadiusAttribute(&ra3)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port.\n";
 	}
-	if (packet.addRadiusAttribute(&ra4)) {
+	if (packet->addRadiusAttribute(&ra4)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Calling_Station_Id.\n";
 	}
 
 	//get information from the config and add the attributes to the packet
 	if (strcmp(context->radiusconf.getNASIdentifier(), "")) {
 		ra5.setValue(context->radiusconf.getNASIdentifier());
-		if (packet.addRadiusAttribute(&ra5)) {
+		if (packet->addRadiusAttribute(&ra5)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Identifier.\n";
 		}
 	}
@@ -281,46 +301,79 @@ int UserAcct::sendStartPacket(PluginContext * context) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to set value ATTRIB_NAS_Ip_Address.\n";
 		}
 
-		if (packet.addRadiusAttribute(&ra6)) {
+		if (packet->addRadiusAttribute(&ra6)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Ip_Address.\n";
 		}
 	}
 	if (strcmp(context->radiusconf.getNASPortType(), "")) {
 		ra7.setValue(context->radiusconf.getNASPortType());
-		if (packet.addRadiusAttribute(&ra7)) {
+		if (packet->addRadiusAttribute(&ra7)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port_Type.\n";
 		}
 	}
 
 	if (strcmp(context->radiusconf.getServiceType(), "")) {
 		ra8.setValue(context->radiusconf.getServiceType());
-		if (packet.addRadiusAttribute(&ra8)) {
+		if (packet->addRadiusAttribute(&ra8)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Service_Type.\n";
 		}
 	}
 
-	if (packet.addRadiusAttribute(&ra9)) {
+	if (packet->addRadiusAttribute(&ra9)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra10)) {
+	if (packet->addRadiusAttribute(&ra10)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
+	this->addClassAttributes(packet);
 
 	if (strcmp(context->radiusconf.getFramedProtocol(), "")) {
 		ra11.setValue(context->radiusconf.getFramedProtocol());
-		if (packet.addRadiusAttribute(&ra11)) {
+		if (packet->addRadiusAttribute(&ra11)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Framed_Protocol.\n";
 		}
 	}
+}
 
+/** The method sends an accounting start packet for the user to the radius server.
+ * The attributes are added by buildStartPacket().
+ * If the accounting spool file is open, the packet is only written to the spool.
+ * The spool in the memory isn't used, the user is rejected if no server answers the start packet.
+ * @param context The context of the plugin.
+ * @return An integer, 0 is everything is ok, else 1.*/
+int UserAcct::sendStartPacket(PluginContext * context) {
+	list<RadiusServer>* serverlist;
+	list<RadiusServer>::iterator server;
+	RadiusPacket packet(ACCOUNTING_REQUEST);
+	packet.setTraceId(this->getTraceId());
+	
+	//the packet is sent by the thread of the spool
+	if (context->acctspool.isDurable()) {
+		this->buildStartPacket(context, &packet);
+		if (context->acctspool.enqueue(&packet, false) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet could not be spooled.\n";
+			return 1;
+		}
+		return 0;
+	}
+	
+	//get the radius server from the config
+	serverlist = context->radiusconf.getRadiusServer();
+	
+	//select the server by the load balancing policy
+	server = context->radiusconf.selectServer(context->radiusconf.getAcctLoadBalance(), this->getUsername());
+	
+	//add the attributes to the packet
+	this->buildStartPacket(context, &packet);
+	
 	//send the packet	
 	if (packet.radiusSend(server) < 0) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet was not sent.\n";
 	}
 
 	//receive the response
-	int ret = packet.radiusReceive(serverlist);
+	int ret = packet.radiusReceive(serverlist, &context->radiusconf);
 	if (ret >= 0) {
 		//is is a accounting resopnse ?
 		if (packet.getCode() == ACCOUNTING_RESPONSE) {
@@ -342,7 +395,7 @@ int UserAcct::sendStartPacket(PluginContext * context) {
 	return 1;
 }
 
-/** The method sends an accounting stop packet for the user to the radius server.
+/** The method adds the attributes of an accounting stop packet for the user to a packet.
  * The accounting information are read from the OpenVpn
  * status file. The following attributes are sent to the radius server:
  * - User_Name, 
@@ -355,16 +408,14 @@ int UserAcct::sendStartPacket(PluginContext * context) {
  * - Service_Type,
  * - Acct_Session_ID,
  * - Acct_Status_Type,
+ * - Class,
  * - Framed_Protocol,
  * - Acct_Input_Octets,
  * - Acct_Output_Octets,
  * - Acct_Session_Time
  * @param context The context of the plugin.
- * @return An integer, 0 is everything is ok, else 1.*/
-int UserAcct::sendStopPacket(PluginContext * context) {
-	list<RadiusServer> * serverlist;
-	list<RadiusServer>::iterator server;
-	RadiusPacket packet(ACCOUNTING_REQUEST);
+ * @param packet The packet, it must be an ACCOUNTING_REQUEST.*/
+void UserAcct::buildStopPacket(PluginContext * context, RadiusPacket *packet) {
 	RadiusAttribute ra1(ATTRIB_User_Name, this->getUsername()), ra2(ATTRIB_Framed_IP_Address, this->getFramedIp()),
 			ra3(ATTRIB_NAS_Port, this->portnumber),
 			ra4(ATTRIB_Calling_Station_Id, this->getCallingStationId()), ra5(ATTRIB_NAS_Identifier), ra6(ATTRIB_NAS_IP_Address),
@@ -374,33 +425,25 @@ int UserAcct::sendStopPacket(PluginContext * context) {
 					ATTRIB_Acct_Session_Time), ra15(ATTRIB_Acct_Input_Gigawords, this->gigain), ra16(ATTRIB_Acct_Output_Gigawords, this->gigaout);
 	
 	
-	//get the server from the config
-	serverlist = context->radiusconf.getRadiusServer();
-
-	
-	//set server to the first server
-	server = serverlist->begin();
-
-	
 	//add the attributes to the packet
-	if (packet.addRadiusAttribute(&ra1)) {
+	if (packet->addRadiusAttribute(&ra1)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_User_Name.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra2)) {
+	if (packet->addRadiusAttribute(&ra2)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_FramedIP_Adress.\n";
 	}
-	if (packet.addRadiusAttribute(&ra3)) {
+	if (packet->addRadiusAttribute(&ra3)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port.\n";
 	}
-	if (packet.addRadiusAttribute(&ra4)) {
+	if (packet->addRadiusAttribute(&ra4)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Calling_Station_Id.\n";
 	}
 
 	//get information from th config and ad it to the packet
 	if (strcmp(context->radiusconf.getNASIdentifier(), "")) {
 		ra5.setValue(context->radiusconf.getNASIdentifier());
-		if (packet.addRadiusAttribute(&ra5)) {
+		if (packet->addRadiusAttribute(&ra5)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Identifier.\n";
 		}
 	}
@@ -408,65 +451,98 @@ int UserAcct::sendStopPacket(PluginContext * context) {
 	if (strcmp(context->radiusconf.getNASIpAddress(), "")) {
 		if (ra6.setValue(context->radiusconf.getNASIpAddress()) != 0) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to set value ATTRIB_NAS_Ip_Address.\n";
-		} else if (packet.addRadiusAttribute(&ra6)) {
+		} else if (packet->addRadiusAttribute(&ra6)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Ip_Address.\n";
 		}
 	}
 	if (strcmp(context->radiusconf.getNASPortType(), "")) {
 		ra7.setValue(context->radiusconf.getNASPortType());
-		if (packet.addRadiusAttribute(&ra7)) {
+		if (packet->addRadiusAttribute(&ra7)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_NAS_Port_Type.\n";
 		}
 	}
 
 	if (strcmp(context->radiusconf.getServiceType(), "")) {
 		ra8.setValue(context->radiusconf.getServiceType());
-		if (packet.addRadiusAttribute(&ra8)) {
+		if (packet->addRadiusAttribute(&ra8)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Service_Type.\n";
 		}
 	}
-	if (packet.addRadiusAttribute(&ra9)) {
+	if (packet->addRadiusAttribute(&ra9)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
-	if (packet.addRadiusAttribute(&ra10)) {
+	if (packet->addRadiusAttribute(&ra10)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_ID.\n";
 	}
+	this->addClassAttributes(packet);
 
 	if (strcmp(context->radiusconf.getFramedProtocol(), "")) {
 		ra11.setValue(context->radiusconf.getFramedProtocol());
-		if (packet.addRadiusAttribute(&ra11)) {
+		if (packet->addRadiusAttribute(&ra11)) {
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Framed_Protocol.\n";
 		}
 	}
 
-	if (packet.addRadiusAttribute(&ra12)) {
+	if (packet->addRadiusAttribute(&ra12)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Input_Packets.\n";
 	}
-	if (packet.addRadiusAttribute(&ra13)) {
+	if (packet->addRadiusAttribute(&ra13)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Output_Packets.\n";
 	}
 
-	//calculate the session time
-	ra14.setValue(time(NULL) - this->starttime);
-	if (packet.addRadiusAttribute(&ra14)) {
+	//calculate the session time, a session which was recovered from the journal ended at its stop time
+	ra14.setValue((this->stoptime != 0 ? this->stoptime : time(NULL)) - this->starttime);
+	if (packet->addRadiusAttribute(&ra14)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Session_Time.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra15)) {
+	if (packet->addRadiusAttribute(&ra15)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Input_Gigawords.\n";
 	}
 
-	if (packet.addRadiusAttribute(&ra16)) {
+	if (packet->addRadiusAttribute(&ra16)) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Acct_Output_Gigawords.\n";
 	}
+}
 
+/** The method sends an accounting stop packet for the user to the radius server.
+ * The accounting information are read from the OpenVpn
+ * status file. The attributes are added by buildStopPacket().
+ * If the accounting spool is open, the packet is only written to the spool.
+ * @param context The context of the plugin.
+ * @return An integer, 0 is everything is ok, else 1.*/
+int UserAcct::sendStopPacket(PluginContext * context) {
+	list<RadiusServer> * serverlist;
+	list<RadiusServer>::iterator server;
+	RadiusPacket packet(ACCOUNTING_REQUEST);
+	packet.setTraceId(this->getTraceId());
+	
+	//the packet is sent by the thread of the spool
+	if (context->acctspool.isOpen()) {
+		this->buildStopPacket(context, &packet);
+		if (context->acctspool.enqueue(&packet, true) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet could not be spooled.\n";
+			return 1;
+		}
+		return 0;
+	}
+	
+	//get the radius server from the config
+	serverlist = context->radiusconf.getRadiusServer();
+	
+	//select the server by the load balancing policy
+	server = context->radiusconf.selectServer(context->radiusconf.getAcctLoadBalance(), this->getUsername());
+	
+	//add the attributes to the packet
+	this->buildStopPacket(context, &packet);
+	
 	//send the packet
 	if (packet.radiusSend(server) < 0) {
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Packet was not sent.\n";
 	}
 
 	//get the response
-	if (packet.radiusReceive(serverlist) >= 0) {
+	if (packet.radiusReceive(serverlist, &context->radiusconf) >= 0) {
 		//is it an accounting response
 		if (packet.getCode() == ACCOUNTING_RESPONSE) {
 			if (DEBUG (context->getVerbosity()))
@@ -484,277 +560,82 @@ int UserAcct::sendStopPacket(PluginContext * context) {
 	return 1;
 }
 
+/** The method adds the Class attributes of the Access-Accept unchanged to an accounting packet (RFC 2865).
+ * @param packet The packet.
+ */
+void UserAcct::addClassAttributes(RadiusPacket *packet) {
+	int offset;
+	
+	for (offset = this->getAttributes()->find(BLOB_CLASS); offset >= 0; offset = this->getAttributes()->find(BLOB_CLASS, this->getAttributes()->next(offset))) {
+		RadiusAttribute ra(ATTRIB_Class);
+		if (ra.setValue((const Octet *) this->getAttributes()->getValue(offset), this->getAttributes()->getLength(offset)) != 0 || packet->addRadiusAttribute(&ra)) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Fail to add attribute ATTRIB_Class.\n";
+		}
+	}
+}
+
 /** The method deletes ths systemroutes of the user.
  * @param context The context of the plugin.
  */
 void UserAcct::delSystemRoutes(PluginContext * context) {
-	char * route;
-	char framedip[16];
-	
-	char routestring[100];
-	char framednetmask_cidr[3];
-	char framedgw[16];
-	char framedmetric[5];
-	char * framedroutes;
-	int j = 0, k = 0, len = 0;
-
-	
-	//copy the framed route string to an char array, it is easier to
-	//analyse
-	framedroutes = new char[this->getFramedRoutes().size() + 1];
-	memset(framedroutes, 0, this->getFramedRoutes().size() + 1);
-
+	int offset;
+	FramedRoute fr;
+	string routestring;
 	
-	// copy in a temp-string, because strtok deletes the delimiter, if it used anywhere
-	strncpy(framedroutes, this->getFramedRoutes().c_str(), this->getFramedRoutes().size());
-
+	if (this->getAttributes()->find(BLOB_ROUTE) < 0) {
+		if (DEBUG (context->getVerbosity()))
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  No routes for user.\n";
+		return;
+	}
 	
-	//are there framed routes
-	if (framedroutes[0] != '\0') {
-		//get the first route
-		route = strtok(framedroutes, ";");
-		len = strlen(route);
-		if (len > 50) //this is too big!! but the length is variable
-		{
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Argument for Framed Route is too long (>50 Characters).\n";
-		} else {
-			while (route != NULL) {
-				//set the arrays to 0
-				memset(routestring, 0, 100);
-				memset(framednetmask_cidr, 0, 3);
-				memset(framedip, 0, 16);
-				memset(framedgw, 0, 16);
-				memset(framedmetric, 0, 5);
-
-				j = 0;
-				k = 0;
-				//get ip address and add it to framedip
-				while (route[j] != '/' && j < len) {
-					if (route[j] != ' ') {
-						framedip[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				k = 0;
-				j++;
-				//get the framednetmask and add it to framednetmack_cidr
-				while (route[j] != ' ' && j <= len) {
-					framednetmask_cidr[k] = route[j];
-					k++;
-					j++;
-				}
-				k = 0;
-				//jump spaces
-				while (route[j] == ' ' && j <= len) {
-					j++;
-				}
-				//get the gateway
-				while (route[j] != '/' && j <= len) {
-					if (route[j] != ' ') {
-						framedgw[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				j++;
-				//find gateway netmask (this isn't used
-				//at the command route under linux)
-				while (route[j] != ' ' && j <= len) {
-					j++;
-				}
-				//jump spaces
-				while (route[j] == ' ' && j <= len) {
-					j++;
-				}
-				k = 0;
-				if (j <= len) //is there a metric (optional)
-				{
-					k = 0;
-					//find the metric
-					while (route[j] != ' ' && j <= len) {
-						framedmetric[k] = route[j];
-						k++;
-						j++;
-					}
-				}
-
-				//create system call
-				strncat(routestring, "route del -net ", 15);
-				strncat(routestring, framedip, 16);
-				strncat(routestring, "/", 1);
-				strncat(routestring, framednetmask_cidr, 2);
-				strncat(routestring, " gw ", 4);
-				strncat(routestring, framedgw, 16);
-				if (framedmetric[0] != '\0') {
-					strncat(routestring, " metric ", 8);
-					strncat(routestring, framedmetric, 5);
-				}
-				//redirect the output stderr to /dev/null
-				strncat(routestring, " 2> /dev/null", 13);
-				
-				if (DEBUG (context->getVerbosity()))
-					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Create route string " << routestring << ".\n";
-
-				
-				//system call
-				if (system(routestring) != 0)
-				//if(1)//-> the debugg can't context system()
-				{
-					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Route " << routestring << " could not set. Route already set or bad route string.\n";
-				} else {
-					if (DEBUG (context->getVerbosity()))
-						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Add route to system routing table.\n";
-					
-				}
-				//get the next route
-				route = strtok(NULL, ";");
-			}
-		}
+	for (offset = this->getAttributes()->find(BLOB_ROUTE); offset >= 0; offset = this->getAttributes()->find(BLOB_ROUTE, this->getAttributes()->next(offset))) {
+		//the value may be unaligned
+		memcpy(&fr, this->getAttributes()->getValue(offset), sizeof(fr));
+		routestring = formatRouteCommand(&fr, false);
 		
-	} else {
 		if (DEBUG (context->getVerbosity()))
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  No routes for user in AccessAcceptPacket.\n";
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Create route string " << routestring << ".\n";
+		
+		//delete the route with the root rights
+		if (context->privhelper.route(&fr, false) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Route " << routestring << " could not deleted. Route not set or bad route string.\n";
+		} else {
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Delete route from system routing table.\n";
+		}
 	}
-	//free the char array
-	delete[] framedroutes;
-
 }
 
 /** The method adds ths routes of the user to the system routing table.
  * @param context The context of the plugin.
  */
 void UserAcct::addSystemRoutes(PluginContext * context) {
-	char * route;
-	char framedip[16];
+	int offset;
+	FramedRoute fr;
+	string routestring;
 	
-	char routestring[100];
-	char framednetmask_cidr[3];
-	char framedgw[16];
-	char framedmetric[5];
-	char * framedroutes;
-	int j = 0, k = 0, len = 0;
-
-	
-	//copy the framed route string to an char array, it is easier to
-	//analyse
-	framedroutes = new char[this->getFramedRoutes().size() + 1];
-	memset(framedroutes, 0, this->getFramedRoutes().size() + 1);
-
-	
-	// copy in a temp-string, becaue strtok deletes the delimiter, if it used anywhere
-	strncpy(framedroutes, this->getFramedRoutes().c_str(), this->getFramedRoutes().size());
-
-	
-	//are there framed routes
-	if (framedroutes[0] != '\0') {
-		//get the first route
-		route = strtok(framedroutes, ";");
-		len = strlen(route);
-		if (len > 50) //this is to big!! but the length is variable
-		{
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Argument for Framed Route is to long (>50 Characters).\n";
-		} else {
-			while (route != NULL) {
-				//set the arrays to 0
-				memset(routestring, 0, 100);
-				memset(framednetmask_cidr, 0, 3);
-				memset(framedip, 0, 16);
-				memset(framedgw, 0, 16);
-				memset(framedmetric, 0, 5);
-
-				j = 0;
-				k = 0;
-				//get ip address and add it to framedip
-				while (route[j] != '/' && j < len) {
-					if (route[j] != ' ') {
-						framedip[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				k = 0;
-				j++;
-				//get the framednetmask and add it to framednetmask_cidr
-				while (route[j] != ' ' && j <= len) {
-					framednetmask_cidr[k] = route[j];
-					k++;
-					j++;
-				}
-				k = 0;
-				//jump spaces
-				while (route[j] == ' ' && j <= len) {
-					j++;
-				}
-				//get the gateway
-				while (route[j] != '/' && j <= len) {
-					if (route[j] != ' ') {
-						framedgw[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				j++;
-				//find gateway netmask (this isn't used
-				//at the command route under linux)
-				while (route[j] != ' ' && j <= len) {
-					j++;
-				}
-				//jump spaces
-				while (route[j] == ' ' && j <= len) {
-					j++;
-				}
-				k = 0;
-				if (j <= len) //is there a metric (optional)
-				{
-					k = 0;
-					//find the metric
-					while (route[j] != ' ' && j <= len) {
-						framedmetric[k] = route[j];
-						k++;
-						j++;
-					}
-				}
-
-				//create system call
-				strncat(routestring, "route add -net ", 15);
-				strncat(routestring, framedip, 16);
-				strncat(routestring, "/", 1);
-				strncat(routestring, framednetmask_cidr, 2);
-				strncat(routestring, " gw ", 4);
-				strncat(routestring, framedgw, 16);
-				if (framedmetric[0] != '\0') {
-					strncat(routestring, " metric ", 8);
-					strncat(routestring, framedmetric, 5);
-				}
-				//redirect the output stderr to /dev/null
-				strncat(routestring, " 2> /dev/null", 13);
-				
-				if (DEBUG (context->getVerbosity()))
-					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Create route string " << routestring << ".\n";
-
-				
-				//system call route
-				if (system(routestring) != 0)
-				//if(1)//-> the debugg can't context system()
-				{
-					cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Route " << routestring << " could not set. Route already set or bad route string.\n";
-				} else {
-					if (DEBUG (context->getVerbosity()))
-						cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Add route to system routing table.\n";
-
-				}
-				//get the next route
-				route = strtok(NULL, ";");
-			}
-		}
-	} else {
+	if (this->getAttributes()->find(BLOB_ROUTE) < 0) {
 		if (DEBUG (context->getVerbosity()))
 			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  No routes for user.\n";
+		return;
 	}
-	//fre the chat array
-	delete[] framedroutes;
 	
+	for (offset = this->getAttributes()->find(BLOB_ROUTE); offset >= 0; offset = this->getAttributes()->find(BLOB_ROUTE, this->getAttributes()->next(offset))) {
+		//the value may be unaligned
+		memcpy(&fr, this->getAttributes()->getValue(offset), sizeof(fr));
+		routestring = formatRouteCommand(&fr, true);
+		
+		if (DEBUG (context->getVerbosity()))
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Create route string " << routestring << ".\n";
+		
+		//add the route with the root rights
+		if (context->privhelper.route(&fr, true) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Route " << routestring << " could not set. Route already set or bad route string.\n";
+		} else {
+			if (DEBUG (context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND-ACCT:  Add route to system routing table.\n";
+		}
+	}
 }
 
 /** The getter method for the gigain variable.
@@ -823,6 +704,28 @@ void UserAcct::setNextUpdate(time_t t) {
 	this->nextupdate = t;
 }
 
+/** The getter method for the lastupdate.
+ * @return The time when the counters were read last.*/
+time_t UserAcct::getLastUpdate(void) {
+	return this->lastupdate;
+}
+/**The setter method for the lastupdate.
+ * @param t The time when the counters were read.*/
+void UserAcct::setLastUpdate(time_t t) {
+	this->lastupdate = t;
+}
+
+/** The getter method for the stoptime.
+ * @return The end of the connection, 0 if it ends when the stop packet is built.*/
+time_t UserAcct::getStoptime(void) {
+	return this->stoptime;
+}
+/**The setter method for the stoptime.
+ * @param t The end of the connection.*/
+void UserAcct::setStoptime(time_t t) {
+	this->stoptime = t;
+}
+
 int UserAcct::deleteCcdFile(PluginContext * context) {
 	string filename;
 	filename = context->conf.getCcdPath() + this->getCommonname();
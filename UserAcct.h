@@ -41,6 +41,10 @@ private:
 	uint32_t bytesout; /**< The sent bytes.*/
 	time_t nextupdate; /**< The next update time.*/
 	time_t starttime; /**< The start time of the connection.*/
+	time_t lastupdate; /**< The time when the counters were read last.*/
+	time_t stoptime; /**< The end of the connection, 0 if it ends when the stop packet is built.*/
+	
+	void addClassAttributes(RadiusPacket *);
 	
 public:
 	
@@ -68,12 +72,21 @@ public:
 	time_t getNextUpdate(void);
 	void setNextUpdate(time_t);
 
+	time_t getLastUpdate(void);
+	void setLastUpdate(time_t);
+
+	time_t getStoptime(void);
+	void setStoptime(time_t);
+
 	UserAcct & operator=(const UserAcct &);
 
 	UserAcct(const UserAcct &);
 
+	void buildUpdatePacket(PluginContext *, RadiusPacket *);
 	int sendUpdatePacket(PluginContext *);
+	void buildStartPacket(PluginContext *, RadiusPacket *);
 	int sendStartPacket(PluginContext *);
+	void buildStopPacket(PluginContext *, RadiusPacket *);
 	int sendStopPacket(PluginContext *);
 	void addSystemRoutes(PluginContext *);
 	void delSystemRoutes(PluginContext * context);
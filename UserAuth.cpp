@@ -27,6 +27,7 @@ int UserAuth::sendAcceptRequestPacket(PluginContext * context) {
 	list<RadiusServer>::iterator server;
 
 	RadiusPacket packet(ACCESS_REQUEST);
+	packet.setTraceId(this->getTraceId());
 	RadiusAttribute ra1(ATTRIB_User_Name, this->getUsername().c_str());
 	RadiusAttribute ra2(ATTRIB_User_Password, this->password);
 	RadiusAttribute ra3(ATTRIB_NAS_Port, this->getPortnumber());
@@ -45,8 +46,8 @@ int UserAuth::sendAcceptRequestPacket(PluginContext * context) {
 	// get the server list
 	serverlist = context->radiusconf.getRadiusServer();
 
-	// set server to the first server
-	server = serverlist->begin();
+	// select the server by the load balancing policy
+	server = context->radiusconf.selectServer(context->radiusconf.getAuthLoadBalance(), this->getUsername());
 	
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: Build password packet:  password: *****, sharedSecret: *****." << endl;
@@ -117,7 +118,7 @@ int UserAuth::sendAcceptRequestPacket(PluginContext * context) {
 	}
 
 	// receive the packet
-	if (packet.radiusReceive(serverlist) == 0) {
+	if (packet.radiusReceive(serverlist, &context->radiusconf) == 0) {
 		// is it a accept?
 		if (packet.getCode() == ACCESS_ACCEPT) {
 			if (DEBUG (context->getVerbosity()))
@@ -172,17 +173,29 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: parse_response_packet()." << endl;
 	
-	// extract framed routes
-	range = packet->findAttributes(ATTRIB_Framed_Route);
-	iter1 = range.first;
-	iter2 = range.second;
-	string froutes;
-	while (iter1 != iter2) {
-		froutes.append((char *) iter1->second.getValue(), iter1->second.getLength() - 2);
-		froutes.append(";");
-		iter1++;
+	FramedRoute fr;
+	int i, routetypes[2] = { ATTRIB_Framed_Route, ATTRIB_Framed_IPv6_Route };
+
+	// the parsed attributes are kept in the attribute blob, which is passed to the other processes
+	this->getAttributes()->clear();
+
+	// extract framed routes and framed ipv6 routes, they are parsed once
+	// here and used for the ccd file and the system routes
+	for (i = 0; i < 2; i++) {
+		range = packet->findAttributes(routetypes[i]);
+		iter1 = range.first;
+		iter2 = range.second;
+		while (iter1 != iter2) {
+			string route((char *) iter1->second.getValue(), iter1->second.getLength() - 2);
+			this->getAttributes()->addString(BLOB_FRAMED_ROUTE, route);
+			if (parseFramedRoute(route, &fr) == 0) {
+				this->getAttributes()->add(BLOB_ROUTE, &fr, sizeof(fr));
+			} else {
+				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Bad framed route: " << route << "." << endl;
+			}
+			iter1++;
+		}
 	}
-	this->setFramedRoutes(froutes);
 	
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: routes: " << this->getFramedRoutes() << "." << endl;
@@ -195,6 +208,9 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 	if (iter1 != iter2) {
 		this->setFramedIp(iter1->second.ipFromBuf());
 	}
+	if (this->getFramedIp().length() > 0) {
+		this->getAttributes()->addString(BLOB_FRAMED_IP, this->getFramedIp());
+	}
 
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: framed ip: " << this->getFramedIp() << "." << endl;
@@ -206,6 +222,7 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 	if (iter1 != iter2) {
 		this->setAcctInterimInterval(iter1->second.intFromBuf());
 	}
+	this->getAttributes()->addInt(BLOB_ACCT_INTERIM_INTERVAL, this->getAcctInterimInterval());
 
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Acct Interim Interval: " << this->getAcctInterimInterval() << "." << endl;
@@ -218,6 +235,9 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 		this->appendVsaBuf(iter1->second.getValue(), iter1->second.getLength() - 2);
 		iter1++;
 	}
+	if (this->getVsaBufLen() > 0) {
+		this->getAttributes()->add(BLOB_VSA, this->getVsaBuf(), this->getVsaBufLen());
+	}
 
 	// extract reply message
 	range = packet->findAttributes(ATTRIB_Reply_Message);
@@ -230,7 +250,7 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 		iter1++;
 	}
 
-	// extract class
+	// extract class, all Class attributes are sent back in the accounting packets (RFC 2865)
 	range = packet->findAttributes(ATTRIB_Class);
 	iter1 = range.first;
 	iter2 = range.second;
@@ -238,6 +258,9 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 		string klass((char*) iter1->second.getValue());
 		this->setClass(klass);
 	}
+	for (; iter1 != iter2; iter1++) {
+		this->getAttributes()->add(BLOB_CLASS, iter1->second.getValue(), iter1->second.getLength() - 2);
+	}
 
 	if (DEBUG (context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: class: " << this->getClass() << "." << endl;
@@ -245,21 +268,12 @@ void UserAuth::parseResponsePacket(RadiusPacket *packet, PluginContext * context
 
 
 int UserAuth::createCcdFile(PluginContext *context) {
-	ofstream ccdfile;
+	string ccdfile;
 	
-	char framedip[16];
 	char ipstring[100];
 	string filename;
-	char framedroutes[4096];
-	char framednetmask_cidr[3]; // ->/24
-	char framednetmask[16]; // ->255.255.255.0
-	char mask_part[6];
-	char framedgw[16];
-	char framedmetric[5]; //what is the biggest metric? 
-
-	double d1, d2;
-	
-	int j = 0, k = 0;
+	FramedRoute fr;
+	int offset;
 	
 
 	// check whether we really should write the config file
@@ -269,31 +283,11 @@ int UserAuth::createCcdFile(PluginContext *context) {
 	}
 
 	memset(ipstring, 0, 100);
-	memset(framedip, 0, 16);
-	memset(framedroutes, 0, 4096);
 
 
-	// create the filename, ccd-path + commonname
+	// the filename for the log, the file is written by the privileged helper, which builds the name itself
 	filename = context->conf.getCcdPath() + this->getCommonname();
 
-	if (DEBUG(context->getVerbosity()))
-		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Try to open ccd file." << endl;
-
-	// open the file
-	ccdfile.open(filename.c_str(), ios::out);
-
-	if (!ccdfile.is_open()) {
-		cerr << getTime() << "RADIUS-PLUGIN: Could not open file " << filename << "." << endl;
-		return 1;
-	}
-
-	if (DEBUG(context->getVerbosity()))
-		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Opened ccd file." << endl;
-
-
-	// copy in a temp-string, becaue strtok deletes the delimiter, if it is used anywhere
-	strncpy(framedroutes, this->getFramedRoutes().c_str(), 4095);
-
 	// set the ip address in the file
 	if (this->framedip[0] != '\0') {
 		if (DEBUG (context->getVerbosity()))
@@ -336,7 +330,9 @@ int UserAuth::createCcdFile(PluginContext *context) {
 			memcpy(&ip3, &ip2, 4);
 
 			// append the new ip address to the string
-			strncat(ipstring, inet_ntoa(ip3), 15);
+			char ip3string[INET_ADDRSTRLEN];
+			inet_ntop(AF_INET, &ip3, ip3string, sizeof(ip3string));
+			strncat(ipstring, ip3string, 15);
 
 			if (DEBUG (context->getVerbosity()))
 				cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Create ifconfig-push for topology net30." << endl;
@@ -344,159 +340,27 @@ int UserAuth::createCcdFile(PluginContext *context) {
 		if (DEBUG (context->getVerbosity()))
 			cerr << getTime() << "RADIUS-PLUGIN: Write " << ipstring << " ccd-file." << endl;
 
-		ccdfile << ipstring << "" << endl;
+		ccdfile.append(ipstring);
+		ccdfile.append("\n");
 	}
 
 	// set the framed routes in the file
-	if (framedroutes[0] != '\0') {
-		if (DEBUG(context->getVerbosity()))
-			cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Write framed routes to ccd-file." << endl;
+	for (offset = this->getAttributes()->find(BLOB_ROUTE); offset >= 0; offset = this->getAttributes()->find(BLOB_ROUTE, this->getAttributes()->next(offset))) {
+		// the value may be unaligned
+		memcpy(&fr, this->getAttributes()->getValue(offset), sizeof(fr));
+		string iroute = formatIroute(&fr);
 
-		char* route = strtok(framedroutes, ";");
-		int len = strlen(route);
-		if (len > 50) { //this is too big! but the length is variable
-			cerr << getTime() << "RADIUS-PLUGIN: Argument for Framed Route is to long (>50 Characters)." << endl;
-			return 1;
-		} else {
-			while (route != NULL) {
-				j = 0;
-				k = 0;
-				// set everything back for the next route entry
-				memset(mask_part, 0, 6);
-				memset(framednetmask_cidr, 0, 3);
-				memset(framedip, 0, 16);
-				memset(framednetmask, 0, 16);
-				memset(framedgw, 0, 16);
-				memset(framedmetric, 0, 5);
-				
-				// add ip address to string
-				while (route[j] != '/' && j < len) {
-					if (route[j] != ' ') {
-						framedip[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				k = 0;
-				j++;
-
-				// add netmask
-				while (route[j] != ' ' && j <= len) {
-					framednetmask_cidr[k] = route[j];
-					k++;
-					j++;
-				}
-				k = 0;
-
-				// jump spaces
-				while (route[j] == ' ' && j < len) {
-					j++;
-				}
-
-				// find gateway
-				while (route[j] != '/' && j < len) {
-					if (route[j] != ' ') {
-						framedgw[k] = route[j];
-						k++;
-					}
-					j++;
-				}
-				j++;
-
-				// find gateway netmask (this isn't used at the command route under linux)
-				while (route[j] != ' ' && j < len) {
-					j++;
-				}
-
-				// jump spaces
-				while (route[j] == ' ' && j < len) {
-					j++;
-				}
-
-				//find the metric
-				if (j <= len) {
-					k = 0;
-					while (route[j] != ' ' && j < len) {
-						framedmetric[k] = route[j];
-						k++;
-						j++;
-					}
-				}
-
-				// create string for client config file
-				// transform framednetmask_cidr
-				d2 = 7;
-				d1 = 0;
-				memset(framednetmask, 0, 16);
-				if (atoi(framednetmask_cidr) > 32) {
-					cerr << getTime() << "RADIUS-PLUGIN: Bad net CIDR netmask." << endl;
-				} else {
-					for (k = 1; k <= atoi(framednetmask_cidr); k++) {
-						d1 = d1 + pow(2, d2);
-						d2--;
-
-						if (k == 8) {
-							sprintf(mask_part, "%.0lf.", d1);
-							d1 = 0;
-							d2 = 7;
-							strncat(framednetmask, mask_part, 4);
-							memset(mask_part, 0, 6);
-						}
-						if (k == 16) {
-							sprintf(mask_part, "%.0lf.", d1);
-							d1 = 0;
-							d2 = 7;
-							strncat(framednetmask, mask_part, 4);
-							memset(mask_part, 0, 6);
-						}
-						if (k == 24) {
-							sprintf(mask_part, "%.0lf.", d1);
-							d1 = 0;
-							d2 = 7;
-							strncat(framednetmask, mask_part, 4);
-							memset(mask_part, 0, 6);
-						}
-					}
-					if (j < 8) {
-						sprintf(mask_part, "%.0lf.", d1);
-						d1 = 0;
-						strncat(framednetmask, mask_part, 4);
-						strncat(framednetmask, "0.0.0", 5);
-						memset(mask_part, 0, 6);
-					} else if (j < 16) {
-						sprintf(mask_part, "%.0lf.", d1);
-						d1 = 0;
-						strncat(framednetmask, mask_part, 4);
-						strncat(framednetmask, "0.0", 3);
-						memset(mask_part, 0, 6);
-					} else if (j < 24) {
-						sprintf(mask_part, "%.0lf.", d1);
-						d1 = 0;
-						strncat(framednetmask, mask_part, 4);
-						strncat(framednetmask, "0", 1);
-						memset(mask_part, 0, 6);
-					} else if (j > 24) {
-						sprintf(mask_part, "%.0lf", d1);
-						d1 = 0;
-						strncat(framednetmask, mask_part, 4);
-						memset(mask_part, 0, 6);
-					}
-
-				}
-
-				if (DEBUG(context->getVerbosity()))
-					cerr << getTime() << "RADIUS-PLUGIN: Write route string: iroute " << framedip << framednetmask << " to ccd-file." << endl;
-
-				// write iroute to client file
-				ccdfile << "iroute " << framedip << " " << framednetmask << endl;
+		if (DEBUG(context->getVerbosity()))
+			cerr << getTime() << "RADIUS-PLUGIN: Write route string: " << iroute << " to ccd-file." << endl;
 
-				route = strtok(NULL, ";");
-			}
-		}
+		ccdfile.append(iroute);
+		ccdfile.append("\n");
 	}
 
-	ccdfile.close();
-	
-	return 0;
+	if (DEBUG(context->getVerbosity()))
+		cerr << getTime() << "RADIUS-PLUGIN: BACKGROUND AUTH: Write ccd file " << filename << "." << endl;
+
+	// the file is written at once, OpenVPN never reads a partly written file
+	return context->privhelper.writeCcd(this->getCommonname(), ccdfile);
 }
 
@@ -29,6 +29,7 @@ UserPlugin::UserPlugin() :
 	this->accounted = false;
 	this->authenticated = false;
 	this->authcontrolfile = "";
+	this->queuetime = 0;
 }
 
 /**The destructor, nothing happens here.*/
@@ -47,6 +48,7 @@ UserPlugin & UserPlugin::operator=(const UserPlugin &u) {
 		this->password = u.password;
 		this->untrustedport = u.untrustedport;
 		this->authcontrolfile = u.authcontrolfile;
+		this->queuetime = u.queuetime;
 	}
 	return *this;
 	
@@ -73,6 +75,7 @@ UserPlugin::UserPlugin(const UserPlugin &u) :
 	this->accounted = u.accounted;
 	this->untrustedport = u.untrustedport;
 	this->authcontrolfile = u.authcontrolfile;
+	this->queuetime = u.queuetime;
 }
 
 /**The getter method of the password.
@@ -133,3 +136,17 @@ void UserPlugin::setAuthControlFile(string file) {
 	authcontrolfile = file;
 }
 
+
+/** The getter method for the time when the user was queued for the authentication thread.
+ * @return The time (monotonic, in microseconds).
+ */
+long long UserPlugin::getQueueTime(void) {
+	return this->queuetime;
+}
+
+/** The setter method for the time when the user was queued for the authentication thread.
+ * @param t The time (monotonic, in microseconds).
+ */
+void UserPlugin::setQueueTime(long long t) {
+	this->queuetime = t;
+}
@@ -56,6 +56,9 @@ public:
 	bool isAccounted(void);
 	void setAccounted(bool);
 
+	long long getQueueTime(void);
+	void setQueueTime(long long);
+
 private:
 	/** The user password.*/
 	string password;
@@ -68,6 +71,9 @@ private:
 
 	/** Indicates if a user is accounted.*/
 	bool accounted;
+
+	/** The time (monotonic, in microseconds) when the user was queued for the authentication thread.*/
+	long long queuetime;
 };
 
 #endif //_USERPLUGIN_H_
@@ -0,0 +1,312 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FakeRadiusServer.h"
+#include "../RadiusClass/RadiusPacket.h"
+#include "../RadiusClass/radius.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <gcrypt.h>
+
+/** The function opens a UDP socket on an unused port of the loopback interface.
+ * @return The socket or -1.
+ */
+static int openSocket(void) {
+	struct sockaddr_in addr;
+	int fd, size = 4 * 1024 * 1024;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	//the requests of thousands of clients can arrive in one burst, the kernel limits the size to rmem_max
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/** The function returns the port of a socket.
+ * @param fd The socket.
+ * @return The port or -1.
+ */
+static int getPort(int fd) {
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	if (fd < 0 || getsockname(fd, (struct sockaddr *) &addr, &len) != 0) {
+		return -1;
+	}
+	return ntohs(addr.sin_port);
+}
+
+/** The constructor of the class, the server answers at once, nothing is lost or rejected.*/
+FakeRadiusServer::FakeRadiusServer() {
+	this->authfd = -1;
+	this->acctfd = -1;
+	this->latency = 0;
+	this->jitter = 0;
+	this->loss = 0;
+	this->reject = 0;
+	this->interiminterval = 0;
+	this->seed = getpid();
+	this->stopping = false;
+	memset(&this->stats, 0, sizeof(this->stats));
+	pthread_mutex_init(&this->mutex, NULL);
+}
+
+/** The destructor stops the server.*/
+FakeRadiusServer::~FakeRadiusServer() {
+	this->stop();
+	pthread_mutex_destroy(&this->mutex);
+}
+
+/** The setter method for the delay of the responses.
+ * @param l The delay in microseconds.
+ * @param j The maximal random addition in microseconds.
+ */
+void FakeRadiusServer::setLatency(long l, long j) {
+	this->latency = l;
+	this->jitter = j;
+}
+
+/** The setter method for the ratio of the requests which aren't answered.
+ * @param l The ratio between 0 and 1.
+ */
+void FakeRadiusServer::setLoss(double l) {
+	this->loss = l;
+}
+
+/** The setter method for the ratio of the rejected Access-Requests.
+ * @param r The ratio between 0 and 1.
+ */
+void FakeRadiusServer::setReject(double r) {
+	this->reject = r;
+}
+
+/** The setter method for the Acct-Interim-Interval of the Access-Accepts.
+ * @param i The interval in seconds, 0 adds no attribute.
+ */
+void FakeRadiusServer::setInterimInterval(int i) {
+	this->interiminterval = i;
+}
+
+/** The method opens the sockets and starts the thread.
+ * @param s The shared secret.
+ * @return 0 or -1 if the server can't be started.
+ */
+int FakeRadiusServer::start(string s) {
+	this->secret = s;
+	this->authfd = openSocket();
+	this->acctfd = openSocket();
+	this->stopping = false;
+	if (this->authfd < 0 || this->acctfd < 0 || pthread_create(&this->thread, NULL, &FakeRadiusServer::run, this) != 0) {
+		if (this->authfd >= 0) {
+			close(this->authfd);
+		}
+		if (this->acctfd >= 0) {
+			close(this->acctfd);
+		}
+		this->authfd = -1;
+		this->acctfd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/** The method stops the thread and closes the sockets, waiting responses are dropped.*/
+void FakeRadiusServer::stop(void) {
+	if (this->authfd < 0) {
+		return;
+	}
+	this->stopping = true;
+	pthread_join(this->thread, NULL);
+	close(this->authfd);
+	close(this->acctfd);
+	this->authfd = -1;
+	this->acctfd = -1;
+	this->pending.clear();
+}
+
+/** The getter method for the authentication port.
+ * @return The port.
+ */
+int FakeRadiusServer::getAuthPort(void) {
+	return getPort(this->authfd);
+}
+
+/** The getter method for the accounting port.
+ * @return The port.
+ */
+int FakeRadiusServer::getAcctPort(void) {
+	return getPort(this->acctfd);
+}
+
+/** The getter method for the counters.
+ * @return A copy of the counters.
+ */
+FakeRadiusStats FakeRadiusServer::getStats(void) {
+	FakeRadiusStats s;
+
+	pthread_mutex_lock(&this->mutex);
+	s = this->stats;
+	pthread_mutex_unlock(&this->mutex);
+	return s;
+}
+
+/** The function of the thread, it receives the requests and sends the delayed responses.
+ * @param arg A pointer to the FakeRadiusServer.
+ * @return NULL.
+ */
+void * FakeRadiusServer::run(void * arg) {
+	FakeRadiusServer * server = (FakeRadiusServer *) arg;
+	struct pollfd fds[2];
+	long long now, timeout;
+
+	fds[0].fd = server->authfd;
+	fds[1].fd = server->acctfd;
+	fds[0].events = fds[1].events = POLLIN;
+	while (!server->stopping) {
+		//wait for a request, the next response or at most 10ms for the stop
+		now = monotonicTime();
+		timeout = 10000;
+		if (!server->pending.empty() && server->pending.begin()->first - now < timeout) {
+			timeout = max(0LL, server->pending.begin()->first - now);
+		}
+		if (poll(fds, 2, (timeout + 999) / 1000) > 0) {
+			if (fds[0].revents & POLLIN) {
+				server->receive(server->authfd);
+			}
+			if (fds[1].revents & POLLIN) {
+				server->receive(server->acctfd);
+			}
+		}
+		server->respond(monotonicTime());
+	}
+	return NULL;
+}
+
+/** The method receives a request and creates the response, which is sent after the latency.
+ * @param fd The socket.
+ */
+void FakeRadiusServer::receive(int fd) {
+	unsigned char buf[RADIUS_MAX_PACKET_LEN], out[RADIUS_MAX_PACKET_LEN];
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	unsigned char digest[16];
+	FakeResponse response;
+	ssize_t n;
+	int len, pos, statustype = 0, outlen;
+	bool drop;
+
+	n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *) &addr, &addrlen);
+	if (n < 20 || (len = (buf[2] << 8) | buf[3]) > n || len < 20) {
+		return;
+	}
+	for (pos = 20; pos + 2 <= len && buf[pos + 1] >= 2; pos += buf[pos + 1]) {
+		if (buf[pos] == ATTRIB_Acct_Status_Type && buf[pos + 1] == 6) {
+			statustype = buf[pos + 5];
+		}
+	}
+
+	pthread_mutex_lock(&this->mutex);
+	drop = rand_r(&this->seed) < this->loss * RAND_MAX;
+	if (drop) {
+		this->stats.dropped++;
+	} else if (buf[0] == ACCESS_REQUEST) {
+		this->stats.accessrequests++;
+	}
+	pthread_mutex_unlock(&this->mutex);
+	if (drop) {
+		return;
+	}
+
+	//the response without the authenticator
+	outlen = 20;
+	if (buf[0] == ACCESS_REQUEST) {
+		pthread_mutex_lock(&this->mutex);
+		if (rand_r(&this->seed) < this->reject * RAND_MAX) {
+			out[0] = ACCESS_REJECT;
+			this->stats.rejects++;
+		} else {
+			out[0] = ACCESS_ACCEPT;
+			this->stats.accepts++;
+		}
+		pthread_mutex_unlock(&this->mutex);
+		if (out[0] == ACCESS_ACCEPT && this->interiminterval > 0) {
+			out[outlen] = ATTRIB_Acct_Interim_Interval;
+			out[outlen + 1] = 6;
+			out[outlen + 2] = this->interiminterval >> 24;
+			out[outlen + 3] = this->interiminterval >> 16;
+			out[outlen + 4] = this->interiminterval >> 8;
+			out[outlen + 5] = this->interiminterval;
+			outlen += 6;
+		}
+	} else if (buf[0] == ACCOUNTING_REQUEST) {
+		out[0] = ACCOUNTING_RESPONSE;
+		pthread_mutex_lock(&this->mutex);
+		if (statustype == 1) {
+			this->stats.starts++;
+		} else if (statustype == 2) {
+			this->stats.stops++;
+		} else if (statustype == 3) {
+			this->stats.updates++;
+		}
+		pthread_mutex_unlock(&this->mutex);
+	} else {
+		return;
+	}
+	out[1] = buf[1];
+	out[2] = outlen >> 8;
+	out[3] = outlen;
+
+	//the response authenticator is MD5(code+id+length+request authenticator+attributes+secret)
+	memcpy(out + 4, buf + 4, 16);
+	memcpy(out + outlen, this->secret.data(), this->secret.size());
+	gcry_md_hash_buffer(GCRY_MD_MD5, digest, out, outlen + this->secret.size());
+	memcpy(out + 4, digest, 16);
+
+	response.fd = fd;
+	response.addr = addr;
+	response.packet.assign((char *) out, outlen);
+	this->pending.insert(make_pair(monotonicTime() + this->latency + (this->jitter > 0 ? rand_r(&this->seed) % this->jitter : 0), response));
+}
+
+/** The method sends the responses whose latency is over.
+ * @param now The time (monotonic, in microseconds).
+ */
+void FakeRadiusServer::respond(long long now) {
+	multimap<long long, FakeResponse>::iterator iter;
+
+	while (!this->pending.empty() && (iter = this->pending.begin())->first <= now) {
+		sendto(iter->second.fd, iter->second.packet.data(), iter->second.packet.size(), 0, (struct sockaddr *) &iter->second.addr, sizeof(iter->second.addr));
+		this->pending.erase(iter);
+	}
+}
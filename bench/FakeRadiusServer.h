@@ -0,0 +1,95 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FAKE_RADIUS_SERVER_H_
+#define _FAKE_RADIUS_SERVER_H_
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+using namespace std;
+
+/** The number of packets the fake server received and answered.*/
+struct FakeRadiusStats {
+	uint64_t accessrequests; /**< The received Access-Requests.*/
+	uint64_t accepts; /**< The sent Access-Accepts.*/
+	uint64_t rejects; /**< The sent Access-Rejects.*/
+	uint64_t starts; /**< The answered Accounting-Requests with the status type start.*/
+	uint64_t updates; /**< The answered Accounting-Requests with the status type interim update.*/
+	uint64_t stops; /**< The answered Accounting-Requests with the status type stop.*/
+	uint64_t dropped; /**< The requests which weren't answered because of the loss ratio.*/
+};
+
+/** A response which waits for its latency.*/
+struct FakeResponse {
+	int fd; /**< The socket of the server.*/
+	struct sockaddr_in addr; /**< The address of the client.*/
+	string packet; /**< The packet.*/
+};
+
+/** The class is a RADIUS server for benchmarks, it runs in a thread of the calling process
+ * on two UDP ports of the loopback interface. Every Access-Request gets an Access-Accept, or an
+ * Access-Reject with the reject ratio, and every Accounting-Request an Accounting-Response.
+ * A request is not answered with the loss ratio, the responses are delayed by the latency
+ * and a random jitter.
+ */
+class FakeRadiusServer {
+private:
+	int authfd; /**< The socket for the authentication.*/
+	int acctfd; /**< The socket for the accounting.*/
+	string secret; /**< The shared secret.*/
+	long latency; /**< The delay of a response in microseconds.*/
+	long jitter; /**< The maximal random addition to the delay in microseconds.*/
+	double loss; /**< The ratio of the requests which aren't answered.*/
+	double reject; /**< The ratio of the Access-Requests which are rejected.*/
+	int interiminterval; /**< The Acct-Interim-Interval in the Access-Accepts, 0 adds no attribute.*/
+	unsigned int seed; /**< The state of the random numbers.*/
+	multimap<long long, FakeResponse> pending; /**< The delayed responses by the time when they are sent.*/
+	FakeRadiusStats stats; /**< The counters.*/
+	pthread_mutex_t mutex; /**< The mutex for the counters.*/
+	pthread_t thread; /**< The thread of the server.*/
+	volatile bool stopping; /**< True if the thread must end.*/
+
+	static void * run(void *);
+	void receive(int);
+	void respond(long long);
+
+public:
+	FakeRadiusServer();
+	~FakeRadiusServer();
+
+	void setLatency(long, long);
+	void setLoss(double);
+	void setReject(double);
+	void setInterimInterval(int);
+
+	int start(string);
+	void stop(void);
+
+	int getAuthPort(void);
+	int getAcctPort(void);
+	FakeRadiusStats getStats(void);
+};
+
+#endif //_FAKE_RADIUS_SERVER_H_
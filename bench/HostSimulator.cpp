@@ -0,0 +1,456 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+//the types of the plugin functions are declared like in OpenVPN
+#define OPENVPN_PLUGIN_H
+#include "../openvpn-plugin.h"
+#include "FakeRadiusServer.h"
+#include "../RadiusClass/RadiusPacket.h"
+#include "../RadiusClass/RadiusHistogram.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/** The simulator of an OpenVPN server. It loads the plugin with dlopen like OpenVPN and calls its
+ * exported functions from one thread, the OpenVPN thread, for many virtual clients against a FakeRadiusServer.
+ * With -d the authentication is deferred: every client gets an auth_control_file, up to the window of
+ * clients are authenticated at the same time and the files are polled like OpenVPN does in its event loop.
+ * The status file of OpenVPN is written every second while the clients are connected.
+ * With -I the plugin is opened several times like by OpenVPN with several plugin lines, the clients
+ * are distributed to the instances, so the background processes of the later instances are forked
+ * while the earlier ones are running.
+ * The connect and disconnect rates and the time the OpenVPN thread is blocked in the plugin are reported.
+ *
+ * Usage: hostsim [-p plugin] [-n clients] [-c cycles] [-h hold seconds] [-i interim interval]
+ *                [-l latency usec] [-j jitter usec] [-L loss ratio] [-r reject ratio]
+ *                [-d] [-w window] [-t timeout seconds] [-I instances] [-v verb] [-o option=value]...
+ */
+
+/** The state of a virtual client.*/
+enum ClientState {
+	CLIENT_IDLE, /**< The client is not connected.*/
+	CLIENT_DEFERRED, /**< The authentication is deferred, the auth_control_file is polled.*/
+	CLIENT_CONNECTED /**< The client is connected.*/
+};
+
+/** A virtual client.*/
+struct VirtualClient {
+	ClientState state; /**< The state.*/
+	long long authstart; /**< The time when the deferred authentication was started.*/
+};
+
+/** The results of one kind of plugin call.*/
+struct HostPhase {
+	const char * name; /**< The name of the call.*/
+	RadiusHistogram blocking; /**< The time the OpenVPN thread was blocked in the plugin in microseconds.*/
+	long long blocked; /**< The sum of the blocking times in microseconds.*/
+	int failed; /**< The number of calls which didn't succeed.*/
+};
+
+/** The plugin and the environment of the clients.*/
+struct PluginHost {
+	openvpn_plugin_func_v2 func_v2; /**< The function of the plugin, if it is exported.*/
+	openvpn_plugin_func_v1 func_v1; /**< The function of the plugin, if func_v2 isn't exported.*/
+	vector<openvpn_plugin_handle_t> handles; /**< The handles of the instances of the plugin.*/
+	const char ** argv; /**< The arguments of the plugin.*/
+	string dir; /**< The directory of the config, the status file and the auth_control_files.*/
+};
+
+/** The function prints the usage.
+ * @param name The name of the program.
+ */
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-p plugin] [-n clients] [-c cycles] [-h hold seconds] [-i interim interval] [-l latency usec] [-j jitter usec] "
+		"[-L loss ratio] [-r reject ratio] [-d] [-w window] [-t timeout seconds] [-I instances] [-v verb] [-o option=value]...\n", name);
+	exit(1);
+}
+
+/** The function writes the status file of OpenVPN with the counters of the connected clients.
+ * @param path The path.
+ * @param clients The clients.
+ * @param tick The counters grow with every tick.
+ */
+static void writeStatusFile(string path, vector<VirtualClient> & clients, int tick) {
+	string tmp = path + ".tmp";
+	FILE * file = fopen(tmp.c_str(), "w");
+	int i;
+
+	if (file == NULL) {
+		return;
+	}
+	fprintf(file, "OpenVPN CLIENT LIST\nUpdated,Thu Jan  1 00:00:00 1970\nCommon Name,Real Address,Bytes Received,Bytes Sent,Connected Since\n");
+	for (i = 0; i < (int) clients.size(); i++) {
+		if (clients[i].state == CLIENT_CONNECTED) {
+			fprintf(file, "client%d,127.0.0.1:%d,%d,%d,Thu Jan  1 00:00:00 1970\n", i, 10000 + i, 1000 * (tick + 1) + i, 2000 * (tick + 1) + i);
+		}
+	}
+	fprintf(file, "ROUTING TABLE\nGLOBAL STATS\nEND\n");
+	fclose(file);
+	//OpenVPN replaces the file, so the plugin never reads a half written file
+	rename(tmp.c_str(), path.c_str());
+}
+
+/** The function calls the plugin like the OpenVPN thread and measures the time it is blocked.
+ * @param host The plugin.
+ * @param phase The results of the call.
+ * @param type The type of the call.
+ * @param client The number of the client.
+ * @param deferred True if an auth_control_file is passed.
+ * @return The result of the plugin.
+ */
+static int callPlugin(PluginHost * host, HostPhase * phase, int type, int client, bool deferred) {
+	char username[64], commonname[64], port[64], ip[64], controlfile[512];
+	openvpn_plugin_handle_t handle = host->handles[client % host->handles.size()];
+	long long start, t;
+	int result;
+
+	sprintf(username, "username=user%d", client);
+	sprintf(commonname, "common_name=client%d", client);
+	sprintf(port, "untrusted_port=%d", 10000 + client);
+	sprintf(ip, "ifconfig_pool_remote_ip=10.%d.%d.%d", 8 + client / 65536, (client / 256) % 256, client % 256);
+	snprintf(controlfile, sizeof(controlfile), "auth_control_file=%s/acf/%d", host->dir.c_str(), client);
+	const char * envp[] = { username, "password=benchpassword", "untrusted_ip=127.0.0.1", commonname, port, ip,
+			deferred ? controlfile : NULL, NULL };
+
+	start = monotonicTime();
+	if (host->func_v2 != NULL) {
+		result = host->func_v2(handle, type, host->argv, envp, NULL, NULL);
+	} else {
+		result = host->func_v1(handle, type, host->argv, envp);
+	}
+	t = monotonicTime() - start;
+	phase->blocking.record(t);
+	phase->blocked += t;
+	return result;
+}
+
+/** The function reads the auth_control_file of a client.
+ * @param host The plugin.
+ * @param client The number of the client.
+ * @return '1' if the client is authenticated, '0' if it is rejected or 0 if the file is still empty.
+ */
+static char readAuthControlFile(PluginHost * host, int client) {
+	char path[512], c = 0;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/acf/%d", host->dir.c_str(), client);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if (read(fd, &c, 1) != 1) {
+			c = 0;
+		}
+		close(fd);
+	}
+	return c;
+}
+
+/** The function prints the results of a phase.
+ * @param phase The phase.
+ */
+static void printPhase(HostPhase * phase) {
+	printf("%-10s %8llu calls %6d failed  blocked %9lld us  p50 %7ld us  p90 %7ld us  p99 %7ld us  max %7ld us\n", phase->name,
+			(unsigned long long) phase->blocking.getCount(), phase->failed, phase->blocked, phase->blocking.getPercentile(50),
+			phase->blocking.getPercentile(90), phase->blocking.getPercentile(99), phase->blocking.getMax());
+}
+
+int main(int argc, char ** argv) {
+	int clients = 1000, cycles = 1, hold = 0, interim = 0, window = 256, timeout = 30, instances = 1, verb = 1, opt, i, cycle, result, next,
+			pending, connected, tick;
+	long latency = 0, jitter = 0;
+	double loss = 0, reject = 0;
+	bool deferred = false, progress;
+	const char * plugin = "./openvpn-auth-radius.so";
+	vector<string> options;
+	FakeRadiusServer server;
+	FakeRadiusStats stats;
+	HostPhase phases[3];
+	RadiusHistogram authtime;
+	PluginHost host;
+	char dir[] = "/tmp/hostsim.XXXXXX";
+	char controlfile[512], verbenv[32];
+	long long start, t, connecttime = 0, disconnecttime = 0, closetime, now;
+	unsigned long long connects = 0, disconnects = 0;
+	unsigned int type_mask = 0;
+	void * lib;
+	char c;
+
+	while ((opt = getopt(argc, argv, "p:n:c:h:i:l:j:L:r:dw:t:I:v:o:")) != -1) {
+		switch (opt) {
+			case 'p':
+				plugin = optarg;
+				break;
+			case 'n':
+				clients = atoi(optarg);
+				break;
+			case 'c':
+				cycles = atoi(optarg);
+				break;
+			case 'h':
+				hold = atoi(optarg);
+				break;
+			case 'i':
+				interim = atoi(optarg);
+				break;
+			case 'l':
+				latency = atol(optarg);
+				break;
+			case 'j':
+				jitter = atol(optarg);
+				break;
+			case 'L':
+				loss = atof(optarg);
+				break;
+			case 'r':
+				reject = atof(optarg);
+				break;
+			case 'd':
+				deferred = true;
+				break;
+			case 'w':
+				window = atoi(optarg);
+				break;
+			case 't':
+				timeout = atoi(optarg);
+				break;
+			case 'I':
+				instances = atoi(optarg);
+				break;
+			case 'v':
+				verb = atoi(optarg);
+				break;
+			case 'o':
+				options.push_back(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (clients <= 0 || clients > 60000 || cycles <= 0 || window <= 0 || timeout <= 0 || instances <= 0) {
+		usage(argv[0]);
+	}
+
+	//OpenVPN ignores SIGPIPE, a write of the plugin to a closed connection of the radius daemon fails
+	signal(SIGPIPE, SIG_IGN);
+
+	//load the plugin like OpenVPN, func_v2 is preferred to func_v1
+	lib = dlopen(plugin, RTLD_NOW);
+	if (lib == NULL) {
+		fprintf(stderr, "The plugin could not be loaded: %s\n", dlerror());
+		return 1;
+	}
+	openvpn_plugin_open_v2 open_v2 = (openvpn_plugin_open_v2) dlsym(lib, "openvpn_plugin_open_v2");
+	openvpn_plugin_close_v1 close_v1 = (openvpn_plugin_close_v1) dlsym(lib, "openvpn_plugin_close_v1");
+	host.func_v2 = (openvpn_plugin_func_v2) dlsym(lib, "openvpn_plugin_func_v2");
+	host.func_v1 = (openvpn_plugin_func_v1) dlsym(lib, "openvpn_plugin_func_v1");
+	if (open_v2 == NULL || close_v1 == NULL || (host.func_v2 == NULL && host.func_v1 == NULL)) {
+		fprintf(stderr, "The plugin doesn't export openvpn_plugin_open_v2, openvpn_plugin_func_v1/v2 and openvpn_plugin_close_v1.\n");
+		return 1;
+	}
+
+	//start the server, it is only in this process, the plugin closes its sockets in the background processes
+	server.setLatency(latency, jitter);
+	server.setLoss(loss);
+	server.setReject(reject);
+	server.setInterimInterval(interim);
+	if (server.start("benchsecret") != 0) {
+		fprintf(stderr, "The fake radius server could not be started.\n");
+		return 1;
+	}
+
+	//the config files of the plugin and of OpenVPN
+	if (mkdtemp(dir) == NULL) {
+		fprintf(stderr, "The directory for the config could not be created.\n");
+		return 1;
+	}
+	host.dir = dir;
+	mkdir((host.dir + "/ccd").c_str(), 0700);
+	mkdir((host.dir + "/acf").c_str(), 0700);
+	FILE * file = fopen((host.dir + "/openvpn.conf").c_str(), "w");
+	fprintf(file, "client-config-dir %s/ccd\nstatus %s/status 1\n", dir, dir);
+	fclose(file);
+	vector<VirtualClient> vclients(clients);
+	for (i = 0; i < clients; i++) {
+		vclients[i].state = CLIENT_IDLE;
+		vclients[i].authstart = 0;
+	}
+	writeStatusFile(host.dir + "/status", vclients, 0);
+	file = fopen((host.dir + "/radiusplugin.conf").c_str(), "w");
+	fprintf(file, "NAS-Identifier=hostsim\nService-Type=5\nFramed-Protocol=1\nNAS-Port-Type=5\nNAS-IP-Address=127.0.0.1\n"
+		"OpenVPNConfig=%s/openvpn.conf\noverwriteccfiles=true\nsessionslots=%d\nuseauthcontrolfile=%s\n", dir, (clients + instances - 1) / instances + 16,
+			deferred ? "true" : "false");
+	for (i = 0; i < (int) options.size(); i++) {
+		fprintf(file, "%s\n", options[i].c_str());
+	}
+	fprintf(file, "server\n{\n\tacctport=%d\n\tauthport=%d\n\tname=127.0.0.1\n\tretry=3\n\twait=1\n\tsharedsecret=benchsecret\n}\n", server.getAcctPort(),
+			server.getAuthPort());
+	fclose(file);
+
+	string conf = host.dir + "/radiusplugin.conf";
+	const char * pluginargv[] = { plugin, conf.c_str(), NULL };
+	snprintf(verbenv, sizeof(verbenv), "verb=%d", verb);
+	const char * pluginenv[] = { verbenv, NULL };
+	host.argv = pluginargv;
+	for (i = 0; i < instances; i++) {
+		openvpn_plugin_handle_t handle = open_v2(&type_mask, pluginargv, pluginenv, NULL);
+		if (handle == NULL) {
+			fprintf(stderr, "The plugin could not be opened.\n");
+			return 1;
+		}
+		host.handles.push_back(handle);
+	}
+
+	phases[0].name = "auth";
+	phases[1].name = "connect";
+	phases[2].name = "disconnect";
+	for (i = 0; i < 3; i++) {
+		phases[i].blocking.reset();
+		phases[i].blocked = 0;
+		phases[i].failed = 0;
+	}
+	authtime.reset();
+
+	tick = 0;
+	for (cycle = 0; cycle < cycles; cycle++) {
+		//authenticate and connect all clients, the deferred authentications run in the window
+		start = monotonicTime();
+		next = 0;
+		pending = 0;
+		connected = 0;
+		while (next < clients || pending > 0) {
+			progress = false;
+			while (next < clients && (!deferred || pending < window)) {
+				i = next++;
+				progress = true;
+				if (deferred) {
+					//OpenVPN creates the empty file before the call
+					snprintf(controlfile, sizeof(controlfile), "%s/acf/%d", dir, i);
+					close(open(controlfile, O_WRONLY | O_CREAT | O_TRUNC, 0600));
+				}
+				result = callPlugin(&host, &phases[0], OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY, i, deferred);
+				if (result == OPENVPN_PLUGIN_FUNC_DEFERRED) {
+					vclients[i].state = CLIENT_DEFERRED;
+					vclients[i].authstart = monotonicTime();
+					pending++;
+				} else if (result == OPENVPN_PLUGIN_FUNC_SUCCESS) {
+					if (callPlugin(&host, &phases[1], OPENVPN_PLUGIN_CLIENT_CONNECT, i, false) == OPENVPN_PLUGIN_FUNC_SUCCESS) {
+						vclients[i].state = CLIENT_CONNECTED;
+						connected++;
+					} else {
+						phases[1].failed++;
+					}
+				} else {
+					phases[0].failed++;
+				}
+			}
+
+			//poll the auth_control_files of the deferred authentications
+			now = monotonicTime();
+			for (i = 0; i < next && pending > 0; i++) {
+				if (vclients[i].state != CLIENT_DEFERRED) {
+					continue;
+				}
+				c = readAuthControlFile(&host, i);
+				if (c == 0 && now - vclients[i].authstart < timeout * 1000000LL) {
+					continue;
+				}
+				progress = true;
+				pending--;
+				authtime.record(now - vclients[i].authstart);
+				vclients[i].state = CLIENT_IDLE;
+				if (c != '1') {
+					phases[0].failed++;
+				} else if (callPlugin(&host, &phases[1], OPENVPN_PLUGIN_CLIENT_CONNECT, i, false) == OPENVPN_PLUGIN_FUNC_SUCCESS) {
+					vclients[i].state = CLIENT_CONNECTED;
+					connected++;
+				} else {
+					phases[1].failed++;
+				}
+			}
+			if (!progress) {
+				usleep(1000);
+			}
+		}
+		connecttime += monotonicTime() - start;
+		connects += connected;
+
+		//the interim updates are sent while the clients are connected, the status file is written every second
+		for (i = 0; i <= hold; i++) {
+			writeStatusFile(host.dir + "/status", vclients, ++tick);
+			if (i < hold) {
+				sleep(1);
+			}
+		}
+
+		//disconnect the connected clients
+		start = monotonicTime();
+		for (i = 0; i < clients; i++) {
+			if (vclients[i].state != CLIENT_CONNECTED) {
+				continue;
+			}
+			vclients[i].state = CLIENT_IDLE;
+			if (callPlugin(&host, &phases[2], OPENVPN_PLUGIN_CLIENT_DISCONNECT, i, false) == OPENVPN_PLUGIN_FUNC_SUCCESS) {
+				disconnects++;
+			} else {
+				phases[2].failed++;
+			}
+		}
+		disconnecttime += monotonicTime() - start;
+		writeStatusFile(host.dir + "/status", vclients, tick);
+	}
+
+	//the stop packets are sent when the plugin is closed at the latest
+	start = monotonicTime();
+	for (i = 0; i < instances; i++) {
+		close_v1(host.handles[i]);
+	}
+	closetime = monotonicTime() - start;
+	stats = server.getStats();
+	server.stop();
+	dlclose(lib);
+
+	printf("clients %d, instances %d, cycles %d, hold %d s, interim %d s, latency %ld us, jitter %ld us, loss %.3f, reject %.3f, %s %s\n", clients,
+			instances, cycles, hold, interim, latency, jitter, loss, reject, deferred ? "deferred" : "synchronous", host.func_v2 != NULL ? "func_v2" : "func_v1");
+	printf("connect    %8llu clients %10.0f clients/s\n", connects, connecttime > 0 ? connects * 1000000.0 / connecttime : 0);
+	printf("disconnect %8llu clients %10.0f clients/s\n", disconnects, disconnecttime > 0 ? disconnects * 1000000.0 / disconnecttime : 0);
+	for (i = 0; i < 3; i++) {
+		printPhase(&phases[i]);
+	}
+	if (deferred) {
+		printf("deferred   %8llu auths   p50 %7ld us  p90 %7ld us  p99 %7ld us  max %7ld us\n", (unsigned long long) authtime.getCount(),
+				authtime.getPercentile(50), authtime.getPercentile(90), authtime.getPercentile(99), authtime.getMax());
+	}
+	t = connecttime + disconnecttime;
+	printf("blocked    %10lld us of %lld us connect and disconnect time (%.1f%%)\n", phases[0].blocked + phases[1].blocked + phases[2].blocked, t,
+			t > 0 ? (phases[0].blocked + phases[1].blocked + phases[2].blocked) * 100.0 / t : 0);
+	printf("close      %10lld us\n", closetime);
+	printf("server     %llu access requests, %llu accepts, %llu rejects, %llu starts, %llu updates, %llu stops, %llu dropped\n",
+			(unsigned long long) stats.accessrequests, (unsigned long long) stats.accepts, (unsigned long long) stats.rejects,
+			(unsigned long long) stats.starts, (unsigned long long) stats.updates, (unsigned long long) stats.stops,
+			(unsigned long long) stats.dropped);
+
+	system((string("rm -rf ") + dir).c_str());
+	return 0;
+}
@@ -0,0 +1,433 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "../RadiusClass/RadiusPacket.h"
+#include "../RadiusClass/RadiusAttribute.h"
+#include "../RadiusClass/radius.h"
+#include <gcrypt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+#include <map>
+
+/** The micro-benchmarks of the packet encoding and decoding and of the password hashing.
+ * Every benchmark is run with doubled iterations until it takes the minimal time,
+ * the time and the number of heap allocations of the last run are reported per operation.
+ *
+ * Usage: packetbench [-t milliseconds] [-w file] [-b file] [-T percent]
+ * -w writes the results to a file, -b compares the results with a file written before
+ * and exits with 1 if a benchmark got slower by more than -T percent (default 10)
+ * or needs more allocations.
+ */
+
+/** The number of heap allocations since the last reset.*/
+static unsigned long long allocations = 0;
+
+#ifdef __GLIBC__
+//all allocations, also of libgcrypt and of operator new, go through malloc
+extern "C" {
+void * __libc_malloc(size_t);
+void * __libc_calloc(size_t, size_t);
+void * __libc_realloc(void *, size_t);
+
+void * malloc(size_t size) {
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void * calloc(size_t n, size_t size) {
+	allocations++;
+	return __libc_calloc(n, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+}
+#else
+//without glibc only the allocations with new are counted
+void * operator new(size_t size) throw (std::bad_alloc) {
+	void * ptr;
+
+	allocations++;
+	if ((ptr = malloc(size ? size : 1)) == NULL) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void * operator new[](size_t size) throw (std::bad_alloc) {
+	return operator new(size);
+}
+
+void operator delete(void * ptr) throw () {
+	free(ptr);
+}
+
+void operator delete[](void * ptr) throw () {
+	free(ptr);
+}
+#endif
+
+/** The shared secret of the benchmarks.*/
+#define BENCH_SECRET "benchsecret"
+
+/** The time of the monotonic clock.
+ * @return The time in nanoseconds.
+ */
+static long long nanoTime(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** The class holds the packets of the benchmarks. It is a friend of RadiusPacket,
+ * so the private methods which shape and unshape the packets can be called directly.
+ */
+class RadiusPacketBench {
+private:
+	RadiusPacket * request; /**< An Access-Request with a 64 byte password.*/
+	RadiusPacket * interim; /**< An Accounting-Request (Interim-Update) with 20 attributes.*/
+	RadiusPacket * accept; /**< The Access-Accept with 50 Framed-Routes and VSAs in its receive buffer, the request is in its send buffer.*/
+	RadiusAttribute * password; /**< The password attribute of the request.*/
+	char hpassword[64]; /**< The buffer for the hashed password.*/
+
+	void addAttribute(RadiusPacket *, Octet, string);
+	void addVendorAttribute(RadiusPacket *, int, Octet, string);
+
+public:
+	RadiusPacketBench();
+	~RadiusPacketBench();
+
+	int setUp(void);
+
+	void hashPassword(void);
+	void shapeAccessRequest(void);
+	void shapeAccountingInterim(void);
+	void digestAccountingInterim(void);
+	void unShapeAccessAccept(void);
+	void authenticateAccessAccept(void);
+};
+
+/** The constructor of the class.*/
+RadiusPacketBench::RadiusPacketBench() {
+	this->request = new RadiusPacket(ACCESS_REQUEST);
+	this->interim = new RadiusPacket(ACCOUNTING_REQUEST);
+	this->accept = new RadiusPacket(ACCESS_ACCEPT);
+	this->password = NULL;
+}
+
+/** The destructor of the class.*/
+RadiusPacketBench::~RadiusPacketBench() {
+	delete this->request;
+	delete this->interim;
+	delete this->accept;
+	delete this->password;
+}
+
+/** The method adds an attribute to a packet.
+ * @param packet The packet.
+ * @param type The type of the attribute.
+ * @param value The value as it is given to RadiusAttribute::setValue.
+ */
+void RadiusPacketBench::addAttribute(RadiusPacket * packet, Octet type, string value) {
+	RadiusAttribute ra(type, value);
+	packet->addRadiusAttribute(&ra);
+}
+
+/** The method adds a vendor specific attribute to a packet.
+ * @param packet The packet.
+ * @param vendor The vendor id.
+ * @param type The vendor type.
+ * @param value The value.
+ */
+void RadiusPacketBench::addVendorAttribute(RadiusPacket * packet, int vendor, Octet type, string value) {
+	char buf[256];
+	RadiusAttribute ra;
+
+	buf[0] = (vendor >> 24) & 0xFF;
+	buf[1] = (vendor >> 16) & 0xFF;
+	buf[2] = (vendor >> 8) & 0xFF;
+	buf[3] = vendor & 0xFF;
+	buf[4] = type;
+	buf[5] = value.size() + 2;
+	memcpy(buf + 6, value.data(), value.size());
+	ra.setType(ATTRIB_Vendor_Specific);
+	ra.setValue(buf);
+	packet->addRadiusAttribute(&ra);
+}
+
+/** The method creates the packets. The Access-Accept is shaped like a packet of a server:
+ * its authenticator is built over the authenticator of the request, so it can be authenticated.
+ * @return 0 or -1 if the packets are not correct.
+ */
+int RadiusPacketBench::setUp(void) {
+	char route[64], value[64];
+	unsigned char digest[MD5_DIGEST_LENGTH];
+	Octet * buf;
+	int i;
+
+	//the request of a client, see UserAuth::sendAcceptRequestPacket
+	this->addAttribute(this->request, ATTRIB_User_Name, "user@example.org");
+	this->addAttribute(this->request, ATTRIB_User_Password, string(64, 'p'));
+	this->addAttribute(this->request, ATTRIB_NAS_IP_Address, "192.168.0.1");
+	this->addAttribute(this->request, ATTRIB_NAS_Port, "42");
+	this->addAttribute(this->request, ATTRIB_Calling_Station_Id, "203.0.113.7");
+	this->addAttribute(this->request, ATTRIB_NAS_Identifier, "openvpn");
+	this->addAttribute(this->request, ATTRIB_Service_Type, "5");
+	this->addAttribute(this->request, ATTRIB_Framed_Protocol, "1");
+	this->addAttribute(this->request, ATTRIB_NAS_Port_Type, "5");
+	this->password = new RadiusAttribute(ATTRIB_User_Password, string(64, 'p'));
+	if (this->request->shapeRadiusPacket(BENCH_SECRET) != 0) {
+		return -1;
+	}
+
+	//an interim update, see UserAcct::sendUpdatePacket
+	this->addAttribute(this->interim, ATTRIB_User_Name, "user@example.org");
+	this->addAttribute(this->interim, ATTRIB_NAS_IP_Address, "192.168.0.1");
+	this->addAttribute(this->interim, ATTRIB_NAS_Port, "42");
+	this->addAttribute(this->interim, ATTRIB_NAS_Identifier, "openvpn");
+	this->addAttribute(this->interim, ATTRIB_Service_Type, "5");
+	this->addAttribute(this->interim, ATTRIB_Framed_Protocol, "1");
+	this->addAttribute(this->interim, ATTRIB_NAS_Port_Type, "5");
+	this->addAttribute(this->interim, ATTRIB_Framed_IP_Address, "10.8.0.6");
+	this->addAttribute(this->interim, ATTRIB_Calling_Station_Id, "203.0.113.7");
+	this->addAttribute(this->interim, ATTRIB_Acct_Status_Type, "3");
+	this->addAttribute(this->interim, ATTRIB_Acct_Session_ID, "4f2a8c01d3e5b697");
+	this->addAttribute(this->interim, ATTRIB_Acct_Authentic, "1");
+	this->addAttribute(this->interim, ATTRIB_Acct_Session_Time, "3600");
+	this->addAttribute(this->interim, ATTRIB_Acct_Input_Octets, "123456789");
+	this->addAttribute(this->interim, ATTRIB_Acct_Output_Octets, "987654321");
+	this->addAttribute(this->interim, ATTRIB_Acct_Input_Gigawords, "1");
+	this->addAttribute(this->interim, ATTRIB_Acct_Output_Gigawords, "2");
+	this->addAttribute(this->interim, ATTRIB_Acct_Input_Packets, "100000");
+	this->addAttribute(this->interim, ATTRIB_Acct_Output_Packets, "200000");
+	this->addAttribute(this->interim, ATTRIB_Event_Timestamp, "1700000000");
+	if (this->interim->getRadiusAttribNumber() != 20 || this->interim->shapeRadiusPacket(BENCH_SECRET) != 0) {
+		return -1;
+	}
+
+	//the answer of the server with 50 routes and vendor specific attributes
+	this->addAttribute(this->accept, ATTRIB_Framed_IP_Address, "10.8.0.6");
+	this->addAttribute(this->accept, ATTRIB_Framed_IP_Netmask, "255.255.255.0");
+	this->addAttribute(this->accept, ATTRIB_Acct_Interim_Interval, "300");
+	this->addAttribute(this->accept, ATTRIB_Session_Timeout, "86400");
+	this->addAttribute(this->accept, ATTRIB_Class, "class-4f2a8c01d3e5b697");
+	for (i = 0; i < 50; i++) {
+		sprintf(route, "10.%d.%d.0/24 10.8.0.1 %d", 16 + i / 256, i % 256, i % 10 + 1);
+		this->addAttribute(this->accept, ATTRIB_Framed_Route, route);
+	}
+	for (i = 0; i < 10; i++) {
+		sprintf(value, "ip:inacl#%d=permit ip any 10.%d.0.0 0.0.255.255", i + 1, 16 + i);
+		this->addVendorAttribute(this->accept, 9, 1, value);
+	}
+	if (this->accept->shapeRadiusPacket(BENCH_SECRET) != 0) {
+		return -1;
+	}
+	buf = new Octet[this->accept->sendbufferlen];
+	memcpy(buf, this->accept->sendbuffer, this->accept->sendbufferlen);
+	this->accept->recvbuffer = buf;
+	this->accept->recvbufferlen = this->accept->sendbufferlen;
+	this->accept->attribs.clear();
+	memcpy(this->accept->sendbuffer, this->request->sendbuffer, 20);
+
+	//the response authenticator: MD5(code+identifier+length+request authenticator+attributes+secret)
+	buf = new Octet[this->accept->recvbufferlen + strlen(BENCH_SECRET)];
+	memcpy(buf, this->accept->recvbuffer, this->accept->recvbufferlen);
+	memcpy(buf + 4, this->request->sendbuffer + 4, RADIUS_PACKET_AUTHENTICATOR_LEN);
+	memcpy(buf + this->accept->recvbufferlen, BENCH_SECRET, strlen(BENCH_SECRET));
+	gcry_md_hash_buffer(GCRY_MD_MD5, digest, buf, this->accept->recvbufferlen + strlen(BENCH_SECRET));
+	memcpy(this->accept->recvbuffer + 4, digest, RADIUS_PACKET_AUTHENTICATOR_LEN);
+	delete[] buf;
+
+	if (this->accept->authenticateReceivedPacket(BENCH_SECRET) != 0 || this->accept->unShapeRadiusPacket() != 0
+			|| this->accept->getRadiusAttribNumber() != 65) {
+		return -1;
+	}
+	this->accept->attribs.clear();
+	return 0;
+}
+
+/** The benchmark of RadiusAttribute::makePasswordHash with a 64 byte password.*/
+void RadiusPacketBench::hashPassword(void) {
+	this->password->makePasswordHash((char *) this->password->getValue(), this->hpassword, BENCH_SECRET, this->request->getAuthenticator());
+}
+
+/** The benchmark of RadiusPacket::shapeRadiusPacket with the Access-Request, it includes the password hash.*/
+void RadiusPacketBench::shapeAccessRequest(void) {
+	this->request->shapeRadiusPacket(BENCH_SECRET);
+}
+
+/** The benchmark of RadiusPacket::shapeRadiusPacket with the Interim-Update.*/
+void RadiusPacketBench::shapeAccountingInterim(void) {
+	this->interim->shapeRadiusPacket(BENCH_SECRET);
+}
+
+/** The benchmark of RadiusPacket::calcacctdigest with the shaped Interim-Update.*/
+void RadiusPacketBench::digestAccountingInterim(void) {
+	this->interim->calcacctdigest(BENCH_SECRET);
+}
+
+/** The benchmark of RadiusPacket::unShapeRadiusPacket with the Access-Accept,
+ * it includes freeing the attributes like the destructor of the packet.
+ */
+void RadiusPacketBench::unShapeAccessAccept(void) {
+	this->accept->unShapeRadiusPacket();
+	this->accept->attribs.clear();
+}
+
+/** The benchmark of RadiusPacket::authenticateReceivedPacket with the Access-Accept.*/
+void RadiusPacketBench::authenticateAccessAccept(void) {
+	this->accept->authenticateReceivedPacket(BENCH_SECRET);
+}
+
+/** A benchmark.*/
+struct PacketBenchmark {
+	const char * name; /**< The name, it is used in the result files.*/
+	void (RadiusPacketBench::*run)(void); /**< The method which runs one operation.*/
+};
+
+/** All benchmarks.*/
+static PacketBenchmark benchmarks[] = {
+	{ "makePasswordHash/password64", &RadiusPacketBench::hashPassword },
+	{ "shapeRadiusPacket/access-request", &RadiusPacketBench::shapeAccessRequest },
+	{ "shapeRadiusPacket/acct-interim", &RadiusPacketBench::shapeAccountingInterim },
+	{ "calcacctdigest/acct-interim", &RadiusPacketBench::digestAccountingInterim },
+	{ "unShapeRadiusPacket/access-accept", &RadiusPacketBench::unShapeAccessAccept },
+	{ "authenticateReceivedPacket/access-accept", &RadiusPacketBench::authenticateAccessAccept },
+	{ NULL, NULL }
+};
+
+/** The function prints the usage.
+ * @param name The name of the program.
+ */
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-t milliseconds] [-w file] [-b file] [-T percent]\n", name);
+	exit(1);
+}
+
+/** The function reads a result file.
+ * @param path The path of the file.
+ * @param results The results: the name and the ns/op and allocs/op.
+ * @return 0 or -1 if the file can't be read.
+ */
+static int readResults(const char * path, map<string, pair<double, double> > * results) {
+	FILE * file = fopen(path, "r");
+	char name[128];
+	double ns, allocs;
+
+	if (file == NULL) {
+		return -1;
+	}
+	while (fscanf(file, "%127s %lf %lf", name, &ns, &allocs) == 3) {
+		(*results)[name] = pair<double, double>(ns, allocs);
+	}
+	fclose(file);
+	return 0;
+}
+
+int main(int argc, char ** argv) {
+	long long mintime = 200, start, t = 0;
+	unsigned long long iterations, i, allocs;
+	double threshold = 10, ns, allocsop, change;
+	const char * writepath = NULL, *basepath = NULL;
+	map<string, pair<double, double> > baseline;
+	RadiusPacketBench bench;
+	FILE * file = NULL;
+	int opt, b, regressions = 0;
+
+	while ((opt = getopt(argc, argv, "t:w:b:T:")) != -1) {
+		switch (opt) {
+			case 't':
+				mintime = atol(optarg);
+				break;
+			case 'w':
+				writepath = optarg;
+				break;
+			case 'b':
+				basepath = optarg;
+				break;
+			case 'T':
+				threshold = atof(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (mintime <= 0) {
+		usage(argv[0]);
+	}
+	if (basepath != NULL && readResults(basepath, &baseline) != 0) {
+		fprintf(stderr, "The baseline %s could not be read.\n", basepath);
+		return 1;
+	}
+	if (writepath != NULL && (file = fopen(writepath, "w")) == NULL) {
+		fprintf(stderr, "The results could not be written to %s.\n", writepath);
+		return 1;
+	}
+	if (bench.setUp() != 0) {
+		fprintf(stderr, "The packets of the benchmarks are not correct.\n");
+		return 1;
+	}
+
+#ifndef __GLIBC__
+	printf("only allocations with operator new are counted\n");
+#endif
+	for (b = 0; benchmarks[b].name != NULL; b++) {
+		//double the iterations until the run takes the minimal time, the first run warms up the caches
+		for (iterations = 1;; iterations *= 2) {
+			allocations = 0;
+			start = nanoTime();
+			for (i = 0; i < iterations; i++) {
+				(bench.*(benchmarks[b].run))();
+			}
+			t = nanoTime() - start;
+			allocs = allocations;
+			if (t >= mintime * 1000000LL) {
+				break;
+			}
+		}
+		ns = (double) t / iterations;
+		allocsop = (double) allocs / iterations;
+		printf("%-42s %10llu ops %12.1f ns/op %8.2f allocs/op", benchmarks[b].name, iterations, ns, allocsop);
+		if (file != NULL) {
+			fprintf(file, "%s %.1f %.2f\n", benchmarks[b].name, ns, allocsop);
+		}
+		if (baseline.find(benchmarks[b].name) != baseline.end()) {
+			pair<double, double> base = baseline[benchmarks[b].name];
+			change = base.first > 0 ? (ns - base.first) * 100 / base.first : 0;
+			printf("  %+7.1f%% ns/op %+6.2f allocs/op", change, allocsop - base.second);
+			if (change > threshold || allocsop > base.second + 0.005) {
+				printf("  REGRESSION");
+				regressions++;
+			}
+		}
+		printf("\n");
+	}
+	if (file != NULL) {
+		fclose(file);
+	}
+	return regressions > 0 ? 1 : 0;
+}
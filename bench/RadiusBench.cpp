@@ -0,0 +1,269 @@
+/*
+ *  radiusplugin -- An OpenVPN plugin for do radius authentication
+ *					and accounting.
+ *
+ *  Copyright (C) 2005 EWE TEL GmbH/Ralf Luebben <ralfluebben@gmx.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FakeRadiusServer.h"
+#include "../radiusplugin.h"
+#include "../RadiusClass/RadiusHistogram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+/** The benchmark of the plugin. It starts a FakeRadiusServer and drives the plugin
+ * (the foreground, the authentication and the accounting process) with simulated clients:
+ * every cycle all clients are authenticated and connected, stay connected for the hold time,
+ * so interim updates can be sent, and are disconnected.
+ * The throughput and the latency percentiles of the plugin calls are reported.
+ *
+ * Usage: radiusbench [-n clients] [-c cycles] [-h hold seconds] [-i interim interval]
+ *                    [-l latency usec] [-j jitter usec] [-L loss ratio] [-r reject ratio]
+ *                    [-o option=value]...
+ * The options of -o are appended to the plugin config, e.g. -o acctspool=/tmp/spool.
+ */
+
+/** The results of one kind of plugin call.*/
+struct BenchPhase {
+	const char * name; /**< The name of the call.*/
+	RadiusHistogram latency; /**< The latency of the calls in microseconds.*/
+	long long time; /**< The sum of the time of all cycles in microseconds.*/
+	int failed; /**< The number of calls which didn't succeed.*/
+};
+
+/** The function prints the usage.
+ * @param name The name of the program.
+ */
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-n clients] [-c cycles] [-h hold seconds] [-i interim interval] [-l latency usec] [-j jitter usec] "
+		"[-L loss ratio] [-r reject ratio] [-o option=value]...\n", name);
+	exit(1);
+}
+
+/** The function writes the status file of OpenVPN with the counters of all clients.
+ * @param path The path.
+ * @param clients The number of clients.
+ * @param cycle The cycle, the counters grow with every cycle.
+ */
+static void writeStatusFile(string path, int clients, int cycle) {
+	FILE * file = fopen(path.c_str(), "w");
+	int i;
+
+	if (file == NULL) {
+		return;
+	}
+	fprintf(file, "OpenVPN CLIENT LIST\nUpdated,Thu Jan  1 00:00:00 1970\nCommon Name,Real Address,Bytes Received,Bytes Sent,Connected Since\n");
+	for (i = 0; i < clients; i++) {
+		fprintf(file, "client%d,127.0.0.1:%d,%d,%d,Thu Jan  1 00:00:00 1970\n", i, 10000 + i, 1000 * (cycle + 1) + i, 2000 * (cycle + 1) + i);
+	}
+	fprintf(file, "ROUTING TABLE\nGLOBAL STATS\nEND\n");
+	fclose(file);
+}
+
+/** The function prints the results of a phase.
+ * @param phase The phase.
+ */
+static void printPhase(BenchPhase * phase) {
+	double seconds = phase->time / 1000000.0;
+
+	printf("%-10s %8llu calls %6d failed %10.0f calls/s  p50 %7ld us  p90 %7ld us  p99 %7ld us  max %7ld us\n", phase->name,
+			(unsigned long long) phase->latency.getCount(), phase->failed, seconds > 0 ? phase->latency.getCount() / seconds : 0,
+			phase->latency.getPercentile(50), phase->latency.getPercentile(90), phase->latency.getPercentile(99), phase->latency.getMax());
+}
+
+int main(int argc, char ** argv) {
+	int clients = 100, cycles = 1, hold = 0, interim = 0, opt, i, cycle, result;
+	long latency = 0, jitter = 0;
+	double loss = 0, reject = 0;
+	vector<string> options;
+	FakeRadiusServer server;
+	FakeRadiusStats stats;
+	BenchPhase phases[3];
+	char dir[] = "/tmp/radiusbench.XXXXXX";
+	char username[64], commonname[64], port[64], ip[64];
+	long long start, t;
+	unsigned int type_mask = 0;
+	openvpn_plugin_handle_t handle;
+
+	while ((opt = getopt(argc, argv, "n:c:h:i:l:j:L:r:o:")) != -1) {
+		switch (opt) {
+			case 'n':
+				clients = atoi(optarg);
+				break;
+			case 'c':
+				cycles = atoi(optarg);
+				break;
+			case 'h':
+				hold = atoi(optarg);
+				break;
+			case 'i':
+				interim = atoi(optarg);
+				break;
+			case 'l':
+				latency = atol(optarg);
+				break;
+			case 'j':
+				jitter = atol(optarg);
+				break;
+			case 'L':
+				loss = atof(optarg);
+				break;
+			case 'r':
+				reject = atof(optarg);
+				break;
+			case 'o':
+				options.push_back(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (clients <= 0 || clients > 60000 || cycles <= 0) {
+		usage(argv[0]);
+	}
+
+	//start the server, it is only in this process, the plugin closes its sockets in the background processes
+	server.setLatency(latency, jitter);
+	server.setLoss(loss);
+	server.setReject(reject);
+	server.setInterimInterval(interim);
+	if (server.start("benchsecret") != 0) {
+		fprintf(stderr, "The fake radius server could not be started.\n");
+		return 1;
+	}
+
+	//the config files of the plugin and of OpenVPN
+	if (mkdtemp(dir) == NULL) {
+		fprintf(stderr, "The directory for the config could not be created.\n");
+		return 1;
+	}
+	string path(dir);
+	mkdir((path + "/ccd").c_str(), 0700);
+	FILE * file = fopen((path + "/openvpn.conf").c_str(), "w");
+	fprintf(file, "client-config-dir %s/ccd\nstatus %s/status 10\n", dir, dir);
+	fclose(file);
+	writeStatusFile(path + "/status", clients, 0);
+	file = fopen((path + "/radiusplugin.conf").c_str(), "w");
+	fprintf(file, "NAS-Identifier=radiusbench\nService-Type=5\nFramed-Protocol=1\nNAS-Port-Type=5\nNAS-IP-Address=127.0.0.1\n"
+		"OpenVPNConfig=%s/openvpn.conf\noverwriteccfiles=true\nsessionslots=%d\n", dir, clients + 16);
+	for (i = 0; i < (int) options.size(); i++) {
+		fprintf(file, "%s\n", options[i].c_str());
+	}
+	fprintf(file, "server\n{\n\tacctport=%d\n\tauthport=%d\n\tname=127.0.0.1\n\tretry=3\n\twait=1\n\tsharedsecret=benchsecret\n}\n", server.getAcctPort(),
+			server.getAuthPort());
+	fclose(file);
+
+	string conf = path + "/radiusplugin.conf";
+	const char * pluginargv[] = { "radiusbench", conf.c_str(), NULL };
+	const char * pluginenv[] = { "verb=1", NULL };
+	handle = openvpn_plugin_open_v2(&type_mask, pluginargv, pluginenv, NULL);
+	if (handle == NULL) {
+		fprintf(stderr, "The plugin could not be opened.\n");
+		return 1;
+	}
+
+	phases[0].name = "auth";
+	phases[1].name = "connect";
+	phases[2].name = "disconnect";
+	for (i = 0; i < 3; i++) {
+		phases[i].latency.reset();
+		phases[i].time = 0;
+		phases[i].failed = 0;
+	}
+
+	vector<bool> connected(clients);
+	for (cycle = 0; cycle < cycles; cycle++) {
+		//authenticate and connect all clients
+		for (i = 0; i < clients; i++) {
+			sprintf(username, "username=user%d", i);
+			sprintf(commonname, "common_name=client%d", i);
+			sprintf(port, "untrusted_port=%d", 10000 + i);
+			sprintf(ip, "ifconfig_pool_remote_ip=10.%d.%d.%d", 8 + i / 65536, (i / 256) % 256, i % 256);
+			const char * env[] = { username, "password=benchpassword", "untrusted_ip=127.0.0.1", commonname, port, ip, NULL };
+
+			start = monotonicTime();
+			result = openvpn_plugin_func_v2(handle, OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY, pluginargv, env, NULL, NULL);
+			t = monotonicTime();
+			phases[0].latency.record(t - start);
+			phases[0].time += t - start;
+			connected[i] = false;
+			if (result != OPENVPN_PLUGIN_FUNC_SUCCESS) {
+				phases[0].failed++;
+				continue;
+			}
+			start = monotonicTime();
+			result = openvpn_plugin_func_v2(handle, OPENVPN_PLUGIN_CLIENT_CONNECT, pluginargv, env, NULL, NULL);
+			t = monotonicTime();
+			phases[1].latency.record(t - start);
+			phases[1].time += t - start;
+			if (result != OPENVPN_PLUGIN_FUNC_SUCCESS) {
+				phases[1].failed++;
+				continue;
+			}
+			connected[i] = true;
+		}
+
+		//the interim updates are sent while the clients are connected
+		if (hold > 0) {
+			writeStatusFile(path + "/status", clients, cycle);
+			sleep(hold);
+		}
+
+		//disconnect the connected clients
+		for (i = 0; i < clients; i++) {
+			if (!connected[i]) {
+				continue;
+			}
+			sprintf(username, "username=user%d", i);
+			sprintf(commonname, "common_name=client%d", i);
+			sprintf(port, "untrusted_port=%d", 10000 + i);
+			const char * env[] = { username, "untrusted_ip=127.0.0.1", commonname, port, NULL };
+
+			start = monotonicTime();
+			result = openvpn_plugin_func_v2(handle, OPENVPN_PLUGIN_CLIENT_DISCONNECT, pluginargv, env, NULL, NULL);
+			t = monotonicTime();
+			phases[2].latency.record(t - start);
+			phases[2].time += t - start;
+			if (result != OPENVPN_PLUGIN_FUNC_SUCCESS) {
+				phases[2].failed++;
+			}
+		}
+	}
+
+	//the stop packets are sent when the plugin is closed at the latest
+	start = monotonicTime();
+	openvpn_plugin_close_v1(handle);
+	t = monotonicTime();
+	stats = server.getStats();
+	server.stop();
+
+	printf("clients %d, cycles %d, hold %d s, interim %d s, latency %ld us, jitter %ld us, loss %.3f, reject %.3f\n", clients, cycles, hold, interim,
+			latency, jitter, loss, reject);
+	for (i = 0; i < 3; i++) {
+		printPhase(&phases[i]);
+	}
+	printf("close      %10lld us\n", t - start);
+	printf("server     %llu access requests, %llu accepts, %llu rejects, %llu starts, %llu updates, %llu stops, %llu dropped\n",
+			(unsigned long long) stats.accessrequests, (unsigned long long) stats.accepts, (unsigned long long) stats.rejects,
+			(unsigned long long) stats.starts, (unsigned long long) stats.updates, (unsigned long long) stats.stops,
+			(unsigned long long) stats.dropped);
+
+	system((string("rm -rf ") + dir).c_str());
+	return 0;
+}
@@ -29,8 +29,10 @@ rm -rf $RPM_BUILD_ROOT
 
 install -d %{buildroot}%{_libdir}/openvpn/plugin/lib
 install -d %{buildroot}%{_sysconfdir}/openvpn/auth
+install -d %{buildroot}%{_sbindir}
 
 install -m0755 openvpn-auth-radius.so -t %{buildroot}%{_libdir}/openvpn/plugin/lib/
+install -m0755 radiusplugind -t %{buildroot}%{_sbindir}/
 install -m0600 auth-radius.conf %{buildroot}%{_sysconfdir}/openvpn/auth/radius.conf  
 
 
@@ -43,4 +45,5 @@ rm -rf $RPM_BUILD_ROOT
 %doc COPYING README auth-radius.conf ToDo ChangeLog vsascript.pl
 %dir %{_sysconfdir}/openvpn/auth/
 %config(noreplace) %{_sysconfdir}/openvpn/auth/radius.conf
-%{_libdir}/openvpn/plugin/lib/openvpn-auth-radius.so 
+%{_libdir}/openvpn/plugin/lib/openvpn-auth-radius.so
+%{_sbindir}/radiusplugind 
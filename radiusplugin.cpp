@@ -39,6 +39,9 @@ extern "C" {
 	 * deletes routes in the system routing table.
 	 * The authentication process is a own process, too. So there is clear separation
 	 * and it is independent from the openvpn process.
+	 * With processmodel=thread the authentication and the accounting run in threads
+	 * of the OpenVPN process instead and only a privileged helper process is started (see PrivHelper).
+	 * With daemonsocket nothing is started, the plugin connects to the radius daemon (see RadiusDaemon).
 	 * @param The type of plugin, maybe client_connect, client_disconnect, user_auth_pass_verify...
 	 * @param A list of arguments which are set in the configuration file of openvpn in plugin line.
 	 * @param The list of environment variables, it is created by the OpenVpn-Process.
@@ -54,6 +57,9 @@ extern "C" {
 		/** An array for the socket pair of the accounting process.*/
 		int fd_acct[2];
 
+		/** The arrays for the socket pairs of the privileged helper process (thread model).*/
+		int fd_priv[2], fd_privacct[2];
+
 		/** The accounting background process object.*/
 		AccountingProcess Acct;
 
@@ -69,6 +75,9 @@ extern "C" {
 		// List for additional arguments
 		struct name_value_list name_value_list;
 
+		// The config file, the radius daemon reads it too
+		string configfile;
+
 		// There must be one param, the name of the plugin file
 		const int base_parms = 1;
 
@@ -107,6 +116,7 @@ extern "C" {
 
 			// parse the radiusplugin config file
 			cerr << getTime() << "RADIUS-PLUGIN: Config filename: " << name_value_list.data[0].value << ".\n";
+			configfile = name_value_list.data[0].value;
 			if (context->radiusconf.parseConfigFile(name_value_list.data[0].value) != 0 or context->conf.parseConfigFile(name_value_list.data[0].value) != 0) {
 				cerr << getTime() << "RADIUS-PLUGIN: Bad config file or error in config.\n";
 
@@ -116,6 +126,7 @@ extern "C" {
 		} else {
 			// if there is no filename, use the default
 			cerr << getTime() << "RADIUS-PLUGIN: Config filename: /etc/openvpn/radiusplugin.cnf.\n";
+			configfile = "/etc/openvpn/radiusplugin.cnf";
 			if (context->radiusconf.parseConfigFile("/etc/openvpn/radiusplugin.cnf") != 0 or context->conf.parseConfigFile("/etc/openvpn/radiusplugin.cnf") != 0) {
 				cerr << getTime() << "RADIUS-PLUGIN: Bad config file or error in config.\n";
 
@@ -125,6 +136,10 @@ extern "C" {
 
 		}
 
+		// The privileged operations only use the ccd path and the vsa script of the config,
+		// which is read here, before the helper process or the background processes are forked
+		context->privhelper.configure(context->conf);
+
 		// Intercept the --auth-user-pass-verify, --client-connect and --client-disconnect callback.
 		if (context->conf.getAccountingOnly() == false) {
 			*type_mask =	OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY) |
@@ -135,6 +150,145 @@ extern "C" {
 							OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_CLIENT_DISCONNECT);
 		}
 
+		// Map the session table, it is shared with the background processes or with the radius daemon.
+		if ((context->conf.getDaemonSocket().size() > 0 ? context->sessions.openShared(context->conf.getSessionSlots()) : context->sessions.open(context->conf.getSessionSlots())) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: session table could not be mapped\n";
+
+			delete context;
+			return 0;
+		}
+
+		// Allocate the session table on the node of the authentication, it reads and writes the table on every login
+		int tablenode = context->conf.getAuthNumaNode() >= 0 ? context->conf.getAuthNumaNode() : context->conf.getAcctNumaNode();
+		if (tablenode >= 0 && context->sessions.setNumaNode(tablenode) != 0)
+			cerr << getTime() << "RADIUS-PLUGIN: session table could not be allocated on numa node " << tablenode << ": " << strerror(errno) << "\n";
+
+		// Map the metrics and give every radius server a histogram of the response times
+		// and a counter of the outstanding requests,
+		// the background processes record into the same mapping. Without it nothing is recorded.
+		if (context->metrics.open() != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: metrics could not be mapped\n";
+		} else {
+			list<RadiusServer>::iterator server;
+			int i = 0;
+			for (server = context->radiusconf.getRadiusServer()->begin(); server != context->radiusconf.getRadiusServer()->end(); server++, i++) {
+				server->setRttHistogram(context->metrics.getServerHistogram(i));
+				server->setInflightCounter(context->metrics.getInflightCounter(i));
+			}
+		}
+
+		// Create the trace file before the fork, the background processes append their spans to it
+		if (context->conf.getTraceFile().size() > 0 && openTrace(context->conf.getTraceFile()) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: trace file " << context->conf.getTraceFile() << " could not be created\n";
+		}
+
+		// With the radius daemon nothing is forked, the authentication and the accounting of
+		// this instance run in the daemon, which is connected once for each of them
+		if (context->conf.getDaemonSocket().size() > 0) {
+			char resolved[PATH_MAX];
+			if (realpath(configfile.c_str(), resolved) != NULL)
+				configfile = resolved;
+			context->setConfigFile(configfile);
+
+			if (connect_daemon(context, &context->authsocketbackgr, DAEMON_AUTH, configfile) != 0 || connect_daemon(context, &context->acctsocketbackgr, DAEMON_ACCT, configfile) != 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: radius daemon " << context->conf.getDaemonSocket() << " could not be connected\n";
+
+				delete context;
+				return 0;
+			}
+
+			if (DEBUG(context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: Connected to the radius daemon " << context->conf.getDaemonSocket() << ".\n";
+
+			// buffer the log lines of the process
+			if (context->conf.getAsyncLog())
+				startAsyncLog();
+
+			return (openvpn_plugin_handle_t) context;
+		}
+
+		// In the thread model only the privileged helper is forked, the threads are started
+		// with the first call of openvpn_plugin_func_v2, OpenVPN may become a daemon before
+		if (context->conf.getProcessModel() == PROCESS_THREAD) {
+			// one socket for the authentication thread and one for the accounting thread
+			if (socketpair(PF_UNIX, SOCK_DGRAM, 0, fd_priv) == -1 || socketpair(PF_UNIX, SOCK_DGRAM, 0, fd_privacct) == -1) {
+				cerr << getTime() << "RADIUS-PLUGIN: socketpair call failed for the privileged helper\n";
+
+				delete context;
+				return 0;
+			}
+
+			pid = fork();
+			if (pid == 0) {
+				// Helper Process
+
+				// close all parent fds except the sockets of the threads
+				close_fds_except(fd_priv[1], fd_privacct[1]);
+
+				// Ignore most signals (the parent will receive them)
+				set_signals();
+
+				if (DEBUG(context->getVerbosity()))
+					cerr << getTime() << "RADIUS-PLUGIN: Start privileged helper\n";
+
+				// serve the threads until both sockets are closed
+				context->privhelper.serve(fd_priv[1], fd_privacct[1]);
+
+				// free the context of the helper process
+				delete context;
+
+				exit(0);
+			}
+
+			// close our copies of the helper's sockets
+			close(fd_priv[1]);
+			close(fd_privacct[1]);
+
+			if (pid < 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: fork failed for the privileged helper\n";
+				close(fd_priv[0]);
+				close(fd_privacct[0]);
+
+				delete context;
+				return 0;
+			}
+
+			// don't let future subprocesses inherit the sockets
+			if (fcntl(fd_priv[0], F_SETFD, FD_CLOEXEC) < 0 || fcntl(fd_privacct[0], F_SETFD, FD_CLOEXEC) < 0)
+				cerr << getTime() << "RADIUS-PLUGIN: Set FD_CLOEXEC flag on socket file descriptor failed\n";
+
+			if (DEBUG(context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: Start privileged helper with PID " << pid << ".\n";
+
+			context->privhelper.setSocket(fd_priv[0]);
+			context->privhelper.setPid(pid);
+
+			// The accounting thread gets its own context, the radius servers keep their
+			// state per thread like in the background processes, the session table and the metrics are shared
+			PluginContext * acctcontext = new PluginContext;
+			acctcontext->setVerbosity(context->getVerbosity());
+			acctcontext->conf = context->conf;
+			acctcontext->radiusconf = context->radiusconf;
+			acctcontext->sessions.attach(&context->sessions);
+			acctcontext->metrics.attach(&context->metrics);
+			acctcontext->privhelper.setSocket(fd_privacct[0]);
+			context->setAcctContext(acctcontext);
+
+			// The spool and the journal are opened now, the accounting thread starts after
+			// OpenVPN dropped the root rights and could not open or create the files
+			if (acctcontext->conf.getAcctSpool() != "" && acctcontext->acctspool.open(acctcontext, acctcontext->conf.getAcctSpool(),
+					acctcontext->conf.getAcctSpoolSize(), acctcontext->conf.getAcctSpoolSync()) != 0)
+				cerr << getTime() << "RADIUS-PLUGIN: spool " << acctcontext->conf.getAcctSpool() << " could not be opened\n";
+			if (acctcontext->conf.getSessionState() != "" && acctcontext->acctjournal.open(acctcontext->conf.getSessionState()) != 0)
+				cerr << getTime() << "RADIUS-PLUGIN: journal " << acctcontext->conf.getSessionState() << " could not be opened\n";
+
+			// buffer the log lines of the process
+			if (context->conf.getAsyncLog())
+				startAsyncLog();
+
+			return (openvpn_plugin_handle_t) context;
+		}
+
 		// Make a socket for foreground and background processes
 		// to communicate.
 		// Authentication process:
@@ -194,15 +348,26 @@ extern "C" {
 			// close all parent fds except our socket back to parent
 			close_fds_except(fd_auth[1]);
 
+			// the trace file was closed, open it again
+			if (reopenTrace() != 0)
+				cerr << getTime() << "RADIUS-PLUGIN: trace file could not be opened in the authentication process\n";
+
 			// Ignore most signals (the parent will receive them)
 			set_signals();
 
+			// pin the process before it starts threads, they inherit the affinity
+			pin_worker(context, false);
+
 			if (DEBUG(context->getVerbosity()))
 				cerr << getTime() << "RADIUS-PLUGIN: Start BACKGROUND Process for authentication\n";
 
 			// save the socket number in the context
 			context->authsocketforegr.setSocket(fd_auth[1]);
 
+			// buffer the log lines of the process
+			if (context->conf.getAsyncLog())
+				startAsyncLog();
+
 			// start the background event loop for accounting
 			Auth.Authentication(context);
 
@@ -212,6 +377,12 @@ extern "C" {
 			// free the context of the background process
 			delete context;
 
+			// write the buffered spans
+			closeTrace("radiusplugin authentication", false);
+
+			// write the buffered log lines
+			stopAsyncLog();
+
 			exit(0);
 		}
 
@@ -253,15 +424,26 @@ extern "C" {
 			// close all parent fds except our socket back to parent
 			close_fds_except(fd_acct[1]);
 
+			// the trace file was closed, open it again
+			if (reopenTrace() != 0)
+				cerr << getTime() << "RADIUS-PLUGIN: trace file could not be opened in the accounting process\n";
+
 			// Ignore most signals (the parent will receive them)
 			set_signals();
 
+			// pin the process before it starts threads, they inherit the affinity
+			pin_worker(context, true);
+
 			if (DEBUG(context->getVerbosity()))
 				cerr << getTime() << "RADIUS-PLUGIN: Start BACKGROUND Process for accounting\n";
 
 			// save the socket in the context
 			context->acctsocketforegr.setSocket(fd_acct[1]);
 
+			// buffer the log lines of the process
+			if (context->conf.getAsyncLog())
+				startAsyncLog();
+
 			//start the background event loop for accounting
 			Acct.Accounting(context);
 
@@ -271,9 +453,19 @@ extern "C" {
 			//free the context of the background process
 			delete context;
 
+			// write the buffered spans
+			closeTrace("radiusplugin accounting", false);
+
+			// write the buffered log lines
+			stopAsyncLog();
+
 			exit(0);
 		}
 
+		// buffer the log lines of the foreground process, the background processes are forked
+		if (context->conf.getAsyncLog())
+			startAsyncLog();
+
 		// return the context, this is used between the functions
 		return (openvpn_plugin_handle_t) context;
 	}
@@ -292,6 +484,7 @@ extern "C" {
 	 * sending the information to the background process.
 	 * CLIENT_DISCONNECT: The user is deleted from the
 	 * accounting by sending the information to the background process.
+	 * The background process answers at once and stops the disconnected users in batches.
 	 * @param The handle which was allocated in the open function.
 	 * @param The type of plugin, maybe client_conect, client_disconnect, auth_user_pass_verify
 	 * @param A list of arguments which are set in the openvpn configuration file.
@@ -309,6 +502,11 @@ extern "C" {
 			pthread_cond_init(context->getCondRecv(), NULL);
 			pthread_mutex_init(context->getMutexRecv(), NULL);
 
+			// the accounting thread of the thread model
+			if (context->getAcctContext() != NULL && start_accounting_thread(context) != 0) {
+				cerr << getTime() << "RADIUS-PLUGIN: Accounting thread creation failed.\n";
+			}
+
 			if (context->conf.getAccountingOnly() == false && pthread_create(context->getThread(), NULL, &auth_user_pass_verify, (void *) context) != 0) {
 				cerr << getTime() << "RADIUS-PLUGIN: Thread creation failed.\n";
 				return OPENVPN_PLUGIN_FUNC_ERROR;
@@ -321,21 +519,28 @@ extern "C" {
 		string common_name; /**<A string for the common_name from the enviroment.*/
 		string untrusted_ip; /** untrusted_ip for ipv6 support **/
 
+		// with the radius daemon a closed connection is connected again at the next call
+		bool daemon = context->conf.getDaemonSocket().size() > 0;
+
 		///////////// OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY
-		if (type == OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY && (context->authsocketbackgr.getSocket()) >= 0) {
+		if (type == OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY && (context->authsocketbackgr.getSocket() >= 0 || context->conf.getProcessModel() == PROCESS_THREAD || daemon)) {
 			if (DEBUG ( context->getVerbosity() ))
 				cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY is called." << endl;
 
 			try {
-				// create a new user
+				// create a new user, every login is a new request in the trace
+				long long start = monotonicTime();
+				uint32_t traceid = newTraceId();
 				UserPlugin* newuser = new UserPlugin();
 				get_user_env(context, type, envp, newuser);
+				newuser->setTraceId(traceid);
 
 				if (newuser->getAuthControlFile().length() > 0 && context->conf.getUseAuthControlFile()) {
 					pthread_mutex_lock(context->getMutexSend());
 					context->addNewUser(newuser);
 					pthread_cond_signal(context->getCondSend());
 					pthread_mutex_unlock(context->getMutexSend());
+					traceSpan("auth_user_pass_verify", traceid, start);
 					return OPENVPN_PLUGIN_FUNC_DEFERRED;
 				} else {
 					pthread_mutex_lock(context->getMutexRecv());
@@ -345,9 +550,11 @@ extern "C" {
 					pthread_mutex_unlock(context->getMutexSend());
 
 					pthread_cond_wait(context->getCondRecv(), context->getMutexRecv());
+					int result = context->getResult();
 					pthread_mutex_unlock(context->getMutexRecv());
 
-					return context->getResult();
+					traceSpan("auth_user_pass_verify", traceid, start);
+					return result;
 				}
 			} catch (Exception &e) {
 				cerr << getTime() << e;
@@ -357,11 +564,12 @@ extern "C" {
 		}
 
 		///////////// CLIENT_CONNECT
-		if (type == OPENVPN_PLUGIN_CLIENT_CONNECT && context->acctsocketbackgr.getSocket() >= 0) {
+		if (type == OPENVPN_PLUGIN_CLIENT_CONNECT && (context->acctsocketbackgr.getSocket() >= 0 || daemon)) {
 			if (DEBUG ( context->getVerbosity() ))
 				cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: OPENVPN_PLUGIN_CLIENT_CONNECT is called.\n";
 
 			try {
+				long long connectstart = monotonicTime();
 				UserPlugin* tmpuser = new UserPlugin();
 				get_user_env(context, type, envp, tmpuser);
 
@@ -373,8 +581,15 @@ extern "C" {
 						newuser->setAuthenticated(true); //the plugin does not care about it
 						newuser->setPortnumber(context->addNasPort());
 						newuser->setSessionId(createSessionId(newuser));
+						newuser->setTraceId(newTraceId());
 						//add the user to the context
 						context->addUser(newuser);
+						if (newuser->getSlot() < 0) {
+							context->delNasPort(newuser->getPortnumber());
+							context->delUser(newuser->getKey());
+							delete newuser;
+							throw Exception("RADIUS-PLUGIN: FOREGROUND: Session table is full.\n");
+						}
 					} else {
 						throw Exception("RADIUS-PLUGIN: FOREGROUND: User should be accounted but is unknown, should only occur if accountingonly=true.\n");
 					}
@@ -397,23 +612,25 @@ extern "C" {
 					if (DEBUG(context->getVerbosity()))
 						cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Add user for accounting: username: " << newuser->getUsername() << ", commonname: "<< newuser->getCommonname() << "\n";
 
-					//send information to the background process
-					context->acctsocketbackgr.send(ADD_USER);
-					context->acctsocketbackgr.send(newuser->getUsername());
-					context->acctsocketbackgr.send(newuser->getSessionId());
-					context->acctsocketbackgr.send(newuser->getPortnumber());
-					context->acctsocketbackgr.send(newuser->getCallingStationId());
-					context->acctsocketbackgr.send(newuser->getFramedIp());
-					context->acctsocketbackgr.send(newuser->getCommonname());
-					context->acctsocketbackgr.send(newuser->getAcctInterimInterval());
-					context->acctsocketbackgr.send(newuser->getFramedRoutes());
-					context->acctsocketbackgr.send(newuser->getKey());
-					context->acctsocketbackgr.send(newuser->getStatusFileKey());
-					context->acctsocketbackgr.send(newuser->getUntrustedPort());
-					context->acctsocketbackgr.send(newuser->getVsaBuf(), newuser->getVsaBufLen());
-
-					//get the response
-					const int status = context->acctsocketbackgr.recvInt();
+					//write the information to the session table, the framed ip may be changed
+					int length = context->sessions.writeUser(newuser->getSlot(), newuser);
+					if (length != 0) {
+						ostringstream msg;
+						msg << "RADIUS-PLUGIN: FOREGROUND: User could not be written to the session table, the record has " << length
+								<< " bytes, a slot holds " << SESSION_SLOT_DATA << " bytes and there are not enough free slots for the rest.\n";
+						throw Exception(msg.str());
+					}
+
+					//send the slot to the background process
+					long long start = monotonicTime();
+					int status = RESPONSE_FAILED;
+					try {
+						status = call_background(context, &context->acctsocketbackgr, ADD_USER, newuser->getSlot(), "");
+					} catch (Exception &e) {
+						cerr << getTime() << e;
+					}
+					context->metrics.record(METRIC_ACCT_IPC, monotonicTime() - start);
+					traceSpan("client_connect", newuser->getTraceId(), connectstart);
 					if (status == RESPONSE_SUCCEEDED) {
 						newuser->setAccounted(true);
 
@@ -450,7 +667,7 @@ extern "C" {
 		}
 
 		///////////// OPENVPN_PLUGIN_CLIENT_DISCONNECT
-		if (type == OPENVPN_PLUGIN_CLIENT_DISCONNECT && context->acctsocketbackgr.getSocket() >= 0) {
+		if (type == OPENVPN_PLUGIN_CLIENT_DISCONNECT && (context->acctsocketbackgr.getSocket() >= 0 || daemon)) {
 			if (DEBUG ( context->getVerbosity() ))
 				cerr << getTime() << "\n\nRADIUS-PLUGIN: FOREGROUND: OPENVPN_PLUGIN_CLIENT_DISCONNECT is called.\n";
 
@@ -468,12 +685,16 @@ extern "C" {
 					if (DEBUG ( context->getVerbosity() ))
 						cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Delete user from accounting: commonname: " << newuser->getKey() << "\n";
 
-					//send the information to the background process
-					context->acctsocketbackgr.send(DEL_USER);
-					context->acctsocketbackgr.send(newuser->getKey());
-
-					//get the response
-					const int status = context->acctsocketbackgr.recvInt();
+					//send the slot to the background process
+					long long start = monotonicTime();
+					int status = RESPONSE_FAILED;
+					try {
+						status = call_background(context, &context->acctsocketbackgr, DEL_USER, newuser->getSlot(), "");
+					} catch (Exception &e) {
+						cerr << getTime() << e;
+					}
+					context->metrics.record(METRIC_ACCT_IPC, monotonicTime() - start);
+					traceSpan("client_disconnect", newuser->getTraceId(), start);
 					if (status == RESPONSE_SUCCEEDED) {
 						if (DEBUG(context->getVerbosity()))
 							cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Accounting for user with key" << newuser->getKey() << " stopped!\n";
@@ -513,6 +734,12 @@ extern "C" {
 	OPENVPN_PLUGIN_DEF void OPENVPN_PLUGIN_FUNC(openvpn_plugin_close_v1)(openvpn_plugin_handle_t handle) {
 		//restore the context
 		PluginContext *context = (PluginContext *) handle;
+		bool asynclog = context->conf.getAsyncLog();
+
+		// the background processes are killed if they don't exit until the deadline
+		long long deadline = 0;
+		if (context->conf.getShutdownDeadline() > 0)
+			deadline = monotonicTime() + (context->conf.getShutdownDeadline() + SHUTDOWN_GRACE) * 1000000LL;
 
 		if (DEBUG(context->getVerbosity()))
 			cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: close\n";
@@ -530,7 +757,7 @@ extern "C" {
 
 			// wait for background process to exit
 			if (context->getAuthPid() > 0)
-				waitpid(context->getAuthPid(), NULL, 0);
+				wait_process(context->getAuthPid(), deadline);
 
 		}
 
@@ -546,9 +773,11 @@ extern "C" {
 				cerr << getTime() << e;
 			}
 
-			// wait for background process to exit
+			// wait for background process or the accounting thread to exit
 			if (context->getAcctPid() > 0)
-				waitpid(context->getAcctPid(), NULL, 0);
+				wait_process(context->getAcctPid(), deadline);
+			else if (context->getAcctContext() != NULL)
+				pthread_join(*context->getAcctThread(), NULL);
 
 		}
 
@@ -572,8 +801,26 @@ extern "C" {
 			cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Auth thread was not started so far.\n";
 		}
 
+		// the threads are stopped, stop the privileged helper
+		if (context->privhelper.getPid() > 0) {
+			if (DEBUG(context->getVerbosity()))
+				cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: close privileged helper.\n";
+
+			context->privhelper.stop();
+			context->getAcctContext()->privhelper.stop();
+			wait_process(context->privhelper.getPid(), deadline);
+		}
+		delete context->getAcctContext();
+
 		delete context;
 		cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: DONE.\n";
+
+		// write the buffered spans and close the JSON array, the background processes have exited
+		closeTrace("openvpn", true);
+
+		// write the buffered log lines, the plugin may be unloaded after the return
+		if (asynclog)
+			stopAsyncLog();
 	}
 }
 
@@ -630,12 +877,13 @@ int string_array_len(const char *array[]) {
  * of FD_CLOEXEC which will stop
  * fds from crossing a fork().
  * @param The socket number which should not be closed.
+ * @param A second socket number which should not be closed, -1 if there is none.
  */
-void close_fds_except(int keep) {
+void close_fds_except(int keep, int keep2) {
 	int i;
 	closelog();
 	for (i = 3; i <= 100; ++i) {
-		if (i != keep)
+		if (i != keep && i != keep2)
 			close(i);
 	}
 }
@@ -654,6 +902,27 @@ void set_signals(void) {
 	signal(SIGPIPE,	SIG_IGN);
 }
 
+/** The function waits until a background process exits. If the
+ * process is still running at the deadline, it is killed.
+ * @param pid The process id.
+ * @param deadline The time (monotonic, in microseconds), 0 waits without limit.
+ */
+void wait_process(pid_t pid, long long deadline) {
+	if (deadline == 0) {
+		waitpid(pid, NULL, 0);
+		return;
+	}
+	while (waitpid(pid, NULL, WNOHANG) == 0) {
+		if (monotonicTime() >= deadline) {
+			cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Background process " << pid << " didn't exit until the shutdown deadline, it is killed.\n";
+			kill(pid, SIGKILL);
+			waitpid(pid, NULL, 0);
+			return;
+		}
+		usleep(10000);
+	}
+}
+
 /** The function creates a md5 hash string as session ID over
  * - user->commonname
  * - user->callingstationid
@@ -701,6 +970,199 @@ string createSessionId(UserPlugin * user) {
 	return string(text);
 }
 
+/** The function connects to the radius daemon for the authentication or the accounting of this instance.
+ * The daemon gets the verbosity, the config file and the descriptor of the session table, it runs the event
+ * loop of the background process for the connection and answers with RESPONSE_INIT_SUCCEEDED.
+ * The foreground sends the same commands over the connection as over the socket to a background process.
+ * @param context The context of the plugin.
+ * @param sock The socket of the foreground, it gets the connection.
+ * @param channel DAEMON_AUTH or DAEMON_ACCT.
+ * @param configfile The absolute path of the config file.
+ * @return 0 or -1 if the daemon could not be connected.
+ */
+int connect_daemon(PluginContext * context, IpcSocket * sock, int channel, string configfile) {
+	struct sockaddr_un addr;
+	int fd;
+
+	if (context->conf.getDaemonSocket().size() >= sizeof(addr.sun_path))
+		return -1;
+	fd = socket(PF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	// don't let future subprocesses inherit the connection
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+		cerr << getTime() << "RADIUS-PLUGIN: Set FD_CLOEXEC flag on socket file descriptor failed\n";
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, context->conf.getDaemonSocket().c_str(), sizeof(addr.sun_path) - 1);
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: connect to the radius daemon failed: " << strerror(errno) << "\n";
+		close(fd);
+		return -1;
+	}
+
+	sock->setSocket(fd);
+	try {
+		sock->send(channel);
+		sock->send(context->getVerbosity());
+		sock->send(configfile);
+		sock->sendFd(context->sessions.getFd());
+
+		// wait for the event loop in the daemon
+		if (sock->recvInt() == RESPONSE_INIT_SUCCEEDED)
+			return 0;
+	} catch (Exception &e) {
+		cerr << getTime() << e;
+	}
+	sock->setSocket(-1);
+	close(fd);
+	return -1;
+}
+
+/** The function sends a command with the slot of a user to the background process and returns the response.
+ * With the radius daemon a failed connection, e.g. after a restart of the daemon, is connected again
+ * and the command is sent once more. The daemon stopped the accounting of the users of the instance
+ * when the connection was closed, so after a new accounting connection the accounted users are
+ * added again and DEL_USER succeeds without being sent.
+ * @param context The context of the plugin.
+ * @param sock The socket to the background process, authsocketbackgr or acctsocketbackgr.
+ * @param command COMMAND_VERIFY, ADD_USER or DEL_USER.
+ * @param slot The slot of the user in the session table.
+ * @param password The password of the user for COMMAND_VERIFY.
+ * @return The response of the background process.
+ * @throws Exception if the background process or the radius daemon isn't reachable.
+ */
+int call_background(PluginContext * context, IpcSocket * sock, int command, int slot, string password) {
+	int channel = (sock == &context->authsocketbackgr ? DAEMON_AUTH : DAEMON_ACCT);
+	list<UserPlugin *> users;
+	list<UserPlugin *>::iterator user;
+
+	for (int attempt = 0;; attempt++) {
+		try {
+			if (sock->getSocket() < 0)
+				throw Exception(Exception::SOCKETSEND);
+			sock->send(command);
+			sock->send(slot);
+			if (command == COMMAND_VERIFY)
+				sock->send(password);
+			return sock->recvInt();
+		} catch (Exception &e) {
+			if (context->conf.getDaemonSocket().size() == 0)
+				throw;
+		}
+
+		// the daemon closed the connection, it was restarted or it isn't running
+		if (sock->getSocket() >= 0) {
+			close(sock->getSocket());
+			sock->setSocket(-1);
+		}
+		if (attempt > 0 || connect_daemon(context, sock, channel, context->getConfigFile()) != 0)
+			throw Exception("RADIUS-PLUGIN: FOREGROUND: The radius daemon " + context->conf.getDaemonSocket() + " is not reachable, the "
+					+ (channel == DAEMON_AUTH ? "authentication" : "accounting") + " of the user fails.\n");
+		cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Connected to the radius daemon " << context->conf.getDaemonSocket() << " again.\n";
+
+		if (channel == DAEMON_ACCT) {
+			users = context->getAccountedUsers();
+			for (user = users.begin(); user != users.end(); user++) {
+				if ((*user)->getSlot() == slot)
+					continue;
+				sock->send(ADD_USER);
+				sock->send((*user)->getSlot());
+				if (sock->recvInt() != RESPONSE_SUCCEEDED)
+					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND: Accounting failed for user: " << (*user)->getUsername() << ".\n";
+			}
+			if (command == DEL_USER)
+				return RESPONSE_SUCCEEDED;
+		}
+	}
+}
+
+/** The function pins the calling process or thread of the authentication or the accounting to the
+ * cpus and the numa node from the config, see pinThread(). A failure is only logged.
+ * @param context The context of the plugin.
+ * @param acct True for the accounting, false for the authentication.
+ */
+void pin_worker(PluginContext * context, bool acct) {
+	string cpus = acct ? context->conf.getAcctCpus() : context->conf.getAuthCpus();
+	int node = acct ? context->conf.getAcctNumaNode() : context->conf.getAuthNumaNode();
+
+	if (cpus.size() == 0 && node < 0)
+		return;
+	if (pinThread(cpus, node) != 0) {
+		cerr << getTime() << "RADIUS-PLUGIN: The " << (acct ? "accounting" : "authentication") << " could not be pinned to the cpus " << cpus << " and the numa node " << node << ": " << strerror(errno) << "\n";
+	} else if (DEBUG(context->getVerbosity())) {
+		cerr << getTime() << "RADIUS-PLUGIN: The " << (acct ? "accounting" : "authentication") << " is pinned to the cpus " << cpus << " and the numa node " << node << ".\n";
+	}
+}
+
+/** The function starts the accounting thread of the thread model and waits until it is initialized.
+ * The thread gets a socket pair like the background process, the foreground sends only the slots over it,
+ * it wakes up the event loop of the accounting.
+ * @param context The context of the plugin, the accounting thread uses the context from getAcctContext().
+ * @return 0 or -1 if the thread could not be started.
+ */
+int start_accounting_thread(PluginContext * context) {
+	int fd_acct[2];
+
+	if (socketpair(PF_UNIX, SOCK_DGRAM, 0, fd_acct) == -1) {
+		cerr << getTime() << "RADIUS-PLUGIN: socketpair call failed for accounting thread\n";
+		return -1;
+	}
+	if (fcntl(fd_acct[0], F_SETFD, FD_CLOEXEC) < 0 || fcntl(fd_acct[1], F_SETFD, FD_CLOEXEC) < 0)
+		cerr << getTime() << "RADIUS-PLUGIN: Set FD_CLOEXEC flag on socket file descriptor failed\n";
+
+	context->getAcctContext()->acctsocketforegr.setSocket(fd_acct[1]);
+	if (pthread_create(context->getAcctThread(), NULL, &accounting_thread, (void *) context->getAcctContext()) != 0) {
+		close(fd_acct[0]);
+		close(fd_acct[1]);
+		context->getAcctContext()->acctsocketforegr.setSocket(-1);
+		return -1;
+	}
+
+	// wait for the thread to initialize, set the socket to -1 if the initialization failed
+	context->acctsocketbackgr.setSocket(fd_acct[0]);
+	try {
+		if (context->acctsocketbackgr.recvInt() != RESPONSE_INIT_SUCCEEDED)
+			context->acctsocketbackgr.setSocket(-1);
+	} catch (Exception &e) {
+		cerr << getTime() << e;
+		context->acctsocketbackgr.setSocket(-1);
+	}
+	if (DEBUG(context->getVerbosity()))
+		cerr << getTime() << "RADIUS-PLUGIN: Start accounting thread\n";
+	return 0;
+}
+
+/** The function implements the accounting thread of the thread model, it runs the
+ * event loop of the background process for accounting in the OpenVPN process.
+ * @param c The context of the accounting thread.
+ */
+void * accounting_thread(void * c) {
+	PluginContext * context = (PluginContext *) c;
+
+	/** The accounting of the thread.*/
+	AccountingProcess acct;
+
+	//ignore signals, the main thread of OpenVPN handles them
+	sigset_t signal_mask;
+	sigemptyset(&signal_mask);
+	sigaddset(&signal_mask, SIGINT);
+	sigaddset(&signal_mask, SIGTERM);
+	sigaddset(&signal_mask, SIGHUP);
+	sigaddset(&signal_mask, SIGUSR1);
+	sigaddset(&signal_mask, SIGUSR2);
+	sigaddset(&signal_mask, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+	// only this thread is pinned, not the OpenVPN process
+	pin_worker(context, true);
+
+	acct.Accounting(context);
+	return NULL;
+}
+
 /** The function implements the thread for authentication. If the auth_control_file is specified the thread writes the results in the
  * auth_control_file, if the file is not specified the thread forward the OPENVPN_PLUGIN_FUNC_SUCCESS or OPENVPN_PLUGIN_FUNC_ERROR
  * to the main process.
@@ -710,6 +1172,9 @@ string createSessionId(UserPlugin * user) {
 void* auth_user_pass_verify(void* c) {
 	PluginContext * context = (PluginContext *) c;
 
+	/** The authentication of the thread model.*/
+	AuthenticationProcess auth;
+
 	if (DEBUG(context->getVerbosity()))
 		cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Auth_user_pass_verify thread started." << endl;
 
@@ -726,6 +1191,10 @@ void* auth_user_pass_verify(void* c) {
 	sigaddset(&signal_mask, SIGPIPE);
 	pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
 
+	// in the thread model the thread authenticates itself, it is pinned like the authentication process
+	if (context->conf.getProcessModel() == PROCESS_THREAD && context->conf.getDaemonSocket().size() == 0)
+		pin_worker(context, false);
+
 	//main thread loop for authentication
 	while (!context->getStopThread()) {
 		if (context->UserWaitingtoAuth() == false) {
@@ -767,6 +1236,7 @@ void* auth_user_pass_verify(void* c) {
 			olduser->setPassword(newuser->getPassword());
 			olduser->setUsername(newuser->getUsername());
 			olduser->setAuthControlFile(newuser->getAuthControlFile());
+			olduser->setTraceId(newuser->getTraceId());
 
 			//delete the newuser and use the olduser
 			delete newuser;
@@ -787,50 +1257,55 @@ void* auth_user_pass_verify(void* c) {
 				<< "\nRADIUS-PLUGIN: FOREGROUND THREAD:\t newuser port: " << newuser->getUntrustedPort() << endl;
 
 
-		// there must be a username
-		if (newuser->getUsername().size() > 0) { //&& olduser==NULL)
-			//send the informations to the background process
-			context->authsocketbackgr.send(COMMAND_VERIFY);
-			context->authsocketbackgr.send(newuser->getUsername());
-			context->authsocketbackgr.send(newuser->getPassword());
-			context->authsocketbackgr.send(newuser->getPortnumber());
-			context->authsocketbackgr.send(newuser->getSessionId());
-			context->authsocketbackgr.send(newuser->getCallingStationId());
-			context->authsocketbackgr.send(newuser->getCommonname());
-			context->authsocketbackgr.send(newuser->getFramedIp());
-
+		int length = 0;
+		if (newuser->getSlot() < 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Session table is full." << endl;
+		} else if ((length = context->sessions.writeUser(newuser->getSlot(), newuser)) != 0) {
+			cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: The record of " << length << " bytes doesn't fit in the session table, a slot holds "
+					<< SESSION_SLOT_DATA << " bytes and there are not enough free slots for the rest." << endl;
+		}
 
-			//get the response
-			const int status = context->authsocketbackgr.recvInt();
+		// there must be a username and a slot in the session table
+		if (newuser->getUsername().size() > 0 && newuser->getSlot() >= 0 && length == 0) { //&& olduser==NULL)
+			//send the slot and the password to the background process,
+			//the password isn't written to the session table
+			long long start = monotonicTime();
+			int status;
+			if (context->conf.getProcessModel() == PROCESS_THREAD && context->conf.getDaemonSocket().size() == 0) {
+				//the thread model authenticates the user in this thread
+				status = auth.verify(context, newuser->getSlot(), newuser->getPassword());
+			} else {
+				// the user is rejected if the background process or the radius daemon isn't reachable
+				try {
+					status = call_background(context, &context->authsocketbackgr, COMMAND_VERIFY, newuser->getSlot(), newuser->getPassword());
+				} catch (Exception &e) {
+					cerr << getTime() << e;
+					status = RESPONSE_FAILED;
+				}
+			}
+			context->metrics.record(METRIC_AUTH_IPC, monotonicTime() - start);
+			traceSpan("auth ipc", newuser->getTraceId(), start);
+			context->metrics.add(status == RESPONSE_SUCCEEDED ? METRIC_AUTH_ACCEPTED : METRIC_AUTH_REJECTED);
 			if (status == RESPONSE_SUCCEEDED) {
 				if (DEBUG(context->getVerbosity()))
 					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Authentication succeeded!" << endl;
 
-				// get the routes from background process
-				newuser->setFramedRoutes(context->authsocketbackgr.recvStr());
+				// get the parsed attributes, the background process wrote them to the session table
+				context->sessions.readUser(newuser->getSlot(), newuser);
 				if (DEBUG(context->getVerbosity()))
 					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Received routes for user: " << newuser->getFramedRoutes() << "." << endl;
 
 				// get the framed ip
-				newuser->setFramedIp(context->authsocketbackgr.recvStr());
+				newuser->setFramedIp(newuser->getAttributes()->getString(BLOB_FRAMED_IP));
 				if (DEBUG(context->getVerbosity()))
 					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Received framed ip for user: " << newuser->getFramedIp() << "." << endl;
 
 
-				// get the interval from the background process
-				newuser->setAcctInterimInterval(context->authsocketbackgr.recvInt());
+				// get the interval
+				newuser->setAcctInterimInterval(newuser->getAttributes()->getInt(BLOB_ACCT_INTERIM_INTERVAL));
 				if (DEBUG(context->getVerbosity()))
 					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Receive acctinteriminterval " << newuser->getAcctInterimInterval() << " sec from backgroundprocess." << endl;
 
-				// clear the buffer if it isn't empty
-				if (newuser->getVsaBuf() != NULL) {
-					delete[] newuser->getVsaBuf();
-					newuser->setVsaBuf(NULL);
-				}
-
-				// get the vendor specific attribute buffer from the background process
-				context->authsocketbackgr.recvBuf(newuser);
-
 				//add the user to the context
 				// if the is already in the map, addUser will throw an exception
 				// only add the user if he it not known already
@@ -858,12 +1333,13 @@ void* auth_user_pass_verify(void* c) {
 					cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Error at re-keying!" << endl;
 
 					// error on authenticate user at re-keying -> delete the user!
-					// send the information to the background process
-					context->acctsocketbackgr.send(DEL_USER);
-					context->acctsocketbackgr.send(newuser->getKey());
-
-					//get the response
-					const int status = context->acctsocketbackgr.recvInt();
+					// send the slot to the background process
+					int status = RESPONSE_FAILED;
+					try {
+						status = call_background(context, &context->acctsocketbackgr, DEL_USER, newuser->getSlot(), "");
+					} catch (Exception &e) {
+						cerr << getTime() << e;
+					}
 					if (status == RESPONSE_SUCCEEDED) {
 						if (DEBUG(context->getVerbosity()))
 							cerr << getTime() << "RADIUS-PLUGIN: FOREGROUND THREAD: Accounting for user with key" << newuser->getKey() << " stopped!" << endl;
@@ -935,14 +1411,21 @@ void write_auth_control_file(PluginContext * context, string filename, char c) {
 /** Returns the current time:
  * @return The current time as a string.
  */
-string getTime() {
-	time_t rawtime;
-	struct tm * timeinfo;
-	time(&rawtime);
-	timeinfo = localtime(&rawtime);
-	string t(ctime(&rawtime));
-	t.replace(t.find("\n"), 1, " ");
-	return t;
+/** The function returns the time for the log lines, e.g. "Mon Oct 19 08:25:56 2026 ".
+ * The text is formatted once per second and thread, so a log line costs no allocation.
+ * @return The time, the pointer is valid in the thread until the next call.
+ */
+const char * getTime(void) {
+	static __thread time_t cachedtime = -1;
+	static __thread char cached[32];
+	time_t now = time(NULL);
+
+	if (now != cachedtime) {
+		ctime_r(&now, cached);
+		cached[strcspn(cached, "\n")] = ' ';
+		cachedtime = now;
+	}
+	return cached;
 }
 
 void get_user_env(PluginContext * context, const int type, const char * envp[], UserPlugin * user) {
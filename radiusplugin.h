@@ -29,8 +29,10 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <dlfcn.h>
 #include <syslog.h>
@@ -63,13 +65,23 @@
 #include "Exception.h"
 #include "AccountingProcess.h"
 #include "AuthenticationProcess.h"
+#include "LogBuffer.h"
+#include "CpuAffinity.h"
 
 using namespace std;
 
 /** This file defines some constants and some functions. The constants and functions
  * are the original function from openvpn auth-pam plugin.*/
 
-#define DEBUG(verb) ((verb) >= 5) /**< A macro for the debugging.*/
+#define RADIUS_LOG_DEBUG	0 /**< The level of the debug messages.*/
+#define RADIUS_LOG_INFO		1 /**< The level of the other messages.*/
+
+/** The lowest level of the log messages which are compiled in, e.g. -DRADIUS_LOG_MIN_LEVEL=1 removes the debug messages.*/
+#ifndef RADIUS_LOG_MIN_LEVEL
+#define RADIUS_LOG_MIN_LEVEL RADIUS_LOG_DEBUG
+#endif
+
+#define DEBUG(verb) (RADIUS_LOG_MIN_LEVEL <= RADIUS_LOG_DEBUG && (verb) >= 5) /**< A macro for the debugging.*/
 
 /* Command codes for foreground -> background communication */
 #define COMMAND_VERIFY 0 /**<The verify command for the background process.*/
@@ -83,6 +95,12 @@ using namespace std;
 #define RESPONSE_SUCCEEDED 12 			/**< Response code from background process to foreground procce.*/
 #define RESPONSE_FAILED    13 			/**< Response code from background process to foreground procce.*/
 
+/* Channels of the connections to the radius daemon */
+#define DAEMON_AUTH	30 /**<The connection runs the authentication of an instance.*/
+#define DAEMON_ACCT	31 /**<The connection runs the accounting of an instance.*/
+
+#define SHUTDOWN_GRACE	2 /**< The time in seconds after the shutdown deadline until a background process is killed.*/
+
 /** A struct for additional command line arguments.*/
 struct name_value {
 	const char *name; /**<The name of name value pair.*/
@@ -99,12 +117,18 @@ struct name_value_list {
 
 const char * get_env(const char *name, const char *envp[]);
 int string_array_len(const char *array[]);
-void close_fds_except(int keep);
+void close_fds_except(int keep, int keep2 = -1);
 void set_signals(void);
+void wait_process(pid_t, long long);
 string createSessionId(UserPlugin *);
 void get_user_env(PluginContext *, const int type, const char *envp[], UserPlugin *);
 void * auth_user_pass_verify(void *);
+int connect_daemon(PluginContext *, IpcSocket *, int, string);
+int call_background(PluginContext *, IpcSocket *, int, int, string);
+void pin_worker(PluginContext *, bool);
+int start_accounting_thread(PluginContext *);
+void * accounting_thread(void *);
 void write_auth_control_file(PluginContext *, string filename, char c);
-string getTime();
+const char * getTime(void);
 
 #endif //_PLUGIN_H_